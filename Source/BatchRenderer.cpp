@@ -0,0 +1,294 @@
+///////////////////////////////////////////////////////////////////////////////
+// BatchRenderer.cpp
+// =================
+// Offscreen rendering of many views, read back through a PBO ring and
+// written by encoder threads.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include "BatchRenderer.h"
+#include "Parallel.h"
+#include "Bmp.h"
+
+
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    float getMilliseconds(Clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    }
+
+    // RGB rows packed with no padding, the layout Bmp::save() takes
+    size_t getImageSize(const BatchRenderer::View& view)
+    {
+        return (size_t)view.width * view.height * 3;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// one view per line: x y z yaw pitch width height [output]
+///////////////////////////////////////////////////////////////////////////////
+bool BatchRenderer::readViews(const char* path, std::vector<View>& views)
+{
+    std::ifstream file(path);
+    if(!file)
+    {
+        std::cout << "[ERROR] BatchRenderer: failed to open " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    for(unsigned int number = 1; std::getline(file, line); ++number)
+    {
+        line = line.substr(0, line.find('#'));
+        if(line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        std::istringstream values(line);
+        View view;
+        values >> view.position[0] >> view.position[1] >> view.position[2] >> view.yaw >> view.pitch >> view.width >> view.height;
+        if(!values || view.width <= 0 || view.height <= 0)
+        {
+            std::cout << "[ERROR] BatchRenderer: invalid view at " << path << ":" << number << std::endl;
+            return false;
+        }
+        if(!(values >> view.output))
+        {
+            std::ostringstream name;
+            name << "view_" << std::setw(6) << std::setfill('0') << views.size() << ".bmp";
+            view.output = name.str();
+        }
+        views.push_back(view);
+    }
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor/dtor
+///////////////////////////////////////////////////////////////////////////////
+BatchRenderer::BatchRenderer() : views(0), framebuffer(0), colorBuffer(0), depthBuffer(0),
+                                 framebufferWidth(0), framebufferHeight(0), failedCount(0), encodeTime(0)
+{
+}
+
+BatchRenderer::~BatchRenderer()
+{
+    destroy();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// render every view, read it back without waiting for the GPU and let the
+// encoders write it
+///////////////////////////////////////////////////////////////////////////////
+BatchRenderer::Stats BatchRenderer::run(const std::vector<View>& views, RenderFunction render,
+                                        unsigned int threadCount, unsigned int ringSize)
+{
+    Stats stats = {};
+    if(threadCount == 0)
+        threadCount = std::max(Parallel::getDefaultThreadCount(), 2u) - 1;
+    if(ringSize == 0)
+        ringSize = 2 * threadCount + 2;
+    stats.threadCount = threadCount;
+    stats.viewCount = (unsigned int)views.size();
+    if(views.empty())
+        return stats;
+
+    // every buffer fits the largest view
+    this->views = &views;
+    size_t largest = 0;
+    for(size_t i = 0; i < views.size(); ++i)
+        largest = std::max(largest, getImageSize(views[i]));
+    ring.create(largest, ringSize);
+
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &colorBuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    failedCount = 0;
+    encodeTime = 0;
+    for(unsigned int i = 0; i < threadCount; ++i)
+        encoders.push_back(std::thread(&BatchRenderer::encoderLoop, this));
+
+    Clock::time_point start = Clock::now();
+    double renderTime = 0, waitTime = 0;
+    for(size_t i = 0; i < views.size(); ++i)
+    {
+        const View& view = views[i];
+        Clock::time_point renderStart = Clock::now();
+        resizeFramebuffer(view.width, view.height);
+        glViewport(0, 0, view.width, view.height);
+        render(view);
+        renderTime += getMilliseconds(renderStart);
+
+        // the oldest buffer, once the GPU and its encoder are done with it
+        Clock::time_point waitStart = Clock::now();
+        const int slot = ring.getFreeSlot(true);
+        waitTime += getMilliseconds(waitStart);
+        if(slot < 0)
+        {
+            // every readback timed out, the views left cannot be read back
+            std::cout << "[ERROR] BatchRenderer: no buffer left, " << views.size() - i << " views skipped" << std::endl;
+            std::lock_guard<std::mutex> lock(mutex);
+            failedCount += (unsigned int)(views.size() - i);
+            break;
+        }
+
+        renderStart = Clock::now();
+        ring.read(slot, (unsigned int)i, view.width, view.height, GL_RGB);
+        renderTime += getMilliseconds(renderStart);
+    }
+
+    // the last readbacks, then the encoders finish the queue; a view whose readback timed out fails
+    ring.poll(true);
+    const unsigned int lostCount = ring.getLostCount();
+    destroy();
+
+    stats.totalTime = getMilliseconds(start);
+    stats.renderTime = (float)renderTime;
+    stats.waitTime = (float)waitTime;
+    stats.encodeTime = (float)encodeTime;
+    stats.failedCount = failedCount + lostCount;
+    return stats;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// join the encoders once the queue is written and release the GL objects
+///////////////////////////////////////////////////////////////////////////////
+void BatchRenderer::destroy()
+{
+    ring.close();
+    for(size_t i = 0; i < encoders.size(); ++i)
+        encoders[i].join();
+    encoders.clear();
+    ring.destroy();
+
+    if(framebuffer)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        framebuffer = colorBuffer = depthBuffer = 0;
+        framebufferWidth = framebufferHeight = 0;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// reallocate the color and depth buffers when the view size changes
+///////////////////////////////////////////////////////////////////////////////
+void BatchRenderer::resizeFramebuffer(int width, int height)
+{
+    if(width == framebufferWidth && height == framebufferHeight)
+        return;
+
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "[ERROR] BatchRenderer: incomplete framebuffer at " << width << " x " << height << std::endl;
+    framebufferWidth = width;
+    framebufferHeight = height;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// write the views the GL thread hands over, until stopped and drained
+///////////////////////////////////////////////////////////////////////////////
+void BatchRenderer::encoderLoop()
+{
+    unsigned int slot;
+    while(ring.take(slot))
+    {
+        // the rows are bottom to top as GL reads them, as a Bmp stores them
+        const View& view = (*views)[ring.getTag(slot)];
+        Clock::time_point start = Clock::now();
+        Image::Bmp bmp;
+        bool written = bmp.save(view.output.c_str(), view.width, view.height, 3, ring.getPixels(slot));
+        if(!written)
+            std::cout << "[ERROR] BatchRenderer: " << view.output << ": " << bmp.getError() << std::endl;
+        float time = getMilliseconds(start);
+        ring.release(slot);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        encodeTime += time;
+        if(!written)
+            ++failedCount;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// print a run
+///////////////////////////////////////////////////////////////////////////////
+void BatchRenderer::printStats(const Stats& stats)
+{
+    const float views = (float)std::max(stats.viewCount, 1u);
+    std::cout << "===== BatchRenderer: " << stats.viewCount << " views, " << stats.threadCount << " encoder threads =====\n"
+              << std::fixed << std::setprecision(2)
+              << "     Speed: " << (stats.totalTime > 0 ? stats.viewCount * 1000.0f / stats.totalTime : 0.0f) << " views/s ("
+              << stats.totalTime / 1000.0f << " s, " << stats.failedCount << " failed)\n"
+              << "  GL Thread: " << stats.renderTime / views << " ms render + readback, "
+              << stats.waitTime / views << " ms waiting for a buffer per view\n"
+              << "   Encoders: " << stats.encodeTime / views << " ms per view" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// the same views with more and more encoder threads
+///////////////////////////////////////////////////////////////////////////////
+void BatchRenderer::benchmark(const std::vector<View>& views, RenderFunction render)
+{
+    // up to one per core, the GL thread mostly waits on the GPU
+    const unsigned int maxThreads = std::max(Parallel::getDefaultThreadCount(), 2u);
+    std::vector<Stats> runs;
+    for(unsigned int threads = 1; ; threads = std::min(threads * 2, maxThreads))
+    {
+        BatchRenderer batch;
+        runs.push_back(batch.run(views, render, threads));
+        if(threads == maxThreads)
+            break;
+    }
+
+    std::cout << "===== BatchRenderer Benchmark: " << views.size() << " views =====\n"
+              << std::fixed << std::setprecision(2);
+    for(size_t i = 0; i < runs.size(); ++i)
+    {
+        const Stats& s = runs[i];
+        const float speed = s.totalTime > 0 ? s.viewCount * 1000.0f / s.totalTime : 0.0f;
+        const float base = runs[0].totalTime > 0 ? runs[0].viewCount * 1000.0f / runs[0].totalTime : 0.0f;
+        std::cout << "  " << std::setw(2) << s.threadCount << " threads: " << std::setw(8) << speed << " views/s, "
+                  << (base > 0 ? speed / base : 0.0f) << "x, GL thread waited "
+                  << s.waitTime / std::max(s.viewCount, 1u) << " ms per view\n";
+    }
+    std::cout << std::flush;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
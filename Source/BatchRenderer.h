@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////////
+// BatchRenderer.h
+// ===============
+// Renders a list of camera views offscreen and writes each one to a Bmp file,
+// e.g. thumbnails of the scene from thousands of viewpoints.
+//
+// run() is called on the GL thread. For each view it binds a framebuffer
+// object of the view's size, calls the render function, and issues
+// glReadPixels() into a pixel pack buffer (PBO) of a ReadbackRing. The
+// pixels are handed to the encoder threads once the fence is signaled, and
+// the threads write the files with Bmp::save(). The GL thread only renders
+// and issues readbacks, so it never waits on the disk; it waits for a buffer
+// only when every buffer of the ring is still being encoded.
+//
+// No window or GPU is needed besides a context: the caller makes a hidden
+// window, which works with a software GL (Mesa llvmpipe, e.g. under xvfb-run
+// with LIBGL_ALWAYS_SOFTWARE=1 on a server without GPU).
+//
+// The views file has a view per line, '#' starts a comment:
+//     x y z yaw pitch width height [output.bmp]
+// Position and angles are those of Camera (degrees); without an output name
+// the view is written to view_000042.bmp. assets/views.txt is a ring of
+// thumbnails around the scene:
+//     OpenGLSample --batch-render assets/views.txt [--threads 4]
+//     OpenGLSample --benchmark-batch assets/views.txt
+//
+// usage:
+//     std::vector<BatchRenderer::View> views;
+//     BatchRenderer::readViews("views.txt", views);
+//     BatchRenderer batch;
+//     BatchRenderer::Stats stats = batch.run(views, [](const BatchRenderer::View& view) { draw(view); });
+//     BatchRenderer::printStats(stats);
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef BATCH_RENDERER_H
+#define BATCH_RENDERER_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include "ReadbackRing.h"
+
+class BatchRenderer
+{
+public:
+    // a camera pose and its output image
+    struct View
+    {
+        float position[3];
+        float yaw;                          // degrees, like Camera
+        float pitch;
+        int width;
+        int height;
+        std::string output;
+    };
+
+    // draws the scene for a view, the framebuffer and viewport are bound already
+    typedef std::function<void(const View& view)> RenderFunction;
+
+    struct Stats
+    {
+        unsigned int threadCount;           // encoder threads
+        unsigned int viewCount;
+        unsigned int failedCount;           // views not written
+        float totalTime;                    // ms from the first view to the last file
+        float renderTime;                   // ms of the GL thread in the render function and readbacks
+        float waitTime;                     // ms of the GL thread waiting for a free buffer
+        float encodeTime;                   // ms of the encoder threads, all threads summed
+    };
+
+    // read the views of a file, return false if it cannot be read or a line is invalid
+    static bool readViews(const char* path, std::vector<View>& views);
+
+    BatchRenderer();
+    ~BatchRenderer();
+
+    // render and write every view, on the GL thread
+    // threadCount = 0 uses one encoder per core minus the GL thread
+    // ringSize = 0 uses 2 buffers per encoder thread plus 2
+    Stats run(const std::vector<View>& views, RenderFunction render, unsigned int threadCount = 0, unsigned int ringSize = 0);
+
+    // print the views per second and where the GL thread spent its time
+    static void printStats(const Stats& stats);
+    // run the views with 1, 2, 4... encoder threads up to one per core and print the views per second of each
+    static void benchmark(const std::vector<View>& views, RenderFunction render);
+
+private:
+    // not copyable, owns threads and GL objects
+    BatchRenderer(const BatchRenderer&);
+    BatchRenderer& operator=(const BatchRenderer&);
+
+    void destroy();
+    void resizeFramebuffer(int width, int height);
+    void encoderLoop();
+
+    const std::vector<View>* views;
+    ReadbackRing ring;                      // buffers of the largest view, tagged with the view index
+
+    // offscreen target, resized to each view
+    GLuint framebuffer;
+    GLuint colorBuffer;
+    GLuint depthBuffer;
+    int framebufferWidth;
+    int framebufferHeight;
+
+    // encoders
+    std::vector<std::thread> encoders;
+    std::mutex mutex;                       // the encoders' stats
+    unsigned int failedCount;               // guarded by mutex
+    double encodeTime;                      // guarded by mutex
+};
+
+#endif
@@ -0,0 +1,555 @@
+///////////////////////////////////////////////////////////////////////////////
+// BlockCompression.cpp
+// ====================
+// BC1/BC3/BC4/BC5/BC7 block encoders.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "BlockCompression.h"
+#include "Parallel.h"
+
+
+
+namespace
+{
+    // 4x4 pixels, 4 channels each, row by row
+    struct Block
+    {
+        float pixels[16][4];
+    };
+
+    // read the 4x4 block at (bx, by) in 4x4 units, repeating the last row/column past the edges
+    // the channels the image does not have are 0, and alpha 255
+    void loadBlock(const unsigned char* image, int width, int height, int channels, int bx, int by, Block& block)
+    {
+        for(int y = 0; y < 4; ++y)
+        {
+            const int sy = std::min(by * 4 + y, height - 1);
+            for(int x = 0; x < 4; ++x)
+            {
+                const int sx = std::min(bx * 4 + x, width - 1);
+                const unsigned char* src = image + ((size_t)sy * width + sx) * channels;
+                float* dst = block.pixels[y * 4 + x];
+                dst[0] = dst[1] = dst[2] = 0.0f;
+                dst[3] = 255.0f;
+                for(int c = 0; c < channels; ++c)
+                    dst[c] = src[c];
+            }
+        }
+    }
+
+    // grey (+ alpha) to RGBA for the color formats
+    void expandGrey(int channels, Block& block)
+    {
+        if(channels > 2)
+            return;
+        for(int i = 0; i < 16; ++i)
+        {
+            float* p = block.pixels[i];
+            p[3] = channels == 2 ? p[1] : 255.0f;
+            p[1] = p[2] = p[0];
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // direction of the largest spread of the first dims channels of the block,
+    // with a few power iterations on their covariance matrix
+    // return false if every pixel is the same
+    ///////////////////////////////////////////////////////////////////////////
+    bool getPrincipalAxis(const Block& block, int dims, float mean[4], float axis[4])
+    {
+        float lo[4], hi[4];
+        for(int c = 0; c < dims; ++c)
+        {
+            mean[c] = 0.0f;
+            lo[c] = hi[c] = block.pixels[0][c];
+        }
+        for(int i = 0; i < 16; ++i)
+        {
+            for(int c = 0; c < dims; ++c)
+            {
+                mean[c] += block.pixels[i][c];
+                lo[c] = std::min(lo[c], block.pixels[i][c]);
+                hi[c] = std::max(hi[c], block.pixels[i][c]);
+            }
+        }
+        for(int c = 0; c < dims; ++c)
+            mean[c] /= 16.0f;
+
+        float cov[4][4] = {};
+        for(int i = 0; i < 16; ++i)
+        {
+            float d[4];
+            for(int c = 0; c < dims; ++c)
+                d[c] = block.pixels[i][c] - mean[c];
+            for(int r = 0; r < dims; ++r)
+                for(int c = 0; c < dims; ++c)
+                    cov[r][c] += d[r] * d[c];
+        }
+
+        // start from the bounding box diagonal, already close for most blocks
+        float length = 0.0f;
+        for(int c = 0; c < dims; ++c)
+        {
+            axis[c] = hi[c] - lo[c];
+            length += axis[c] * axis[c];
+        }
+        if(length == 0.0f)
+            return false;
+
+        for(int iteration = 0; iteration < 8; ++iteration)
+        {
+            float next[4] = {};
+            for(int r = 0; r < dims; ++r)
+                for(int c = 0; c < dims; ++c)
+                    next[r] += cov[r][c] * axis[c];
+
+            length = 0.0f;
+            for(int c = 0; c < dims; ++c)
+                length += next[c] * next[c];
+            if(length == 0.0f)
+                break;              // no correlation, keep the diagonal
+            length = 1.0f / std::sqrt(length);
+            for(int c = 0; c < dims; ++c)
+                axis[c] = next[c] * length;
+        }
+        return true;
+    }
+
+    // ends of the block's span along the axis
+    void getEndpoints(const Block& block, int dims, const float mean[4], const float axis[4], float e0[4], float e1[4])
+    {
+        float lo = 0.0f, hi = 0.0f;
+        for(int i = 0; i < 16; ++i)
+        {
+            float t = 0.0f;
+            for(int c = 0; c < dims; ++c)
+                t += (block.pixels[i][c] - mean[c]) * axis[c];
+            lo = std::min(lo, t);
+            hi = std::max(hi, t);
+        }
+        for(int c = 0; c < dims; ++c)
+        {
+            e0[c] = std::min(std::max(mean[c] + axis[c] * hi, 0.0f), 255.0f);
+            e1[c] = std::min(std::max(mean[c] + axis[c] * lo, 0.0f), 255.0f);
+        }
+    }
+
+    // squared distance of the first dims channels
+    float distance(const float* a, const float* b, int dims)
+    {
+        float sum = 0.0f;
+        for(int c = 0; c < dims; ++c)
+            sum += (a[c] - b[c]) * (a[c] - b[c]);
+        return sum;
+    }
+
+    void writeBits(unsigned char* dst, unsigned int& bit, unsigned int value, unsigned int count)
+    {
+        for(unsigned int i = 0; i < count; ++i, ++bit)
+        {
+            if(value & (1u << i))
+                dst[bit >> 3] |= (unsigned char)(1u << (bit & 7));
+        }
+    }
+
+
+
+    ///////////////////////////////////////////////////////////////////////////
+    // BC1: 2 RGB565 endpoints, 4 colors, 2-bit indices
+    ///////////////////////////////////////////////////////////////////////////
+    unsigned short toRgb565(const float color[3])
+    {
+        int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+        int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+        int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+        return (unsigned short)((r << 11) | (g << 5) | b);
+    }
+
+    void fromRgb565(unsigned short c, float color[3])
+    {
+        int r = (c >> 11) & 31;
+        int g = (c >> 5) & 63;
+        int b = c & 31;
+        color[0] = (float)((r << 3) | (r >> 2));
+        color[1] = (float)((g << 2) | (g >> 4));
+        color[2] = (float)((b << 3) | (b >> 2));
+    }
+
+    // 4-color palette of the endpoints, in index order, c0 > c1 so there is no transparent entry
+    void getPaletteBC1(unsigned short c0, unsigned short c1, float palette[4][3])
+    {
+        fromRgb565(c0, palette[0]);
+        fromRgb565(c1, palette[1]);
+        for(int c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+    }
+
+    // nearest palette entry of each pixel, return the total error
+    float getIndicesBC1(const Block& block, const float palette[4][3], unsigned int indices[16])
+    {
+        float error = 0.0f;
+        for(int i = 0; i < 16; ++i)
+        {
+            float best = distance(block.pixels[i], palette[0], 3);
+            indices[i] = 0;
+            for(unsigned int j = 1; j < 4; ++j)
+            {
+                float d = distance(block.pixels[i], palette[j], 3);
+                if(d < best)
+                {
+                    best = d;
+                    indices[i] = j;
+                }
+            }
+            error += best;
+        }
+        return error;
+    }
+
+    // quantize, order and index the endpoints, return the error
+    float fitBC1(const Block& block, const float e0[3], const float e1[3], unsigned short& c0, unsigned short& c1, unsigned int indices[16])
+    {
+        c0 = toRgb565(e0);
+        c1 = toRgb565(e1);
+        if(c0 < c1)
+            std::swap(c0, c1);
+        if(c0 == c1)
+        {
+            // c0 <= c1 is the 3 color mode, where entry 0 is still c0
+            float color[3];
+            fromRgb565(c0, color);
+            std::fill(indices, indices + 16, 0u);
+            float error = 0.0f;
+            for(int i = 0; i < 16; ++i)
+                error += distance(block.pixels[i], color, 3);
+            return error;
+        }
+
+        float palette[4][3];
+        getPaletteBC1(c0, c1, palette);
+        return getIndicesBC1(block, palette, indices);
+    }
+
+    // endpoints minimizing the error of the indices (least squares)
+    // return false if the indices do not separate the endpoints
+    bool refineBC1(const Block& block, const unsigned int indices[16], float e0[3], float e1[3])
+    {
+        static const float WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+        float ax[3] = {}, bx[3] = {};
+        for(int i = 0; i < 16; ++i)
+        {
+            const float a = WEIGHTS[indices[i]];
+            const float b = 1.0f - a;
+            aa += a * a;
+            bb += b * b;
+            ab += a * b;
+            for(int c = 0; c < 3; ++c)
+            {
+                ax[c] += a * block.pixels[i][c];
+                bx[c] += b * block.pixels[i][c];
+            }
+        }
+        const float det = aa * bb - ab * ab;
+        if(std::fabs(det) < 1e-6f)
+            return false;
+        for(int c = 0; c < 3; ++c)
+        {
+            e0[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / det, 0.0f), 255.0f);
+            e1[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / det, 0.0f), 255.0f);
+        }
+        return true;
+    }
+
+    void encodeBC1(const Block& block, unsigned char* dst)
+    {
+        float mean[4], axis[4], e0[4], e1[4];
+        if(getPrincipalAxis(block, 3, mean, axis))
+        {
+            getEndpoints(block, 3, mean, axis, e0, e1);
+        }
+        else
+        {
+            std::copy(mean, mean + 3, e0);
+            std::copy(mean, mean + 3, e1);
+        }
+
+        unsigned short c0, c1;
+        unsigned int indices[16];
+        float error = fitBC1(block, e0, e1, c0, c1, indices);
+
+        // one least squares pass on the endpoints, kept if it lowers the error
+        if(error > 0.0f && refineBC1(block, indices, e0, e1))
+        {
+            unsigned short r0, r1;
+            unsigned int refined[16];
+            if(fitBC1(block, e0, e1, r0, r1, refined) < error)
+            {
+                c0 = r0;
+                c1 = r1;
+                std::copy(refined, refined + 16, indices);
+            }
+        }
+
+        dst[0] = (unsigned char)(c0 & 0xff);
+        dst[1] = (unsigned char)(c0 >> 8);
+        dst[2] = (unsigned char)(c1 & 0xff);
+        dst[3] = (unsigned char)(c1 >> 8);
+        unsigned int bits = 0;
+        for(int i = 0; i < 16; ++i)
+            bits |= indices[i] << (i * 2);
+        dst[4] = (unsigned char)(bits & 0xff);
+        dst[5] = (unsigned char)((bits >> 8) & 0xff);
+        dst[6] = (unsigned char)((bits >> 16) & 0xff);
+        dst[7] = (unsigned char)(bits >> 24);
+    }
+
+
+
+    ///////////////////////////////////////////////////////////////////////////
+    // BC4: 1 channel, 2 8-bit endpoints, 8 values, 3-bit indices
+    ///////////////////////////////////////////////////////////////////////////
+    void encodeBC4(const Block& block, int channel, unsigned char* dst)
+    {
+        float lo = block.pixels[0][channel], hi = lo;
+        for(int i = 1; i < 16; ++i)
+        {
+            lo = std::min(lo, block.pixels[i][channel]);
+            hi = std::max(hi, block.pixels[i][channel]);
+        }
+
+        // e0 > e1 selects the 8 value mode, e0 == e1 only uses entry 0
+        const int e0 = (int)(hi + 0.5f);
+        const int e1 = (int)(lo + 0.5f);
+        float palette[8];
+        palette[0] = (float)e0;
+        palette[1] = (float)e1;
+        for(int j = 2; j < 8; ++j)
+            palette[j] = (float)(((8 - j) * e0 + (j - 1) * e1) / 7);
+
+        std::memset(dst, 0, 8);
+        dst[0] = (unsigned char)e0;
+        dst[1] = (unsigned char)e1;
+        unsigned int bit = 16;
+        for(int i = 0; i < 16; ++i)
+        {
+            unsigned int index = 0;
+            if(e0 != e1)
+            {
+                float best = std::fabs(block.pixels[i][channel] - palette[0]);
+                for(unsigned int j = 1; j < 8; ++j)
+                {
+                    float d = std::fabs(block.pixels[i][channel] - palette[j]);
+                    if(d < best)
+                    {
+                        best = d;
+                        index = j;
+                    }
+                }
+            }
+            writeBits(dst, bit, index, 3);
+        }
+    }
+
+
+
+    ///////////////////////////////////////////////////////////////////////////
+    // BC7 mode 6: 1 subset, RGBA 7.7.7.7 endpoints + 1 p-bit each,
+    // 16 colors, 4-bit indices (3 for the first pixel)
+    ///////////////////////////////////////////////////////////////////////////
+    const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    struct Bc7Fit
+    {
+        int endpoints[2][4];            // 7 bits per channel
+        int pbits[2];
+        unsigned int indices[16];
+        float error;
+    };
+
+    void fitBC7(const Block& block, const float e0[4], const float e1[4], int p0, int p1, Bc7Fit& fit)
+    {
+        const float* ends[2] = { e0, e1 };
+        const int pbits[2] = { p0, p1 };
+        int colors[2][4];
+        for(int e = 0; e < 2; ++e)
+        {
+            fit.pbits[e] = pbits[e];
+            for(int c = 0; c < 4; ++c)
+            {
+                int q = (int)((ends[e][c] - pbits[e]) * 0.5f + 0.5f);
+                q = std::min(std::max(q, 0), 127);
+                fit.endpoints[e][c] = q;
+                colors[e][c] = (q << 1) | pbits[e];
+            }
+        }
+
+        float palette[16][4];
+        for(int j = 0; j < 16; ++j)
+            for(int c = 0; c < 4; ++c)
+                palette[j][c] = (float)(((64 - BC7_WEIGHTS[j]) * colors[0][c] + BC7_WEIGHTS[j] * colors[1][c] + 32) >> 6);
+
+        fit.error = 0.0f;
+        for(int i = 0; i < 16; ++i)
+        {
+            float best = distance(block.pixels[i], palette[0], 4);
+            fit.indices[i] = 0;
+            for(unsigned int j = 1; j < 16; ++j)
+            {
+                float d = distance(block.pixels[i], palette[j], 4);
+                if(d < best)
+                {
+                    best = d;
+                    fit.indices[i] = j;
+                }
+            }
+            fit.error += best;
+        }
+    }
+
+    void encodeBC7(const Block& block, unsigned char* dst)
+    {
+        float mean[4], axis[4], e0[4], e1[4];
+        if(getPrincipalAxis(block, 4, mean, axis))
+        {
+            getEndpoints(block, 4, mean, axis, e0, e1);
+        }
+        else
+        {
+            std::copy(mean, mean + 4, e0);
+            std::copy(mean, mean + 4, e1);
+        }
+
+        // the p-bits are the shared low bit of each endpoint, try all 4
+        // unless the block is opaque: only odd endpoints can be exactly 255
+        bool opaque = true;
+        for(int i = 0; i < 16 && opaque; ++i)
+            opaque = block.pixels[i][3] == 255.0f;
+
+        Bc7Fit best, fit;
+        fitBC7(block, e0, e1, 1, 1, best);
+        for(int p = 0; p < 3 && !opaque && best.error > 0.0f; ++p)
+        {
+            fitBC7(block, e0, e1, p & 1, p >> 1, fit);
+            if(fit.error < best.error)
+                best = fit;
+        }
+
+        // the high bit of the first index is implied 0, swap the endpoints if it is set
+        if(best.indices[0] & 8)
+        {
+            for(int c = 0; c < 4; ++c)
+                std::swap(best.endpoints[0][c], best.endpoints[1][c]);
+            std::swap(best.pbits[0], best.pbits[1]);
+            for(int i = 0; i < 16; ++i)
+                best.indices[i] = 15 - best.indices[i];
+        }
+
+        std::memset(dst, 0, 16);
+        unsigned int bit = 0;
+        writeBits(dst, bit, 1u << 6, 7);                    // mode 6
+        for(int c = 0; c < 4; ++c)
+        {
+            writeBits(dst, bit, best.endpoints[0][c], 7);
+            writeBits(dst, bit, best.endpoints[1][c], 7);
+        }
+        writeBits(dst, bit, best.pbits[0], 1);
+        writeBits(dst, bit, best.pbits[1], 1);
+        writeBits(dst, bit, best.indices[0], 3);
+        for(int i = 1; i < 16; ++i)
+            writeBits(dst, bit, best.indices[i], 4);
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// sizes and names
+///////////////////////////////////////////////////////////////////////////////
+unsigned int BlockCompression::getBlockSize(Format format)
+{
+    return (format == BC1 || format == BC4) ? 8 : 16;
+}
+
+size_t BlockCompression::getImageSize(Format format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+}
+
+const char* BlockCompression::getName(Format format)
+{
+    switch(format)
+    {
+    case BC1: return "BC1";
+    case BC3: return "BC3";
+    case BC4: return "BC4";
+    case BC5: return "BC5";
+    case BC7: return "BC7";
+    }
+    return "?";
+}
+
+BlockCompression::Format BlockCompression::getFormat(int channels, bool highQuality)
+{
+    if(channels == 1)
+        return BC4;
+    if(channels == 2)
+        return BC5;
+    if(highQuality)
+        return BC7;
+    return channels == 3 ? BC1 : BC3;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// encode every block, each thread a range of block rows
+///////////////////////////////////////////////////////////////////////////////
+void BlockCompression::compress(const unsigned char* image, int width, int height, int channels, Format format,
+                                unsigned char* dst, unsigned int threadCount)
+{
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+    const unsigned int blockSize = getBlockSize(format);
+
+    Parallel::forEach((unsigned int)blocksY, threadCount, [&](unsigned int begin, unsigned int end, unsigned int) {
+        Block block;
+        for(unsigned int by = begin; by < end; ++by)
+        {
+            unsigned char* out = dst + (size_t)by * blocksX * blockSize;
+            for(int bx = 0; bx < blocksX; ++bx, out += blockSize)
+            {
+                loadBlock(image, width, height, channels, bx, (int)by, block);
+                switch(format)
+                {
+                case BC1:
+                    expandGrey(channels, block);
+                    encodeBC1(block, out);
+                    break;
+                case BC3:
+                    expandGrey(channels, block);
+                    encodeBC4(block, 3, out);
+                    encodeBC1(block, out + 8);
+                    break;
+                case BC4:
+                    encodeBC4(block, 0, out);
+                    break;
+                case BC5:
+                    encodeBC4(block, 0, out);
+                    encodeBC4(block, 1, out + 8);
+                    break;
+                case BC7:
+                    expandGrey(channels, block);
+                    encodeBC7(block, out);
+                    break;
+                }
+            }
+        }
+    }, 16);
+}
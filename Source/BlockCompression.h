@@ -0,0 +1,55 @@
+///////////////////////////////////////////////////////////////////////////////
+// BlockCompression.h
+// ==================
+// Encoders for the BCn block compressed texture formats the GPU samples
+// directly. Each 4x4 block of pixels is stored in 8 or 16 bytes:
+//
+//   BC1   RGB      8 bytes   2 RGB565 endpoints + 2-bit indices      (6:1 vs RGB8)
+//   BC3   RGBA    16 bytes   BC4 alpha block + BC1 color block       (4:1 vs RGBA8)
+//   BC4   R        8 bytes   2 8-bit endpoints + 3-bit indices       (2:1 vs R8)
+//   BC5   RG      16 bytes   2 BC4 blocks                            (2:1 vs RG8)
+//   BC7   RGBA    16 bytes   mode 6: RGBA 7.7.7.7 + p-bit endpoints, 4-bit indices
+//
+// The endpoints are the extremes of the block's colors along their principal
+// axis, then the indices pick the nearest palette entry for each pixel. BC7
+// is only encoded with mode 6 (1 subset), which already beats BC1/BC3 on
+// smooth gradients and alpha, without the cost of a partition search.
+//
+// Images whose width or height is not a multiple of 4 are padded by
+// repeating the last row and column.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <cstddef>
+
+namespace BlockCompression
+{
+    enum Format
+    {
+        BC1,
+        BC3,
+        BC4,
+        BC5,
+        BC7
+    };
+
+    // # of bytes per 4x4 block
+    unsigned int getBlockSize(Format format);
+    // # of bytes of a width x height image
+    size_t getImageSize(Format format, int width, int height);
+    // short name, e.g. "BC7"
+    const char* getName(Format format);
+
+    // default format for a # of channels: BC4 for 1, BC5 for 2, BC1 for 3, BC3 for 4
+    // highQuality uses BC7 for 3 and 4 channels
+    Format getFormat(int channels, bool highQuality = false);
+
+    // encode an image of channels bytes per pixel, top row first, to dst (getImageSize() bytes)
+    // blocks are encoded on threadCount threads (0 = one per core)
+    void compress(const unsigned char* image, int width, int height, int channels, Format format,
+                  unsigned char* dst, unsigned int threadCount = 0);
+}
+
+#endif
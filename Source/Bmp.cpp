@@ -1,8 +1,11 @@
 // Bmp.cpp
 // =======
 // BMP image loader
-// It reads only 8/24/32-bit uncompressed and 8-bit RLE compression format.
+// It reads only 8/24/32-bit uncompressed and 8-bit/4-bit RLE compression format.
 //
+// 2026-10-18: Added 4-bit RLE, decoded from the mapping with bounds checks.
+// 2026-10-18: Flip and swap red/blue with the SIMD ImageKernels.
+// 2026-10-18: Read from a memory mapped file in one pass, into one RGB buffer.
 // 2019-07-20: Fixed clearing memory in getColorCount()
 // 2018-08-10: Fixed dealloc memory in save()
 // 2016-11-09: Fixed errors when height < 0 in read()/save().
@@ -19,9 +22,15 @@
 
 #include <fstream>
 #include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cstdio>                       // for remove()
 #include <cstring>                      // for memcpy()
 #include <cstdlib>                      // for abs()
 #include "Bmp.h"
+#include "MappedFile.h"
+#include "ImageKernels.h"
 //using std::ifstream;
 //using std::ofstream;
 //using std::ios;
@@ -34,7 +43,7 @@ using namespace Image;
 ///////////////////////////////////////////////////////////////////////////////
 // default constructor
 ///////////////////////////////////////////////////////////////////////////////
-Bmp::Bmp() : width(0), height(0), bitCount(0), dataSize(0), data(0), dataRGB(0),
+Bmp::Bmp() : width(0), height(0), bitCount(0), dataSize(0), data(0),
              errorMessage("No error.")
 {
 }
@@ -62,14 +71,6 @@ Bmp::Bmp(const Bmp &rhs)
     }
     else
         data = 0;           // array is not allocated yet, set to 0
-
-    if(rhs.getDataRGB())    // allocate memory only if the pointer is not NULL
-    {
-        dataRGB = new unsigned char[dataSize];
-        memcpy(dataRGB, rhs.getDataRGB(), dataSize); // deep copy
-    }
-    else
-        dataRGB = 0;        // array is not allocated yet, set to 0
 }
 
 
@@ -82,8 +83,6 @@ Bmp::~Bmp()
     // deallocate data array
     delete [] data;
     data = 0;
-    delete [] dataRGB;
-    dataRGB = 0;
 }
 
 
@@ -103,6 +102,7 @@ Bmp& Bmp::operator=(const Bmp &rhs)
     dataSize = rhs.getDataSize();
     errorMessage = rhs.getError();
 
+    delete [] data;         // release the old image first
     if(rhs.getData())       // allocate memory only if the pointer is not NULL
     {
         data = new unsigned char[dataSize];
@@ -111,14 +111,6 @@ Bmp& Bmp::operator=(const Bmp &rhs)
     else
         data = 0;
 
-    if(rhs.getDataRGB())   // allocate memory only if the pointer is not NULL
-    {
-        dataRGB = new unsigned char[dataSize];
-        memcpy(dataRGB, rhs.getDataRGB(), dataSize);
-    }
-    else
-        dataRGB = 0;
-
     return *this;
 }
 
@@ -134,8 +126,6 @@ void Bmp::init()
 
     delete [] data;
     data = 0;
-    delete [] dataRGB;
-    dataRGB = 0;
 }
 
 
@@ -158,6 +148,7 @@ void Bmp::printSelf() const
 ///////////////////////////////////////////////////////////////////////////////
 // read a BMP image header infos and datafile and load
 // If height < 0, the bitmap is top-to-bottom orientation.
+// The file is mapped and decoded straight into the only image buffer.
 ///////////////////////////////////////////////////////////////////////////////
 bool Bmp::read(const char* fileName)
 {
@@ -170,182 +161,280 @@ bool Bmp::read(const char* fileName)
         return false;
     }
 
-    // open a BMP file as binary mode
-    std::ifstream inFile;
-    inFile.open(fileName, std::ios::binary);    // binary mode
-    if(!inFile.good())
+    MappedFile file;
+    if(!file.open(fileName))
     {
         errorMessage = "Failed to open a BMP file to read.";
         return false;            // exit if failed
     }
 
-    // list of entries in BMP header
-    char id[2];             // magic identifier "BM" (2 bytes)
-    int fileSize;           // file size in bytes (4)
-    short reserved1;        // reserved 1 (2)
-    short reserved2;        // reserved 2 (2)
-    int dataOffset;         // starting offset of bitmap data (4)
-    int infoHeaderSize;     // info header size (4)
-    int width;              // image width (4)
-    int height;             // image height (4)
-    short planeCount;       // # of planes (2)
-    short bitCount;         // # of bits per pixel (2)
-    int compression;        // compression mode (4)
-    int dataSizeWithPaddings; // bitmap data size with paddings in bytes (4)
-    //int xResolution;        // horizontal pixels per metre (4)
-    //int yResolution;        // vertical pixels per metre (4)
-    //int colorCount;         // # of colours used (4)
-    //int importantColorCount;// # of important colours (4)
-
-    // read BMP header infos
-    inFile.read(id, 2);                         // should be "BM"
-    inFile.read((char*)&fileSize, 4);           // should be same as file size
-    inFile.read((char*)&reserved1, 2);          // should be 0
-    inFile.read((char*)&reserved2, 2);          // should be 0
-    inFile.read((char*)&dataOffset, 4);
-    inFile.read((char*)&infoHeaderSize, 4);     // should be 40
-    inFile.read((char*)&width, 4);
-    inFile.read((char*)&height, 4);
-    inFile.read((char*)&planeCount, 2);         // should be 1
-    inFile.read((char*)&bitCount, 2);           // 1, 4, 8, 24, or 32
-    inFile.read((char*)&compression, 4);        // 0(uncompressed), 1(8-bit RLE), 2(4-bit RLE), 3(RGB with mask)
-    inFile.read((char*)&dataSizeWithPaddings, 4);
-    //inFile.read((char*)&xResolution, 4);
-    //inFile.read((char*)&yResolution, 4);
-    //inFile.read((char*)&colorCount, 4);
-    //inFile.read((char*)&importantColorCount, 4);
+    int dataOffset, compression;
+    bool bottomUp;
+    if(!readHeader(file, dataOffset, compression, bottomUp))
+        return false;
 
-    // check magic ID, "BM"
-    if(id[0] != 'B' && id[1] != 'M')
+    data = new unsigned char [dataSize];
+    if(!decode(file, dataOffset, compression, bottomUp, data))
     {
-        // it is not BMP file, close the opened file and exit
-        inFile.close();
-        errorMessage = "Magic ID is invalid.";
+        delete [] data;
+        data = 0;
         return false;
     }
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// read a BMP image into the caller's buffer, RGB order, top-to-bottom
+// The object only keeps the header infos.
+///////////////////////////////////////////////////////////////////////////////
+bool Bmp::read(const char* fileName, unsigned char* dst, int dstSize)
+{
+    this->init();   // clear out all values
 
-    // it supports only 8-bit grayscale, 24-bit BGR or 32-bit BGRA
-    if(bitCount < 8)
+    if(!fileName || !dst)
     {
-        inFile.close();
-        errorMessage = "Unsupported format.";
+        errorMessage = "File name or buffer is not defined (NULL pointer).";
         return false;
     }
 
-    // it supports only uncompressed and 8-bit RLE compressed format
-    if(compression > 1)
+    MappedFile file;
+    if(!file.open(fileName))
     {
-        inFile.close();
-        errorMessage = "Unsupported compression mode.";
+        errorMessage = "Failed to open a BMP file to read.";
+        return false;
+    }
+
+    int dataOffset, compression;
+    bool bottomUp;
+    if(!readHeader(file, dataOffset, compression, bottomUp))
+        return false;
+
+    if(dstSize < dataSize)
+    {
+        errorMessage = "Buffer is too small for the image.";
         return false;
     }
+    return decode(file, dataOffset, compression, bottomUp, dst);
+}
 
-    // do not trust the file size in header, recalculate it
-    inFile.seekg(0, std::ios::end);
-    fileSize = (int)inFile.tellg();
 
-    // compute the number of paddings
-    // In BMP, each scanline must be divisible evenly by 4.
-    // If not divisible by 4, then each line adds
-    // extra paddings. So it can be divided evenly by 4.
-    int paddings = (4 - ((width * bitCount / 8) % 4)) % 4;
 
-    // compute data size without paddings
-    // NOTE: height can be negative
-    int dataSize = width * abs(height) * bitCount / 8;
+///////////////////////////////////////////////////////////////////////////////
+// read only the header infos, getDataSize() is the buffer size read() needs
+///////////////////////////////////////////////////////////////////////////////
+bool Bmp::readHeader(const char* fileName)
+{
+    this->init();   // clear out all values
 
-    // recompute data size with paddings (do not trust the data size in header)
-    dataSizeWithPaddings = fileSize - dataOffset;   // it maybe greater than "dataSize+(height*paddings)" because 4-byte boundary for file size
+    if(!fileName)
+    {
+        errorMessage = "File name is not defined (NULL pointer).";
+        return false;
+    }
 
-    // now it is ready to store info and image data
-    this->width = width;
-    this->height = abs(height);
-    this->bitCount = bitCount;
-    this->dataSize = dataSize;
+    MappedFile file;
+    if(!file.open(fileName))
+    {
+        errorMessage = "Failed to open a BMP file to read.";
+        return false;
+    }
 
-    // allocate data arrays
-    // add extra bytes for paddings if width is not divisible by 4
-    data = new unsigned char [dataSizeWithPaddings];
-    dataRGB = new unsigned char [dataSize];
+    int dataOffset, compression;
+    bool bottomUp;
+    return readHeader(file, dataOffset, compression, bottomUp);
+}
 
-/*@@ we don't use palette for 8-bit indexed grayscale mode. Instead, we use the index value as the intensity of the pixel.
-    // for loading palette
-    unsigned char* palette = 0; // for palette for indexed mode
-    int paletteSize = 0;
 
-    // if bit count is 8 (256 grayscale), then it uses palette (indexed mode)
-    // build palette lookup table = (4 * colorCount) bytes
-    if(bitCount == 8)
+
+///////////////////////////////////////////////////////////////////////////////
+// parse the header infos of a mapped BMP file and check them
+///////////////////////////////////////////////////////////////////////////////
+bool Bmp::readHeader(const MappedFile& file, int& dataOffset, int& compression, bool& bottomUp)
+{
+    const size_t HEADER_SIZE = 54;     // fileHeader(14) + infoHeader(40)
+    const char* header = file.getData();
+    if(file.getSize() < HEADER_SIZE)
     {
-        // count palette size
-        // palette is placed between BMP header and data
-        paletteSize = dataOffset - 54;              // BMP header size is 54 bytes total
+        errorMessage = "File is too small for a BMP header.";
+        return false;
+    }
 
-        // allocate palette array
-        palette = new unsigned char[paletteSize];
+    // list of entries in BMP header, at their offsets in the file
+    int width;              // image width (4), offset 18
+    int height;             // image height (4), offset 22
+    short bitCount;         // # of bits per pixel (2), offset 28
+    memcpy(&dataOffset, header + 10, 4);    // starting offset of bitmap data
+    memcpy(&width, header + 18, 4);
+    memcpy(&height, header + 22, 4);
+    memcpy(&bitCount, header + 28, 2);      // 1, 4, 8, 24, or 32
+    memcpy(&compression, header + 30, 4);   // 0(uncompressed), 1(8-bit RLE), 2(4-bit RLE), 3(RGB with mask)
 
-        // get number of colors used
-        int colorCount = paletteSize / 4;       // each palette has 4 entries(B,G,R,A)
+    // check magic ID, "BM"
+    if(header[0] != 'B' || header[1] != 'M')
+    {
+        errorMessage = "Magic ID is invalid.";
+        return false;
+    }
 
-        // copy palette data
-        inFile.seekg(54, std::ios::beg);        // palette starts right after BMP header block (54 bytes)
-        inFile.read((char*)palette, paletteSize);
+    // it supports only 8-bit grayscale, 24-bit BGR or 32-bit BGRA (and 4-bit RLE, decoded to 8-bit)
+    if(bitCount != 8 && bitCount != 24 && bitCount != 32 && !(bitCount == 4 && compression == 2))
+    {
+        errorMessage = "Unsupported format.";
+        return false;
     }
-*/
 
-    if(compression == 0)                    // uncompressed
+    // it supports only uncompressed, 8-bit RLE and 4-bit RLE compressed format
+    if(compression < 0 || compression > 2 || (compression == 1 && bitCount != 8) || (compression == 2 && bitCount != 4))
     {
-        inFile.seekg(dataOffset, std::ios::beg); // move cursor to the starting position of data
-        inFile.read((char*)data, dataSizeWithPaddings);
+        errorMessage = "Unsupported compression mode.";
+        return false;
     }
-    else if(compression == 1)               // 8-bit RLE(Run Length Encode) compressed
+    if(bitCount == 4)
+        bitCount = 8;                       // the loader's pixels
+
+    // do not trust the sizes in header, the data must fit in the file (the size is not stored beyond 2GB)
+    // NOTE: height can be negative
+    const long long lineSize = (long long)width * (bitCount / 8);
+    const long long lineSizeWithPaddings = (lineSize + 3) / 4 * 4;   // each scanline is divisible evenly by 4
+    const long long lineCount = height < 0 ? -(long long)height : height;
+    if(width <= 0 || lineCount == 0 || lineSize * lineCount > 0x7fffffff ||
+       dataOffset < (int)HEADER_SIZE || (size_t)dataOffset > file.getSize() ||
+       (compression == 0 && (size_t)(lineSizeWithPaddings * lineCount) > file.getSize() - dataOffset))
     {
-        // get length of encoded data
-        int size = fileSize - dataOffset;
+        errorMessage = "Invalid image size.";
+        return false;
+    }
 
-        // allocate tmp array to store the encoded data
-        unsigned char *encData = new unsigned char[size];
+    // now it is ready to store info
+    this->width = width;
+    this->height = (int)lineCount;
+    this->bitCount = bitCount;
+    this->dataSize = (int)(lineSize * lineCount);
+    bottomUp = height > 0;
+    return true;
+}
 
-        // read data from file
-        inFile.seekg(dataOffset, std::ios::beg);
-        inFile.read((char*)encData, size);
 
-        // decode RLE into image data buffer
-        decodeRLE8(encData, data);
 
-        // deallocate encoded data buffer after decoding
-        delete [] encData;
+///////////////////////////////////////////////////////////////////////////////
+// decode the pixels of a mapped BMP file into dst (dataSize bytes)
+// Uncompressed lines go from the mapping to dst in one pass, the paddings are
+// skipped, the lines flipped and red/blue swapped on the way. RLE lines are
+// decoded from the mapping straight into their flipped place.
+///////////////////////////////////////////////////////////////////////////////
+bool Bmp::decode(const MappedFile& file, int dataOffset, int compression, bool bottomUp, unsigned char* dst)
+{
+    const unsigned char* src = (const unsigned char*)file.getData() + dataOffset;
+    const int channelCount = bitCount / 8;
+
+    if(compression == 0)                    // uncompressed
+    {
+        int lineSize = width * channelCount;
+        int paddings = (4 - (lineSize % 4)) % 4;
+        copyRows(src, lineSize + paddings, dst, width, height, channelCount, bottomUp);
+        return true;
     }
 
-    // close it after reading
-    inFile.close();
+    // 8-bit or 4-bit RLE(Run Length Encode) compressed, decoded in place from the rest of the file
+    return decodeRLE(src, file.getSize() - dataOffset, dst, width, height,
+                     compression == 2 ? 4 : 8, bottomUp, errorMessage);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// time both ways to read 8K images of 24 and 32 bits: the old stream read
+// into a padded buffer, padding strip, flip and a second RGB copy, against
+// the mapped read in one pass into a single buffer
+///////////////////////////////////////////////////////////////////////////////
+void Bmp::benchmark(int width, int height, int iterations)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const char* fileName = "bmp_benchmark.bmp";
+    const float MB = 1024.0f * 1024.0f;
 
-    // we don't need paddings, trim paddings from each line
-    // Note that there is no padding in RLE compressed data
-    if(compression == 0 && paddings > 0)
+    for(int channelCount = 3; channelCount <= 4; ++channelCount)
     {
-        int lineWidth = width * bitCount / 8;
+        // gradient test image, saved bottom-to-top with paddings as any BMP
+        const int lineSize = width * channelCount;
+        const int paddings = (4 - (lineSize % 4)) % 4;
+        std::vector<unsigned char> image((size_t)lineSize * height);
+        for(size_t i = 0; i < image.size(); ++i)
+            image[i] = (unsigned char)(i * 7 + i / lineSize);
+        Bmp bmp;
+        if(!bmp.save(fileName, width, height, channelCount, image.data()))
+        {
+            std::cout << "[ERROR] Bmp: " << bmp.getError() << std::endl;
+            return;
+        }
 
-        // copy line by line
-        int lineCount = abs(height);
-        for(int i = 1; i < lineCount; ++i)
+        // old way, 3 full passes and 2 buffers
+        float streamTime = 0;
+        size_t streamPeak = 0;
+        unsigned int sum = 0;
+        for(int k = 0; k < iterations; ++k)
         {
-            memcpy(&data[i*lineWidth], &data[i*(lineWidth+paddings)], lineWidth);
+            Clock::time_point start = Clock::now();
+            std::ifstream inFile(fileName, std::ios::binary);
+            inFile.seekg(0, std::ios::end);
+            const size_t paddedSize = (size_t)inFile.tellg() - 54;
+            unsigned char* padded = new unsigned char[paddedSize];
+            inFile.seekg(54, std::ios::beg);
+            inFile.read((char*)padded, paddedSize);
+            inFile.close();
+            for(int i = 1; paddings > 0 && i < height; ++i)
+                memmove(&padded[(size_t)i * lineSize], &padded[(size_t)i * (lineSize + paddings)], lineSize);
+            flipImage(padded, width, height, channelCount);
+            unsigned char* rgb = new unsigned char[image.size()];
+            memcpy(rgb, padded, image.size());
+            swapRedBlue(rgb, (int)image.size(), channelCount);
+            streamTime += std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+            streamPeak = paddedSize + image.size();
+            sum += rgb[image.size() / 2];
+            delete [] padded;
+            delete [] rgb;
         }
-    }
 
-    // BMP is bottom-to-top orientation by default, flip image vertically
-    // But if the height is negative value, then it is top-to-bottom orientation.
-    if(height > 0)
-        flipImage(data, width, height, bitCount/8);
+        // mapped, one pass into one buffer
+        float mappedTime = 0;
+        bool same = true;
+        for(int k = 0; k < iterations; ++k)
+        {
+            Clock::time_point start = Clock::now();
+            Bmp reader;
+            reader.read(fileName, image.data(), (int)image.size());
+            mappedTime += std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+            sum += image[image.size() / 2];
+        }
 
-    // the colour components order of BMP image is BGR
-    // convert image data to RGB order for convenience
-    memcpy(dataRGB, data, dataSize);    // copy data to dataRGB first
-    if(bitCount == 24 || bitCount == 32)
-        swapRedBlue(dataRGB, dataSize, bitCount/8);
+        // the one pass read must give the image back (as it was saved, RGB and bottom row last)
+        Bmp check;
+        check.read(fileName);
+        for(int y = 0; y < height && same; ++y)
+            for(int x = 0; x < lineSize && same; ++x)
+                same = check.getData()[(size_t)y * lineSize + x] == (unsigned char)(((size_t)(height - 1 - y) * lineSize + x) * 7 + (height - 1 - y));
 
-    return true;
+        // keeps the reads from being optimized out
+        volatile unsigned int sink = sum;
+        (void)sink;
+
+        if(iterations > 0)
+        {
+            streamTime /= iterations;
+            mappedTime /= iterations;
+        }
+        std::cout << "===== Bmp Benchmark: " << width << " x " << height << ", " << channelCount * 8 << " bits =====\n"
+                  << std::fixed << std::setprecision(2)
+                  << "   Stream Read: " << streamTime << " ms, " << streamPeak / MB << " MB peak (3 passes, 2 buffers)\n"
+                  << "   Mapped Read: " << mappedTime << " ms, " << image.size() / MB << " MB peak (1 pass into the caller's buffer)\n"
+                  << "       Speedup: " << (mappedTime > 0 ? streamTime / mappedTime : 0.0f) << "x"
+                  << (same ? "" : " (IMAGES DIFFER)") << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+        std::cout << std::setprecision(6);
+    }
+    remove(fileName);
 }
 
 
@@ -528,20 +617,26 @@ bool Bmp::save(const char* fileName, int w, int h, int channelCount, const unsig
 // static shared functions ****************************************************
 
 ///////////////////////////////////////////////////////////////////////////////
-// decode 8-bit RLE data into uncompressed data
-// This routine needs 2 pointers: the pointer to the encoded input data and
-// the pointer to the decoded output data. The length of input array is not
-// necessary because the last 2 bytes of input data must be 00 and 01, which
-// tells the end of data. So it can stop decoding process.
+// decode 8-bit or 4-bit RLE data into uncompressed 8-bit data
+// The encoded data is read through a window of srcSize bytes (the mapped
+// file after the data offset) and every read is checked against it, so a
+// truncated or corrupt file stops with an error instead of reading past the
+// mapping. The decoded lines go straight to their final place in dst (flipped
+// if bottomUp), each write is checked against the line and the image, runs
+// are memset and absolute runs memcpy'ed. Pixels skipped by end of line,
+// delta or end of bitmap marks are 0. The input is read once in order, so the
+// OS only keeps the pages being decoded and no copy of the file is made.
 //
 // BMP uses 2-value RLE scheme: the first value contains a count of the number
 // of pixels in the run, and the second value contains the value of the pixel
 // repeated. For example, 0x3 0xFF means 0xFF 0xFF 0xFF.
+// In 4-bit RLE, the second value holds 2 pixels that alternate in the run,
+// high nibble first: 0x5 0x12 means 1 2 1 2 1.
 //
 // If the first value is 0x00, then it is unencoded run mode and a pixel is not
 // repeated any more. In unencode run mode, the second value is the the number
-// of unencoded pixel values that follow. If the number of pixels is odd, then
-// a 0x00 padding value also follows.
+// of unencoded pixel values that follow. The values are padded with 0s to an
+// even number of bytes (2 pixels per byte in 4-bit RLE).
 // 1st  2nd  EncodedValue  DecodedValue
 // ===  ===  ============  ============
 //  00   03  FF FE FD 00   FF FE FD
@@ -561,45 +656,124 @@ bool Bmp::save(const char* fileName, int w, int h, int channelCount, const unsig
 // same scanline and the fourth byte is the number of rows to move. For
 // example, 00 02 03 04 means move the cursor 3 pixels right, and 4 pixels
 // upward. (Note that BMP is bottom-to-top orientation.)
+//
+// The loader has no palette support (8-bit images are grayscale), so 4-bit
+// indices are scaled to the 16 levels of a grayscale palette (x 17).
 ///////////////////////////////////////////////////////////////////////////////
-bool Bmp::decodeRLE8(const unsigned char *encData, unsigned char *outData)
+bool Bmp::decodeRLE(const unsigned char *src, size_t srcSize, unsigned char *dst,
+                    int width, int height, int bitCount, bool bottomUp, std::string& error)
 {
     // check NULL pointer
-    if(!encData || !outData)
+    if(!src || !dst || (bitCount != 4 && bitCount != 8))
+    {
+        error = "Invalid RLE parameters.";
         return false;
+    }
 
-    unsigned char first, second;
-    int i;
-    bool stop = false;
+    const unsigned char* end = src + srcSize;
+    const int scale = bitCount == 4 ? 17 : 1;
+    int x = 0;                  // cursor in the current line
+    int y = 0;                  // current line, in file order
+
+    // start of a line in dst, from its index in file order
+    auto lineAt = [=](int line) { return dst + (size_t)(bottomUp ? height - 1 - line : line) * width; };
 
-    // start decoding, stop when it reaches at the end of decoded data
-    while(!stop)
+    while(y < height)
     {
         // grab 2 bytes at the current position
-        first = *encData++;
-        second = *encData++;
+        if(end - src < 2)
+        {
+            error = "RLE data is truncated.";
+            return false;
+        }
+        const int first = *src++;
+        const int second = *src++;
+        unsigned char* line = lineAt(y);
 
         if(first)                   // encoded run mode
         {
-            for(i=0; i < first; ++i)
-                *outData++ = second;
+            if(first > width - x)
+            {
+                error = "RLE run goes past the end of a line.";
+                return false;
+            }
+            const unsigned char hi = (unsigned char)(bitCount == 4 ? (second >> 4) * scale : second);
+            const unsigned char lo = (unsigned char)(bitCount == 4 ? (second & 15) * scale : second);
+            if(hi == lo)
+            {
+                memset(line + x, hi, first);
+            }
+            else
+            {
+                for(int i = 0; i < first; ++i)
+                    line[x + i] = (i & 1) ? lo : hi;
+            }
+            x += first;
         }
-        else
+        else if(second == 0)        // end of line, the rest of the line is 0
         {
-            if(second == 1)         // reached the end of bitmap
-                stop = true;        // must stop decoding
-
-            else if(second == 2)    // delta mark
-                encData += 2;       // do nothing, but move the cursor 2 more bytes
-
-            else                    // unencoded run mode (second >= 3)
+            memset(line + x, 0, width - x);
+            x = 0;
+            ++y;
+        }
+        else if(second == 1)        // end of bitmap, the rest of the image is 0
+        {
+            memset(line + x, 0, width - x);
+            for(++y; y < height; ++y)
+                memset(lineAt(y), 0, width);
+        }
+        else if(second == 2)        // delta, the skipped pixels are 0
+        {
+            if(end - src < 2)
             {
-                for(i=0; i < second; ++i)
-                    *outData++ = *encData++;
-
-                if(second % 2)      // if it is odd number, then there is a padding 0. ignore it
-                    encData++;
+                error = "RLE data is truncated.";
+                return false;
+            }
+            const int dx = *src++;
+            const int dy = *src++;
+            if(dy >= height - y || (dy == 0 && dx > width - x) || (dy > 0 && dx > width))
+            {
+                error = "RLE delta goes past the end of the image.";
+                return false;
+            }
+            if(dy > 0)
+            {
+                // to the end of this line, the whole lines between, then the start of the target line
+                memset(line + x, 0, width - x);
+                for(int i = 1; i < dy; ++i)
+                    memset(lineAt(y + i), 0, width);
+                y += dy;
+                x = 0;
+                line = lineAt(y);
+            }
+            memset(line + x, 0, dx);
+            x += dx;
+        }
+        else                        // unencoded run mode (second >= 3)
+        {
+            const int byteCount = bitCount == 4 ? (second + 1) / 2 : second;
+            const int paddedCount = (byteCount + 1) & ~1;   // to an even number of bytes
+            if(second > width - x)
+            {
+                error = "RLE run goes past the end of a line.";
+                return false;
+            }
+            if(end - src < paddedCount)
+            {
+                error = "RLE data is truncated.";
+                return false;
+            }
+            if(bitCount == 8)
+            {
+                memcpy(line + x, src, second);
             }
+            else
+            {
+                for(int i = 0; i < second; ++i)
+                    line[x + i] = (unsigned char)(((i & 1) ? (src[i >> 1] & 15) : (src[i >> 1] >> 4)) * scale);
+            }
+            src += paddedCount;
+            x += second;
         }
     }
 
@@ -608,6 +782,28 @@ bool Bmp::decodeRLE8(const unsigned char *encData, unsigned char *outData)
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// copy the lines of a BMP image in one pass: the paddings at the end of each
+// source line are skipped, the lines are flipped if the source is bottom-to-
+// top and the red and blue components are swapped (BGR(A) to RGB(A)) while
+// the line is still in the cache
+///////////////////////////////////////////////////////////////////////////////
+void Bmp::copyRows(const unsigned char *src, int srcLineSize, unsigned char *dst,
+                   int width, int height, int channelCount, bool flip)
+{
+    const int lineSize = width * channelCount;
+    for(int i = 0; i < height; ++i)
+    {
+        const unsigned char* s = src + (size_t)(flip ? height - 1 - i : i) * srcLineSize;
+        unsigned char* d = dst + (size_t)i * lineSize;
+        memcpy(d, s, lineSize);
+        if(channelCount >= 3)               // grayscale, nothing to swap
+            ImageKernels::swapRedBlue(d, width, channelCount);
+    }
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // BMP is bottom-to-top orientation. Flip the image vertically, so the image
 // can be rendered from top to bottom orientation
@@ -616,28 +812,8 @@ void Bmp::flipImage(unsigned char *data, int width, int height, int channelCount
 {
     if(!data) return;
 
-    int lineSize = width * channelCount;
-    unsigned char* tmp = new unsigned char [lineSize];
-    int half = height / 2;
-
-    int line1 = 0;                          // first line
-    int line2 = (height - 1) * lineSize;    // last line
-
-    // scan only half of height
-    for(int i = 0; i < half; ++i)
-    {
-        // copy line by line
-        memcpy(tmp, &data[line1], lineSize);
-        memcpy(&data[line1], &data[line2], lineSize);
-        memcpy(&data[line2], tmp, lineSize);
-
-        // move to next line
-        line1 += lineSize;
-        line2 -= lineSize;
-    }
-
-    // deallocate temp arrays
-    delete [] tmp;
+    // swap the lines in place, with the widest SIMD the CPU has
+    ImageKernels::flipVertical(data, width, height, channelCount);
 }
 
 
@@ -651,16 +827,8 @@ void Bmp::swapRedBlue(unsigned char *data, int dataSize, int channelCount)
     if(channelCount < 3) return;            // must be 3 or 4
     if(dataSize % channelCount) return;     // must be divisible by the number of channels
 
-    unsigned char tmp;
-    int i;
-
     // swap the position of red and blue components
-    for(i=0; i < dataSize; i+=channelCount)
-    {
-        tmp = data[i];
-        data[i] = data[i+2];
-        data[i+2] = tmp;
-    }
+    ImageKernels::swapRedBlue(data, dataSize / channelCount, channelCount);
 }
 
 
@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////////////////////////
+// CameraUniforms.cpp
+// ==================
+// View and projection matrices in a ring of uniform buffer slots.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+#include "CameraUniforms.h"
+
+
+
+namespace
+{
+    const unsigned int NO_SLOT = 0xffffffff;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor
+///////////////////////////////////////////////////////////////////////////////
+CameraUniforms::CameraUniforms() : buffer(0), mapped(0), slotSize(0), slot(NO_SLOT), setCount(0), waitCount(0)
+{
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// create/destroy the ring, the slots start at offsets the GL accepts for
+// glBindBufferRange()
+///////////////////////////////////////////////////////////////////////////////
+void CameraUniforms::create(unsigned int slotCount)
+{
+    destroy();
+
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if(alignment < 1)
+        alignment = 256;
+    slotSize = ((GLsizeiptr)sizeof(Block) + alignment - 1) / alignment * alignment;
+    fences.assign(slotCount > 1 ? slotCount : 2, (GLsync)0);
+    const GLsizeiptr size = slotSize * (GLsizeiptr)fences.size();
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    if(GLEW_ARB_buffer_storage)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, size, 0, flags);
+        mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+    }
+    else
+    {
+        glBufferData(GL_UNIFORM_BUFFER, size, 0, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    slot = NO_SLOT;
+    setCount = 0;
+    waitCount = 0;
+}
+
+void CameraUniforms::destroy()
+{
+    for(size_t i = 0; i < fences.size(); ++i)
+    {
+        if(fences[i])
+            glDeleteSync(fences[i]);
+    }
+    fences.clear();
+    if(buffer)
+    {
+        if(mapped)
+        {
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &buffer);
+    }
+    buffer = 0;
+    mapped = 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// the draws of the previous slot are all issued by now, so its fence goes
+// here; the next slot is reused once the fence put after its draws a ring
+// ago is signaled
+///////////////////////////////////////////////////////////////////////////////
+void CameraUniforms::set(const GLfloat* view, const GLfloat* projection)
+{
+    if(!buffer)
+        return;
+
+    if(slot != NO_SLOT)
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot = slot == NO_SLOT ? 0 : (slot + 1) % (unsigned int)fences.size();
+
+    if(fences[slot])
+    {
+        if(glClientWaitSync(fences[slot], 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            ++waitCount;
+            glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        }
+        glDeleteSync(fences[slot]);
+        fences[slot] = 0;
+    }
+
+    Block block;
+    std::memcpy(block.view, view, sizeof(block.view));
+    std::memcpy(block.projection, projection, sizeof(block.projection));
+    const GLintptr offset = slotSize * slot;
+    if(mapped)
+    {
+        // coherent: visible to the draws issued after this
+        std::memcpy(mapped + offset, &block, sizeof(block));
+    }
+    else
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(block), &block);
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, BINDING, buffer, offset, sizeof(block));
+    ++setCount;
+}
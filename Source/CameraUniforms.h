@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////////////////////////
+// CameraUniforms.h
+// ================
+// The view and projection matrices of the scene in a uniform buffer, shared
+// by every program that declares the block
+//     layout(std140, binding = 0) uniform CameraBlock { mat4 view; mat4 projection; };
+// so they are written once per view instead of set on each program for each
+// object.
+//
+// The buffer is a ring of slots mapped for good with buffer storage. set()
+// writes the matrices to the next slot and binds its range, so the camera
+// can be latched right before the draws are issued without waiting for the
+// GPU to finish the draws of an earlier view. A fence after the draws of
+// each slot tells when it can be written again; set() only waits if the GPU
+// is a whole ring behind. Without buffer storage the slot is written with
+// glBufferSubData().
+//
+// usage:
+//     uniforms.create();
+//     uniforms.set(glm::value_ptr(view), glm::value_ptr(projection));
+//     draw();
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef CAMERA_UNIFORMS_H
+#define CAMERA_UNIFORMS_H
+
+#include <GL/glew.h>
+#include <vector>
+
+class CameraUniforms
+{
+public:
+    static const GLuint BINDING = 0;    // uniform buffer binding of the block
+
+    CameraUniforms();
+
+    // create the ring, on the GL thread; slotCount is the # of views in flight
+    void create(unsigned int slotCount = 16);
+    void destroy();
+
+    // write the matrices (16 floats each, column-major) to the next slot and bind it
+    void set(const GLfloat* view, const GLfloat* projection);
+
+    unsigned int getSetCount() const    { return setCount; }
+    unsigned int getWaitCount() const   { return waitCount; }   // set() waited for the GPU to free a slot
+
+private:
+    // std140 layout of the block
+    struct Block
+    {
+        GLfloat view[16];
+        GLfloat projection[16];
+    };
+
+    GLuint buffer;
+    unsigned char* mapped;              // persistent coherent mapping, 0 without buffer storage
+    GLsizeiptr slotSize;                // sizeof(Block) rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    std::vector<GLsync> fences;         // per slot, after the draws that read it
+    unsigned int slot;                  // last slot written
+    unsigned int setCount;
+    unsigned int waitCount;
+};
+
+#endif
@@ -0,0 +1,375 @@
+///////////////////////////////////////////////////////////////////////////////
+// CommandList.cpp
+// ===============
+// Draw commands recorded on any thread and replayed on the GL thread.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+#include "CommandList.h"
+#include "Parallel.h"
+#include "JobSystem.h"
+
+
+
+namespace
+{
+    const GLuint UNKNOWN = 0xffffffff;
+
+    // arguments of the commands, every field is a 4 byte word
+    struct TextureArgs
+    {
+        GLuint unit;
+        GLenum target;
+        GLuint texture;
+    };
+
+    struct SamplerArgs
+    {
+        GLuint unit;
+        GLuint sampler;
+    };
+
+    struct Uniform2Args
+    {
+        GLint location;
+        GLuint x;
+        GLuint y;
+    };
+
+    struct DrawArgs
+    {
+        GLenum mode;
+        GLsizei count;
+        GLenum type;
+        GLuint offset;
+    };
+
+    // the arguments after an opcode, copied out since the stream is only 4 byte aligned
+    template <typename T>
+    inline T read(const unsigned char*& p)
+    {
+        T value;
+        std::memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return value;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor
+///////////////////////////////////////////////////////////////////////////////
+CommandList::CommandList(size_t capacity) : data(capacity), size(0), commandCount(0), drawCount(0)
+{
+    clear();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// forget the commands and the state they leave, the memory is reused
+///////////////////////////////////////////////////////////////////////////////
+void CommandList::clear()
+{
+    size = 0;
+    commandCount = 0;
+    drawCount = 0;
+    program = UNKNOWN;
+    vao = UNKNOWN;
+    for(unsigned int i = 0; i < STATE_UNITS; ++i)
+    {
+        textures[i] = UNKNOWN;
+        targets[i] = UNKNOWN;
+        samplers[i] = UNKNOWN;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// append a command, the buffer doubles when it is full
+///////////////////////////////////////////////////////////////////////////////
+void CommandList::push(Opcode opcode, const void* args, size_t bytes)
+{
+    const size_t needed = size + sizeof(GLuint) + bytes;
+    if(needed > data.size())
+        data.resize(needed > data.size() * 2 ? needed : data.size() * 2);
+
+    const GLuint op = opcode;
+    std::memcpy(&data[size], &op, sizeof(op));
+    if(bytes)
+        std::memcpy(&data[size + sizeof(op)], args, bytes);
+    size = needed;
+    ++commandCount;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// state changes, dropped if the list already left the same state bound
+///////////////////////////////////////////////////////////////////////////////
+void CommandList::useProgram(GLuint program)
+{
+    if(this->program == program)
+        return;
+    this->program = program;
+    push(USE_PROGRAM, &program, sizeof(program));
+}
+
+void CommandList::bindVertexArray(GLuint vao)
+{
+    if(this->vao == vao)
+        return;
+    this->vao = vao;
+    push(BIND_VERTEX_ARRAY, &vao, sizeof(vao));
+}
+
+void CommandList::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    if(unit < STATE_UNITS)
+    {
+        if(textures[unit] == texture && targets[unit] == target)
+            return;
+        textures[unit] = texture;
+        targets[unit] = target;
+    }
+    const TextureArgs args = { unit, target, texture };
+    push(BIND_TEXTURE, &args, sizeof(args));
+}
+
+void CommandList::bindSampler(GLuint unit, GLuint sampler)
+{
+    if(unit < STATE_UNITS)
+    {
+        if(samplers[unit] == sampler)
+            return;
+        samplers[unit] = sampler;
+    }
+    const SamplerArgs args = { unit, sampler };
+    push(BIND_SAMPLER, &args, sizeof(args));
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// uniforms of the program bound when the command is replayed
+///////////////////////////////////////////////////////////////////////////////
+void CommandList::uniform1i(GLint location, GLint x)
+{
+    const GLint args[2] = { location, x };
+    push(UNIFORM_1I, args, sizeof(args));
+}
+
+void CommandList::uniform2i(GLint location, GLint x, GLint y)
+{
+    const GLint args[3] = { location, x, y };
+    push(UNIFORM_2I, args, sizeof(args));
+}
+
+void CommandList::uniform2ui(GLint location, GLuint x, GLuint y)
+{
+    const Uniform2Args args = { location, x, y };
+    push(UNIFORM_2UI, &args, sizeof(args));
+}
+
+void CommandList::uniform4f(GLint location, const GLfloat* v)
+{
+    GLfloat args[5];
+    std::memcpy(&args[0], &location, sizeof(location));
+    std::memcpy(&args[1], v, 4 * sizeof(GLfloat));
+    push(UNIFORM_4F, args, sizeof(args));
+}
+
+void CommandList::uniformMatrix3(GLint location, const GLfloat* m)
+{
+    GLfloat args[10];
+    std::memcpy(&args[0], &location, sizeof(location));
+    std::memcpy(&args[1], m, 9 * sizeof(GLfloat));
+    push(UNIFORM_MATRIX3, args, sizeof(args));
+}
+
+void CommandList::uniformMatrix4(GLint location, const GLfloat* m)
+{
+    GLfloat args[17];
+    std::memcpy(&args[0], &location, sizeof(location));
+    std::memcpy(&args[1], m, 16 * sizeof(GLfloat));
+    push(UNIFORM_MATRIX4, args, sizeof(args));
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// indexed draw from the element buffer of the bound vertex array
+///////////////////////////////////////////////////////////////////////////////
+void CommandList::drawElements(GLenum mode, GLsizei count, GLenum type, GLuint offset)
+{
+    const DrawArgs args = { mode, count, type, offset };
+    push(DRAW_ELEMENTS, &args, sizeof(args));
+    ++drawCount;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// decode and issue each command, the only part that calls GL
+///////////////////////////////////////////////////////////////////////////////
+void CommandList::replay() const
+{
+    const unsigned char* p = data.data();
+    const unsigned char* end = p + size;
+    GLuint activeUnit = 0;
+    GLfloat m[16];
+    while(p < end)
+    {
+        switch(read<GLuint>(p))
+        {
+        case USE_PROGRAM:
+            glUseProgram(read<GLuint>(p));
+            break;
+        case BIND_VERTEX_ARRAY:
+            glBindVertexArray(read<GLuint>(p));
+            break;
+        case BIND_TEXTURE:
+        {
+            const TextureArgs args = read<TextureArgs>(p);
+            if(args.unit != activeUnit)
+            {
+                glActiveTexture(GL_TEXTURE0 + args.unit);
+                activeUnit = args.unit;
+            }
+            glBindTexture(args.target, args.texture);
+            break;
+        }
+        case BIND_SAMPLER:
+        {
+            const SamplerArgs args = read<SamplerArgs>(p);
+            glBindSampler(args.unit, args.sampler);
+            break;
+        }
+        case UNIFORM_1I:
+        {
+            const GLint location = read<GLint>(p);
+            glUniform1i(location, read<GLint>(p));
+            break;
+        }
+        case UNIFORM_2I:
+        {
+            const Uniform2Args args = read<Uniform2Args>(p);
+            glUniform2i(args.location, (GLint)args.x, (GLint)args.y);
+            break;
+        }
+        case UNIFORM_2UI:
+        {
+            const Uniform2Args args = read<Uniform2Args>(p);
+            glUniform2ui(args.location, args.x, args.y);
+            break;
+        }
+        case UNIFORM_4F:
+        {
+            const GLint location = read<GLint>(p);
+            std::memcpy(m, p, 4 * sizeof(GLfloat));
+            p += 4 * sizeof(GLfloat);
+            glUniform4fv(location, 1, m);
+            break;
+        }
+        case UNIFORM_MATRIX3:
+        {
+            const GLint location = read<GLint>(p);
+            std::memcpy(m, p, 9 * sizeof(GLfloat));
+            p += 9 * sizeof(GLfloat);
+            glUniformMatrix3fv(location, 1, GL_FALSE, m);
+            break;
+        }
+        case UNIFORM_MATRIX4:
+        {
+            const GLint location = read<GLint>(p);
+            std::memcpy(m, p, 16 * sizeof(GLfloat));
+            p += 16 * sizeof(GLfloat);
+            glUniformMatrix4fv(location, 1, GL_FALSE, m);
+            break;
+        }
+        case DRAW_ELEMENTS:
+        {
+            const DrawArgs args = read<DrawArgs>(p);
+            glDrawElements(args.mode, args.count, args.type, (const void*)(size_t)args.offset);
+            break;
+        }
+        default:
+            // only push() writes the stream, an unknown opcode means it is corrupt
+            return;
+        }
+    }
+    if(activeUnit != 0)
+        glActiveTexture(GL_TEXTURE0);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CommandRecorder ctor
+///////////////////////////////////////////////////////////////////////////////
+CommandRecorder::CommandRecorder(JobSystem& jobs) : jobs(jobs), lists(jobs.getThreadCount() ? jobs.getThreadCount() : 1), blockCount(0)
+{
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// a job per block, any thread may record any block since each has its own list
+///////////////////////////////////////////////////////////////////////////////
+void CommandRecorder::record(unsigned int count, const RecordFunction& func, unsigned int minBlockSize)
+{
+    const unsigned int blocks = Parallel::getBlockCount(count, (unsigned int)lists.size(), minBlockSize ? minBlockSize : 1);
+    const unsigned int blockSize = (count + blocks - 1) / blocks;
+    blockCount = blocks;
+    jobs.parallelFor(blocks, [&](unsigned int first, unsigned int last) {
+        for(unsigned int block = first; block < last; ++block)
+        {
+            const unsigned int begin = block * blockSize < count ? block * blockSize : count;
+            const unsigned int end = begin + blockSize < count ? begin + blockSize : count;
+            lists[block].clear();
+            func(begin, end, lists[block]);
+        }
+    }, 1);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// submit the blocks in order
+///////////////////////////////////////////////////////////////////////////////
+void CommandRecorder::replay() const
+{
+    for(unsigned int i = 0; i < blockCount; ++i)
+        lists[i].replay();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// totals of the lists of the last record()
+///////////////////////////////////////////////////////////////////////////////
+unsigned int CommandRecorder::getCommandCount() const
+{
+    unsigned int total = 0;
+    for(unsigned int i = 0; i < blockCount; ++i)
+        total += lists[i].getCommandCount();
+    return total;
+}
+
+unsigned int CommandRecorder::getDrawCount() const
+{
+    unsigned int total = 0;
+    for(unsigned int i = 0; i < blockCount; ++i)
+        total += lists[i].getDrawCount();
+    return total;
+}
+
+size_t CommandRecorder::getSize() const
+{
+    size_t total = 0;
+    for(unsigned int i = 0; i < blockCount; ++i)
+        total += lists[i].getSize();
+    return total;
+}
@@ -0,0 +1,139 @@
+///////////////////////////////////////////////////////////////////////////////
+// CommandList.h
+// =============
+// Draw commands recorded without a GL context and replayed later on the GL
+// thread, so the draw preparation (matrices, uniform values, texture
+// selection) of a large scene can run on worker threads.
+//
+// A CommandList is a byte stream of small fixed size commands: an opcode and
+// its arguments, the matrices copied by value. clear() keeps the memory, so
+// once the lists have grown to the size of a frame, recording does not
+// allocate. Binds of the program, vertex array, textures and samplers that
+// are already current in the list are dropped while recording; each list
+// starts from an unknown state, so it can be replayed after any other.
+//
+// Uniform locations come from glGetUniformLocation(), which needs the
+// context: look them up once on the GL thread and record with them.
+//
+// CommandRecorder splits [0, count) into one contiguous block per thread of a
+// JobSystem, records each block into its own list as a job, and replay()
+// submits the lists in block order, so the draw order is the same as
+// recording everything on one thread.
+//
+// usage:
+//     CommandRecorder recorder(jobs);
+//     recorder.record(objectCount, [&](unsigned int begin, unsigned int end, CommandList& list) {
+//         for(unsigned int i = begin; i < end; ++i) {
+//             list.uniformMatrix4(modelLoc, model[i]);
+//             list.bindVertexArray(vao[i]);
+//             list.drawElements(GL_TRIANGLES, count[i], GL_UNSIGNED_INT);
+//         }
+//     });
+//     recorder.replay();                  // GL thread
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef COMMAND_LIST_H
+#define COMMAND_LIST_H
+
+#include <GL/glew.h>
+#include <vector>
+#include <functional>
+#include <cstddef>
+
+class JobSystem;
+
+class CommandList
+{
+public:
+    // capacity is the # of bytes reserved up front
+    explicit CommandList(size_t capacity = 64 * 1024);
+
+    // forget the commands and the current state, keep the memory
+    void clear();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    void bindSampler(GLuint unit, GLuint sampler);
+    void uniform1i(GLint location, GLint x);
+    void uniform2i(GLint location, GLint x, GLint y);
+    void uniform2ui(GLint location, GLuint x, GLuint y);
+    void uniform4f(GLint location, const GLfloat* v);
+    void uniformMatrix3(GLint location, const GLfloat* m);      // 9 floats, column-major
+    void uniformMatrix4(GLint location, const GLfloat* m);      // 16 floats, column-major
+    void drawElements(GLenum mode, GLsizei count, GLenum type, GLuint offset = 0);
+
+    // issue the commands in order, on the GL thread
+    // GL_TEXTURE0 is the active texture unit afterwards
+    void replay() const;
+
+    unsigned int getCommandCount() const    { return commandCount; }
+    unsigned int getDrawCount() const       { return drawCount; }
+    size_t getSize() const                  { return size; }        // bytes recorded
+    size_t getCapacity() const              { return data.size(); }
+
+    static const unsigned int STATE_UNITS = 8;  // texture units whose binds are filtered
+
+private:
+    enum Opcode
+    {
+        USE_PROGRAM,
+        BIND_VERTEX_ARRAY,
+        BIND_TEXTURE,
+        BIND_SAMPLER,
+        UNIFORM_1I,
+        UNIFORM_2I,
+        UNIFORM_2UI,
+        UNIFORM_4F,
+        UNIFORM_MATRIX3,
+        UNIFORM_MATRIX4,
+        DRAW_ELEMENTS
+    };
+
+    // append an opcode and its arguments, 4 byte words
+    void push(Opcode opcode, const void* args, size_t bytes);
+
+    std::vector<unsigned char> data;        // grows only, size is the part in use
+    size_t size;
+    unsigned int commandCount;
+    unsigned int drawCount;
+
+    // what the commands recorded so far leave bound, 0xffffffff if unknown
+    GLuint program;
+    GLuint vao;
+    GLuint textures[STATE_UNITS];
+    GLenum targets[STATE_UNITS];
+    GLuint samplers[STATE_UNITS];
+};
+
+
+
+class CommandRecorder
+{
+public:
+    // records the items [begin, end) into list
+    typedef std::function<void(unsigned int begin, unsigned int end, CommandList& list)> RecordFunction;
+
+    // a list per thread of the started job system
+    explicit CommandRecorder(JobSystem& jobs);
+
+    // clear the lists and record count items, one block per thread, and return once every block is recorded
+    // blocks have at least minBlockSize items, so small counts are recorded on the calling thread only
+    // call it on the thread that started the job system
+    void record(unsigned int count, const RecordFunction& func, unsigned int minBlockSize = 1024);
+    // replay the lists of the last record() in block order, on the GL thread
+    void replay() const;
+
+    unsigned int getBlockCount() const      { return blockCount; }
+    const CommandList& getList(unsigned int block) const { return lists[block]; }
+    unsigned int getCommandCount() const;   // of every list
+    unsigned int getDrawCount() const;
+    size_t getSize() const;                 // bytes of every list
+
+private:
+    JobSystem& jobs;
+    std::vector<CommandList> lists;         // one per thread, the first blockCount are used
+    unsigned int blockCount;
+};
+
+#endif
@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrameAllocator.cpp
+// ==================
+// Bump pointer allocator released once per frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameAllocator.h"
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor/dtor
+///////////////////////////////////////////////////////////////////////////////
+FrameAllocator::FrameAllocator(size_t capacity) : offset(0), used(0), peak(0)
+{
+    addBlock(capacity ? capacity : 1024);
+}
+
+FrameAllocator::~FrameAllocator()
+{
+    for(size_t i = 0; i < blocks.size(); ++i)
+        delete [] blocks[i].data;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// align the offset in the last block, or start a block twice as large
+///////////////////////////////////////////////////////////////////////////////
+void* FrameAllocator::allocate(size_t bytes, size_t alignment)
+{
+    Block* block = &blocks.back();
+    size_t start = (size_t)(((size_t)block->data + offset + alignment - 1) & ~(alignment - 1)) - (size_t)block->data;
+    if(start + bytes > block->size)
+    {
+        const size_t size = block->size * 2 > bytes + alignment ? block->size * 2 : bytes + alignment;
+        addBlock(size);
+        block = &blocks.back();
+        start = (size_t)(((size_t)block->data + alignment - 1) & ~(alignment - 1)) - (size_t)block->data;
+    }
+
+    used += start + bytes - offset;
+    if(used > peak)
+        peak = used;
+    offset = start + bytes;
+    return block->data + start;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// one block of the total size replaces several, so the next frames fit
+///////////////////////////////////////////////////////////////////////////////
+void FrameAllocator::reset()
+{
+    if(blocks.size() > 1)
+    {
+        const size_t size = getCapacity();
+        for(size_t i = 0; i < blocks.size(); ++i)
+            delete [] blocks[i].data;
+        blocks.clear();
+        addBlock(size);
+    }
+    offset = 0;
+    used = 0;
+}
+
+size_t FrameAllocator::getCapacity() const
+{
+    size_t size = 0;
+    for(size_t i = 0; i < blocks.size(); ++i)
+        size += blocks[i].size;
+    return size;
+}
+
+void FrameAllocator::addBlock(size_t size)
+{
+    Block block = { new unsigned char[size], size };
+    blocks.push_back(block);
+    offset = 0;
+}
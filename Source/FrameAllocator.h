@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrameAllocator.h
+// ================
+// Linear (bump pointer) allocator for memory that only lives for one frame,
+// e.g. the lists a per-frame job builds. allocate() moves a pointer forward;
+// there is no free(), reset() releases everything at once at the start of the
+// next frame.
+//
+// When a frame needs more than the capacity, another block is allocated;
+// reset() then replaces the blocks with one of their total size, so after the
+// first frames the allocator does not touch the heap any more.
+//
+// An allocator is used by one thread at a time: the job system keeps one per
+// thread, see JobSystem::getFrameAllocator().
+//
+// usage:
+//     unsigned int* visible = allocator.allocate<unsigned int>(objectCount);
+//     ...
+//     allocator.reset();              // next frame
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef FRAME_ALLOCATOR_H
+#define FRAME_ALLOCATOR_H
+
+#include <cstddef>
+#include <vector>
+
+class FrameAllocator
+{
+public:
+    explicit FrameAllocator(size_t capacity = 256 * 1024);
+    ~FrameAllocator();
+
+    // uninitialized memory, alignment is a power of 2
+    void* allocate(size_t bytes, size_t alignment = 16);
+    // room for count objects of type T, not constructed
+    template <typename T>
+    T* allocate(size_t count)               { return static_cast<T*>(allocate(count * sizeof(T), alignof(T))); }
+
+    // release every allocation, keep (and merge) the memory
+    void reset();
+
+    size_t getUsed() const                  { return used; }        // bytes allocated since reset()
+    size_t getPeak() const                  { return peak; }        // most bytes used by a frame
+    size_t getCapacity() const;
+
+private:
+    struct Block
+    {
+        unsigned char* data;
+        size_t size;
+    };
+
+    // not copyable, owns the blocks
+    FrameAllocator(const FrameAllocator&);
+    FrameAllocator& operator=(const FrameAllocator&);
+
+    void addBlock(size_t size);
+
+    std::vector<Block> blocks;              // allocations come from the last one
+    size_t offset;                          // in the last block
+    size_t used;
+    size_t peak;
+};
+
+#endif
@@ -0,0 +1,334 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrameCapture.cpp
+// ================
+// Asynchronous back buffer readback through a PBO ring, encoded on a writer
+// thread.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <cctype>
+#include "FrameCapture.h"
+#include "Bmp.h"
+
+
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    float getMilliseconds(Clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    }
+
+    // full range BT.601 (JPEG) in 8.8 fixed point, the chroma of a 2x2 block from the sum of its 4 pixels
+    inline unsigned char getLuma(const unsigned char* p)
+    {
+        return (unsigned char)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+    }
+
+    inline unsigned char getChroma(int r, int g, int b, int cr, int cg, int cb)
+    {
+        const int value = (cr * r + cg * g + cb * b + 4 * 128 * 256 + 512) >> 10;
+        return (unsigned char)std::min(std::max(value, 0), 255);
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// .y4m and .rgba are videos, anything else a Bmp per frame
+///////////////////////////////////////////////////////////////////////////////
+FrameCapture::Format FrameCapture::getFormat(const std::string& path)
+{
+    const size_t dot = path.find_last_of('.');
+    std::string extension = dot == std::string::npos ? "" : path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if(extension == "y4m")
+        return Y4M;
+    if(extension == "rgba" || extension == "raw")
+        return RAW;
+    return BMP;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor/dtor
+///////////////////////////////////////////////////////////////////////////////
+FrameCapture::FrameCapture() : format(BMP), width(0), height(0), fps(60), frameLimit(0), active(false),
+                               persistent(false), capturedCount(0), droppedCount(0), writtenCount(0),
+                               failedCount(0), lostCount(0), captureTime(0), writeTime(0), writtenBytes(0)
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+    stop();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// create the ring, open the video file and start the writer
+///////////////////////////////////////////////////////////////////////////////
+bool FrameCapture::start(const char* path, int width, int height, unsigned int fps,
+                         unsigned int frameLimit, unsigned int ringSize)
+{
+    if(active || !path || width <= 0 || height <= 0)
+        return false;
+
+    this->path = path;
+    this->format = getFormat(this->path);
+    this->width = width;
+    this->height = height;
+    this->fps = std::max(fps, 1u);
+    this->frameLimit = frameLimit;
+
+    if(format != BMP)
+    {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if(!file)
+        {
+            std::cout << "[ERROR] FrameCapture: failed to open " << path << std::endl;
+            return false;
+        }
+        if(format == Y4M)
+            file << "YUV4MPEG2 W" << width << " H" << height << " F" << this->fps << ":1 Ip A1:1 C420jpeg\n";
+    }
+
+    ring.create((size_t)width * height * 4, ringSize);
+    persistent = ring.isPersistent();
+
+    capturedCount = droppedCount = writtenCount = failedCount = lostCount = 0;
+    captureTime = writeTime = 0;
+    writtenBytes = 0;
+    active = true;
+    writer = std::thread(&FrameCapture::writerLoop, this);
+
+    std::cout << "Capturing " << width << " x " << height << " frames to " << path << std::endl;
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// hand the finished readbacks to the writer and read the current frame into
+// the next free buffer
+///////////////////////////////////////////////////////////////////////////////
+void FrameCapture::capture()
+{
+    if(!active)
+        return;
+
+    Clock::time_point start = Clock::now();
+    ring.poll(false);
+
+    if(frameLimit && capturedCount >= frameLimit)
+    {
+        // every frame read, stop once they are written (or lost)
+        bool written;
+        {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            written = writtenCount + failedCount + ring.getLostCount() == capturedCount;
+        }
+        captureTime += getMilliseconds(start);
+        if(written)
+            stop();
+        return;
+    }
+
+    // never wait for the writer, a full ring drops the frame
+    const int slot = ring.getFreeSlot(false);
+    if(slot < 0)
+    {
+        ++droppedCount;
+        captureTime += getMilliseconds(start);
+        return;
+    }
+    ring.read(slot, capturedCount++, width, height, GL_RGBA);
+
+    captureTime += getMilliseconds(start);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// write the frames in flight, join the writer and release the ring
+///////////////////////////////////////////////////////////////////////////////
+void FrameCapture::stop()
+{
+    if(!active)
+        return;
+
+    ring.poll(true);
+    ring.close();
+    writer.join();
+    if(file.is_open())
+        file.close();
+
+    lostCount = ring.getLostCount();
+    ring.destroy();
+    active = false;
+    printStats();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// encode the frames the GL thread hands over, until stopped and drained
+///////////////////////////////////////////////////////////////////////////////
+void FrameCapture::writerLoop()
+{
+    unsigned int slot;
+    while(ring.take(slot))
+    {
+        Clock::time_point start = Clock::now();
+        write(ring.getPixels(slot), ring.getTag(slot));
+        float time = getMilliseconds(start);
+        ring.release(slot);
+
+        std::lock_guard<std::mutex> lock(writerMutex);
+        writeTime += time;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// encode one frame, the rows of pixels are bottom to top as GL reads them
+///////////////////////////////////////////////////////////////////////////////
+void FrameCapture::write(const unsigned char* pixels, unsigned int frame)
+{
+    const size_t rowSize = (size_t)width * 4;
+    bool written = true;
+    size_t bytes = 0;
+    if(format == BMP)
+    {
+        // a Bmp is stored bottom to top too
+        Image::Bmp bmp;
+        const std::string name = getFrameName(frame);
+        written = bmp.save(name.c_str(), width, height, 4, pixels);
+        if(!written)
+            std::cout << "[ERROR] FrameCapture: " << name << ": " << bmp.getError() << std::endl;
+        bytes = rowSize * height;
+    }
+    else if(format == RAW)
+    {
+        for(int y = height - 1; y >= 0; --y)
+            file.write((const char*)pixels + y * rowSize, rowSize);
+        bytes = rowSize * height;
+    }
+    else
+    {
+        writeY4m(pixels);
+        bytes = planes.size();
+    }
+
+    if(format != BMP && !file)
+    {
+        std::cout << "[ERROR] FrameCapture: failed to write frame " << frame << " to " << path << std::endl;
+        written = false;
+    }
+
+    std::lock_guard<std::mutex> lock(writerMutex);
+    if(written)
+    {
+        ++writtenCount;
+        writtenBytes += bytes;
+    }
+    else
+    {
+        ++failedCount;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// convert a frame to YUV 4:2:0 planes, top row first, and append it
+// the chroma of odd sizes repeats the last column and row
+///////////////////////////////////////////////////////////////////////////////
+void FrameCapture::writeY4m(const unsigned char* pixels)
+{
+    const int chromaWidth = (width + 1) / 2;
+    const int chromaHeight = (height + 1) / 2;
+    const size_t lumaSize = (size_t)width * height;
+    const size_t chromaSize = (size_t)chromaWidth * chromaHeight;
+    planes.resize(lumaSize + 2 * chromaSize);
+    unsigned char* yPlane = &planes[0];
+    unsigned char* uPlane = yPlane + lumaSize;
+    unsigned char* vPlane = uPlane + chromaSize;
+
+    const size_t rowSize = (size_t)width * 4;
+    for(int y = 0; y < height; ++y)
+    {
+        const unsigned char* row = pixels + (height - 1 - y) * rowSize;
+        unsigned char* luma = yPlane + (size_t)y * width;
+        for(int x = 0; x < width; ++x)
+            luma[x] = getLuma(row + x * 4);
+    }
+
+    for(int y = 0; y < chromaHeight; ++y)
+    {
+        const unsigned char* row0 = pixels + (height - 1 - 2 * y) * rowSize;
+        const unsigned char* row1 = pixels + (height - 1 - std::min(2 * y + 1, height - 1)) * rowSize;
+        for(int x = 0; x < chromaWidth; ++x)
+        {
+            const int x0 = 2 * x * 4;
+            const int x1 = std::min(2 * x + 1, width - 1) * 4;
+            const int r = row0[x0] + row0[x1] + row1[x0] + row1[x1];
+            const int g = row0[x0 + 1] + row0[x1 + 1] + row1[x0 + 1] + row1[x1 + 1];
+            const int b = row0[x0 + 2] + row0[x1 + 2] + row1[x0 + 2] + row1[x1 + 2];
+            uPlane[(size_t)y * chromaWidth + x] = getChroma(r, g, b, -43, -85, 128);
+            vPlane[(size_t)y * chromaWidth + x] = getChroma(r, g, b, 128, -107, -21);
+        }
+    }
+
+    file.write("FRAME\n", 6);
+    file.write((const char*)planes.data(), planes.size());
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// name_000042.bmp, or the name as is when a single frame is captured
+///////////////////////////////////////////////////////////////////////////////
+std::string FrameCapture::getFrameName(unsigned int frame) const
+{
+    if(frameLimit == 1)
+        return path;
+
+    const size_t dot = path.find_last_of('.');
+    const size_t slash = path.find_last_of("/\\");
+    const bool hasExtension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+    std::ostringstream name;
+    name << path.substr(0, hasExtension ? dot : path.size()) << "_" << std::setw(6) << std::setfill('0') << frame << ".bmp";
+    return name.str();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// print the capture
+///////////////////////////////////////////////////////////////////////////////
+void FrameCapture::printStats() const
+{
+    const char* FORMAT_NAMES[] = { "Bmp files", "raw RGBA", "Y4M 4:2:0" };
+    const float MB = 1024.0f * 1024.0f;
+    const unsigned int frames = capturedCount + droppedCount;
+    std::cout << "===== FrameCapture =====\n"
+              << std::fixed << std::setprecision(2)
+              << "     Output: " << path << " (" << FORMAT_NAMES[format] << ", " << width << " x " << height << ")\n"
+              << "     Frames: " << writtenCount << " written, " << failedCount + lostCount << " failed, " << droppedCount << " dropped (ring full)\n"
+              << "  GL Thread: " << (frames ? captureTime / frames : 0.0) << " ms per frame ("
+              << (persistent ? "persistent mapping" : "map and copy") << ")\n"
+              << "     Writer: " << (writtenCount ? writeTime / writtenCount : 0.0) << " ms per frame, "
+              << writtenBytes / MB << " MB" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrameCapture.h
+// ==============
+// Screenshots and video capture of the back buffer without stalling the GL
+// thread. capture() only issues glReadPixels() into the next pixel pack
+// buffer (PBO) of a ReadbackRing and a fence; the pixels are taken 2 or 3
+// frames later, once the fence is signaled, so the GPU copies them while the
+// following frames are drawn. A writer thread encodes the frames and gives
+// the buffers back; if it falls behind and the ring is full, the frame is
+// dropped (and counted) instead of waiting.
+//
+// The format comes from the file extension:
+//   .y4m   one YUV 4:2:0 video file (full range BT.601, ffmpeg/ffplay read it)
+//   .rgba  one raw video file, RGBA rows top to bottom, no header
+//   other  a Bmp file per frame, name_000000.bmp, or the name as is for a
+//          single frame
+// The size is fixed by start(); stop and start again after a resize.
+//
+// usage:
+//     capture.start("capture.y4m", width, height, 60);
+//     while(running) { render(); capture.capture(); swapBuffers(); }
+//     capture.stop();
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include "ReadbackRing.h"
+
+class FrameCapture
+{
+public:
+    enum Format
+    {
+        BMP,
+        RAW,
+        Y4M
+    };
+
+    // format of a file name, from its extension
+    static Format getFormat(const std::string& path);
+
+    FrameCapture();
+    ~FrameCapture();
+
+    // start capturing width x height frames, on the GL thread
+    // frameLimit = 0 captures until stop(), ringSize is the # of frames in flight
+    bool start(const char* path, int width, int height, unsigned int fps = 60,
+               unsigned int frameLimit = 0, unsigned int ringSize = 3);
+    // read back the frame just drawn, after rendering and before swapping buffers
+    // stops by itself once frameLimit frames are written
+    void capture();
+    // wait for the frames in flight, write them, close the file and print the stats
+    void stop();
+
+    bool isActive() const                   { return active; }
+    const std::string& getPath() const      { return path; }
+    unsigned int getCapturedCount() const   { return capturedCount; }
+    unsigned int getDroppedCount() const    { return droppedCount; }
+
+    // print the frames written and dropped, and the GL thread and writer times per frame
+    void printStats() const;
+
+private:
+    // not copyable, owns a thread and GL objects
+    FrameCapture(const FrameCapture&);
+    FrameCapture& operator=(const FrameCapture&);
+
+    void writerLoop();
+    void write(const unsigned char* pixels, unsigned int frame);
+    void writeY4m(const unsigned char* pixels);
+    std::string getFrameName(unsigned int frame) const;
+
+    std::string path;
+    Format format;
+    int width;
+    int height;
+    unsigned int fps;
+    unsigned int frameLimit;
+    bool active;
+
+    // frames for the writer, tagged with their #
+    ReadbackRing ring;
+    bool persistent;                        // the ring is mapped for good
+    std::thread writer;
+    std::mutex writerMutex;                 // the writer's stats
+
+    // writer only
+    std::ofstream file;                     // the video file of RAW and Y4M
+    std::vector<unsigned char> planes;      // Y, U and V of a Y4M frame
+
+    // stats
+    unsigned int capturedCount;             // readbacks issued
+    unsigned int droppedCount;              // frames skipped because the ring was full
+    unsigned int writtenCount;              // guarded by writerMutex
+    unsigned int failedCount;               // not written, guarded by writerMutex
+    unsigned int lostCount;                 // readbacks that timed out
+    double captureTime;                     // ms spent in capture() on the GL thread
+    double writeTime;                       // ms spent encoding, guarded by writerMutex
+    size_t writtenBytes;                    // guarded by writerMutex
+};
+
+#endif
@@ -0,0 +1,186 @@
+///////////////////////////////////////////////////////////////////////////////
+// FramePacer.cpp
+// ==============
+// Frame rate limit, frames in flight and input to GPU latency.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include "FramePacer.h"
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor
+///////////////////////////////////////////////////////////////////////////////
+FramePacer::FramePacer() : next(0), lowLatency(false), frameLimit(0), frameInterval(Clock::duration::zero()),
+                           fence(0), pendingInput(false), gpuReference(0),
+                           totalLatencySum(0), totalLatencyMax(0), totalLatencyCount(0), totalFrameCount(0)
+{
+    reset();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// create/destroy the query ring
+///////////////////////////////////////////////////////////////////////////////
+void FramePacer::create(unsigned int latency)
+{
+    destroy();
+    frames.resize(latency > 0 ? latency : 1);
+    for(size_t i = 0; i < frames.size(); ++i)
+    {
+        glGenQueries(1, &frames[i].query);
+        frames[i].issued = false;
+        frames[i].hasInput = false;
+    }
+    next = 0;
+    pendingInput = false;
+    lastInputTime = Clock::time_point();
+    frameStart = Clock::now();
+    totalLatencySum = totalLatencyMax = 0;
+    totalLatencyCount = totalFrameCount = 0;
+    reset();
+}
+
+void FramePacer::destroy()
+{
+    for(size_t i = 0; i < frames.size(); ++i)
+        glDeleteQueries(1, &frames[i].query);
+    frames.clear();
+    if(fence)
+        glDeleteSync(fence);
+    fence = 0;
+}
+
+void FramePacer::setFrameLimit(float framesPerSecond)
+{
+    frameLimit = framesPerSecond > 0 ? framesPerSecond : 0;
+    frameInterval = frameLimit > 0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(1.0f / frameLimit))
+                                   : Clock::duration::zero();
+    frameStart = Clock::now();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// the frames start an interval apart; a frame later than a whole interval
+// moves the schedule instead of letting the next ones start back to back
+///////////////////////////////////////////////////////////////////////////////
+void FramePacer::beginFrame()
+{
+    const Clock::time_point start = Clock::now();
+    if(frameLimit > 0)
+    {
+        if(start < frameStart)
+            std::this_thread::sleep_until(frameStart);
+        const Clock::time_point now = Clock::now();
+        frameStart = now - frameStart > frameInterval ? now + frameInterval : frameStart + frameInterval;
+    }
+
+    if(fence)
+    {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    waitSum += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    ++frameCount;
+    ++totalFrameCount;
+}
+
+// only the first frame to show an input measures it, later frames show it too
+void FramePacer::setInputTime(Clock::time_point inputTime)
+{
+    if(inputTime <= lastInputTime)
+        return;
+    lastInputTime = inputTime;
+    pendingInputTime = inputTime;
+    pendingInput = true;
+}
+
+void FramePacer::endFrame()
+{
+    if(frames.empty())
+        return;
+
+    Frame& frame = frames[next];
+    collect(frame);
+    glQueryCounter(frame.query, GL_TIMESTAMP);
+    frame.issued = true;
+    frame.hasInput = pendingInput;
+    frame.inputTime = pendingInputTime;
+    pendingInput = false;
+    next = (next + 1) % (unsigned int)frames.size();
+
+    if(lowLatency)
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// read the GPU time a frame finished at, waits only if the GPU is more than
+// the ring behind
+///////////////////////////////////////////////////////////////////////////////
+void FramePacer::collect(Frame& frame)
+{
+    if(!frame.issued)
+        return;
+    frame.issued = false;
+    GLuint64 timestamp = 0;
+    glGetQueryObjectui64v(frame.query, GL_QUERY_RESULT, &timestamp);
+    if(!frame.hasInput)
+        return;
+
+    const Clock::time_point finished = cpuReference + std::chrono::duration_cast<Clock::duration>(
+                                       std::chrono::nanoseconds((GLint64)timestamp - gpuReference));
+    const double latency = std::chrono::duration<double, std::milli>(finished - frame.inputTime).count();
+    if(latency < 0)
+        return;                         // clocks drifted apart, recalibrated on reset()
+    latencySum += latency;
+    if(latency > latencyMax)
+        latencyMax = latency;
+    ++latencyCount;
+    totalLatencySum += latency;
+    if(latency > totalLatencyMax)
+        totalLatencyMax = latency;
+    ++totalLatencyCount;
+}
+
+void FramePacer::calibrate()
+{
+    if(frames.empty())
+        return;
+    glGetInteger64v(GL_TIMESTAMP, &gpuReference);
+    cpuReference = Clock::now();
+}
+
+void FramePacer::reset()
+{
+    latencySum = latencyMax = 0;
+    latencyCount = 0;
+    waitSum = 0;
+    frameCount = 0;
+    calibrate();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// print the latency over every frame
+///////////////////////////////////////////////////////////////////////////////
+void FramePacer::printStats() const
+{
+    std::cout << std::fixed << std::setprecision(2)
+              << "===== FramePacer: " << (lowLatency ? "low latency" : "default") << ", "
+              << (frameLimit > 0 ? std::to_string((int)(frameLimit + 0.5f)) + " fps limit" : std::string("no limit")) << " =====\n"
+              << "  " << totalFrameCount << " frames, " << totalLatencyCount << " with new input\n"
+              << "  input to GPU done: " << (totalLatencyCount ? totalLatencySum / totalLatencyCount : 0.0) << " ms average, "
+              << totalLatencyMax << " ms max" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
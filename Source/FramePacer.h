@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+// FramePacer.h
+// ============
+// Frame rate limit, frames in flight and input to GPU latency.
+//
+// beginFrame(), before the CPU work of a frame, sleeps until the frame's
+// start time when a frame limit is set (the next start is an interval after
+// this one was due, so the sleep's overshoot does not add up). In low
+// latency mode it then waits on the fence put after the previous frame's
+// swap, so at most one frame is in flight and the input latched for a frame
+// is not queued behind frames the driver still buffers.
+//
+// endFrame(), right after the swap, puts a GL_TIMESTAMP query after the
+// frame's commands. When the frame showed input newer than the earlier
+// frames (setInputTime()), the sample is the time from that input to the
+// GPU finishing the frame, the GPU clock converted to the CPU clock with a
+// pair of readings taken at create() and reset(). The display adds up to a
+// refresh interval of scanout on top. The queries are used in a ring and
+// read when reused, like GpuTimer.
+//
+// usage:
+//     pacer.create();
+//     pacer.setLowLatency(true);
+//     pacer.setFrameLimit(60.0f);
+//     while(running) {
+//         pacer.beginFrame();
+//         ...                             // CPU work
+//         pollInput();
+//         pacer.setInputTime(newestInput);
+//         render(); swap();
+//         pacer.endFrame();
+//     }
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <GL/glew.h>
+#include <vector>
+#include <chrono>
+
+class FramePacer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    FramePacer();
+
+    // create the queries, latency is the # of frames in flight before a result is read
+    void create(unsigned int latency = 8);
+    void destroy();
+
+    // at most one frame in flight
+    void setLowLatency(bool enabled)    { lowLatency = enabled; }
+    bool isLowLatency() const           { return lowLatency; }
+    // frames per second beginFrame() holds to, 0 for no limit
+    void setFrameLimit(float framesPerSecond);
+    float getFrameLimit() const         { return frameLimit; }
+
+    // before the frame's CPU work, on the GL thread
+    void beginFrame();
+    // the newest input the frame shows was received at inputTime
+    void setInputTime(Clock::time_point inputTime);
+    // right after the swap
+    void endFrame();
+
+    // since the last reset(), in ms
+    float getAverageLatency() const     { return latencyCount ? (float)(latencySum / latencyCount) : 0.0f; }
+    float getMaxLatency() const         { return (float)latencyMax; }
+    unsigned int getLatencyCount() const { return latencyCount; }
+    float getAverageWaitTime() const    { return frameCount ? (float)(waitSum / frameCount) : 0.0f; }   // limiter and fence
+    void reset();
+
+    // latency over every frame since create()
+    void printStats() const;
+
+private:
+    // a frame whose timestamp is not read yet
+    struct Frame
+    {
+        GLuint query;
+        bool issued;
+        bool hasInput;
+        Clock::time_point inputTime;
+    };
+
+    void collect(Frame& frame);
+    void calibrate();
+
+    std::vector<Frame> frames;
+    unsigned int next;
+    bool lowLatency;
+    float frameLimit;
+    Clock::duration frameInterval;
+    Clock::time_point frameStart;       // when the limiter lets the next frame start
+    GLsync fence;                       // after the last swap, low latency only
+
+    // input shown by the frame being built
+    bool pendingInput;
+    Clock::time_point pendingInputTime;
+    Clock::time_point lastInputTime;
+
+    // GPU timestamp and CPU time read together
+    GLint64 gpuReference;
+    Clock::time_point cpuReference;
+
+    // since reset()
+    double latencySum;
+    double latencyMax;
+    unsigned int latencyCount;
+    double waitSum;
+    unsigned int frameCount;
+    // since create()
+    double totalLatencySum;
+    double totalLatencyMax;
+    unsigned int totalLatencyCount;
+    unsigned int totalFrameCount;
+};
+
+#endif
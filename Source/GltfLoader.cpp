@@ -0,0 +1,517 @@
+///////////////////////////////////////////////////////////////////////////////
+// GltfLoader.cpp
+// ==============
+// glTF 2.0 binary (.glb) reader.
+// layout: 12 byte header (magic "glTF", version 2, length), then chunks of
+// (length, type, data): the JSON chunk first, then an optional BIN chunk.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include "GltfLoader.h"
+#include "Json.h"
+
+
+
+namespace
+{
+    const unsigned int GLB_MAGIC = 0x46546C67;     // "glTF"
+    const unsigned int CHUNK_JSON = 0x4E4F534A;     // "JSON"
+    const unsigned int CHUNK_BIN = 0x004E4942;      // "BIN\0"
+
+    typedef std::chrono::high_resolution_clock Clock;
+
+    unsigned int readU32(const unsigned char* p)
+    {
+        return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+    }
+
+    unsigned int getComponentSize(unsigned int componentType)
+    {
+        switch(componentType)
+        {
+        case GltfLoader::BYTE:
+        case GltfLoader::UNSIGNED_BYTE:     return 1;
+        case GltfLoader::SHORT:
+        case GltfLoader::UNSIGNED_SHORT:    return 2;
+        case GltfLoader::UNSIGNED_INT:
+        case GltfLoader::FLOAT:             return 4;
+        default:                            return 0;
+        }
+    }
+
+    unsigned int getComponentCount(const std::string& type)
+    {
+        if(type == "SCALAR") return 1;
+        if(type == "VEC2")   return 2;
+        if(type == "VEC3")   return 3;
+        if(type == "VEC4")   return 4;
+        return 0;       // matrices are not used by meshes
+    }
+
+    // one component as float, normalized integers are mapped to [0,1] or [-1,1]
+    float readComponent(const unsigned char* p, unsigned int componentType, bool normalized)
+    {
+        switch(componentType)
+        {
+        case GltfLoader::BYTE:
+        {
+            float v = (float)(signed char)p[0];
+            return normalized ? (v / 127.0f < -1.0f ? -1.0f : v / 127.0f) : v;
+        }
+        case GltfLoader::UNSIGNED_BYTE:
+            return normalized ? p[0] / 255.0f : (float)p[0];
+        case GltfLoader::SHORT:
+        {
+            short s;
+            memcpy(&s, p, 2);
+            return normalized ? (s / 32767.0f < -1.0f ? -1.0f : s / 32767.0f) : (float)s;
+        }
+        case GltfLoader::UNSIGNED_SHORT:
+        {
+            unsigned short s;
+            memcpy(&s, p, 2);
+            return normalized ? s / 65535.0f : (float)s;
+        }
+        case GltfLoader::UNSIGNED_INT:
+            return (float)readU32(p);
+        case GltfLoader::FLOAT:
+        {
+            float f;
+            memcpy(&f, p, 4);
+            return f;
+        }
+        default:
+            return 0;
+        }
+    }
+
+    // index value of an integer component
+    unsigned int readIndex(const unsigned char* p, unsigned int componentType)
+    {
+        if(componentType == GltfLoader::UNSIGNED_BYTE)
+            return p[0];
+        if(componentType == GltfLoader::UNSIGNED_SHORT)
+            return (unsigned int)p[0] | ((unsigned int)p[1] << 8);
+        return readU32(p);
+    }
+
+    int getTextureIndex(const JsonValue& material, const char* key)
+    {
+        const JsonValue* info = material.find(key);
+        return info ? info->getInt("index", -1) : -1;
+    }
+
+    // check that size bytes at offset of a buffer view are inside the view
+    bool inView(const GltfLoader::Document& document, int view, size_t offset, size_t size)
+    {
+        if(view < 0 || view >= (int)document.bufferViews.size())
+            return false;
+        return offset <= document.bufferViews[view].byteLength && size <= document.bufferViews[view].byteLength - offset;
+    }
+
+    bool fail(const char* path, const char* message)
+    {
+        std::cout << "[ERROR] GltfLoader: " << path << ": " << message << std::endl;
+        return false;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// map and parse a .glb file
+///////////////////////////////////////////////////////////////////////////////
+bool GltfLoader::load(const char* path, Document& document)
+{
+    Clock::time_point start = Clock::now();
+
+    document.bin = 0;
+    document.binSize = 0;
+    document.bufferViews.clear();
+    document.accessors.clear();
+    document.meshes.clear();
+    document.materials.clear();
+    document.textures.clear();
+    document.images.clear();
+    memset(&document.stats, 0, sizeof(Stats));
+
+    if(!document.file.open(path))
+        return fail(path, "cannot open file");
+
+    const unsigned char* data = (const unsigned char*)document.file.getData();
+    const size_t size = document.file.getSize();
+    if(size < 20 || readU32(data) != GLB_MAGIC || readU32(data + 4) != 2 || readU32(data + 8) > size)
+        return fail(path, "not a glTF 2.0 binary file");
+
+    // chunks
+    const unsigned char* json = 0;
+    size_t jsonSize = 0;
+    size_t offset = 12;
+    size_t length = readU32(data + 8);
+    while(offset + 8 <= length)
+    {
+        size_t chunkSize = readU32(data + offset);
+        unsigned int chunkType = readU32(data + offset + 4);
+        if(chunkSize > length - offset - 8)
+            return fail(path, "truncated chunk");
+
+        if(chunkType == CHUNK_JSON && !json)
+        {
+            json = data + offset + 8;
+            jsonSize = chunkSize;
+        }
+        else if(chunkType == CHUNK_BIN && !document.bin)
+        {
+            document.bin = data + offset + 8;
+            document.binSize = chunkSize;
+        }
+        offset += 8 + ((chunkSize + 3) & ~(size_t)3);
+    }
+    if(!json)
+        return fail(path, "missing JSON chunk");
+
+    JsonValue root;
+    std::string error;
+    if(!JsonValue::parse((const char*)json, jsonSize, root, error))
+        return fail(path, error.c_str());
+
+    // only the GLB BIN chunk is supported as buffer 0
+    const JsonValue* buffers = root.find("buffers");
+    if(buffers && buffers->size() > 0 && !(*buffers)[0].getString("uri").empty())
+        return fail(path, "external buffers are not supported");
+
+    // buffer views
+    const JsonValue* views = root.find("bufferViews");
+    for(size_t i = 0; views && i < views->size(); ++i)
+    {
+        const JsonValue& v = (*views)[i];
+        if(v.getInt("buffer", 0) != 0)
+            return fail(path, "buffer view does not reference the BIN chunk");
+        BufferView view;
+        view.byteOffset = (size_t)v.getNumber("byteOffset", 0);
+        view.byteLength = (size_t)v.getNumber("byteLength", 0);
+        view.byteStride = (unsigned int)v.getInt("byteStride", 0);
+        if(view.byteOffset > document.binSize || view.byteLength > document.binSize - view.byteOffset)
+            return fail(path, "buffer view out of range");
+        document.bufferViews.push_back(view);
+    }
+
+    // accessors
+    const JsonValue* accessors = root.find("accessors");
+    for(size_t i = 0; accessors && i < accessors->size(); ++i)
+    {
+        const JsonValue& a = (*accessors)[i];
+        Accessor accessor;
+        accessor.bufferView = a.getInt("bufferView", -1);
+        accessor.byteOffset = (size_t)a.getNumber("byteOffset", 0);
+        accessor.componentType = (unsigned int)a.getInt("componentType", 0);
+        accessor.components = getComponentCount(a.getString("type"));
+        accessor.count = (unsigned int)a.getNumber("count", 0);
+        accessor.normalized = a.find("normalized") ? a.find("normalized")->getBool() : false;
+        accessor.sparse = false;
+        accessor.sparseCount = 0;
+        accessor.sparseIndicesView = accessor.sparseValuesView = -1;
+        accessor.sparseIndicesOffset = accessor.sparseValuesOffset = 0;
+        accessor.sparseIndicesType = 0;
+        if(getComponentSize(accessor.componentType) == 0 || accessor.components == 0)
+            return fail(path, "unsupported accessor type");
+
+        const JsonValue* sparse = a.find("sparse");
+        if(sparse)
+        {
+            const JsonValue* sparseIndices = sparse->find("indices");
+            const JsonValue* sparseValues = sparse->find("values");
+            if(!sparseIndices || !sparseValues)
+                return fail(path, "invalid sparse accessor");
+            accessor.sparse = true;
+            accessor.sparseCount = (unsigned int)sparse->getNumber("count", 0);
+            accessor.sparseIndicesView = sparseIndices->getInt("bufferView", -1);
+            accessor.sparseIndicesOffset = (size_t)sparseIndices->getNumber("byteOffset", 0);
+            accessor.sparseIndicesType = (unsigned int)sparseIndices->getInt("componentType", 0);
+            accessor.sparseValuesView = sparseValues->getInt("bufferView", -1);
+            accessor.sparseValuesOffset = (size_t)sparseValues->getNumber("byteOffset", 0);
+            if(!inView(document, accessor.sparseIndicesView, accessor.sparseIndicesOffset,
+                       (size_t)accessor.sparseCount * getComponentSize(accessor.sparseIndicesType)) ||
+               !inView(document, accessor.sparseValuesView, accessor.sparseValuesOffset,
+                       (size_t)accessor.sparseCount * getElementSize(accessor)))
+                return fail(path, "sparse accessor out of range");
+        }
+
+        // the last element must end inside the buffer view
+        if(accessor.bufferView >= 0 && accessor.count > 0)
+        {
+            if(accessor.bufferView >= (int)document.bufferViews.size())
+                return fail(path, "invalid buffer view index");
+            unsigned int stride = getStride(document, accessor);
+            size_t span = (size_t)stride * (accessor.count - 1) + getElementSize(accessor);
+            if(!inView(document, accessor.bufferView, accessor.byteOffset, span))
+                return fail(path, "accessor out of range");
+        }
+        document.accessors.push_back(accessor);
+    }
+
+    // meshes, only triangle lists
+    const JsonValue* meshes = root.find("meshes");
+    for(size_t i = 0; meshes && i < meshes->size(); ++i)
+    {
+        const JsonValue& m = (*meshes)[i];
+        Mesh mesh;
+        mesh.name = m.getString("name");
+        const JsonValue* primitives = m.find("primitives");
+        for(size_t j = 0; primitives && j < primitives->size(); ++j)
+        {
+            const JsonValue& p = (*primitives)[j];
+            if(p.getInt("mode", 4) != 4)
+                continue;
+            const JsonValue* attributes = p.find("attributes");
+            Primitive primitive;
+            primitive.position = attributes ? attributes->getInt("POSITION", -1) : -1;
+            primitive.normal = attributes ? attributes->getInt("NORMAL", -1) : -1;
+            primitive.texCoord = attributes ? attributes->getInt("TEXCOORD_0", -1) : -1;
+            primitive.tangent = attributes ? attributes->getInt("TANGENT", -1) : -1;
+            primitive.indices = p.getInt("indices", -1);
+            primitive.material = p.getInt("material", -1);
+
+            int referenced[] = { primitive.position, primitive.normal, primitive.texCoord, primitive.tangent, primitive.indices };
+            for(int k = 0; k < 5; ++k)
+                if(referenced[k] >= (int)document.accessors.size())
+                    return fail(path, "invalid accessor index");
+            if(primitive.position < 0)
+                continue;
+            mesh.primitives.push_back(primitive);
+            ++document.stats.primitiveCount;
+        }
+        document.meshes.push_back(mesh);
+    }
+
+    // materials
+    const JsonValue* materials = root.find("materials");
+    for(size_t i = 0; materials && i < materials->size(); ++i)
+    {
+        const JsonValue& m = (*materials)[i];
+        Material material;
+        material.name = m.getString("name");
+        material.baseColor[0] = material.baseColor[1] = material.baseColor[2] = material.baseColor[3] = 1.0f;
+        material.baseColorTexture = material.metallicRoughnessTexture = -1;
+        const JsonValue* pbr = m.find("pbrMetallicRoughness");
+        if(pbr)
+        {
+            const JsonValue* factor = pbr->find("baseColorFactor");
+            for(size_t k = 0; factor && k < 4 && k < factor->size(); ++k)
+                material.baseColor[k] = (float)(*factor)[k].getNumber(1.0);
+            material.baseColorTexture = getTextureIndex(*pbr, "baseColorTexture");
+            material.metallicRoughnessTexture = getTextureIndex(*pbr, "metallicRoughnessTexture");
+        }
+        material.normalTexture = getTextureIndex(m, "normalTexture");
+        material.occlusionTexture = getTextureIndex(m, "occlusionTexture");
+        document.materials.push_back(material);
+    }
+
+    // textures and images
+    const JsonValue* textures = root.find("textures");
+    for(size_t i = 0; textures && i < textures->size(); ++i)
+        document.textures.push_back((*textures)[i].getInt("source", -1));
+
+    const JsonValue* images = root.find("images");
+    for(size_t i = 0; images && i < images->size(); ++i)
+    {
+        const JsonValue& im = (*images)[i];
+        Image image;
+        image.bufferView = im.getInt("bufferView", -1);
+        image.mimeType = im.getString("mimeType");
+        image.uri = im.getString("uri");
+        if(image.bufferView >= (int)document.bufferViews.size())
+            return fail(path, "invalid image buffer view");
+        document.images.push_back(image);
+    }
+
+    Stats& stats = document.stats;
+    stats.fileSize = size;
+    stats.jsonSize = jsonSize;
+    stats.binSize = document.binSize;
+    stats.meshCount = (unsigned int)document.meshes.size();
+    stats.parseTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// accessor layout
+///////////////////////////////////////////////////////////////////////////////
+unsigned int GltfLoader::getElementSize(const Accessor& accessor)
+{
+    return getComponentSize(accessor.componentType) * accessor.components;
+}
+
+unsigned int GltfLoader::getStride(const Document& document, const Accessor& accessor)
+{
+    if(accessor.bufferView >= 0 && document.bufferViews[accessor.bufferView].byteStride)
+        return document.bufferViews[accessor.bufferView].byteStride;
+    return getElementSize(accessor);
+}
+
+const unsigned char* GltfLoader::getData(const Document& document, const Accessor& accessor)
+{
+    if(accessor.bufferView < 0)
+        return 0;
+    return document.bin + document.bufferViews[accessor.bufferView].byteOffset + accessor.byteOffset;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// OpenGL reads attributes in place if the data is not sparse and every
+// component is aligned to its size, and the stride to 4 bytes
+///////////////////////////////////////////////////////////////////////////////
+bool GltfLoader::isDirectAttribute(const Document& document, const Accessor& accessor)
+{
+    if(accessor.sparse || accessor.bufferView < 0)
+        return false;
+    size_t offset = document.bufferViews[accessor.bufferView].byteOffset + accessor.byteOffset;
+    unsigned int componentSize = getComponentSize(accessor.componentType);
+    return (offset % componentSize) == 0 && (getStride(document, accessor) % 4) == 0;
+}
+
+// 8-bit indices are widened, GPUs handle them poorly
+bool GltfLoader::isDirectIndexBuffer(const Document& document, const Accessor& accessor)
+{
+    if(accessor.sparse || accessor.bufferView < 0 || accessor.components != 1)
+        return false;
+    if(accessor.componentType != UNSIGNED_SHORT && accessor.componentType != UNSIGNED_INT)
+        return false;
+    size_t offset = document.bufferViews[accessor.bufferView].byteOffset + accessor.byteOffset;
+    return (offset % getComponentSize(accessor.componentType)) == 0 &&
+           getStride(document, accessor) == getElementSize(accessor);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// expand an accessor to floats
+///////////////////////////////////////////////////////////////////////////////
+void GltfLoader::readAccessor(const Document& document, const Accessor& accessor, std::vector<float>& out)
+{
+    const unsigned int components = accessor.components;
+    const unsigned int componentSize = getComponentSize(accessor.componentType);
+    out.assign((size_t)accessor.count * components, 0.0f);
+
+    const unsigned char* data = getData(document, accessor);
+    if(data)
+    {
+        unsigned int stride = getStride(document, accessor);
+        for(unsigned int i = 0; i < accessor.count; ++i)
+            for(unsigned int c = 0; c < components; ++c)
+                out[(size_t)i * components + c] = readComponent(data + (size_t)i * stride + c * componentSize,
+                                                                accessor.componentType, accessor.normalized);
+    }
+
+    if(accessor.sparse)
+    {
+        const unsigned char* indices = document.bin + document.bufferViews[accessor.sparseIndicesView].byteOffset + accessor.sparseIndicesOffset;
+        const unsigned char* values = document.bin + document.bufferViews[accessor.sparseValuesView].byteOffset + accessor.sparseValuesOffset;
+        unsigned int indexSize = getComponentSize(accessor.sparseIndicesType);
+        for(unsigned int i = 0; i < accessor.sparseCount; ++i)
+        {
+            unsigned int target = readIndex(indices + (size_t)i * indexSize, accessor.sparseIndicesType);
+            if(target >= accessor.count)
+                continue;
+            for(unsigned int c = 0; c < components; ++c)
+                out[(size_t)target * components + c] = readComponent(values + ((size_t)i * components + c) * componentSize,
+                                                                     accessor.componentType, accessor.normalized);
+        }
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// read an index accessor as 32-bit indices
+///////////////////////////////////////////////////////////////////////////////
+void GltfLoader::readIndices(const Document& document, const Accessor& accessor, std::vector<unsigned int>& out)
+{
+    out.assign(accessor.count, 0);
+    const unsigned char* data = getData(document, accessor);
+    if(data)
+    {
+        unsigned int stride = getStride(document, accessor);
+        for(unsigned int i = 0; i < accessor.count; ++i)
+            out[i] = readIndex(data + (size_t)i * stride, accessor.componentType);
+    }
+
+    if(accessor.sparse)
+    {
+        const unsigned char* indices = document.bin + document.bufferViews[accessor.sparseIndicesView].byteOffset + accessor.sparseIndicesOffset;
+        const unsigned char* values = document.bin + document.bufferViews[accessor.sparseValuesView].byteOffset + accessor.sparseValuesOffset;
+        unsigned int indexSize = getComponentSize(accessor.sparseIndicesType);
+        unsigned int valueSize = getComponentSize(accessor.componentType);
+        for(unsigned int i = 0; i < accessor.sparseCount; ++i)
+        {
+            unsigned int target = readIndex(indices + (size_t)i * indexSize, accessor.sparseIndicesType);
+            if(target < accessor.count)
+                out[target] = readIndex(values + (size_t)i * valueSize, accessor.componentType);
+        }
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// peak resident memory of the process
+///////////////////////////////////////////////////////////////////////////////
+size_t GltfLoader::getPeakMemoryUsage()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss;             // bytes
+#else
+    return (size_t)usage.ru_maxrss * 1024;      // KB
+#endif
+#endif
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// print file size, load time and peak memory
+///////////////////////////////////////////////////////////////////////////////
+void GltfLoader::printStats(const char* path, const Stats& stats)
+{
+    const float MB = 1024.0f * 1024.0f;
+    std::cout << "===== GltfLoader: " << (path ? path : "") << " =====\n"
+              << std::fixed << std::setprecision(2)
+              << "      File Size: " << stats.fileSize / MB << " MB (JSON: " << stats.jsonSize / MB
+              << " MB, BIN: " << stats.binSize / MB << " MB)\n"
+              << "         Meshes: " << stats.meshCount << " (" << stats.primitiveCount << " primitives)\n"
+              << "  Direct Upload: " << stats.directBytes / MB << " MB\n"
+              << "Converted Bytes: " << stats.convertedBytes / MB << " MB\n"
+              << "     Parse Time: " << stats.parseTime << " ms\n"
+              << "      Load Time: " << stats.totalTime << " ms ("
+              << (stats.totalTime > 0 ? stats.fileSize / MB * 1000.0f / stats.totalTime : 0.0f) << " MB/s)\n"
+              << "       Peak RSS: " << stats.peakMemory / MB << " MB ("
+              << (stats.fileSize ? (float)stats.peakMemory / stats.fileSize : 0.0f) << "x file size)" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
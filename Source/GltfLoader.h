@@ -0,0 +1,150 @@
+///////////////////////////////////////////////////////////////////////////////
+// GltfLoader.h
+// ============
+// glTF 2.0 binary (.glb) reader.
+// The file is memory mapped and stays mapped as long as the Document lives,
+// so accessor data can be handed to glBufferData straight from the BIN chunk
+// with no intermediate copy. Accessors whose layout OpenGL cannot consume
+// directly (sparse, misaligned, or with no buffer view) are expanded to
+// tightly packed floats with readAccessor().
+//
+// Only the data needed to draw meshes is read: buffer views, accessors,
+// triangle primitives, materials (PBR metallic-roughness), textures and
+// images. Node transforms and animation are ignored.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef GLTF_LOADER_H
+#define GLTF_LOADER_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "MappedFile.h"
+
+namespace GltfLoader
+{
+    // component types, same values as the GL enums
+    enum ComponentType
+    {
+        BYTE = 5120, UNSIGNED_BYTE = 5121, SHORT = 5122, UNSIGNED_SHORT = 5123, UNSIGNED_INT = 5125, FLOAT = 5126
+    };
+
+    struct BufferView
+    {
+        size_t byteOffset;              // in the BIN chunk
+        size_t byteLength;
+        unsigned int byteStride;        // 0 = tightly packed
+    };
+
+    struct Accessor
+    {
+        int bufferView;                 // -1 = all zeros (or sparse only)
+        size_t byteOffset;              // in the buffer view
+        unsigned int componentType;
+        unsigned int components;        // 1 (SCALAR) to 4 (VEC4)
+        unsigned int count;
+        bool normalized;
+        bool sparse;
+        // sparse substitution, used when sparse is true
+        unsigned int sparseCount;
+        int sparseIndicesView;
+        size_t sparseIndicesOffset;
+        unsigned int sparseIndicesType;
+        int sparseValuesView;
+        size_t sparseValuesOffset;
+    };
+
+    struct Primitive
+    {
+        int position;                   // accessor indices, -1 if missing
+        int normal;
+        int texCoord;                   // TEXCOORD_0
+        int tangent;                    // vec4, w = bitangent sign
+        int indices;
+        int material;
+    };
+
+    struct Mesh
+    {
+        std::string name;
+        std::vector<Primitive> primitives;
+    };
+
+    struct Material
+    {
+        std::string name;
+        float baseColor[4];
+        int baseColorTexture;           // texture indices, -1 if none
+        int metallicRoughnessTexture;
+        int normalTexture;
+        int occlusionTexture;
+    };
+
+    struct Image
+    {
+        int bufferView;                 // embedded image, -1 if uri is used
+        std::string mimeType;
+        std::string uri;                // external file relative to the .glb
+    };
+
+    struct Stats
+    {
+        size_t fileSize;
+        size_t jsonSize;
+        size_t binSize;
+        unsigned int meshCount;
+        unsigned int primitiveCount;
+        size_t directBytes;             // uploaded straight from the mapped file
+        size_t convertedBytes;          // uploaded after conversion
+        float parseTime;                // ms
+        float totalTime;                // ms, set by the caller that uploads the data
+        size_t peakMemory;              // peak resident set size in bytes, 0 if unknown
+    };
+
+    struct Document
+    {
+        MappedFile file;
+        const unsigned char* bin;       // BIN chunk in the mapped file
+        size_t binSize;
+        std::vector<BufferView> bufferViews;
+        std::vector<Accessor> accessors;
+        std::vector<Mesh> meshes;
+        std::vector<Material> materials;
+        std::vector<int> textures;      // image index of each texture
+        std::vector<Image> images;
+        Stats stats;
+    };
+
+    // map and parse a .glb file
+    bool load(const char* path, Document& document);
+
+    // byte size of one element of an accessor
+    unsigned int getElementSize(const Accessor& accessor);
+
+    // stride in bytes between elements of an accessor
+    unsigned int getStride(const Document& document, const Accessor& accessor);
+
+    // pointer to the first element in the mapped file, 0 if there is no buffer view
+    const unsigned char* getData(const Document& document, const Accessor& accessor);
+
+    // true if OpenGL can read the accessor in place as a vertex attribute
+    bool isDirectAttribute(const Document& document, const Accessor& accessor);
+
+    // true if OpenGL can read the accessor in place as an index buffer
+    bool isDirectIndexBuffer(const Document& document, const Accessor& accessor);
+
+    // expand an accessor to count * components floats (normalized integers are
+    // scaled to [0,1] or [-1,1]), sparse values are applied
+    void readAccessor(const Document& document, const Accessor& accessor, std::vector<float>& out);
+
+    // read an index accessor as 32-bit indices
+    void readIndices(const Document& document, const Accessor& accessor, std::vector<unsigned int>& out);
+
+    // peak resident memory of the process in bytes, 0 if not available
+    size_t getPeakMemoryUsage();
+
+    // print file size, load time and peak memory
+    void printStats(const char* path, const Stats& stats);
+}
+
+#endif
@@ -0,0 +1,77 @@
+///////////////////////////////////////////////////////////////////////////////
+// GpuTimer.cpp
+// ============
+// GPU time of a span of GL commands with a ring of timer queries.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GpuTimer.h"
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor
+///////////////////////////////////////////////////////////////////////////////
+GpuTimer::GpuTimer() : next(0), totalTime(0), sampleCount(0)
+{
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// create/destroy the query ring
+///////////////////////////////////////////////////////////////////////////////
+void GpuTimer::create(unsigned int latency)
+{
+    destroy();
+    queries.resize(latency > 0 ? latency : 1);
+    issued.assign(queries.size(), false);
+    glGenQueries((GLsizei)queries.size(), queries.data());
+    next = 0;
+    reset();
+}
+
+void GpuTimer::destroy()
+{
+    if(!queries.empty())
+        glDeleteQueries((GLsizei)queries.size(), queries.data());
+    queries.clear();
+    issued.clear();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// start/stop timing, the oldest query is read before it is reused
+///////////////////////////////////////////////////////////////////////////////
+void GpuTimer::begin()
+{
+    if(queries.empty())
+        return;
+    collect(next);
+    glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+}
+
+void GpuTimer::end()
+{
+    if(queries.empty())
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    issued[next] = true;
+    next = (next + 1) % (unsigned int)queries.size();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// add the result of a query, waits only if the GPU is more than the ring behind
+///////////////////////////////////////////////////////////////////////////////
+void GpuTimer::collect(unsigned int index)
+{
+    if(!issued[index])
+        return;
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &nanoseconds);
+    totalTime += nanoseconds / 1000000.0;
+    ++sampleCount;
+    issued[index] = false;
+}
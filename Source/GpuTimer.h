@@ -0,0 +1,49 @@
+///////////////////////////////////////////////////////////////////////////////
+// GpuTimer.h
+// ==========
+// Measures the GPU time of a span of GL commands (e.g. a frame) with
+// GL_TIME_ELAPSED queries. The queries are used in a ring, so a result is
+// only read several frames after it was issued, when the GPU is done with
+// it, and reading it does not stall the pipeline.
+//
+// usage:
+//     timer.create();
+//     timer.begin(); render(); timer.end();
+//     float ms = timer.getAverageTime();
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <GL/glew.h>
+#include <vector>
+
+class GpuTimer
+{
+public:
+    GpuTimer();
+
+    // create the queries, latency is the # of spans in flight before a result is read
+    void create(unsigned int latency = 4);
+    void destroy();
+
+    // around the commands to time, on the GL thread, not nested
+    void begin();
+    void end();
+
+    // average over the results read since the last reset(), in ms
+    float getAverageTime() const        { return sampleCount ? (float)(totalTime / sampleCount) : 0.0f; }
+    unsigned int getSampleCount() const { return sampleCount; }
+    void reset()                        { totalTime = 0; sampleCount = 0; }
+
+private:
+    void collect(unsigned int index);
+
+    std::vector<GLuint> queries;
+    std::vector<bool> issued;           // query has a result to read
+    unsigned int next;
+    double totalTime;
+    unsigned int sampleCount;
+};
+
+#endif
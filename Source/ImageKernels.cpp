@@ -0,0 +1,796 @@
+///////////////////////////////////////////////////////////////////////////////
+// ImageKernels.cpp
+// ================
+// Scalar, SSE2, SSSE3 and AVX2 pixel kernels with run time dispatch.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <atomic>
+#include <random>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "ImageKernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define KERNELS_TARGET(isa)
+#else
+#include <cpuid.h>
+// compiled for the instruction set whatever the build flags, only called once the CPU is known to have it
+#define KERNELS_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    // linear values are quantized to 12 bits to look up their sRGB byte (as MipGenerator does)
+    const int LINEAR_STEPS = 4096;
+
+    struct Tables
+    {
+        // sRGB bytes then alpha bytes, indexed by byte + 256 for alpha
+        float toLinear[512];
+        // sRGB byte of each linear step then alpha bytes, indexed by LINEAR_STEPS + byte for alpha;
+        // 32-bit entries so AVX2 can gather them
+        int toSrgb[LINEAR_STEPS + 256];
+
+        Tables()
+        {
+            for(int i = 0; i < 256; ++i)
+            {
+                float c = i / 255.0f;
+                toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                toLinear[256 + i] = c;
+                toSrgb[LINEAR_STEPS + i] = i;
+            }
+            for(int i = 0; i < LINEAR_STEPS; ++i)
+            {
+                float c = i / (float)(LINEAR_STEPS - 1);
+                float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+                toSrgb[i] = (int)(s * 255.0f + 0.5f);
+            }
+        }
+    };
+
+    // built once, on first use (thread safe since C++11)
+    const Tables& getTables()
+    {
+        static const Tables tables;
+        return tables;
+    }
+
+    // channel 1 of grey + alpha and channel 3 of RGBA are alpha
+    bool isAlpha(int channels, int channel)
+    {
+        return (channels == 2 && channel == 1) || (channels == 4 && channel == 3);
+    }
+
+
+
+    // scalar kernels, the reference for the others //////////////////////////
+    void flipScalar(unsigned char* image, int width, int height, int channels)
+    {
+        const size_t lineSize = (size_t)width * channels;
+        for(int j = 0; j < height / 2; ++j)
+        {
+            unsigned char* a = image + (size_t)j * lineSize;
+            unsigned char* b = image + (size_t)(height - 1 - j) * lineSize;
+            for(size_t i = 0; i < lineSize; ++i)
+                std::swap(a[i], b[i]);
+        }
+    }
+
+    void swapRedBlueScalar(unsigned char* pixels, size_t pixelCount, int channels)
+    {
+        const size_t size = pixelCount * channels;
+        for(size_t i = 0; i < size; i += channels)
+            std::swap(pixels[i], pixels[i + 2]);
+    }
+
+    void expandScalar(const unsigned char* src, unsigned char* dst, size_t pixelCount, unsigned char alpha)
+    {
+        for(size_t i = 0; i < pixelCount; ++i)
+        {
+            dst[i * 4] = src[i * 3];
+            dst[i * 4 + 1] = src[i * 3 + 1];
+            dst[i * 4 + 2] = src[i * 3 + 2];
+            dst[i * 4 + 3] = alpha;
+        }
+    }
+
+    // round(c * a / 255) without a division, exact for every byte pair
+    inline unsigned char multiplyBytes(unsigned int c, unsigned int a)
+    {
+        unsigned int t = c * a + 128;
+        return (unsigned char)((t + (t >> 8)) >> 8);
+    }
+
+    void premultiplyScalar(unsigned char* pixels, size_t pixelCount)
+    {
+        for(size_t i = 0; i < pixelCount * 4; i += 4)
+        {
+            const unsigned int a = pixels[i + 3];
+            pixels[i] = multiplyBytes(pixels[i], a);
+            pixels[i + 1] = multiplyBytes(pixels[i + 1], a);
+            pixels[i + 2] = multiplyBytes(pixels[i + 2], a);
+        }
+    }
+
+    void srgbToLinearScalar(const unsigned char* src, float* dst, size_t pixelCount, int channels)
+    {
+        const Tables& t = getTables();
+        for(size_t i = 0; i < pixelCount * channels; i += channels)
+            for(int c = 0; c < channels; ++c)
+                dst[i + c] = t.toLinear[src[i + c] + (isAlpha(channels, c) ? 256 : 0)];
+    }
+
+    inline unsigned char linearToSrgbValue(const Tables& t, float v, bool alpha)
+    {
+        v = std::min(std::max(v, 0.0f), 1.0f);
+        return alpha ? (unsigned char)t.toSrgb[LINEAR_STEPS + (int)(v * 255.0f + 0.5f)]
+                     : (unsigned char)t.toSrgb[(int)(v * (LINEAR_STEPS - 1) + 0.5f)];
+    }
+
+    void linearToSrgbScalar(const float* src, unsigned char* dst, size_t pixelCount, int channels)
+    {
+        const Tables& t = getTables();
+        for(size_t i = 0; i < pixelCount * channels; i += channels)
+            for(int c = 0; c < channels; ++c)
+                dst[i + c] = linearToSrgbValue(t, src[i + c], isAlpha(channels, c));
+    }
+
+
+
+#if defined(KERNELS_X86)
+    // SSE2 kernels ///////////////////////////////////////////////////////////
+    KERNELS_TARGET("sse2")
+    void flipSse2(unsigned char* image, int width, int height, int channels)
+    {
+        const size_t lineSize = (size_t)width * channels;
+        for(int j = 0; j < height / 2; ++j)
+        {
+            unsigned char* a = image + (size_t)j * lineSize;
+            unsigned char* b = image + (size_t)(height - 1 - j) * lineSize;
+            size_t i = 0;
+            for(; i + 16 <= lineSize; i += 16)
+            {
+                __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+                __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+                _mm_storeu_si128((__m128i*)(a + i), y);
+                _mm_storeu_si128((__m128i*)(b + i), x);
+            }
+            for(; i < lineSize; ++i)
+                std::swap(a[i], b[i]);
+        }
+    }
+
+    // 4 channels only, by shifts and masks
+    KERNELS_TARGET("sse2")
+    void swapRedBlueSse2(unsigned char* pixels, size_t pixelCount, int channels)
+    {
+        if(channels != 4)
+        {
+            swapRedBlueScalar(pixels, pixelCount, channels);
+            return;
+        }
+        const __m128i low = _mm_set1_epi32(0x000000ff);
+        const __m128i greenAlpha = _mm_set1_epi32((int)0xff00ff00);
+        size_t i = 0;
+        for(; i + 4 <= pixelCount; i += 4)
+        {
+            __m128i p = _mm_loadu_si128((const __m128i*)(pixels + i * 4));
+            __m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), low);
+            __m128i b = _mm_slli_epi32(_mm_and_si128(p, low), 16);
+            _mm_storeu_si128((__m128i*)(pixels + i * 4), _mm_or_si128(_mm_and_si128(p, greenAlpha), _mm_or_si128(r, b)));
+        }
+        swapRedBlueScalar(pixels + i * 4, pixelCount - i, 4);
+    }
+
+    // 4 pixels at once: (c * a + 128) in 16 bits, alpha multiplied by 255 to stay as it is
+    KERNELS_TARGET("sse2")
+    inline __m128i premultiply8(__m128i p, __m128i colorMask, __m128i alpha255)
+    {
+        const __m128i half = _mm_set1_epi16(128);
+        __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        a = _mm_or_si128(_mm_and_si128(a, colorMask), alpha255);
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(p, a), half);
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    }
+
+    KERNELS_TARGET("sse2")
+    void premultiplySse2(unsigned char* pixels, size_t pixelCount)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i colorMask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+        const __m128i alpha255 = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+        size_t i = 0;
+        for(; i + 4 <= pixelCount; i += 4)
+        {
+            __m128i p = _mm_loadu_si128((const __m128i*)(pixels + i * 4));
+            __m128i lo = premultiply8(_mm_unpacklo_epi8(p, zero), colorMask, alpha255);
+            __m128i hi = premultiply8(_mm_unpackhi_epi8(p, zero), colorMask, alpha255);
+            _mm_storeu_si128((__m128i*)(pixels + i * 4), _mm_packus_epi16(lo, hi));
+        }
+        premultiplyScalar(pixels + i * 4, pixelCount - i);
+    }
+
+    // 4 values at once to table indices, the lookups stay scalar
+    KERNELS_TARGET("sse2")
+    void linearToSrgbSse2(const float* src, unsigned char* dst, size_t pixelCount, int channels)
+    {
+        const Tables& t = getTables();
+        const size_t count = pixelCount * channels;
+        const bool alpha = channels == 2 || channels == 4;     // alpha lanes repeat every 4 values
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const float s = (float)(LINEAR_STEPS - 1);
+        const __m128 scale = !alpha ? _mm_set1_ps(s) : channels == 4 ? _mm_set_ps(255.0f, s, s, s) : _mm_set_ps(255.0f, s, 255.0f, s);
+        const __m128i offset = !alpha ? _mm_setzero_si128() : channels == 4 ? _mm_set_epi32(LINEAR_STEPS, 0, 0, 0)
+                                                                            : _mm_set_epi32(LINEAR_STEPS, 0, LINEAR_STEPS, 0);
+        int index[4];
+        size_t i = 0;
+        for(; i + 4 <= count; i += 4)
+        {
+            __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), zero), one);
+            __m128i k = _mm_add_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half)), offset);
+            _mm_storeu_si128((__m128i*)index, k);
+            dst[i] = (unsigned char)t.toSrgb[index[0]];
+            dst[i + 1] = (unsigned char)t.toSrgb[index[1]];
+            dst[i + 2] = (unsigned char)t.toSrgb[index[2]];
+            dst[i + 3] = (unsigned char)t.toSrgb[index[3]];
+        }
+        // i is a multiple of 4 (and of channels when there is alpha), the tail starts at a pixel for 1, 2 and 4 channels
+        for(; i < count; ++i)
+            dst[i] = linearToSrgbValue(t, src[i], isAlpha(channels, (int)(i % channels)));
+    }
+
+
+
+    // SSSE3 kernels, byte shuffles ///////////////////////////////////////////
+    KERNELS_TARGET("ssse3")
+    void swapRedBlueSsse3(unsigned char* pixels, size_t pixelCount, int channels)
+    {
+        const size_t size = pixelCount * channels;
+        size_t i = 0;
+        if(channels == 4)
+        {
+            const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+            for(; i + 16 <= size; i += 16)
+                _mm_storeu_si128((__m128i*)(pixels + i), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pixels + i)), mask));
+        }
+        else if(channels == 3)
+        {
+            // 5 pixels in 16 bytes, the 16th byte is stored back as it is and swapped with the next 5 pixels;
+            // the next 16 bytes are loaded before the store, so the load does not wait on it
+            const __m128i mask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+            if(size >= 16)
+            {
+                __m128i p = _mm_loadu_si128((const __m128i*)pixels);
+                for(; i + 31 <= size; i += 15)
+                {
+                    __m128i next = _mm_loadu_si128((const __m128i*)(pixels + i + 15));
+                    _mm_storeu_si128((__m128i*)(pixels + i), _mm_shuffle_epi8(p, mask));
+                    p = next;
+                }
+                _mm_storeu_si128((__m128i*)(pixels + i), _mm_shuffle_epi8(p, mask));
+                i += 15;
+            }
+        }
+        swapRedBlueScalar(pixels + i, (size - i) / channels, channels);
+    }
+
+    KERNELS_TARGET("ssse3")
+    void expandSsse3(const unsigned char* src, unsigned char* dst, size_t pixelCount, unsigned char alpha)
+    {
+        const __m128i mask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alphas = _mm_set1_epi32((int)((unsigned int)alpha << 24));
+        size_t i = 0;
+        // 4 pixels from a 16 byte load, so the last 4 bytes of src are never read past
+        for(; (i + 4) * 3 + 4 <= pixelCount * 3; i += 4)
+        {
+            __m128i p = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i * 3)), mask);
+            _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(p, alphas));
+        }
+        expandScalar(src + i * 3, dst + i * 4, pixelCount - i, alpha);
+    }
+
+
+
+    // AVX2 kernels, 32 bytes at once /////////////////////////////////////////
+    KERNELS_TARGET("avx2")
+    void flipAvx2(unsigned char* image, int width, int height, int channels)
+    {
+        const size_t lineSize = (size_t)width * channels;
+        for(int j = 0; j < height / 2; ++j)
+        {
+            unsigned char* a = image + (size_t)j * lineSize;
+            unsigned char* b = image + (size_t)(height - 1 - j) * lineSize;
+            size_t i = 0;
+            for(; i + 32 <= lineSize; i += 32)
+            {
+                __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+                __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+                _mm256_storeu_si256((__m256i*)(a + i), y);
+                _mm256_storeu_si256((__m256i*)(b + i), x);
+            }
+            for(; i < lineSize; ++i)
+                std::swap(a[i], b[i]);
+        }
+    }
+
+    // 16 bytes at p in the low lane, 16 bytes at p + 15 in the high lane
+    KERNELS_TARGET("avx2")
+    inline __m256i load2x15(const unsigned char* p)
+    {
+        return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)),
+                                       _mm_loadu_si128((const __m128i*)(p + 15)), 1);
+    }
+
+    KERNELS_TARGET("avx2")
+    inline void store2x15(unsigned char* p, __m256i v)
+    {
+        _mm_storeu_si128((__m128i*)p, _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i*)(p + 15), _mm256_extracti128_si256(v, 1));
+    }
+
+    KERNELS_TARGET("avx2")
+    void swapRedBlueAvx2(unsigned char* pixels, size_t pixelCount, int channels)
+    {
+        const size_t size = pixelCount * channels;
+        size_t i = 0;
+        if(channels == 4)
+        {
+            const __m256i mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                                  2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+            for(; i + 32 <= size; i += 32)
+                _mm256_storeu_si256((__m256i*)(pixels + i), _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(pixels + i)), mask));
+        }
+        else if(channels == 3)
+        {
+            // 5 pixels in each 16 byte lane, loaded 15 bytes apart; the low lane is stored first so its
+            // 16th byte (unchanged) is overwritten by the high lane's first swapped byte. As with SSSE3,
+            // the next 10 pixels are loaded before the stores
+            const __m256i mask = _mm256_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15,
+                                                  2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+            if(size >= 31)
+            {
+                __m256i p = load2x15(pixels);
+                for(; i + 61 <= size; i += 30)
+                {
+                    __m256i next = load2x15(pixels + i + 30);
+                    store2x15(pixels + i, _mm256_shuffle_epi8(p, mask));
+                    p = next;
+                }
+                store2x15(pixels + i, _mm256_shuffle_epi8(p, mask));
+                i += 30;
+            }
+        }
+        swapRedBlueScalar(pixels + i, (size - i) / channels, channels);
+    }
+
+    KERNELS_TARGET("avx2")
+    void expandAvx2(const unsigned char* src, unsigned char* dst, size_t pixelCount, unsigned char alpha)
+    {
+        const __m256i mask = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                              0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i alphas = _mm256_set1_epi32((int)((unsigned int)alpha << 24));
+        size_t i = 0;
+        // 8 pixels from two 16 byte loads 12 bytes apart, the second ends 4 bytes past the 8th pixel
+        for(; (i + 8) * 3 + 4 <= pixelCount * 3; i += 8)
+        {
+            __m256i p = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(src + i * 3))),
+                                                _mm_loadu_si128((const __m128i*)(src + i * 3 + 12)), 1);
+            _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(p, mask), alphas));
+        }
+        expandScalar(src + i * 3, dst + i * 4, pixelCount - i, alpha);
+    }
+
+    KERNELS_TARGET("avx2")
+    inline __m256i premultiply16(__m256i p, __m256i colorMask, __m256i alpha255)
+    {
+        const __m256i half = _mm256_set1_epi16(128);
+        __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(p, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        a = _mm256_or_si256(_mm256_and_si256(a, colorMask), alpha255);
+        __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(p, a), half);
+        return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+    }
+
+    // unpack and pack both work within 16 byte lanes, so the pixels come back in order
+    KERNELS_TARGET("avx2")
+    void premultiplyAvx2(unsigned char* pixels, size_t pixelCount)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i colorMask = _mm256_set_epi16(0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1);
+        const __m256i alpha255 = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+        size_t i = 0;
+        for(; i + 8 <= pixelCount; i += 8)
+        {
+            __m256i p = _mm256_loadu_si256((const __m256i*)(pixels + i * 4));
+            __m256i lo = premultiply16(_mm256_unpacklo_epi8(p, zero), colorMask, alpha255);
+            __m256i hi = premultiply16(_mm256_unpackhi_epi8(p, zero), colorMask, alpha255);
+            _mm256_storeu_si256((__m256i*)(pixels + i * 4), _mm256_packus_epi16(lo, hi));
+        }
+        premultiplyScalar(pixels + i * 4, pixelCount - i);
+    }
+
+    // 8 bytes widened to indices and gathered from the table, + 256 in the alpha lanes
+    KERNELS_TARGET("avx2")
+    void srgbToLinearAvx2(const unsigned char* src, float* dst, size_t pixelCount, int channels)
+    {
+        const Tables& t = getTables();
+        const size_t count = pixelCount * channels;
+        const __m256i offset = channels == 4 ? _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256) :
+                               channels == 2 ? _mm256_setr_epi32(0, 256, 0, 256, 0, 256, 0, 256) : _mm256_setzero_si256();
+        size_t i = 0;
+        for(; i + 8 <= count; i += 8)
+        {
+            __m256i k = _mm256_add_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i))), offset);
+            _mm256_storeu_ps(dst + i, _mm256_i32gather_ps(t.toLinear, k, 4));
+        }
+        // i is a multiple of 8, so of channels when there is alpha
+        for(; i < count; ++i)
+            dst[i] = t.toLinear[src[i] + (isAlpha(channels, (int)(i % channels)) ? 256 : 0)];
+    }
+
+    KERNELS_TARGET("avx2")
+    void linearToSrgbAvx2(const float* src, unsigned char* dst, size_t pixelCount, int channels)
+    {
+        const Tables& t = getTables();
+        const size_t count = pixelCount * channels;
+        const bool alpha = channels == 2 || channels == 4;
+        const float s = (float)(LINEAR_STEPS - 1);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 scale = !alpha ? _mm256_set1_ps(s) : channels == 4 ? _mm256_setr_ps(s, s, s, 255.0f, s, s, s, 255.0f)
+                                                                        : _mm256_setr_ps(s, 255.0f, s, 255.0f, s, 255.0f, s, 255.0f);
+        const __m256i offset = !alpha ? _mm256_setzero_si256() :
+                               channels == 4 ? _mm256_setr_epi32(0, 0, 0, LINEAR_STEPS, 0, 0, 0, LINEAR_STEPS)
+                                             : _mm256_setr_epi32(0, LINEAR_STEPS, 0, LINEAR_STEPS, 0, LINEAR_STEPS, 0, LINEAR_STEPS);
+        size_t i = 0;
+        for(; i + 8 <= count; i += 8)
+        {
+            __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), zero), one);
+            __m256i k = _mm256_add_epi32(_mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, scale), half)), offset);
+            __m256i bytes = _mm256_i32gather_epi32(t.toSrgb, k, 4);
+            __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(bytes), _mm256_extracti128_si256(bytes, 1));
+            _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(words, words));
+        }
+        for(; i < count; ++i)
+            dst[i] = linearToSrgbValue(t, src[i], isAlpha(channels, (int)(i % channels)));
+    }
+#endif
+
+
+
+    // dispatch ///////////////////////////////////////////////////////////////
+    struct Kernels
+    {
+        void (*flip)(unsigned char*, int, int, int);
+        void (*swapRedBlue)(unsigned char*, size_t, int);
+        void (*expand)(const unsigned char*, unsigned char*, size_t, unsigned char);
+        void (*premultiply)(unsigned char*, size_t);
+        void (*srgbToLinear)(const unsigned char*, float*, size_t, int);
+        void (*linearToSrgb)(const float*, unsigned char*, size_t, int);
+    };
+
+    // each level falls back to the widest version below it
+    Kernels getKernels(ImageKernels::Level level)
+    {
+        Kernels k = { flipScalar, swapRedBlueScalar, expandScalar, premultiplyScalar, srgbToLinearScalar, linearToSrgbScalar };
+#if defined(KERNELS_X86)
+        if(level >= ImageKernels::SSE2)
+        {
+            k.flip = flipSse2;
+            k.swapRedBlue = swapRedBlueSse2;
+            k.premultiply = premultiplySse2;
+            k.linearToSrgb = linearToSrgbSse2;
+        }
+        if(level >= ImageKernels::SSSE3)
+        {
+            k.swapRedBlue = swapRedBlueSsse3;
+            k.expand = expandSsse3;
+        }
+        if(level >= ImageKernels::AVX2)
+        {
+            k.flip = flipAvx2;
+            k.swapRedBlue = swapRedBlueAvx2;
+            k.expand = expandAvx2;
+            k.premultiply = premultiplyAvx2;
+            k.srgbToLinear = srgbToLinearAvx2;
+            k.linearToSrgb = linearToSrgbAvx2;
+        }
+#endif
+        return k;
+    }
+
+    ImageKernels::Level detectLevel()
+    {
+#if defined(KERNELS_X86)
+        unsigned int regs[4] = { 0, 0, 0, 0 };     // eax, ebx, ecx, edx
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        const unsigned int maxLeaf = (unsigned int)info[0];
+        __cpuid(info, 1);
+        regs[2] = (unsigned int)info[2];
+        regs[3] = (unsigned int)info[3];
+#else
+        const unsigned int maxLeaf = __get_cpuid_max(0, 0);
+        __get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+        if(!(regs[3] & (1u << 26)))
+            return ImageKernels::SCALAR;
+        if(!(regs[2] & (1u << 9)))
+            return ImageKernels::SSE2;
+
+        // AVX2 needs the CPU flag, AVX and the OS saving the YMM registers (OSXSAVE + XCR0 bits 1 and 2)
+        const bool osSavesYmm = (regs[2] & (1u << 27)) && (regs[2] & (1u << 28));
+        unsigned int xcr0 = 0;
+        unsigned int leaf7Ebx = 0;
+#if defined(_MSC_VER)
+        if(osSavesYmm)
+            xcr0 = (unsigned int)_xgetbv(0);
+        if(maxLeaf >= 7)
+        {
+            __cpuidex(info, 7, 0);
+            leaf7Ebx = (unsigned int)info[1];
+        }
+#else
+        if(osSavesYmm)
+        {
+            unsigned int edx;
+            __asm__("xgetbv" : "=a"(xcr0), "=d"(edx) : "c"(0));
+        }
+        if(maxLeaf >= 7)
+        {
+            unsigned int eax, ecx, edx;
+            __cpuid_count(7, 0, eax, leaf7Ebx, ecx, edx);
+        }
+#endif
+        if(osSavesYmm && (xcr0 & 6) == 6 && (leaf7Ebx & (1u << 5)))
+            return ImageKernels::AVX2;
+        return ImageKernels::SSSE3;
+#else
+        return ImageKernels::SCALAR;
+#endif
+    }
+
+    std::atomic<int> currentLevel(-1);
+
+    const Kernels& getCurrent()
+    {
+        static const Kernels kernels[4] = { getKernels(ImageKernels::SCALAR), getKernels(ImageKernels::SSE2),
+                                            getKernels(ImageKernels::SSSE3), getKernels(ImageKernels::AVX2) };
+        return kernels[ImageKernels::getLevel()];
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// levels
+///////////////////////////////////////////////////////////////////////////////
+ImageKernels::Level ImageKernels::getSupportedLevel()
+{
+    static const Level level = detectLevel();
+    return level;
+}
+
+ImageKernels::Level ImageKernels::getLevel()
+{
+    int level = currentLevel.load(std::memory_order_relaxed);
+    return level < 0 ? getSupportedLevel() : (Level)level;
+}
+
+void ImageKernels::setLevel(Level level)
+{
+    currentLevel.store(std::min(level, getSupportedLevel()), std::memory_order_relaxed);
+}
+
+const char* ImageKernels::getName(Level level)
+{
+    switch(level)
+    {
+    case SSE2:  return "SSE2";
+    case SSSE3: return "SSSE3";
+    case AVX2:  return "AVX2";
+    default:    return "scalar";
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// kernels, through the table of the current level
+///////////////////////////////////////////////////////////////////////////////
+void ImageKernels::flipVertical(unsigned char* image, int width, int height, int channels)
+{
+    getCurrent().flip(image, width, height, channels);
+}
+
+void ImageKernels::swapRedBlue(unsigned char* pixels, size_t pixelCount, int channels)
+{
+    if(channels == 3 || channels == 4)
+        getCurrent().swapRedBlue(pixels, pixelCount, channels);
+}
+
+void ImageKernels::expandRgbToRgba(const unsigned char* src, unsigned char* dst, size_t pixelCount, unsigned char alpha)
+{
+    getCurrent().expand(src, dst, pixelCount, alpha);
+}
+
+void ImageKernels::premultiplyAlpha(unsigned char* pixels, size_t pixelCount)
+{
+    getCurrent().premultiply(pixels, pixelCount);
+}
+
+void ImageKernels::srgbToLinear(const unsigned char* src, float* dst, size_t pixelCount, int channels)
+{
+    getCurrent().srgbToLinear(src, dst, pixelCount, channels);
+}
+
+void ImageKernels::linearToSrgb(const float* src, unsigned char* dst, size_t pixelCount, int channels)
+{
+    getCurrent().linearToSrgb(src, dst, pixelCount, channels);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// run every kernel of every supported level on random images whose sizes hit
+// the vector tails, and compare with the scalar kernels byte for byte
+///////////////////////////////////////////////////////////////////////////////
+bool ImageKernels::verify()
+{
+    const Kernels reference = getKernels(SCALAR);
+    const int SIZES[][2] = { { 1, 1 }, { 3, 2 }, { 5, 3 }, { 17, 9 }, { 31, 7 }, { 64, 5 }, { 101, 33 } };
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::uniform_real_distribution<float> value(-0.1f, 1.1f);     // out of range values are clamped
+    bool passed = true;
+
+    for(int level = SSE2; level <= getSupportedLevel(); ++level)
+    {
+        const Kernels k = getKernels((Level)level);
+        unsigned int failures = 0;
+        for(size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); ++s)
+        {
+            const int width = SIZES[s][0], height = SIZES[s][1];
+            const size_t pixelCount = (size_t)width * height;
+            std::vector<unsigned char> image(pixelCount * 4), expected, actual;
+            std::vector<float> linear(pixelCount * 4), expectedLinear(pixelCount * 4), actualLinear(pixelCount * 4);
+            for(size_t i = 0; i < image.size(); ++i)
+                image[i] = (unsigned char)byte(random);
+            for(size_t i = 0; i < linear.size(); ++i)
+                linear[i] = value(random);
+
+            for(int channels = 1; channels <= 4; ++channels)
+            {
+                const size_t size = pixelCount * channels;
+                expected.assign(image.begin(), image.begin() + size);
+                actual = expected;
+                reference.flip(expected.data(), width, height, channels);
+                k.flip(actual.data(), width, height, channels);
+                failures += expected != actual;
+
+                if(channels >= 3)
+                {
+                    expected.assign(image.begin(), image.begin() + size);
+                    actual = expected;
+                    reference.swapRedBlue(expected.data(), pixelCount, channels);
+                    k.swapRedBlue(actual.data(), pixelCount, channels);
+                    failures += expected != actual;
+                }
+
+                reference.srgbToLinear(image.data(), expectedLinear.data(), pixelCount, channels);
+                k.srgbToLinear(image.data(), actualLinear.data(), pixelCount, channels);
+                failures += memcmp(expectedLinear.data(), actualLinear.data(), size * sizeof(float)) != 0;
+
+                expected.assign(size, 0);
+                actual.assign(size, 0);
+                reference.linearToSrgb(linear.data(), expected.data(), pixelCount, channels);
+                k.linearToSrgb(linear.data(), actual.data(), pixelCount, channels);
+                failures += expected != actual;
+            }
+
+            // exact sized buffers, so reading past the RGB source would show with a memory checker
+            std::vector<unsigned char> rgb(image.begin(), image.begin() + pixelCount * 3);
+            expected.assign(pixelCount * 4, 0);
+            actual.assign(pixelCount * 4, 0);
+            reference.expand(rgb.data(), expected.data(), pixelCount, 200);
+            k.expand(rgb.data(), actual.data(), pixelCount, 200);
+            failures += expected != actual;
+
+            expected = image;
+            actual = image;
+            reference.premultiply(expected.data(), pixelCount);
+            k.premultiply(actual.data(), pixelCount);
+            failures += expected != actual;
+        }
+
+        if(failures)
+            std::cout << "[ERROR] ImageKernels: " << failures << " " << getName((Level)level) << " results differ from the scalar kernels" << std::endl;
+        passed = passed && !failures;
+    }
+
+    // every byte pair of the premultiply formula against the exact rounding
+    for(unsigned int c = 0; c < 256; ++c)
+        for(unsigned int a = 0; a < 256; ++a)
+            if(multiplyBytes(c, a) != (unsigned char)((c * a * 2 + 255) / 510))
+            {
+                std::cout << "[ERROR] ImageKernels: premultiply " << c << " x " << a << " is not rounded" << std::endl;
+                passed = false;
+            }
+    return passed;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// time each kernel at each level, in GB/s of bytes read + written
+///////////////////////////////////////////////////////////////////////////////
+void ImageKernels::benchmark(size_t pixelCount, unsigned int iterations)
+{
+    const int width = 3840;
+    const int height = (int)std::max<size_t>(pixelCount / width, 2);
+    pixelCount = (size_t)width * height;
+    const unsigned int runs = std::max(iterations, 1u);
+
+    std::vector<unsigned char> rgba(pixelCount * 4), rgb(pixelCount * 3);
+    std::vector<float> linear(pixelCount * 4);
+    for(size_t i = 0; i < rgba.size(); ++i)
+        rgba[i] = (unsigned char)(i * 7 + i / 4093);
+    memcpy(rgb.data(), rgba.data(), rgb.size());
+
+    const char* NAMES[] = { "Flip RGBA", "Swap RGB", "Swap RGBA", "Expand RGB", "Premultiply", "sRGB to Linear", "Linear to sRGB" };
+    const size_t BYTES[] = { rgba.size() * 2, rgb.size() * 2, rgba.size() * 2, rgb.size() + rgba.size(), rgba.size() * 2,
+                             rgba.size() * 5, rgba.size() * 5 };
+    const Level level = getLevel();
+    const bool verified = verify();
+
+    std::cout << "===== ImageKernels Benchmark: " << width << " x " << height << ", supported: " << getName(getSupportedLevel()) << " =====\n"
+              << "  Correctness: " << (verified ? "every level matches the scalar kernels" : "FAILED") << "\n"
+              << std::fixed << std::setprecision(2);
+    for(int k = 0; k < 7; ++k)
+    {
+        std::cout << std::setw(16) << NAMES[k] << ":";
+        for(int l = SCALAR; l <= getSupportedLevel(); ++l)
+        {
+            setLevel((Level)l);
+            Clock::time_point start = Clock::now();
+            for(unsigned int i = 0; i < runs; ++i)
+            {
+                switch(k)
+                {
+                case 0: flipVertical(rgba.data(), width, height, 4); break;
+                case 1: swapRedBlue(rgb.data(), pixelCount, 3); break;
+                case 2: swapRedBlue(rgba.data(), pixelCount, 4); break;
+                case 3: expandRgbToRgba(rgb.data(), rgba.data(), pixelCount); break;
+                case 4: premultiplyAlpha(rgba.data(), pixelCount); break;
+                case 5: srgbToLinear(rgba.data(), linear.data(), pixelCount, 4); break;
+                default: linearToSrgb(linear.data(), rgba.data(), pixelCount, 4); break;
+                }
+            }
+            float time = std::chrono::duration<float>(Clock::now() - start).count() / runs;
+            std::cout << "  " << getName((Level)l) << " " << (time > 0 ? BYTES[k] / time / 1e9f : 0.0f) << " GB/s";
+        }
+        std::cout << "\n";
+    }
+    std::cout << std::flush;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+    setLevel(level);
+}
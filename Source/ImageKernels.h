@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+// ImageKernels.h
+// ==============
+// Pixel kernels for 8-bit images: vertical flip, red/blue swizzle, RGB to
+// RGBA expansion, alpha premultiplication and sRGB <-> linear conversion.
+//
+// Each kernel has a scalar version and SSE2, SSSE3 and/or AVX2 versions. The
+// instruction sets the CPU (and OS) supports are detected once at run time
+// and every call goes to the widest version available, so the same binary
+// runs on any x86 CPU; other CPUs use the scalar versions. setLevel() caps
+// the level, to compare the versions.
+//
+// Every version gives exactly the same bytes (and floats) as the scalar
+// one; verify() checks it on random images of awkward sizes and
+// benchmark() prints the GB/s of each kernel at each level:
+//   OpenGLSample --benchmark-image-kernels
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef IMAGE_KERNELS_H
+#define IMAGE_KERNELS_H
+
+#include <cstddef>
+
+namespace ImageKernels
+{
+    enum Level
+    {
+        SCALAR,
+        SSE2,
+        SSSE3,
+        AVX2
+    };
+
+    // widest level the CPU and OS support
+    Level getSupportedLevel();
+    // level the kernels run at, getSupportedLevel() unless capped
+    Level getLevel();
+    // cap the level, clamped to getSupportedLevel()
+    void setLevel(Level level);
+    const char* getName(Level level);
+
+    // swap the rows of a width x height image in place
+    void flipVertical(unsigned char* image, int width, int height, int channels);
+    // swap the 1st and 3rd bytes of 3 or 4 byte pixels in place (RGB <-> BGR, RGBA <-> BGRA)
+    void swapRedBlue(unsigned char* pixels, size_t pixelCount, int channels);
+    // RGB to RGBA with a constant alpha, src and dst must not overlap
+    void expandRgbToRgba(const unsigned char* src, unsigned char* dst, size_t pixelCount, unsigned char alpha = 255);
+    // multiply the color of RGBA pixels by their alpha in place, rounded to nearest
+    void premultiplyAlpha(unsigned char* pixels, size_t pixelCount);
+    // sRGB bytes to linear floats, the alpha channel of 2 and 4 channel pixels is only scaled to [0, 1]
+    void srgbToLinear(const unsigned char* src, float* dst, size_t pixelCount, int channels);
+    // linear floats (clamped to [0, 1]) to sRGB bytes, the alpha channel is only scaled to [0, 255]
+    void linearToSrgb(const float* src, unsigned char* dst, size_t pixelCount, int channels);
+
+    // compare every supported level with the scalar kernels, print the failures, return true if all match
+    bool verify();
+    // print the throughput of each kernel at each supported level on an image of pixelCount pixels
+    void benchmark(size_t pixelCount = 3840 * 2160, unsigned int iterations = 20);
+}
+
+#endif
@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+// IndexBuffer.cpp
+// ===============
+// Index width selection for triangle meshes.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "IndexBuffer.h"
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// copy 32-bit indices to 16-bit
+///////////////////////////////////////////////////////////////////////////////
+void IndexBuffer::narrow(const unsigned int* indices, unsigned int indexCount, unsigned short* out)
+{
+    for(unsigned int i = 0; i < indexCount; ++i)
+        out[i] = (unsigned short)indices[i];
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// split triangles into chunks of at most maxVertices unique vertices
+// Triangles are kept in their original order, so a cache/fetch optimized
+// index buffer stays optimized and chunk borders duplicate few vertices.
+///////////////////////////////////////////////////////////////////////////////
+void IndexBuffer::split(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount,
+                        std::vector<unsigned short>& chunkIndices, std::vector<unsigned int>& vertexRemap,
+                        std::vector<Chunk>& chunks, unsigned int maxVertices)
+{
+    chunkIndices.clear();
+    vertexRemap.clear();
+    chunks.clear();
+    if(indexCount < 3 || maxVertices < 3)
+        return;
+
+    chunkIndices.reserve(indexCount);
+    vertexRemap.reserve(vertexCount);
+
+    // local index of each source vertex in the current chunk
+    // a vertex belongs to the current chunk if its stamp matches the chunk #
+    std::vector<unsigned int> local(vertexCount, 0);
+    std::vector<unsigned int> stamp(vertexCount, ~0u);
+
+    Chunk chunk = { 0, 0, 0, 0 };
+    unsigned int triangleCount = indexCount / 3;
+    for(unsigned int t = 0; t < triangleCount; ++t)
+    {
+        const unsigned int* tri = &indices[t * 3];
+        unsigned int chunkId = (unsigned int)chunks.size();
+
+        // count the vertices this triangle adds to the chunk
+        unsigned int added = 0;
+        for(int k = 0; k < 3; ++k)
+        {
+            bool repeated = (k > 0 && tri[k] == tri[0]) || (k > 1 && tri[k] == tri[1]);
+            if(stamp[tri[k]] != chunkId && !repeated)
+                ++added;
+        }
+
+        // close the chunk when it would overflow
+        if(chunk.vertexCount + added > maxVertices)
+        {
+            chunks.push_back(chunk);
+            chunk.firstIndex = (unsigned int)chunkIndices.size();
+            chunk.indexCount = 0;
+            chunk.baseVertex = (unsigned int)vertexRemap.size();
+            chunk.vertexCount = 0;
+            chunkId = (unsigned int)chunks.size();
+        }
+
+        for(int k = 0; k < 3; ++k)
+        {
+            unsigned int v = tri[k];
+            if(stamp[v] != chunkId)
+            {
+                stamp[v] = chunkId;
+                local[v] = chunk.vertexCount++;
+                vertexRemap.push_back(v);
+            }
+            chunkIndices.push_back((unsigned short)local[v]);
+        }
+        chunk.indexCount += 3;
+    }
+    chunks.push_back(chunk);
+}
@@ -0,0 +1,49 @@
+///////////////////////////////////////////////////////////////////////////////
+// IndexBuffer.h
+// =============
+// Index width selection for triangle meshes.
+// Meshes with at most 65536 vertices are drawn with 16-bit indices, which
+// halves the index buffer size and the index fetch bandwidth. Larger meshes
+// either keep 32-bit indices or are split into chunks of at most 65536
+// vertices, each drawn with 16-bit indices and a base vertex
+// (glDrawElementsBaseVertex).
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef INDEX_BUFFER_H
+#define INDEX_BUFFER_H
+
+#include <vector>
+
+namespace IndexBuffer
+{
+    // max # of vertices addressable with 16-bit indices
+    const unsigned int MAX_SHORT_VERTEX_COUNT = 65536;
+
+    // a range of a chunked index buffer, drawn with its own base vertex
+    struct Chunk
+    {
+        unsigned int firstIndex;    // offset in the 16-bit index buffer (in indices)
+        unsigned int indexCount;
+        unsigned int baseVertex;    // first vertex of the chunk in the remapped vertex buffer
+        unsigned int vertexCount;
+    };
+
+    // size of an index in bytes (2 or 4) for a mesh with vertexCount vertices
+    inline unsigned int getIndexSize(unsigned int vertexCount)
+    {
+        return vertexCount <= MAX_SHORT_VERTEX_COUNT ? 2 : 4;
+    }
+
+    // copy 32-bit indices to 16-bit, all indices must be less than 65536
+    void narrow(const unsigned int* indices, unsigned int indexCount, unsigned short* out);
+
+    // split triangles into chunks referencing at most maxVertices vertices each
+    // chunkIndices: 16-bit indices relative to the base vertex of each chunk
+    // vertexRemap : source vertex of each vertex in the chunked vertex buffer;
+    //               vertices shared by 2 chunks are duplicated
+    void split(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount,
+               std::vector<unsigned short>& chunkIndices, std::vector<unsigned int>& vertexRemap,
+               std::vector<Chunk>& chunks, unsigned int maxVertices = MAX_SHORT_VERTEX_COUNT);
+}
+
+#endif
@@ -0,0 +1,431 @@
+///////////////////////////////////////////////////////////////////////////////
+// JobSystem.cpp
+// =============
+// Work stealing job scheduler with per-thread job rings and frame allocators.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <algorithm>
+#include "JobSystem.h"
+#include "Parallel.h"
+
+
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // the system and index of the calling thread, set by start() and the workers
+    thread_local const JobSystem* tlsSystem = 0;
+    thread_local unsigned int tlsThread = 0;
+
+    // idle loops before a worker sleeps, and how long it sleeps if no run() wakes it
+    const unsigned int SPIN_COUNT = 64;
+    const std::chrono::milliseconds SLEEP_TIME(2);
+
+    float getMilliseconds(Clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor/dtor
+///////////////////////////////////////////////////////////////////////////////
+JobSystem::Worker::Worker(size_t frameAllocatorSize) : deque(MAX_JOBS), jobMemory((MAX_JOBS + 1) * sizeof(Job)), jobs(0), nextJob(0),
+                                                       allocator(frameAllocatorSize), random(0), executedCount(0), stolenCount(0)
+{
+    void* memory = jobMemory.data();
+    size_t space = jobMemory.size();
+    jobs = static_cast<Job*>(std::align(alignof(Job), MAX_JOBS * sizeof(Job), memory, space));
+    for(unsigned int i = 0; i < MAX_JOBS; ++i)
+        new(&jobs[i]) Job();
+}
+
+JobSystem::JobSystem() : stopping(false), sleepingCount(0)
+{
+}
+
+JobSystem::~JobSystem()
+{
+    stop();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// the calling thread becomes thread 0
+///////////////////////////////////////////////////////////////////////////////
+void JobSystem::start(unsigned int threadCount, size_t frameAllocatorSize)
+{
+    if(isRunning())
+        return;
+    if(threadCount == 0)
+        threadCount = Parallel::getDefaultThreadCount();
+
+    stopping = false;
+    for(unsigned int i = 0; i < threadCount; ++i)
+    {
+        workers.push_back(new Worker(frameAllocatorSize));
+        workers.back()->random = 0x9e3779b9u * (i + 1);
+    }
+    tlsSystem = this;
+    tlsThread = 0;
+    for(unsigned int i = 1; i < threadCount; ++i)
+        threads.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+void JobSystem::stop()
+{
+    if(!isRunning())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for(size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+    threads.clear();
+
+    for(size_t i = 0; i < workers.size(); ++i)
+        delete workers[i];
+    workers.clear();
+    if(tlsSystem == this)
+        tlsSystem = 0;
+}
+
+unsigned int JobSystem::getThreadIndex() const
+{
+    // any other thread is taken for the thread that called start()
+    return tlsSystem == this ? tlsThread : 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// the next finished job of the ring of the calling thread, normally the one
+// whose turn it is; a job still unfinished MAX_JOBS jobs later is skipped,
+// and with the whole ring unfinished the thread helps until one is done
+///////////////////////////////////////////////////////////////////////////////
+JobSystem::Job* JobSystem::allocate(Job* parent)
+{
+    const unsigned int thread = getThreadIndex();
+    Worker& worker = *workers[thread];
+    Job* job = &worker.jobs[worker.nextJob++ & (MAX_JOBS - 1)];
+    for(unsigned int skipped = 1; !isFinished(job); ++skipped)
+    {
+        if(skipped == MAX_JOBS)
+        {
+            Job* other = getJob(thread);
+            if(other)
+                execute(other, thread);
+            else
+                std::this_thread::yield();
+            skipped = 0;
+        }
+        job = &worker.jobs[worker.nextJob++ & (MAX_JOBS - 1)];
+    }
+    job->parent = parent;
+    job->unfinished.store(1, std::memory_order_relaxed);
+    job->continuationCount.store(0, std::memory_order_relaxed);
+    if(parent)
+        parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+    return job;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// a full job gets the continuation of its last continuation, it still runs
+// after the job
+///////////////////////////////////////////////////////////////////////////////
+void JobSystem::addContinuation(Job* job, Job* continuation)
+{
+    const int index = job->continuationCount.load(std::memory_order_relaxed);
+    if(index == (int)MAX_CONTINUATIONS)
+    {
+        addContinuation(job->continuations[MAX_CONTINUATIONS - 1], continuation);
+        return;
+    }
+    job->continuations[index] = continuation;
+    job->continuationCount.store(index + 1, std::memory_order_relaxed);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// push on the deque of the calling thread and wake a sleeping worker
+///////////////////////////////////////////////////////////////////////////////
+void JobSystem::run(Job* job)
+{
+    const unsigned int thread = getThreadIndex();
+    if(!workers[thread]->deque.push(job))
+    {
+        // more jobs queued than a ring holds, run it now
+        execute(job, thread);
+        return;
+    }
+    // a wake-up missed by a worker going to sleep right now only delays it by SLEEP_TIME,
+    // the jobs still run on this thread when it waits
+    if(sleepingCount.load(std::memory_order_relaxed) > 0)
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wakeCondition.notify_one();
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// help with any job until this one is finished
+///////////////////////////////////////////////////////////////////////////////
+void JobSystem::wait(const Job* job)
+{
+    const unsigned int thread = getThreadIndex();
+    while(!isFinished(job))
+    {
+        Job* next = getJob(thread);
+        if(next)
+            execute(next, thread);
+        else
+            std::this_thread::yield();
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// the newest job of this thread, or the oldest of another one, starting from a
+// random victim so the thieves spread out
+///////////////////////////////////////////////////////////////////////////////
+JobSystem::Job* JobSystem::getJob(unsigned int thread)
+{
+    Worker& worker = *workers[thread];
+    Job* job = 0;
+    if(worker.deque.pop(job))
+        return job;
+
+    const unsigned int count = getThreadCount();
+    if(count < 2)
+        return 0;
+    worker.random ^= worker.random << 13;
+    worker.random ^= worker.random >> 17;
+    worker.random ^= worker.random << 5;
+    const unsigned int first = worker.random % count;
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const unsigned int victim = (first + i) % count;
+        if(victim != thread && workers[victim]->deque.steal(job))
+        {
+            worker.stolenCount.store(worker.stolenCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    return 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// a job is finished once it has run and each of its children is finished;
+// then its continuations are run and its parent is told
+///////////////////////////////////////////////////////////////////////////////
+void JobSystem::execute(Job* job, unsigned int thread)
+{
+    job->function(job);
+    finish(job);
+    Worker& worker = *workers[thread];
+    worker.executedCount.store(worker.executedCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void JobSystem::finish(Job* job)
+{
+    // once finished the job may be reused by the thread that created it, read it first
+    Job* parent = job->parent;
+    const int continuationCount = job->continuationCount.load(std::memory_order_relaxed);
+    Job* continuations[MAX_CONTINUATIONS];
+    for(int i = 0; i < continuationCount; ++i)
+        continuations[i] = job->continuations[i];
+    if(job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    for(int i = 0; i < continuationCount; ++i)
+        run(continuations[i]);
+    if(parent)
+        finish(parent);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// run, steal, spin a little, then sleep until run() wakes the worker
+///////////////////////////////////////////////////////////////////////////////
+void JobSystem::workerLoop(unsigned int thread)
+{
+    tlsSystem = this;
+    tlsThread = thread;
+
+    unsigned int idleCount = 0;
+    for(;;)
+    {
+        Job* job = getJob(thread);
+        if(job)
+        {
+            execute(job, thread);
+            idleCount = 0;
+            continue;
+        }
+        if(stopping.load(std::memory_order_relaxed))
+            return;
+        if(++idleCount < SPIN_COUNT)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingCount.fetch_add(1);
+        if(!stopping.load(std::memory_order_relaxed))
+            wakeCondition.wait_for(lock, SLEEP_TIME);
+        sleepingCount.fetch_sub(1);
+        idleCount = 0;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// scratch memory of the last frame is released
+///////////////////////////////////////////////////////////////////////////////
+void JobSystem::beginFrame()
+{
+    for(size_t i = 0; i < workers.size(); ++i)
+        workers[i]->allocator.reset();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// print the jobs run and stolen by each thread
+///////////////////////////////////////////////////////////////////////////////
+void JobSystem::printStats() const
+{
+    std::cout << "===== JobSystem: " << getThreadCount() << " threads =====\n";
+    for(size_t i = 0; i < workers.size(); ++i)
+    {
+        const Worker& worker = *workers[i];
+        std::cout << "  " << (i == 0 ? "main    " : "worker ") << (i == 0 ? "" : std::to_string(i)) << ": "
+                  << worker.executedCount.load() << " jobs run, " << worker.stolenCount.load() << " stolen, frame memory "
+                  << worker.allocator.getPeak() / 1024 << " KB peak\n";
+    }
+    std::cout << std::flush;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// spawn overhead: empty jobs against std::thread; scaling: a compute bound
+// parallelFor with 1, 2, 4... 64 threads, past the # of cores the threads
+// share them
+///////////////////////////////////////////////////////////////////////////////
+void JobSystem::benchmark()
+{
+    const unsigned int cores = Parallel::getDefaultThreadCount();
+    const unsigned int rounds = 200;
+    const unsigned int children = 1000;                 // per round, fewer than MAX_JOBS in flight
+    const auto empty = [](Job*) {};
+
+    std::cout << "===== JobSystem Benchmark: " << cores << " cores =====\n"
+              << std::fixed << std::setprecision(2);
+
+    // one thread: the cost of a job without any contention
+    {
+        JobSystem jobs;
+        jobs.start(1);
+        Clock::time_point start = Clock::now();
+        for(unsigned int i = 0; i < rounds * children; ++i)
+        {
+            Job* job = jobs.create(empty);
+            jobs.run(job);
+            jobs.wait(job);
+        }
+        std::cout << "  Spawn, create + run + wait:     " << std::setw(8)
+                  << getMilliseconds(start) * 1e6f / (rounds * children) << " ns per job, 1 thread\n";
+    }
+
+    // children of a root, run by every thread
+    for(unsigned int threads = 1; ; threads = std::max(cores, 2u))
+    {
+        JobSystem jobs;
+        jobs.start(threads);
+        Clock::time_point start = Clock::now();
+        for(unsigned int r = 0; r < rounds; ++r)
+        {
+            Job* root = jobs.create(empty);
+            for(unsigned int i = 0; i < children; ++i)
+                jobs.run(jobs.create(empty, root));
+            jobs.run(root);
+            jobs.wait(root);
+        }
+        std::cout << "  Spawn, " << children << " children of a root: " << std::setw(8)
+                  << getMilliseconds(start) * 1e6f / (rounds * (children + 1)) << " ns per job, " << threads << " threads\n";
+        if(threads != 1)
+            break;
+    }
+
+    // the alternative without a scheduler, a thread per task
+    {
+        const unsigned int count = 1000;
+        Clock::time_point start = Clock::now();
+        for(unsigned int i = 0; i < count; ++i)
+            std::thread([] {}).join();
+        std::cout << "  Spawn, std::thread + join:      " << std::setw(8) << getMilliseconds(start) * 1e6f / count << " ns per thread\n";
+    }
+
+    // scaling of a compute bound loop, blocks of 1024 items
+    const unsigned int itemCount = 1 << 20;
+    std::vector<float> values(itemCount);
+    const auto work = [&values](unsigned int begin, unsigned int end)
+    {
+        for(unsigned int i = begin; i < end; ++i)
+        {
+            float x = (float)i;
+            for(int k = 0; k < 16; ++k)
+                x = std::sqrt(x * 0.5f + 1.0f) + std::sin(x);
+            values[i] = x;
+        }
+    };
+
+    float baseTime = 0.0f;
+    for(unsigned int threads = 1; threads <= 64; threads *= 2)
+    {
+        JobSystem jobs;
+        jobs.start(threads);
+        jobs.parallelFor(itemCount, work, 1024);        // warm up the threads and caches
+        const unsigned int runs = 3;
+        Clock::time_point start = Clock::now();
+        for(unsigned int r = 0; r < runs; ++r)
+            jobs.parallelFor(itemCount, work, 1024);
+        const float time = getMilliseconds(start) / runs;
+        if(threads == 1)
+            baseTime = time;
+
+        unsigned int stolen = 0;
+        for(size_t i = 0; i < jobs.workers.size(); ++i)
+            stolen += jobs.workers[i]->stolenCount.load();
+        const float speedup = time > 0 ? baseTime / time : 0.0f;
+        std::cout << "  parallelFor " << std::setw(2) << threads << " threads: " << std::setw(8) << time << " ms, "
+                  << speedup << "x, " << 100.0f * speedup / std::min(threads, cores) << "% efficiency, "
+                  << stolen << " jobs stolen" << (threads > cores ? " (more threads than cores)" : "") << "\n";
+    }
+    std::cout << std::flush;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
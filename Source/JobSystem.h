@@ -0,0 +1,225 @@
+///////////////////////////////////////////////////////////////////////////////
+// JobSystem.h
+// ===========
+// Work stealing scheduler for the small CPU tasks of a frame (transform
+// updates, command recording, ...). Unlike TaskGraph, which runs a graph
+// built once, jobs are created and run from inside other jobs, thousands per
+// frame, so creating one must cost about as little as a function call:
+//
+// - a job is a fixed 128 byte block from a ring owned by the creating thread,
+//   the function object is copied into it; no heap allocation, no lock
+// - each thread pushes its jobs on its own Chase-Lev deque
+//   (WorkStealingDeque.h) and runs them newest first; a thread out of work
+//   steals the oldest job of another thread
+// - a job created with a parent counts as unfinished work of the parent, so
+//   waiting on the parent waits on the whole tree
+// - continuations are jobs started when another job and its children finish
+// - wait() runs other jobs until the job is done, so the waiting thread
+//   helps instead of blocking
+//
+// The thread calling start() is thread 0 and takes part: it creates jobs and
+// runs them while it waits. Only it and the workers may use the system.
+// Idle workers spin for a moment and then sleep until jobs are run.
+//
+// Each thread also has a FrameAllocator for per-frame scratch memory, reset
+// by beginFrame() at the start of each frame.
+//
+// Limits: the ring of a thread holds MAX_JOBS jobs, creating a job skips
+// the unfinished ones and, once all are unfinished, runs other jobs until
+// one is done; parallelFor() makes its blocks larger so it never fills
+// more than half the ring. Function objects up to DATA_SIZE bytes and
+// trivially destructible (capture by reference or pointers);
+// MAX_CONTINUATIONS per job.
+//
+// usage:
+//     JobSystem jobs;
+//     jobs.start();
+//     jobs.parallelFor(count, [&](unsigned int begin, unsigned int end) { ... });
+//
+//     JobSystem::Job* root = jobs.create([&](JobSystem::Job* job) {
+//         jobs.run(jobs.create([&](JobSystem::Job*) { cull(); }, job));
+//         animate();
+//     });
+//     jobs.addContinuation(root, jobs.create([&](JobSystem::Job*) { sort(); }));
+//     jobs.run(root);
+//     jobs.wait(root);
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <new>
+#include <type_traits>
+#include "WorkStealingDeque.h"
+#include "FrameAllocator.h"
+
+class JobSystem
+{
+public:
+    static const unsigned int MAX_JOBS = 4096;          // per thread, power of 2
+    static const unsigned int MAX_CONTINUATIONS = 4;
+
+    // exactly two cache lines, so jobs of different threads never share one
+    struct alignas(64) Job
+    {
+        // what the members below leave of the 128 bytes
+        static const size_t DATA_SIZE = 128 - (2 + MAX_CONTINUATIONS) * sizeof(void*) - 2 * sizeof(std::atomic<int>);
+
+        void (*function)(Job* job);
+        Job* parent;
+        std::atomic<int> unfinished;                    // the job itself and its unfinished children
+        std::atomic<int> continuationCount;
+        Job* continuations[MAX_CONTINUATIONS];
+        union                                           // the function object, aligned for pointers and doubles
+        {
+            unsigned char data[DATA_SIZE];
+            double alignment;
+        };
+    };
+    static_assert(sizeof(Job) == 128, "a job is two cache lines");
+
+    JobSystem();
+    ~JobSystem();
+
+    // start the workers, threadCount = 0 uses one thread per core, the calling thread included
+    void start(unsigned int threadCount = 0, size_t frameAllocatorSize = 256 * 1024);
+    // finish the jobs run so far and join the workers
+    void stop();
+
+    // a job calling func(job), a child of parent if not null; run() it once its continuations are added
+    template <typename Func>
+    Job* create(const Func& func, Job* parent = 0);
+    // run continuation once job and its children are finished, before job is run
+    void addContinuation(Job* job, Job* continuation);
+    // queue the job on this thread
+    void run(Job* job);
+    // run jobs until job and its children are finished
+    void wait(const Job* job);
+    bool isFinished(const Job* job) const   { return job->unfinished.load(std::memory_order_acquire) == 0; }
+
+    // call func(begin, end) on blocks of [0, count) of at most minBlockSize items and return once all are done
+    // the range is split in halves recursively, so the blocks are spread by stealing; a large count
+    // gets larger blocks, at most MAX_JOBS / 2 of them
+    template <typename Func>
+    void parallelFor(unsigned int count, const Func& func, unsigned int minBlockSize = 256);
+
+    // release the frame allocators of every thread, at the start of a frame while no job runs
+    void beginFrame();
+    // scratch memory of the calling thread, valid until the next beginFrame()
+    FrameAllocator& getFrameAllocator()     { return workers[getThreadIndex()]->allocator; }
+
+    unsigned int getThreadCount() const     { return static_cast<unsigned int>(workers.size()); }
+    // 0 for the thread calling start(), 1... for the workers
+    unsigned int getThreadIndex() const;
+    bool isRunning() const                  { return !workers.empty(); }
+
+    // print the jobs run and stolen by each thread since start()
+    void printStats() const;
+    // time creating and running empty jobs against threads, and the speedup of a parallelFor with 1 to 64 threads
+    static void benchmark();
+
+private:
+    struct Worker
+    {
+        explicit Worker(size_t frameAllocatorSize);
+
+        WorkStealingDeque<Job*> deque;
+        std::vector<unsigned char> jobMemory;           // a vector does not align to 64 bytes before C++17
+        Job* jobs;                                      // ring of MAX_JOBS in jobMemory
+        unsigned int nextJob;
+        FrameAllocator allocator;
+        unsigned int random;                            // xorshift state to pick a victim
+        std::atomic<unsigned int> executedCount;        // written by this thread only
+        std::atomic<unsigned int> stolenCount;
+    };
+
+    // runs the right half of a range as a child and keeps splitting the left half
+    template <typename Func>
+    struct ParallelForJob
+    {
+        JobSystem* system;
+        const Func* func;
+        unsigned int begin;
+        unsigned int end;
+        unsigned int minBlockSize;
+
+        void operator()(Job* job) const
+        {
+            unsigned int last = end;
+            while(last - begin > minBlockSize)
+            {
+                const unsigned int middle = begin + (last - begin) / 2;
+                const ParallelForJob right = { system, func, middle, last, minBlockSize };
+                system->run(system->create(right, job));
+                last = middle;
+            }
+            (*func)(begin, last);
+        }
+    };
+
+    template <typename Func>
+    static void invoke(Job* job)                    { (*reinterpret_cast<Func*>(job->data))(job); }
+
+    // not copyable, owns threads
+    JobSystem(const JobSystem&);
+    JobSystem& operator=(const JobSystem&);
+
+    Job* allocate(Job* parent);
+    Job* getJob(unsigned int thread);
+    void execute(Job* job, unsigned int thread);
+    void finish(Job* job);
+    void workerLoop(unsigned int thread);
+
+    std::vector<Worker*> workers;                   // workers[0] is the thread calling start()
+    std::vector<std::thread> threads;               // threads[i] runs workers[i + 1]
+    std::atomic<bool> stopping;
+
+    // idle workers sleep until run() wakes one
+    std::mutex sleepMutex;
+    std::condition_variable wakeCondition;
+    std::atomic<int> sleepingCount;
+};
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// copy the function object into a job of the calling thread
+///////////////////////////////////////////////////////////////////////////////
+template <typename Func>
+JobSystem::Job* JobSystem::create(const Func& func, Job* parent)
+{
+    static_assert(sizeof(Func) <= Job::DATA_SIZE, "the job captures too much, capture a pointer to the data");
+    static_assert(std::is_trivially_destructible<Func>::value, "the job is never destroyed, capture by reference");
+    Job* job = allocate(parent);
+    new(job->data) Func(func);
+    job->function = &invoke<Func>;
+    return job;
+}
+
+template <typename Func>
+void JobSystem::parallelFor(unsigned int count, const Func& func, unsigned int minBlockSize)
+{
+    // halving leaves blocks over minBlockSize / 2 items, so fewer than 2 * count / minBlockSize jobs
+    const unsigned int maxBlocks = MAX_JOBS / 4;
+    if(minBlockSize == 0)
+        minBlockSize = 1;
+    if(count / maxBlocks >= minBlockSize)
+        minBlockSize = count / maxBlocks + (count % maxBlocks ? 1 : 0);
+    if(count <= minBlockSize || getThreadCount() < 2)
+    {
+        if(count)
+            func(0u, count);
+        return;
+    }
+    const ParallelForJob<Func> range = { this, &func, 0, count, minBlockSize };
+    Job* root = create(range);
+    run(root);
+    wait(root);
+}
+
+#endif
@@ -0,0 +1,413 @@
+///////////////////////////////////////////////////////////////////////////////
+// Json.cpp
+// ========
+// Minimal JSON DOM parser (recursive descent).
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include "Json.h"
+
+
+
+namespace
+{
+    const JsonValue& nullValue()
+    {
+        static const JsonValue value;
+        return value;
+    }
+
+    const std::string& emptyString()
+    {
+        static const std::string value;
+        return value;
+    }
+
+    // UTF-8 encode a code point
+    void appendUtf8(std::string& out, unsigned int c)
+    {
+        if(c < 0x80)
+            out += (char)c;
+        else if(c < 0x800)
+        {
+            out += (char)(0xc0 | (c >> 6));
+            out += (char)(0x80 | (c & 0x3f));
+        }
+        else if(c < 0x10000)
+        {
+            out += (char)(0xe0 | (c >> 12));
+            out += (char)(0x80 | ((c >> 6) & 0x3f));
+            out += (char)(0x80 | (c & 0x3f));
+        }
+        else
+        {
+            out += (char)(0xf0 | (c >> 18));
+            out += (char)(0x80 | ((c >> 12) & 0x3f));
+            out += (char)(0x80 | ((c >> 6) & 0x3f));
+            out += (char)(0x80 | (c & 0x3f));
+        }
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// recursive descent parser, a friend of JsonValue
+///////////////////////////////////////////////////////////////////////////////
+class JsonParser
+{
+public:
+    JsonParser(const char* text, size_t length) : begin(text), p(text), end(text + length), depth(0) {}
+
+    bool parseDocument(JsonValue& root, std::string& error)
+    {
+        bool ok = parseValue(root);
+        if(ok)
+        {
+            skipSpaces();
+            if(p != end)
+                ok = fail("unexpected data after the root value");
+        }
+        if(!ok)
+        {
+            std::ostringstream ss;
+            ss << message << " at offset " << (failure - begin);
+            error = ss.str();
+        }
+        return ok;
+    }
+
+private:
+    static const int MAX_DEPTH = 256;
+
+    bool fail(const char* text)
+    {
+        message = text;
+        failure = p;
+        return false;
+    }
+
+    void skipSpaces()
+    {
+        while(p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            ++p;
+    }
+
+    bool literal(const char* word)
+    {
+        size_t length = strlen(word);
+        if((size_t)(end - p) < length || memcmp(p, word, length) != 0)
+            return fail("invalid literal");
+        p += length;
+        return true;
+    }
+
+    bool parseValue(JsonValue& value)
+    {
+        skipSpaces();
+        if(p == end)
+            return fail("unexpected end of data");
+
+        switch(*p)
+        {
+        case '{':
+            return parseObject(value);
+        case '[':
+            return parseArray(value);
+        case '"':
+            value.type = JsonValue::STRING;
+            return parseString(value.string);
+        case 't':
+            value.type = JsonValue::BOOLEAN;
+            value.boolean = true;
+            return literal("true");
+        case 'f':
+            value.type = JsonValue::BOOLEAN;
+            value.boolean = false;
+            return literal("false");
+        case 'n':
+            value.type = JsonValue::NUL;
+            return literal("null");
+        default:
+            return parseNumber(value);
+        }
+    }
+
+    bool parseNumber(JsonValue& value)
+    {
+        // validate the JSON number grammar, then convert with strtod
+        const char* start = p;
+        if(p < end && *p == '-')
+            ++p;
+        if(p == end || (unsigned)(*p - '0') >= 10)
+            return fail("invalid value");
+        if(*p == '0')
+            ++p;
+        else
+            while(p < end && (unsigned)(*p - '0') < 10) ++p;
+        if(p < end && *p == '.')
+        {
+            ++p;
+            if(p == end || (unsigned)(*p - '0') >= 10)
+                return fail("invalid number");
+            while(p < end && (unsigned)(*p - '0') < 10) ++p;
+        }
+        if(p < end && (*p == 'e' || *p == 'E'))
+        {
+            ++p;
+            if(p < end && (*p == '+' || *p == '-'))
+                ++p;
+            if(p == end || (unsigned)(*p - '0') >= 10)
+                return fail("invalid number");
+            while(p < end && (unsigned)(*p - '0') < 10) ++p;
+        }
+
+        std::string digits(start, p);
+        value.type = JsonValue::NUMBER;
+        value.number = strtod(digits.c_str(), 0);
+        return true;
+    }
+
+    bool parseHex4(unsigned int& c)
+    {
+        if(end - p < 4)
+            return fail("invalid escape");
+        c = 0;
+        for(int i = 0; i < 4; ++i, ++p)
+        {
+            char h = *p;
+            c <<= 4;
+            if(h >= '0' && h <= '9')      c |= h - '0';
+            else if(h >= 'a' && h <= 'f') c |= h - 'a' + 10;
+            else if(h >= 'A' && h <= 'F') c |= h - 'A' + 10;
+            else return fail("invalid escape");
+        }
+        return true;
+    }
+
+    bool parseString(std::string& out)
+    {
+        ++p;    // opening quote
+        out.clear();
+        for(;;)
+        {
+            const char* run = p;
+            while(p < end && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20)
+                ++p;
+            out.append(run, p);
+            if(p == end)
+                return fail("unterminated string");
+            if(*p == '"')
+            {
+                ++p;
+                return true;
+            }
+            if((unsigned char)*p < 0x20)
+                return fail("control character in string");
+
+            ++p;    // backslash
+            if(p == end)
+                return fail("unterminated string");
+            char e = *p++;
+            switch(e)
+            {
+            case '"':  out += '"';  break;
+            case '\\': out += '\\'; break;
+            case '/':  out += '/';  break;
+            case 'b':  out += '\b'; break;
+            case 'f':  out += '\f'; break;
+            case 'n':  out += '\n'; break;
+            case 'r':  out += '\r'; break;
+            case 't':  out += '\t'; break;
+            case 'u':
+            {
+                unsigned int c;
+                if(!parseHex4(c))
+                    return false;
+                // surrogate pair
+                if(c >= 0xd800 && c < 0xdc00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+                {
+                    p += 2;
+                    unsigned int low;
+                    if(!parseHex4(low))
+                        return false;
+                    if(low >= 0xdc00 && low < 0xe000)
+                        c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+                }
+                appendUtf8(out, c);
+                break;
+            }
+            default:
+                --p;
+                return fail("invalid escape");
+            }
+        }
+    }
+
+    bool parseArray(JsonValue& value)
+    {
+        if(++depth > MAX_DEPTH)
+            return fail("nesting too deep");
+        ++p;
+        value.type = JsonValue::ARRAY;
+        skipSpaces();
+        if(p < end && *p == ']')
+        {
+            ++p;
+            --depth;
+            return true;
+        }
+        for(;;)
+        {
+            value.elements.push_back(JsonValue());
+            if(!parseValue(value.elements.back()))
+                return false;
+            skipSpaces();
+            if(p < end && *p == ',')
+            {
+                ++p;
+                continue;
+            }
+            if(p < end && *p == ']')
+            {
+                ++p;
+                --depth;
+                return true;
+            }
+            return fail("expected ',' or ']'");
+        }
+    }
+
+    bool parseObject(JsonValue& value)
+    {
+        if(++depth > MAX_DEPTH)
+            return fail("nesting too deep");
+        ++p;
+        value.type = JsonValue::OBJECT;
+        skipSpaces();
+        if(p < end && *p == '}')
+        {
+            ++p;
+            --depth;
+            return true;
+        }
+        for(;;)
+        {
+            skipSpaces();
+            if(p == end || *p != '"')
+                return fail("expected member name");
+            value.keys.push_back(std::string());
+            if(!parseString(value.keys.back()))
+                return false;
+            skipSpaces();
+            if(p == end || *p != ':')
+                return fail("expected ':'");
+            ++p;
+            value.elements.push_back(JsonValue());
+            if(!parseValue(value.elements.back()))
+                return false;
+            skipSpaces();
+            if(p < end && *p == ',')
+            {
+                ++p;
+                continue;
+            }
+            if(p < end && *p == '}')
+            {
+                ++p;
+                --depth;
+                return true;
+            }
+            return fail("expected ',' or '}'");
+        }
+    }
+
+    const char* begin;
+    const char* p;
+    const char* end;
+    int depth;
+    const char* failure;
+    std::string message;
+};
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// parse a whole document
+///////////////////////////////////////////////////////////////////////////////
+bool JsonValue::parse(const char* text, size_t length, JsonValue& root, std::string& error)
+{
+    root = JsonValue();
+    JsonParser parser(text, length);
+    return parser.parseDocument(root, error);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// getters
+///////////////////////////////////////////////////////////////////////////////
+size_t JsonValue::size() const
+{
+    return (type == ARRAY || type == OBJECT) ? elements.size() : 0;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+    return index < size() ? elements[index] : nullValue();
+}
+
+const JsonValue* JsonValue::find(const char* key) const
+{
+    if(type != OBJECT)
+        return 0;
+    for(size_t i = 0; i < keys.size(); ++i)
+        if(keys[i] == key)
+            return &elements[i];
+    return 0;
+}
+
+const std::string& JsonValue::getKey(size_t index) const
+{
+    return (type == OBJECT && index < keys.size()) ? keys[index] : emptyString();
+}
+
+bool JsonValue::getBool(bool defaultValue) const
+{
+    return type == BOOLEAN ? boolean : defaultValue;
+}
+
+double JsonValue::getNumber(double defaultValue) const
+{
+    return type == NUMBER ? number : defaultValue;
+}
+
+int JsonValue::getInt(int defaultValue) const
+{
+    return type == NUMBER ? (int)number : defaultValue;
+}
+
+const std::string& JsonValue::getString() const
+{
+    return type == STRING ? string : emptyString();
+}
+
+int JsonValue::getInt(const char* key, int defaultValue) const
+{
+    const JsonValue* value = find(key);
+    return value ? value->getInt(defaultValue) : defaultValue;
+}
+
+double JsonValue::getNumber(const char* key, double defaultValue) const
+{
+    const JsonValue* value = find(key);
+    return value ? value->getNumber(defaultValue) : defaultValue;
+}
+
+std::string JsonValue::getString(const char* key) const
+{
+    const JsonValue* value = find(key);
+    return value ? value->getString() : std::string();
+}
@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+// Json.h
+// ======
+// Minimal JSON (RFC 8259) DOM parser, enough for asset headers such as glTF.
+// Objects keep their members in file order; lookups are linear, which is
+// fine for the small objects of asset descriptions.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+class JsonValue
+{
+public:
+    enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+    JsonValue() : type(NUL), boolean(false), number(0) {}
+
+    // parse a whole document, return false and set error on a syntax error
+    static bool parse(const char* text, size_t length, JsonValue& root, std::string& error);
+
+    Type getType() const                        { return type; }
+    bool isNull() const                         { return type == NUL; }
+    bool isNumber() const                       { return type == NUMBER; }
+    bool isString() const                       { return type == STRING; }
+    bool isArray() const                        { return type == ARRAY; }
+    bool isObject() const                       { return type == OBJECT; }
+
+    // array elements or object members
+    size_t size() const;
+    const JsonValue& operator[](size_t index) const;            // null value if out of range
+    const JsonValue* find(const char* key) const;               // 0 if missing or not an object
+    const std::string& getKey(size_t index) const;              // object member name
+
+    // typed getters, the default is returned if the value has another type
+    bool getBool(bool defaultValue = false) const;
+    double getNumber(double defaultValue = 0) const;
+    int getInt(int defaultValue = 0) const;
+    const std::string& getString() const;
+
+    // member getters, shortcut for find(key) followed by the typed getter
+    int getInt(const char* key, int defaultValue) const;
+    double getNumber(const char* key, double defaultValue) const;
+    std::string getString(const char* key) const;
+
+private:
+    friend class JsonParser;
+
+    Type type;
+    bool boolean;
+    double number;
+    std::string string;
+    std::vector<JsonValue> elements;
+    std::vector<std::string> keys;              // object member names, parallel to elements
+};
+
+#endif
@@ -0,0 +1,315 @@
+///////////////////////////////////////////////////////////////////////////////
+// Ktx2.cpp
+// ========
+// KTX 2.0 container of block compressed textures.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include "Ktx2.h"
+
+
+
+namespace
+{
+    const uint8_t IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    // Khronos data format descriptor values
+    const uint32_t KHR_DF_VERSION = 2;
+    const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+    const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+    const uint32_t KHR_DF_CHANNEL_ALPHA = 15;     // in the BC1A/BC2/BC3 color models
+    const uint32_t BASIC_BLOCK_SIZE = 24;         // without the samples
+    const uint32_t SAMPLE_SIZE = 16;
+
+    const char ORIENTATION_KEY[] = "KTXorientation";
+
+    struct FormatInfo
+    {
+        BlockCompression::Format format;
+        uint32_t vkFormat;
+        uint32_t colorModel;                    // KHR_DF_MODEL_*
+    };
+
+    const FormatInfo FORMATS[] =
+    {
+        { BlockCompression::BC1, 131, 128 },    // VK_FORMAT_BC1_RGB_UNORM_BLOCK, KHR_DF_MODEL_BC1A
+        { BlockCompression::BC3, 137, 130 },    // VK_FORMAT_BC3_UNORM_BLOCK, KHR_DF_MODEL_BC3
+        { BlockCompression::BC4, 139, 131 },    // VK_FORMAT_BC4_UNORM_BLOCK, KHR_DF_MODEL_BC4
+        { BlockCompression::BC5, 141, 132 },    // VK_FORMAT_BC5_UNORM_BLOCK, KHR_DF_MODEL_BC5
+        { BlockCompression::BC7, 145, 134 },    // VK_FORMAT_BC7_UNORM_BLOCK, KHR_DF_MODEL_BC7
+    };
+
+    const FormatInfo* findFormat(BlockCompression::Format format)
+    {
+        for(size_t i = 0; i < sizeof(FORMATS) / sizeof(FORMATS[0]); ++i)
+            if(FORMATS[i].format == format)
+                return &FORMATS[i];
+        return 0;
+    }
+
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    bool fail(const char* path, const char* message)
+    {
+        std::cout << "[ERROR] Ktx2: " << path << ": " << message << std::endl;
+        return false;
+    }
+
+    void append(std::vector<unsigned char>& buffer, uint32_t value)
+    {
+        for(int i = 0; i < 4; ++i)
+            buffer.push_back((unsigned char)(value >> (i * 8)));
+    }
+
+    // one sample of the descriptor: bits [offset, offset + length) hold channel
+    void appendSample(std::vector<unsigned char>& buffer, uint32_t offset, uint32_t length, uint32_t channel)
+    {
+        append(buffer, offset | ((length - 1) << 16) | (channel << 24));
+        append(buffer, 0);                      // sample position 0,0,0,0
+        append(buffer, 0);                      // lower
+        append(buffer, 0xffffffff);             // upper
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // data format descriptor: its total size then one basic descriptor block
+    ///////////////////////////////////////////////////////////////////////////
+    std::vector<unsigned char> buildDescriptor(const FormatInfo& info)
+    {
+        const uint32_t blockSize = BlockCompression::getBlockSize(info.format);
+        const uint32_t sampleCount = (info.format == BlockCompression::BC3 || info.format == BlockCompression::BC5) ? 2 : 1;
+        const uint32_t descriptorSize = BASIC_BLOCK_SIZE + SAMPLE_SIZE * sampleCount;
+
+        std::vector<unsigned char> dfd;
+        append(dfd, 4 + descriptorSize);
+        append(dfd, 0);                                         // vendor Khronos, type basic
+        append(dfd, KHR_DF_VERSION | (descriptorSize << 16));
+        append(dfd, info.colorModel | (KHR_DF_PRIMARIES_BT709 << 8) | (KHR_DF_TRANSFER_LINEAR << 16));
+        append(dfd, 3 | (3 << 8));                              // 4x4x1x1 texel block
+        append(dfd, blockSize);                                 // bytes in plane 0
+        append(dfd, 0);
+
+        if(info.format == BlockCompression::BC3)
+        {
+            appendSample(dfd, 0, 64, KHR_DF_CHANNEL_ALPHA);
+            appendSample(dfd, 64, 64, 0);
+        }
+        else if(info.format == BlockCompression::BC5)
+        {
+            appendSample(dfd, 0, 64, 0);                        // red
+            appendSample(dfd, 64, 64, 1);                       // green
+        }
+        else
+        {
+            appendSample(dfd, 0, blockSize * 8, 0);
+        }
+        return dfd;
+    }
+
+    // key/value data: the orientation only, each pair is its length, key\0value\0, padded to 4 bytes
+    std::vector<unsigned char> buildKeyValues(bool flipped)
+    {
+        const char* value = flipped ? "ru" : "rd";
+        const uint32_t length = (uint32_t)(sizeof(ORIENTATION_KEY) + strlen(value) + 1);
+
+        std::vector<unsigned char> kvd;
+        append(kvd, length);
+        kvd.insert(kvd.end(), ORIENTATION_KEY, ORIENTATION_KEY + sizeof(ORIENTATION_KEY));
+        kvd.insert(kvd.end(), value, value + strlen(value) + 1);
+        kvd.resize(alignUp(kvd.size(), 4), 0);
+        return kvd;
+    }
+
+    // value of the orientation key, 0 if missing
+    const char* findOrientation(const char* kvd, size_t size)
+    {
+        size_t offset = 0;
+        while(offset + 4 <= size)
+        {
+            uint32_t length;
+            memcpy(&length, kvd + offset, 4);
+            if(length > size - offset - 4)
+                return 0;
+            const char* pair = kvd + offset + 4;
+            if(length >= sizeof(ORIENTATION_KEY) + 2 && memcmp(pair, ORIENTATION_KEY, sizeof(ORIENTATION_KEY)) == 0)
+                return pair + sizeof(ORIENTATION_KEY);
+            offset += alignUp(4 + length, 4);
+        }
+        return 0;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// VkFormat of a block format and back, file names
+///////////////////////////////////////////////////////////////////////////////
+uint32_t Ktx2::getVkFormat(BlockCompression::Format format)
+{
+    const FormatInfo* info = findFormat(format);
+    return info ? info->vkFormat : 0;
+}
+
+bool Ktx2::getFormat(uint32_t vkFormat, BlockCompression::Format& format)
+{
+    for(size_t i = 0; i < sizeof(FORMATS) / sizeof(FORMATS[0]); ++i)
+    {
+        if(FORMATS[i].vkFormat == vkFormat)
+        {
+            format = FORMATS[i].format;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+
+std::string Ktx2::getCompressedPath(const std::string& imagePath)
+{
+    size_t dot = imagePath.find_last_of('.');
+    size_t slash = imagePath.find_last_of("/\\");
+    if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return imagePath + ".ktx2";
+    return imagePath.substr(0, dot) + ".ktx2";
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Writer
+///////////////////////////////////////////////////////////////////////////////
+Ktx2::Writer::Writer(BlockCompression::Format format, int width, int height, bool flipped)
+    : format(format), width(width), height(height), flipped(flipped)
+{
+}
+
+void Ktx2::Writer::addLevel(const void* data, size_t size)
+{
+    levels.push_back(std::vector<unsigned char>((const unsigned char*)data, (const unsigned char*)data + size));
+}
+
+bool Ktx2::Writer::write(const char* path) const
+{
+    const FormatInfo* info = findFormat(format);
+    if(!info || levels.empty() || levels.size() > MAX_LEVELS)
+        return fail(path, "unsupported texture");
+
+    const std::vector<unsigned char> dfd = buildDescriptor(*info);
+    const std::vector<unsigned char> kvd = buildKeyValues(flipped);
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.identifier, IDENTIFIER, sizeof(IDENTIFIER));
+    header.vkFormat = info->vkFormat;
+    header.typeSize = 1;
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.faceCount = 1;
+    header.levelCount = (uint32_t)levels.size();
+    header.dfdByteOffset = (uint32_t)(sizeof(Header) + sizeof(Level) * levels.size());
+    header.dfdByteLength = (uint32_t)dfd.size();
+    header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = (uint32_t)kvd.size();
+
+    // smallest level first, each on a multiple of the block size (a multiple of 4)
+    const size_t alignment = BlockCompression::getBlockSize(format);
+    std::vector<Level> index(levels.size());
+    size_t offset = alignUp(header.kvdByteOffset + header.kvdByteLength, alignment);
+    const size_t dataStart = offset;
+    for(size_t i = levels.size(); i-- > 0; )
+    {
+        index[i].byteOffset = offset;
+        index[i].byteLength = levels[i].size();
+        index[i].uncompressedByteLength = levels[i].size();
+        offset = alignUp(offset + levels[i].size(), alignment);
+    }
+
+    std::vector<unsigned char> data(offset - dataStart, 0);
+    for(size_t i = 0; i < levels.size(); ++i)
+    {
+        if(!levels[i].empty())
+            memcpy(&data[index[i].byteOffset - dataStart], levels[i].data(), levels[i].size());
+    }
+    std::vector<unsigned char> padding(dataStart - header.kvdByteOffset - header.kvdByteLength, 0);
+
+    std::ofstream outFile(path, std::ios::binary | std::ios::trunc);
+    if(!outFile.good())
+        return fail(path, "cannot open file for writing");
+    outFile.write((const char*)&header, sizeof(header));
+    outFile.write((const char*)index.data(), sizeof(Level) * index.size());
+    outFile.write((const char*)dfd.data(), dfd.size());
+    outFile.write((const char*)kvd.data(), kvd.size());
+    outFile.write((const char*)padding.data(), padding.size());
+    outFile.write((const char*)data.data(), data.size());
+    outFile.close();
+    if(outFile.fail())
+        return fail(path, "write error");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// map and validate a file
+///////////////////////////////////////////////////////////////////////////////
+bool Ktx2::Reader::open(const char* path)
+{
+    close();
+    if(!file.open(path))
+        return false;       // a missing file is not an error, the source image is used
+
+    const char* data = file.getData();
+    const size_t size = file.getSize();
+    const Header* h = (const Header*)data;
+    if(size < sizeof(Header) || memcmp(h->identifier, IDENTIFIER, sizeof(IDENTIFIER)) != 0)
+    {
+        file.close();
+        return fail(path, "not a KTX 2.0 file");
+    }
+    if(!Ktx2::getFormat(h->vkFormat, format) || h->supercompressionScheme != 0 ||
+       h->pixelDepth != 0 || h->layerCount != 0 || h->faceCount != 1)
+    {
+        file.close();
+        return fail(path, "unsupported format, only 2D BC1/BC3/BC4/BC5/BC7 textures");
+    }
+    if(h->pixelWidth == 0 || h->pixelHeight == 0 || h->levelCount == 0 || h->levelCount > MAX_LEVELS ||
+       size - sizeof(Header) < sizeof(Level) * h->levelCount ||
+       h->kvdByteOffset > size || h->kvdByteLength > size - h->kvdByteOffset)
+    {
+        file.close();
+        return fail(path, "invalid header");
+    }
+
+    // every level has the size of its dimensions and fits in the file
+    const Level* l = (const Level*)(data + sizeof(Header));
+    for(unsigned int i = 0; i < h->levelCount; ++i)
+    {
+        int w = (h->pixelWidth >> i) > 0 ? (int)(h->pixelWidth >> i) : 1;
+        int ht = (h->pixelHeight >> i) > 0 ? (int)(h->pixelHeight >> i) : 1;
+        if(l[i].byteOffset > size || l[i].byteLength > size - l[i].byteOffset ||
+           l[i].byteLength != BlockCompression::getImageSize(format, w, ht))
+        {
+            file.close();
+            return fail(path, "invalid level");
+        }
+    }
+
+    const char* orientation = findOrientation(data + h->kvdByteOffset, h->kvdByteLength);
+    flipped = orientation && orientation[1] == 'u';
+    header = h;
+    levels = l;
+    return true;
+}
+
+void Ktx2::Reader::close()
+{
+    file.close();
+    header = 0;
+    levels = 0;
+    flipped = false;
+}
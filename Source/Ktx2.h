@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+// Ktx2.h
+// ======
+// KTX 2.0 container (Khronos) of block compressed textures with their
+// mipmaps, stored exactly as glCompressedTexImage2D() takes them, so a
+// texture is loaded by mapping the file and uploading the levels in place.
+//
+// Only what this sample writes is supported: a 2D texture, no array layers
+// or cube faces, BC1/BC3/BC4/BC5/BC7 UNORM, no supercompression, every
+// level present. The data format descriptor is the basic one the spec
+// requires for these formats, and the orientation is stored with the
+// "KTXorientation" key ("rd": first row is the top, "ru": first row is the
+// bottom, as OpenGL expects).
+//
+// layout (little-endian):
+//   Header
+//   Level[levelCount]         level 0 (the largest) first
+//   data format descriptor
+//   key/value data
+//   level data                smallest level first, each aligned to its block size
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "MappedFile.h"
+#include "BlockCompression.h"
+
+namespace Ktx2
+{
+    const unsigned int MAX_LEVELS = 16;
+
+    struct Header
+    {
+        uint8_t identifier[12];                 // AB "KTX 20" BB 0D 0A 1A 0A
+        uint32_t vkFormat;                      // VkFormat enum
+        uint32_t typeSize;                      // 1 for block compressed formats
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;                    // 0 for 2D textures
+        uint32_t layerCount;                    // 0 if not an array
+        uint32_t faceCount;                     // 1 if not a cube map
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;        // 0 = none
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+
+    struct Level
+    {
+        uint64_t byteOffset;                    // from the start of the file
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;        // = byteLength without supercompression
+    };
+
+    // VkFormat of a block format, 0 if none
+    uint32_t getVkFormat(BlockCompression::Format format);
+    // block format of a VkFormat, return false if not supported
+    bool getFormat(uint32_t vkFormat, BlockCompression::Format& format);
+
+    // path of the compressed texture of an image file: its extension replaced by .ktx2
+    std::string getCompressedPath(const std::string& imagePath);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // collects the levels of a texture and writes the file
+    ///////////////////////////////////////////////////////////////////////////
+    class Writer
+    {
+    public:
+        // flipped: the first row of the levels is the bottom of the image
+        Writer(BlockCompression::Format format, int width, int height, bool flipped);
+
+        // copy the next level, level 0 first
+        void addLevel(const void* data, size_t size);
+        // write the file, return false on an I/O error
+        bool write(const char* path) const;
+
+    private:
+        BlockCompression::Format format;
+        int width;
+        int height;
+        bool flipped;
+        std::vector<std::vector<unsigned char> > levels;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // maps a file and validates it, the levels are read in place
+    ///////////////////////////////////////////////////////////////////////////
+    class Reader
+    {
+    public:
+        Reader() : header(0), levels(0), format(BlockCompression::BC1), flipped(false) {}
+
+        bool open(const char* path);            // return false if missing or not supported
+        void close();
+        bool isOpen() const                     { return header != 0; }
+
+        BlockCompression::Format getFormat() const              { return format; }
+        int getWidth() const                    { return header ? (int)header->pixelWidth : 0; }
+        int getHeight() const                   { return header ? (int)header->pixelHeight : 0; }
+        unsigned int getLevelCount() const      { return header ? header->levelCount : 0; }
+        bool isFlipped() const                  { return flipped; }
+        const void* getLevelData(unsigned int level) const      { return file.getData() + levels[level].byteOffset; }
+        size_t getLevelSize(unsigned int level) const           { return (size_t)levels[level].byteLength; }
+        size_t getFileSize() const              { return file.getSize(); }
+
+    private:
+        MappedFile file;
+        const Header* header;
+        const Level* levels;
+        BlockCompression::Format format;
+        bool flipped;
+    };
+}
+
+#endif
@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////////
+// LockFreeQueue.h
+// ===============
+// Bounded multi-producer multi-consumer FIFO queue without locks
+// (Dmitry Vyukov's array based queue). Each cell carries a sequence number
+// telling producers and consumers whose turn it is, so push() and pop()
+// only need one compare-and-swap on the shared position.
+// push() returns false when the queue is full and pop() returns false when
+// it is empty; neither ever blocks.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LOCK_FREE_QUEUE_H
+#define LOCK_FREE_QUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+template <typename T>
+class LockFreeQueue
+{
+public:
+    // capacity is rounded up to a power of 2
+    explicit LockFreeQueue(size_t capacity = 256) : cells(roundUp(capacity)), mask(roundUp(capacity) - 1), head(0), tail(0)
+    {
+        for(size_t i = 0; i < cells.size(); ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool push(const T& value)
+    {
+        size_t position = tail.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            Cell& cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = (ptrdiff_t)sequence - (ptrdiff_t)position;
+            if(diff == 0)
+            {
+                if(tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(diff < 0)
+            {
+                return false;           // full
+            }
+            else
+            {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(T& value)
+    {
+        size_t position = head.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            Cell& cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = (ptrdiff_t)sequence - (ptrdiff_t)(position + 1);
+            if(diff == 0)
+            {
+                if(head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    value = cell.value;
+                    cell.sequence.store(position + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(diff < 0)
+            {
+                return false;           // empty
+            }
+            else
+            {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t getCapacity() const          { return mask + 1; }
+
+private:
+    // not copyable, the cells are shared with other threads
+    LockFreeQueue(const LockFreeQueue&);
+    LockFreeQueue& operator=(const LockFreeQueue&);
+
+    static size_t roundUp(size_t n)
+    {
+        size_t size = 2;
+        while(size < n)
+            size <<= 1;
+        return size;
+    }
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+
+        Cell() : sequence(0), value() {}
+        Cell(const Cell& rhs) : sequence(rhs.sequence.load()), value(rhs.value) {}
+    };
+
+    std::vector<Cell> cells;
+    const size_t mask;
+    // producers and consumers on separate cache lines
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
+
+#endif
@@ -0,0 +1,40 @@
+///////////////////////////////////////////////////////////////////////////////
+// MappedFile.h
+// ============
+// Read-only memory mapped file (CreateFileMapping on Windows, mmap elsewhere).
+// The whole file is mapped at once, pages are loaded by the OS on first
+// access, so parsers can read it in place without copying it to a buffer.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const char* path);            // return false if the file cannot be mapped
+    void close();
+
+    bool isOpen() const                     { return data != 0; }
+    const char* getData() const             { return data; }
+    size_t getSize() const                  { return size; }
+
+private:
+    // not copyable, the mapping is owned by one object
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const char* data;
+    size_t size;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+};
+
+#endif
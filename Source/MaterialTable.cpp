@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////
+// MaterialTable.cpp
+// =================
+// Bindless texture handles of the materials in a shader storage buffer.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "MaterialTable.h"
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// the extension, and storage buffers from GL 4.3 or their own extension
+///////////////////////////////////////////////////////////////////////////////
+bool MaterialTable::isSupported()
+{
+    return GLEW_ARB_bindless_texture && (GLEW_VERSION_4_3 || GLEW_ARB_shader_storage_buffer_object);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor
+///////////////////////////////////////////////////////////////////////////////
+MaterialTable::MaterialTable(unsigned int textureCount) : textureCount(std::max(textureCount, 1u)), buffer(0)
+{
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// add a material, the textures after count are none
+///////////////////////////////////////////////////////////////////////////////
+unsigned int MaterialTable::add(const GLuint* textures, unsigned int count)
+{
+    for(unsigned int i = 0; i < textureCount; ++i)
+        materials.push_back(i < count ? textures[i] : 0);
+    return getMaterialCount() - 1;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// add a sampler, once per object
+///////////////////////////////////////////////////////////////////////////////
+unsigned int MaterialTable::addSampler(GLuint sampler)
+{
+    std::vector<GLuint>::iterator it = std::find(samplers.begin(), samplers.end(), sampler);
+    if(it != samplers.end())
+        return (unsigned int)(it - samplers.begin());
+    samplers.push_back(sampler);
+    return (unsigned int)samplers.size() - 1;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// get the handle of every texture with every sampler, make them resident and
+// upload the rows
+///////////////////////////////////////////////////////////////////////////////
+bool MaterialTable::build()
+{
+    if(buffer)
+        return true;
+    if(!isSupported() || materials.empty())
+        return false;
+    if(samplers.empty())
+        samplers.push_back(0);
+
+    handles.assign(samplers.size() * materials.size(), 0);
+    for(unsigned int s = 0; s < samplers.size(); ++s)
+    {
+        for(unsigned int m = 0; m < getMaterialCount(); ++m)
+        {
+            for(unsigned int i = 0; i < textureCount; ++i)
+            {
+                const GLuint texture = materials[m * textureCount + i];
+                if(!texture)
+                    continue;
+
+                GLuint64 handle = samplers[s] ? glGetTextureSamplerHandleARB(texture, samplers[s]) : glGetTextureHandleARB(texture);
+                if(!handle)
+                {
+                    std::cout << "[ERROR] MaterialTable: no handle for texture " << texture << std::endl;
+                    continue;
+                }
+                // making a handle resident twice is an error
+                if(std::find(residentHandles.begin(), residentHandles.end(), handle) == residentHandles.end())
+                {
+                    glMakeTextureHandleResidentARB(handle);
+                    residentHandles.push_back(handle);
+                }
+                handles[getRow(m, s) * textureCount + i] = handle;
+            }
+        }
+    }
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    if(GLEW_ARB_buffer_storage)
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, getBytes(), handles.data(), 0);
+    else
+        glBufferData(GL_SHADER_STORAGE_BUFFER, getBytes(), handles.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// bind the buffer for the draws
+///////////////////////////////////////////////////////////////////////////////
+void MaterialTable::bind(GLuint binding) const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// release the handles, the materials and samplers stay for another build()
+///////////////////////////////////////////////////////////////////////////////
+void MaterialTable::clear()
+{
+    for(size_t i = 0; i < residentHandles.size(); ++i)
+        glMakeTextureHandleNonResidentARB(residentHandles[i]);
+    residentHandles.clear();
+    handles.clear();
+    if(buffer)
+        glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// print the table
+///////////////////////////////////////////////////////////////////////////////
+void MaterialTable::printStats() const
+{
+    const float KB = 1024.0f;
+    std::cout << "===== MaterialTable =====\n"
+              << std::fixed << std::setprecision(2)
+              << "  Materials: " << getMaterialCount() << " x " << samplers.size() << " samplers, "
+              << textureCount << " textures each"
+              << (buffer ? "" : " (not built)") << "\n"
+              << "   Resident: " << residentHandles.size() << " handles\n"
+              << "     Buffer: " << getBytes() / KB << " KB" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
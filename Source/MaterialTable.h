@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////
+// MaterialTable.h
+// ===============
+// The textures of each material as bindless handles (ARB_bindless_texture) in
+// a shader storage buffer, so a draw only passes its material index and binds
+// no texture at all.
+//
+// Each material has the same number of textures, given to the ctor. build()
+// gets a handle for every texture with every sampler added by addSampler() (a
+// handle is fixed to its sampler, so each sampler is its own set of rows),
+// makes the handles resident once and uploads them: row getRow(material,
+// sampler) holds the handles of a material, as uvec2, 0 for no texture. The
+// shader reads them with sampler2D(handles[row * textureCount + i]).
+//
+// A texture cannot be re-specified once it has a handle (glTexImage2D fails,
+// glTexSubImage* still works), so build() must wait until the streamer has
+// uploaded every texture of the table. clear() makes the handles non resident
+// and must run before the textures are deleted. Everything is on the GL
+// thread; check isSupported() and use texture arrays or classic binding
+// without the extension.
+//
+// usage:
+//     MaterialTable materials(2);         // diffuse and specular
+//     GLuint textures[] = { diffuse.getId(), specular.getId() };
+//     unsigned int baseMaterial = materials.add(textures, 2);
+//     unsigned int trilinear = materials.addSampler(samplerObject);
+//     materials.build();                  // once the textures are uploaded
+//     materials.bind(0);                  // layout(std430, binding = 0)
+//     glUniform1ui(materialLoc, materials.getRow(baseMaterial, trilinear));
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MATERIAL_TABLE_H
+#define MATERIAL_TABLE_H
+
+#include <GL/glew.h>
+#include <vector>
+#include <cstdint>
+
+class MaterialTable
+{
+public:
+    // bindless textures and shader storage buffers are available
+    static bool isSupported();
+
+    explicit MaterialTable(unsigned int textureCount = 1);
+
+    // add a material with up to textureCount textures (0 = none), return its index
+    unsigned int add(const GLuint* textures, unsigned int count);
+    // add a sampler object the handles are made with (0 = the texture's own parameters), return its index
+    unsigned int addSampler(GLuint sampler);
+
+    // make every handle resident and upload the table, once the textures are final
+    bool build();
+    bool isBuilt() const                { return buffer != 0; }
+    // bind the table to a shader storage buffer binding point
+    void bind(GLuint binding) const;
+    // make the handles non resident and delete the buffer, before the textures are deleted
+    void clear();
+
+    // row of a material's handles with a sampler
+    unsigned int getRow(unsigned int material, unsigned int sampler) const { return sampler * getMaterialCount() + material; }
+    unsigned int getTextureCount() const    { return textureCount; }
+    unsigned int getMaterialCount() const   { return (unsigned int)materials.size() / textureCount; }
+    unsigned int getResidentCount() const   { return (unsigned int)residentHandles.size(); }
+    size_t getBytes() const                 { return handles.size() * sizeof(GLuint64); }
+
+    // print the materials, resident handles and buffer size
+    void printStats() const;
+
+private:
+    // not copyable, owns GL objects
+    MaterialTable(const MaterialTable&);
+    MaterialTable& operator=(const MaterialTable&);
+
+    unsigned int textureCount;
+    std::vector<GLuint> materials;          // textureCount textures per material
+    std::vector<GLuint> samplers;
+    std::vector<GLuint64> handles;          // the buffer's content, textureCount per row
+    std::vector<GLuint64> residentHandles;  // each once, a texture/sampler pair has one handle
+    GLuint buffer;
+};
+
+#endif
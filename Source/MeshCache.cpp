@@ -0,0 +1,400 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshCache.cpp
+// =============
+// Versioned binary container of GPU-ready meshes.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "IndexBuffer.h"
+
+
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    // LOD n + 1 is kept only if it has at most this fraction of the triangles of LOD n
+    const float LOD_REDUCTION = 0.75f;
+    // vertex clustering grid of the first LOD, halved for each next LOD
+    const unsigned int LOD_GRID_SIZE = 64;
+
+    size_t alignUp(size_t value)
+    {
+        return (value + MeshCache::ALIGNMENT - 1) & ~(size_t)(MeshCache::ALIGNMENT - 1);
+    }
+
+    const MeshCache::VertexAttribute* findPosition(const MeshCache::VertexFormat& format)
+    {
+        for(unsigned int i = 0; i < format.attributeCount && i < MeshCache::MAX_ATTRIBUTES; ++i)
+        {
+            const MeshCache::VertexAttribute& a = format.attributes[i];
+            if(a.location == 0 && a.type == MeshCache::FLOAT_TYPE && a.components >= 3)
+                return &a;
+        }
+        return 0;
+    }
+
+    bool fail(const char* path, const char* message)
+    {
+        std::cout << "[ERROR] MeshCache: " << path << ": " << message << std::endl;
+        return false;
+    }
+
+    // read one byte per page, as the driver would when it copies the data
+    unsigned int touchPages(const char* data, size_t size)
+    {
+        unsigned int sum = 0;
+        for(size_t i = 0; i < size; i += 4096)
+            sum += (unsigned char)data[i];
+        return sum;
+    }
+
+    // drop the file from the OS page cache so the next open reads the disk
+    bool evictFromOsCache(const char* path)
+    {
+#if defined(_WIN32) || defined(__APPLE__)
+        (void)path;
+        return false;
+#else
+        int fd = ::open(path, O_RDONLY);
+        if(fd < 0)
+            return false;
+        fsync(fd);          // dirty pages of a freshly written file cannot be dropped
+        int result = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+        return result == 0;
+#endif
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// 64-bit FNV-1a
+///////////////////////////////////////////////////////////////////////////////
+uint64_t MeshCache::hash(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* p = (const unsigned char*)data;
+    uint64_t h = seed;
+    for(size_t i = 0; i < size; ++i)
+    {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// copy a mesh, compute its bounds and LODs
+///////////////////////////////////////////////////////////////////////////////
+void MeshCache::Writer::addMesh(const char* name, uint64_t sourceKey, const VertexFormat& format,
+                                const void* vertices, unsigned int vertexCount,
+                                const unsigned int* indices, unsigned int indexCount, unsigned int lodCount)
+{
+    Mesh mesh;
+    MeshEntry& entry = mesh.entry;
+    memset(&entry, 0, sizeof(entry));
+    strncpy(entry.name, name, NAME_SIZE - 1);
+    entry.sourceKey = sourceKey;
+    entry.format = format;
+    entry.vertexCount = vertexCount;
+    entry.indexSize = IndexBuffer::getIndexSize(vertexCount);
+
+    const unsigned char* vertexData = (const unsigned char*)vertices;
+    mesh.vertices.assign(vertexData, vertexData + (size_t)vertexCount * format.stride);
+
+    // bounds from the float positions
+    const VertexAttribute* position = findPosition(format);
+    const float* positions = position ? (const float*)(vertexData + position->offset) : 0;
+    for(unsigned int v = 0; positions && v < vertexCount; ++v)
+    {
+        const float* p = (const float*)(vertexData + (size_t)v * format.stride + position->offset);
+        for(int j = 0; j < 3; ++j)
+        {
+            entry.boundsMin[j] = (v == 0) ? p[j] : std::min(entry.boundsMin[j], p[j]);
+            entry.boundsMax[j] = (v == 0) ? p[j] : std::max(entry.boundsMax[j], p[j]);
+        }
+    }
+
+    // LOD 0, then coarser grids while they remove enough triangles
+    std::vector<unsigned int> allIndices(indices, indices + indexCount);
+    entry.lods[0].indexCount = indexCount;
+    entry.lodCount = 1;
+
+    float extent = std::max(entry.boundsMax[0] - entry.boundsMin[0],
+                            std::max(entry.boundsMax[1] - entry.boundsMin[1], entry.boundsMax[2] - entry.boundsMin[2]));
+    std::vector<unsigned int> lodIndices(indexCount);
+    for(unsigned int grid = LOD_GRID_SIZE; positions && grid >= 2 && entry.lodCount < std::min(lodCount, MAX_LODS); grid /= 2)
+    {
+        unsigned int count = MeshOptimizer::simplifyClustered(lodIndices.data(), indices, indexCount,
+                                                              positions, vertexCount, format.stride, grid);
+        const Lod& previous = entry.lods[entry.lodCount - 1];
+        if(count == 0 || count > previous.indexCount * LOD_REDUCTION)
+            continue;
+
+        MeshOptimizer::optimizeVertexCache(lodIndices.data(), count, vertexCount);
+        Lod& lod = entry.lods[entry.lodCount++];
+        lod.firstIndex = (uint32_t)allIndices.size();
+        lod.indexCount = count;
+        lod.error = extent / grid;
+        allIndices.insert(allIndices.end(), lodIndices.begin(), lodIndices.begin() + count);
+    }
+    entry.indexCount = (uint32_t)allIndices.size();
+
+    // indices in their final width
+    mesh.indices.resize(allIndices.size() * entry.indexSize);
+    if(entry.indexSize == 2)
+        IndexBuffer::narrow(allIndices.data(), (unsigned int)allIndices.size(), (unsigned short*)mesh.indices.data());
+    else if(!allIndices.empty())
+        memcpy(mesh.indices.data(), allIndices.data(), mesh.indices.size());
+
+    entry.vertexBytes = mesh.vertices.size();
+    entry.indexBytes = mesh.indices.size();
+    meshes.push_back(mesh);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// copy a mesh from another cache
+///////////////////////////////////////////////////////////////////////////////
+void MeshCache::Writer::addMesh(const MeshEntry& entry, const void* vertices, const void* indices)
+{
+    Mesh mesh;
+    mesh.entry = entry;
+    mesh.vertices.assign((const unsigned char*)vertices, (const unsigned char*)vertices + entry.vertexBytes);
+    mesh.indices.assign((const unsigned char*)indices, (const unsigned char*)indices + entry.indexBytes);
+    meshes.push_back(mesh);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// lay out the blocks and write the file
+///////////////////////////////////////////////////////////////////////////////
+bool MeshCache::Writer::write(const char* path) const
+{
+    // entries with their final offsets
+    std::vector<MeshEntry> entries(meshes.size());
+    size_t offset = alignUp(sizeof(FileHeader) + sizeof(MeshEntry) * meshes.size());
+    const size_t payloadStart = offset;
+    for(size_t i = 0; i < meshes.size(); ++i)
+    {
+        entries[i] = meshes[i].entry;
+        entries[i].vertexOffset = offset;
+        offset = alignUp(offset + meshes[i].vertices.size());
+        entries[i].indexOffset = offset;
+        offset = alignUp(offset + meshes[i].indices.size());
+    }
+
+    // payload with the padding, so the hash covers the bytes as they are in the file
+    std::vector<unsigned char> payload(offset - payloadStart, 0);
+    for(size_t i = 0; i < meshes.size(); ++i)
+    {
+        if(!meshes[i].vertices.empty())
+            memcpy(&payload[entries[i].vertexOffset - payloadStart], meshes[i].vertices.data(), meshes[i].vertices.size());
+        if(!meshes[i].indices.empty())
+            memcpy(&payload[entries[i].indexOffset - payloadStart], meshes[i].indices.data(), meshes[i].indices.size());
+    }
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.headerSize = sizeof(FileHeader);
+    header.entrySize = sizeof(MeshEntry);
+    header.meshCount = (uint32_t)meshes.size();
+    header.fileSize = offset;
+    header.payloadHash = hash(payload.data(), payload.size());
+
+    std::vector<unsigned char> padding(payloadStart - sizeof(FileHeader) - sizeof(MeshEntry) * entries.size(), 0);
+
+    std::ofstream outFile(path, std::ios::binary | std::ios::trunc);
+    if(!outFile.good())
+        return fail(path, "cannot open file for writing");
+    outFile.write((const char*)&header, sizeof(header));
+    if(!entries.empty())
+        outFile.write((const char*)entries.data(), sizeof(MeshEntry) * entries.size());
+    outFile.write((const char*)padding.data(), padding.size());
+    outFile.write((const char*)payload.data(), payload.size());
+    outFile.close();
+    if(outFile.fail())
+        return fail(path, "write error");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// map and validate a cache file
+///////////////////////////////////////////////////////////////////////////////
+bool MeshCache::Reader::open(const char* path, bool verify)
+{
+    close();
+    if(!file.open(path))
+        return false;       // a missing cache is not an error, it is built on first use
+
+    const char* data = file.getData();
+    const size_t size = file.getSize();
+    const FileHeader* h = (const FileHeader*)data;
+    if(size < sizeof(FileHeader) || h->magic != MAGIC)
+    {
+        file.close();
+        return fail(path, "not a mesh cache");
+    }
+    if(h->version != VERSION || h->headerSize != sizeof(FileHeader) || h->entrySize != sizeof(MeshEntry))
+    {
+        file.close();
+        return fail(path, "version mismatch");
+    }
+    if(h->fileSize != size || h->meshCount > (size - sizeof(FileHeader)) / sizeof(MeshEntry))
+    {
+        file.close();
+        return fail(path, "truncated file");
+    }
+
+    const MeshEntry* e = (const MeshEntry*)(data + sizeof(FileHeader));
+    for(unsigned int i = 0; i < h->meshCount; ++i)
+    {
+        const MeshEntry& m = e[i];
+        bool valid = m.format.attributeCount <= MAX_ATTRIBUTES &&
+                     (m.indexSize == 2 || m.indexSize == 4) &&
+                     m.lodCount >= 1 && m.lodCount <= MAX_LODS &&
+                     m.vertexOffset % ALIGNMENT == 0 && m.indexOffset % ALIGNMENT == 0 &&
+                     m.vertexOffset <= size && m.vertexBytes <= size - m.vertexOffset &&
+                     m.indexOffset <= size && m.indexBytes <= size - m.indexOffset &&
+                     m.vertexBytes == (uint64_t)m.vertexCount * m.format.stride &&
+                     m.indexBytes == (uint64_t)m.indexCount * m.indexSize;
+        for(unsigned int j = 0; valid && j < m.lodCount; ++j)
+            valid = m.lods[j].firstIndex <= m.indexCount && m.lods[j].indexCount <= m.indexCount - m.lods[j].firstIndex;
+        for(unsigned int j = 0; valid && j < m.format.attributeCount; ++j)
+            valid = m.format.attributes[j].offset < m.format.stride;
+        if(!valid)
+        {
+            file.close();
+            return fail(path, "invalid mesh entry");
+        }
+    }
+
+    if(verify)
+    {
+        size_t payloadStart = alignUp(sizeof(FileHeader) + sizeof(MeshEntry) * h->meshCount);
+        bool valid = payloadStart <= size && hash(data + payloadStart, size - payloadStart) == h->payloadHash;
+        for(unsigned int i = 0; valid && i < h->meshCount; ++i)
+        {
+            const MeshEntry& m = e[i];
+            const unsigned char* indices = (const unsigned char*)data + m.indexOffset;
+            for(unsigned int j = 0; valid && j < m.indexCount; ++j)
+            {
+                unsigned int index = (m.indexSize == 2) ? ((const uint16_t*)indices)[j] : ((const uint32_t*)indices)[j];
+                valid = index < m.vertexCount;
+            }
+        }
+        if(!valid)
+        {
+            file.close();
+            return fail(path, "corrupted data");
+        }
+    }
+
+    header = h;
+    entries = e;
+    return true;
+}
+
+void MeshCache::Reader::close()
+{
+    file.close();
+    header = 0;
+    entries = 0;
+}
+
+const MeshCache::MeshEntry* MeshCache::Reader::findMesh(const char* name) const
+{
+    for(unsigned int i = 0; i < getMeshCount(); ++i)
+        if(strncmp(entries[i].name, name, NAME_SIZE) == 0)
+            return &entries[i];
+    return 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// cold and warm load times
+///////////////////////////////////////////////////////////////////////////////
+void MeshCache::benchmark(const char* path, unsigned int iterations)
+{
+    bool evicted = evictFromOsCache(path);
+
+    Reader reader;
+    unsigned int sum = 0;
+    Clock::time_point start = Clock::now();
+    if(!reader.open(path))
+    {
+        std::cout << "[ERROR] MeshCache: cannot open " << path << std::endl;
+        return;
+    }
+    for(unsigned int i = 0; i < reader.getMeshCount(); ++i)
+    {
+        const MeshEntry& m = reader.getMesh(i);
+        sum += touchPages((const char*)reader.getVertices(m), (size_t)m.vertexBytes);
+        sum += touchPages((const char*)reader.getIndices(m), (size_t)m.indexBytes);
+    }
+    float coldTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    const size_t fileSize = reader.getFileSize();
+    const unsigned int meshCount = reader.getMeshCount();
+    reader.close();
+
+    float warmTime = 0;
+    for(unsigned int k = 0; k < iterations; ++k)
+    {
+        start = Clock::now();
+        reader.open(path);
+        for(unsigned int i = 0; i < reader.getMeshCount(); ++i)
+        {
+            const MeshEntry& m = reader.getMesh(i);
+            sum += touchPages((const char*)reader.getVertices(m), (size_t)m.vertexBytes);
+            sum += touchPages((const char*)reader.getIndices(m), (size_t)m.indexBytes);
+        }
+        warmTime += std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+        reader.close();
+    }
+    if(iterations)
+        warmTime /= iterations;
+
+    // verified open reads every byte, for comparison
+    start = Clock::now();
+    bool valid = reader.open(path, true);
+    float verifyTime = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    reader.close();
+
+    // keeps the page reads from being optimized out
+    volatile unsigned int sink = sum;
+    (void)sink;
+
+    const float MB = 1024.0f * 1024.0f;
+    std::cout << "===== MeshCache Benchmark: " << path << " =====\n"
+              << std::fixed << std::setprecision(3)
+              << "   File Size: " << fileSize / MB << " MB (" << meshCount << " meshes)\n"
+              << "   Cold Load: " << coldTime << " ms" << (evicted ? "" : " (file may still be in the OS cache)") << "\n"
+              << "   Warm Load: " << warmTime << " ms (average of " << iterations << ")\n"
+              << " Verify Load: " << verifyTime << " ms (" << (valid ? "valid" : "INVALID") << ")\n"
+              << "  Throughput: " << (coldTime > 0 ? fileSize / MB * 1000.0f / coldTime : 0.0f) << " MB/s cold, "
+              << (warmTime > 0 ? fileSize / MB * 1000.0f / warmTime : 0.0f) << " MB/s warm" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
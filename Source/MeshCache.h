@@ -0,0 +1,163 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshCache.h
+// ===========
+// Versioned binary container of GPU-ready meshes.
+// Each mesh stores interleaved vertices and indices exactly as they are
+// uploaded (already welded and optimized), its bounds, up to MAX_LODS index
+// ranges sharing the vertex buffer, and a descriptor of the vertex format.
+// Vertex and index blocks start on ALIGNMENT byte boundaries, so the Reader
+// maps the file and hands pointers into it straight to glBufferStorage().
+//
+// layout (native byte order, little-endian on every supported target):
+//   FileHeader
+//   MeshEntry[meshCount]
+//   vertex and index blocks, each aligned to ALIGNMENT bytes
+//
+// The version is bumped whenever a struct below changes; files with another
+// version are rejected and rebuilt from the source data.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "MappedFile.h"
+
+namespace MeshCache
+{
+    const uint32_t MAGIC = 0x4843534D;          // "MSCH"
+    const uint32_t VERSION = 1;
+    const uint32_t ALIGNMENT = 64;
+    const uint32_t MAX_ATTRIBUTES = 8;
+    const uint32_t MAX_LODS = 4;
+    const uint32_t NAME_SIZE = 32;
+    const uint32_t FLOAT_TYPE = 0x1406;         // GL_FLOAT
+
+    // one vertex attribute, the arguments of glVertexAttribPointer()
+    struct VertexAttribute
+    {
+        uint32_t location;
+        uint32_t components;
+        uint32_t type;                          // GL enum, e.g. GL_FLOAT
+        uint32_t normalized;
+        uint32_t offset;                        // in bytes from the start of the vertex
+    };
+
+    // the attribute at location 0 must be the float position
+    struct VertexFormat
+    {
+        uint32_t stride;                        // vertex size in bytes
+        uint32_t attributeCount;
+        VertexAttribute attributes[MAX_ATTRIBUTES];
+    };
+
+    // an index range of the mesh, LOD 0 is the full mesh
+    struct Lod
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float error;                            // max vertex displacement in model units
+        uint32_t reserved;
+    };
+
+    struct MeshEntry
+    {
+        char name[NAME_SIZE];
+        uint64_t sourceKey;                     // hash of the source data, detects stale meshes
+        VertexFormat format;
+        uint32_t vertexCount;
+        uint32_t indexCount;                    // all LODs
+        uint32_t indexSize;                     // 2 or 4 bytes
+        uint32_t lodCount;
+        Lod lods[MAX_LODS];
+        float boundsMin[3];
+        float boundsMax[3];
+        uint64_t vertexOffset;                  // from the start of the file
+        uint64_t vertexBytes;
+        uint64_t indexOffset;
+        uint64_t indexBytes;
+    };
+
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t headerSize;                    // sizeof(FileHeader)
+        uint32_t entrySize;                     // sizeof(MeshEntry)
+        uint32_t meshCount;
+        uint32_t reserved;
+        uint64_t fileSize;
+        uint64_t payloadHash;                   // FNV-1a of everything after the entries
+    };
+
+    // 64-bit FNV-1a, also used to build source keys
+    uint64_t hash(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ULL);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // builds a cache file in memory and writes it
+    ///////////////////////////////////////////////////////////////////////////
+    class Writer
+    {
+    public:
+        // copy a mesh, the indices are stored as 16-bit if the vertex count allows it
+        // LODs after the first are generated by vertex clustering, lodCount = 1 disables them
+        void addMesh(const char* name, uint64_t sourceKey, const VertexFormat& format,
+                     const void* vertices, unsigned int vertexCount,
+                     const unsigned int* indices, unsigned int indexCount, unsigned int lodCount = MAX_LODS);
+
+        // copy a mesh as it is from another cache
+        void addMesh(const MeshEntry& entry, const void* vertices, const void* indices);
+
+        unsigned int getMeshCount() const               { return (unsigned int)meshes.size(); }
+        const MeshEntry& getMesh(unsigned int index) const          { return meshes[index].entry; }
+        const void* getVertices(unsigned int index) const           { return meshes[index].vertices.data(); }
+        const void* getIndices(unsigned int index) const            { return meshes[index].indices.data(); }
+
+        // write the file, return false on an I/O error
+        bool write(const char* path) const;
+
+    private:
+        struct Mesh
+        {
+            MeshEntry entry;                    // offsets are set by write()
+            std::vector<unsigned char> vertices;
+            std::vector<unsigned char> indices;
+        };
+        std::vector<Mesh> meshes;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // maps a cache file and validates it, the data is read in place
+    ///////////////////////////////////////////////////////////////////////////
+    class Reader
+    {
+    public:
+        Reader() : header(0), entries(0) {}
+
+        // verify also checks the payload hash and every index, which reads the whole file
+        bool open(const char* path, bool verify = false);
+        void close();
+        bool isOpen() const                     { return header != 0; }
+
+        unsigned int getMeshCount() const       { return header ? header->meshCount : 0; }
+        const MeshEntry& getMesh(unsigned int index) const          { return entries[index]; }
+        const MeshEntry* findMesh(const char* name) const;          // 0 if missing
+        const void* getVertices(const MeshEntry& entry) const       { return file.getData() + entry.vertexOffset; }
+        const void* getIndices(const MeshEntry& entry) const        { return file.getData() + entry.indexOffset; }
+        size_t getFileSize() const              { return file.getSize(); }
+
+    private:
+        MappedFile file;
+        const FileHeader* header;
+        const MeshEntry* entries;
+    };
+
+    // time a cold open (the file is first evicted from the OS cache where the
+    // platform allows it) and warm opens, each open touches every page as an
+    // upload would; prints the results
+    void benchmark(const char* path, unsigned int iterations = 20);
+}
+
+#endif
@@ -0,0 +1,189 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshCacheConverter.cpp
+// ======================
+// Offline conversion of model files to a mesh cache.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "MeshCacheConverter.h"
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
+#include "GltfLoader.h"
+
+
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    bool hasExtension(const std::string& path, const char* extension)
+    {
+        std::string ext(extension);
+        return path.size() > ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+    }
+
+    // optimize and add a mesh of ObjLoader::VERTEX_FLOATS floats per vertex
+    void addMesh(MeshCache::Writer& writer, const std::string& name,
+                 std::vector<float>& vertices, std::vector<unsigned int>& indices)
+    {
+        const unsigned int stride = ObjLoader::VERTEX_FLOATS * sizeof(float);
+        unsigned int vertexCount = (unsigned int)(vertices.size() / ObjLoader::VERTEX_FLOATS);
+        unsigned int indexCount = (unsigned int)indices.size();
+        if(vertexCount == 0 || indexCount == 0)
+            return;
+
+        MeshOptimizer::optimizeVertexCache(indices.data(), indexCount, vertexCount);
+        MeshOptimizer::optimizeOverdraw(indices.data(), indexCount, vertices.data(), vertexCount, stride);
+        vertexCount = MeshOptimizer::optimizeVertexFetch(vertices.data(), vertexCount, stride, indices.data(), indexCount);
+
+        // the content is the key, a changed source gives a new key
+        uint64_t key = MeshCache::hash(vertices.data(), (size_t)vertexCount * stride);
+        key = MeshCache::hash(indices.data(), indices.size() * sizeof(unsigned int), key);
+        writer.addMesh(name.c_str(), key, MeshCacheConverter::getVertexFormat(),
+                       vertices.data(), vertexCount, indices.data(), indexCount);
+    }
+
+    bool convertObj(const char* path, MeshCache::Writer& writer)
+    {
+        ObjLoader::Scene scene;
+        if(!ObjLoader::load(path, scene))
+            return false;
+
+        for(size_t i = 0; i < scene.groups.size(); ++i)
+        {
+            ObjLoader::Group& group = scene.groups[i];
+            std::string name = group.name;
+            if(group.material >= 0)
+                name += "/" + scene.materials[group.material].name;
+            addMesh(writer, name, group.vertices, group.indices);
+        }
+        return true;
+    }
+
+    bool convertGltf(const char* path, MeshCache::Writer& writer)
+    {
+        GltfLoader::Document document;
+        if(!GltfLoader::load(path, document))
+            return false;
+
+        for(size_t i = 0; i < document.meshes.size(); ++i)
+        {
+            const GltfLoader::Mesh& mesh = document.meshes[i];
+            for(size_t j = 0; j < mesh.primitives.size(); ++j)
+            {
+                const GltfLoader::Primitive& primitive = mesh.primitives[j];
+                const unsigned int vertexCount = document.accessors[primitive.position].count;
+
+                // interleave position, normal and texCoords, missing attributes are 0
+                const int accessors[] = { primitive.position, primitive.normal, primitive.texCoord };
+                const unsigned int offsets[] = { 0, 3, 6 };
+                const unsigned int sizes[] = { 3, 3, 2 };
+                std::vector<float> vertices((size_t)vertexCount * ObjLoader::VERTEX_FLOATS, 0.0f);
+                std::vector<float> data;
+                for(int k = 0; k < 3; ++k)
+                {
+                    if(accessors[k] < 0)
+                        continue;
+                    const GltfLoader::Accessor& accessor = document.accessors[accessors[k]];
+                    GltfLoader::readAccessor(document, accessor, data);
+                    unsigned int count = std::min(accessor.count, vertexCount);
+                    unsigned int components = std::min(accessor.components, sizes[k]);
+                    for(unsigned int v = 0; v < count; ++v)
+                        for(unsigned int c = 0; c < components; ++c)
+                            vertices[(size_t)v * ObjLoader::VERTEX_FLOATS + offsets[k] + c] = data[(size_t)v * accessor.components + c];
+                }
+
+                std::vector<unsigned int> indices;
+                if(primitive.indices >= 0)
+                    GltfLoader::readIndices(document, document.accessors[primitive.indices], indices);
+                else
+                    for(unsigned int v = 0; v < vertexCount; ++v)
+                        indices.push_back(v);
+
+                // drop out of range indices instead of writing an unsafe mesh
+                std::vector<unsigned int> valid;
+                valid.reserve(indices.size());
+                for(size_t t = 0; t + 2 < indices.size(); t += 3)
+                {
+                    if(indices[t] < vertexCount && indices[t + 1] < vertexCount && indices[t + 2] < vertexCount)
+                        valid.insert(valid.end(), indices.begin() + t, indices.begin() + t + 3);
+                }
+
+                std::string name = mesh.name.empty() ? "mesh" + std::to_string(i) : mesh.name;
+                if(mesh.primitives.size() > 1)
+                    name += "/" + std::to_string(j);
+                addMesh(writer, name, vertices, valid);
+            }
+        }
+        return true;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// position, normal, texCoords
+///////////////////////////////////////////////////////////////////////////////
+MeshCache::VertexFormat MeshCacheConverter::getVertexFormat()
+{
+    MeshCache::VertexFormat format = {};
+    format.stride = ObjLoader::VERTEX_FLOATS * sizeof(float);
+    format.attributeCount = 3;
+    const unsigned int components[] = { 3, 3, 2 };
+    const unsigned int offsets[] = { 0, 3, 6 };
+    for(unsigned int i = 0; i < 3; ++i)
+    {
+        format.attributes[i].location = i;
+        format.attributes[i].components = components[i];
+        format.attributes[i].type = MeshCache::FLOAT_TYPE;
+        format.attributes[i].normalized = 0;
+        format.attributes[i].offset = offsets[i] * sizeof(float);
+    }
+    return format;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// load, optimize and write
+///////////////////////////////////////////////////////////////////////////////
+bool MeshCacheConverter::convert(const char* inputPath, const char* outputPath)
+{
+    Clock::time_point start = Clock::now();
+
+    MeshCache::Writer writer;
+    bool loaded = false;
+    if(hasExtension(inputPath, ".obj"))
+        loaded = convertObj(inputPath, writer);
+    else if(hasExtension(inputPath, ".glb"))
+        loaded = convertGltf(inputPath, writer);
+    else
+        std::cout << "[ERROR] MeshCacheConverter: unsupported file type: " << inputPath << std::endl;
+    if(!loaded || !writer.write(outputPath))
+        return false;
+
+    unsigned int vertexCount = 0, triangleCount = 0, lodCount = 0;
+    for(unsigned int i = 0; i < writer.getMeshCount(); ++i)
+    {
+        const MeshCache::MeshEntry& entry = writer.getMesh(i);
+        vertexCount += entry.vertexCount;
+        triangleCount += entry.lods[0].indexCount / 3;
+        lodCount += entry.lodCount;
+    }
+
+    float time = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    std::cout << "===== MeshCacheConverter: " << inputPath << " -> " << outputPath << " =====\n"
+              << std::fixed << std::setprecision(2)
+              << "    Meshes: " << writer.getMeshCount() << " (" << lodCount << " LODs)\n"
+              << "  Vertices: " << vertexCount << "\n"
+              << " Triangles: " << triangleCount << " (LOD 0)\n"
+              << "      Time: " << time << " ms" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+    return true;
+}
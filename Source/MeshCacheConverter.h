@@ -0,0 +1,29 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshCacheConverter.h
+// ====================
+// Offline conversion of model files to a mesh cache (see MeshCache.h).
+// Supported inputs: Wavefront OBJ (.obj) and binary glTF (.glb). Each OBJ
+// group or glTF primitive becomes one mesh with float position, normal and
+// texture coords (ObjLoader::VERTEX_FLOATS per vertex), optimized for the
+// vertex cache, overdraw and vertex fetch, with LODs.
+//
+// Run from the command line:
+//   OpenGLSample --convert-mesh <input.obj|input.glb> <output.meshcache>
+//   OpenGLSample --benchmark-mesh-cache <file.meshcache>
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MESH_CACHE_CONVERTER_H
+#define MESH_CACHE_CONVERTER_H
+
+#include "MeshCache.h"
+
+namespace MeshCacheConverter
+{
+    // vertex format of converted meshes: position (0), normal (1), texCoords (2)
+    MeshCache::VertexFormat getVertexFormat();
+
+    // convert a model file, return false if it cannot be read or written
+    bool convert(const char* inputPath, const char* outputPath);
+}
+
+#endif
@@ -0,0 +1,578 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshOptimizer.cpp
+// =================
+// Index/vertex buffer optimization before uploading a mesh to the GPU.
+// - vertex cache: Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+// - overdraw    : clusters split where the vertex cache is flushed, then
+//                 sorted front-to-back with respect to the mesh centroid
+//                 (Sander et al., "Fast Triangle Reordering for Vertex
+//                 Locality and Reduced Overdraw")
+// - vertex fetch: vertices renumbered in the order of first reference
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include "MeshOptimizer.h"
+
+
+
+// constants //////////////////////////////////////////////////////////////////
+namespace
+{
+    // Forsyth scoring parameters
+    const int   CACHE_SIZE          = 32;       // size of the modelled LRU cache
+    const float CACHE_DECAY_POWER   = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+    const int   MAX_VALENCE         = 32;       // valence score table size
+
+    // FIFO cache size used to find cluster boundaries for overdraw
+    const unsigned int OVERDRAW_CACHE_SIZE = 16;
+
+    // collapsed triangle for duplicate removal in simplifyClustered()
+    struct Triangle
+    {
+        unsigned int a, b, c;
+        bool operator==(const Triangle& rhs) const { return a == rhs.a && b == rhs.b && c == rhs.c; }
+    };
+    struct TriangleHash
+    {
+        size_t operator()(const Triangle& t) const { return (t.a * 73856093u) ^ (t.b * 19349663u) ^ (t.c * 83492791u); }
+    };
+
+    // score of a vertex by its position in the cache and by its remaining valence
+    struct ScoreTables
+    {
+        float cache[CACHE_SIZE];
+        float valence[MAX_VALENCE];
+
+        ScoreTables()
+        {
+            for(int i = 0; i < CACHE_SIZE; ++i)
+            {
+                if(i < 3)       // the vertices of the last triangle get a fixed score
+                    cache[i] = LAST_TRIANGLE_SCORE;
+                else
+                    cache[i] = powf(1.0f - (float)(i - 3) / (CACHE_SIZE - 3), CACHE_DECAY_POWER);
+            }
+
+            valence[0] = 0;
+            for(int i = 1; i < MAX_VALENCE; ++i)
+                valence[i] = VALENCE_BOOST_SCALE * powf((float)i, -VALENCE_BOOST_POWER);
+        }
+    };
+
+    // built once on first use, the initialization of a local static is thread-safe,
+    // meshes are optimized on several threads at startup
+    const ScoreTables& getScoreTables()
+    {
+        static const ScoreTables tables;
+        return tables;
+    }
+
+    float vertexScore(const ScoreTables& tables, int cachePosition, unsigned int remainingValence)
+    {
+        if(remainingValence == 0)
+            return -1.0f;   // no triangle needs this vertex anymore
+
+        float score = 0;
+        if(cachePosition >= 0)
+            score = tables.cache[cachePosition];
+
+        if(remainingValence < (unsigned int)MAX_VALENCE)
+            score += tables.valence[remainingValence];
+        else
+            score += tables.valence[MAX_VALENCE - 1];
+        return score;
+    }
+
+    // FIFO cache miss count of triangles [first, last)
+    unsigned int countCacheMisses(const unsigned int* indices, unsigned int first, unsigned int last,
+                                  std::vector<unsigned int>& timestamps, unsigned int& time,
+                                  unsigned int cacheSize)
+    {
+        unsigned int misses = 0;
+        for(unsigned int i = first * 3; i < last * 3; ++i)
+        {
+            unsigned int v = indices[i];
+            if(time - timestamps[v] > cacheSize)
+            {
+                timestamps[v] = time++;
+                ++misses;
+            }
+        }
+        return misses;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// simulate a FIFO post-transform cache
+// A vertex is in the cache if fewer than cacheSize vertices were transformed
+// after it.
+///////////////////////////////////////////////////////////////////////////////
+MeshOptimizer::VertexCacheStats MeshOptimizer::analyzeVertexCache(const unsigned int* indices, unsigned int indexCount,
+                                                                  unsigned int vertexCount, unsigned int cacheSize)
+{
+    VertexCacheStats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.triangleCount = indexCount / 3;
+
+    std::vector<unsigned int> timestamps(vertexCount, 0);
+    std::vector<unsigned char> used(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+
+    for(unsigned int i = 0; i < stats.triangleCount * 3; ++i)
+    {
+        unsigned int v = indices[i];
+        if(time - timestamps[v] > cacheSize)
+        {
+            timestamps[v] = time++;
+            stats.transformCount++;
+        }
+        if(!used[v])
+        {
+            used[v] = 1;
+            stats.vertexCount++;
+        }
+    }
+
+    if(stats.triangleCount)
+        stats.acmr = (float)stats.transformCount / stats.triangleCount;
+    if(stats.vertexCount)
+        stats.atvr = (float)stats.transformCount / stats.vertexCount;
+    return stats;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// reorder triangles for vertex cache locality
+// Each vertex gets a score from its position in a modelled LRU cache and the
+// number of triangles still using it. Greedily emit the triangle with the
+// highest score, then rescore only the vertices/triangles touched by the
+// cache update, which keeps the algorithm linear in the triangle count.
+///////////////////////////////////////////////////////////////////////////////
+void MeshOptimizer::optimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount)
+{
+    unsigned int triangleCount = indexCount / 3;
+    if(triangleCount == 0)
+        return;
+
+    const ScoreTables& tables = getScoreTables();
+
+    // build vertex to triangle adjacency (compressed rows)
+    std::vector<unsigned int> valence(vertexCount, 0);
+    for(unsigned int i = 0; i < triangleCount * 3; ++i)
+        valence[indices[i]]++;
+
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for(unsigned int i = 0; i < vertexCount; ++i)
+        offsets[i + 1] = offsets[i] + valence[i];
+
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for(unsigned int t = 0; t < triangleCount; ++t)
+    {
+        for(int k = 0; k < 3; ++k)
+        {
+            unsigned int v = indices[t * 3 + k];
+            adjacency[fill[v]++] = t;
+        }
+    }
+
+    // initial scores
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for(unsigned int v = 0; v < vertexCount; ++v)
+        vertexScores[v] = vertexScore(tables, -1, valence[v]);
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<unsigned char> emitted(triangleCount, 0);
+    for(unsigned int t = 0; t < triangleCount; ++t)
+    {
+        triangleScores[t] = vertexScores[indices[t * 3]] +
+                            vertexScores[indices[t * 3 + 1]] +
+                            vertexScores[indices[t * 3 + 2]];
+    }
+
+    unsigned int cache[CACHE_SIZE + 3];
+    unsigned int cacheCount = 0;
+    unsigned int newCache[CACHE_SIZE + 3];
+
+    std::vector<unsigned int> output(triangleCount * 3);
+    unsigned int outputCount = 0;
+    unsigned int cursor = 0;    // next candidate when the cache has no live triangle
+
+    // start with the best triangle overall
+    int best = (int)(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+
+    while(outputCount < triangleCount)
+    {
+        if(best < 0)
+        {
+            // dead end: continue with the next triangle in input order
+            while(emitted[cursor])
+                ++cursor;
+            best = (int)cursor;
+        }
+
+        unsigned int t = (unsigned int)best;
+        unsigned int a = indices[t * 3], b = indices[t * 3 + 1], c = indices[t * 3 + 2];
+
+        output[outputCount * 3]     = a;
+        output[outputCount * 3 + 1] = b;
+        output[outputCount * 3 + 2] = c;
+        ++outputCount;
+        emitted[t] = 1;
+
+        // remove the triangle from the adjacency of its vertices
+        unsigned int tri[3] = { a, b, c };
+        for(int k = 0; k < 3; ++k)
+        {
+            unsigned int v = tri[k];
+            unsigned int* first = &adjacency[offsets[v]];
+            unsigned int* last = first + valence[v];
+            unsigned int* it = std::find(first, last, t);
+            if(it != last)
+            {
+                *it = *(last - 1);
+                valence[v]--;
+            }
+        }
+
+        // move the triangle vertices to the front of the cache
+        unsigned int newCount = 0;
+        newCache[newCount++] = a;
+        newCache[newCount++] = b;
+        newCache[newCount++] = c;
+        for(unsigned int i = 0; i < cacheCount; ++i)
+        {
+            unsigned int v = cache[i];
+            if(v != a && v != b && v != c)
+                newCache[newCount++] = v;
+        }
+
+        // vertices pushed out of the cache lose their cache score
+        for(unsigned int i = CACHE_SIZE; i < newCount; ++i)
+            cachePositions[newCache[i]] = -1;
+
+        cacheCount = newCount < (unsigned int)CACHE_SIZE ? newCount : (unsigned int)CACHE_SIZE;
+        memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+
+        // rescore the touched vertices and their live triangles
+        float bestScore = -1.0f;
+        best = -1;
+        for(unsigned int i = 0; i < newCount; ++i)
+        {
+            unsigned int v = newCache[i];
+            if(i < cacheCount)
+                cachePositions[v] = (int)i;
+
+            float score = vertexScore(tables, cachePositions[v], valence[v]);
+            float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+
+            for(unsigned int j = 0; j < valence[v]; ++j)
+            {
+                unsigned int adj = adjacency[offsets[v] + j];
+                triangleScores[adj] += delta;
+                if(i < cacheCount && triangleScores[adj] > bestScore)
+                {
+                    bestScore = triangleScores[adj];
+                    best = (int)adj;
+                }
+            }
+        }
+    }
+
+    memcpy(indices, output.data(), triangleCount * 3 * sizeof(unsigned int));
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// reorder clusters of triangles to reduce overdraw
+// Hard boundaries are where the vertex cache is effectively flushed (a
+// triangle misses all 3 vertices), so moving those clusters costs nothing.
+// Each hard cluster is split further into soft clusters whenever the ACMR of
+// the soft cluster, simulated with an empty cache, stays within threshold of
+// the hard cluster ACMR. Clusters are then sorted by how much they face away
+// from the mesh centroid: outer surfaces are drawn first and occlude the rest.
+///////////////////////////////////////////////////////////////////////////////
+void MeshOptimizer::optimizeOverdraw(unsigned int* indices, unsigned int indexCount,
+                                     const float* positions, unsigned int vertexCount,
+                                     unsigned int positionStride, float threshold)
+{
+    unsigned int triangleCount = indexCount / 3;
+    if(triangleCount == 0 || !positions)
+        return;
+
+    const unsigned char* base = (const unsigned char*)positions;
+
+    // hard boundaries
+    std::vector<unsigned int> hard;
+    {
+        std::vector<unsigned int> timestamps(vertexCount, 0);
+        unsigned int time = OVERDRAW_CACHE_SIZE + 1;
+        for(unsigned int t = 0; t < triangleCount; ++t)
+        {
+            unsigned int misses = countCacheMisses(indices, t, t + 1, timestamps, time, OVERDRAW_CACHE_SIZE);
+            if(t == 0 || misses == 3)
+                hard.push_back(t);
+        }
+        hard.push_back(triangleCount);
+    }
+
+    // soft boundaries
+    std::vector<unsigned int> clusters;
+    {
+        std::vector<unsigned int> timestamps(vertexCount, 0);
+        unsigned int time = OVERDRAW_CACHE_SIZE + 1;
+        for(unsigned int h = 0; h + 1 < hard.size(); ++h)
+        {
+            unsigned int first = hard[h];
+            unsigned int last = hard[h + 1];
+
+            // ACMR of the whole hard cluster
+            time += OVERDRAW_CACHE_SIZE + 1;    // flush
+            unsigned int misses = countCacheMisses(indices, first, last, timestamps, time, OVERDRAW_CACHE_SIZE);
+            float clusterAcmr = (float)misses / (last - first);
+
+            // split when a soft cluster alone is as cache friendly as the whole
+            clusters.push_back(first);
+            time += OVERDRAW_CACHE_SIZE + 1;
+            unsigned int softStart = first;
+            unsigned int softMisses = 0;
+            for(unsigned int t = first; t < last; ++t)
+            {
+                softMisses += countCacheMisses(indices, t, t + 1, timestamps, time, OVERDRAW_CACHE_SIZE);
+                unsigned int softCount = t + 1 - softStart;
+                if(t + 1 < last && (float)softMisses / softCount <= threshold * clusterAcmr)
+                {
+                    clusters.push_back(t + 1);
+                    time += OVERDRAW_CACHE_SIZE + 1;
+                    softStart = t + 1;
+                    softMisses = 0;
+                }
+            }
+        }
+        clusters.push_back(triangleCount);
+    }
+
+    unsigned int clusterCount = (unsigned int)clusters.size() - 1;
+    if(clusterCount <= 1)
+        return;
+
+    // mesh centroid (area weighted)
+    float meshCenter[3] = { 0, 0, 0 };
+    float meshArea = 0;
+    std::vector<float> clusterCenters(clusterCount * 3, 0.0f);
+    std::vector<float> clusterNormals(clusterCount * 3, 0.0f);
+    std::vector<float> clusterAreas(clusterCount, 0.0f);
+
+    for(unsigned int c = 0; c < clusterCount; ++c)
+    {
+        for(unsigned int t = clusters[c]; t < clusters[c + 1]; ++t)
+        {
+            const float* p0 = (const float*)(base + indices[t * 3] * positionStride);
+            const float* p1 = (const float*)(base + indices[t * 3 + 1] * positionStride);
+            const float* p2 = (const float*)(base + indices[t * 3 + 2] * positionStride);
+
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1],
+                           e1[2] * e2[0] - e1[0] * e2[2],
+                           e1[0] * e2[1] - e1[1] * e2[0] };
+            float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for(int k = 0; k < 3; ++k)
+            {
+                float center = (p0[k] + p1[k] + p2[k]) / 3.0f;
+                clusterCenters[c * 3 + k] += center * area;
+                clusterNormals[c * 3 + k] += n[k];
+                meshCenter[k] += center * area;
+            }
+            clusterAreas[c] += area;
+            meshArea += area;
+        }
+    }
+
+    if(meshArea > 0)
+    {
+        for(int k = 0; k < 3; ++k)
+            meshCenter[k] /= meshArea;
+    }
+
+    // sort key: dot(clusterCenter - meshCenter, clusterNormal)
+    std::vector<float> keys(clusterCount);
+    for(unsigned int c = 0; c < clusterCount; ++c)
+    {
+        float* center = &clusterCenters[c * 3];
+        float* normal = &clusterNormals[c * 3];
+        if(clusterAreas[c] > 0)
+        {
+            for(int k = 0; k < 3; ++k)
+                center[k] /= clusterAreas[c];
+        }
+        float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if(length > 0)
+        {
+            for(int k = 0; k < 3; ++k)
+                normal[k] /= length;
+        }
+        keys[c] = (center[0] - meshCenter[0]) * normal[0] +
+                  (center[1] - meshCenter[1]) * normal[1] +
+                  (center[2] - meshCenter[2]) * normal[2];
+    }
+
+    std::vector<unsigned int> order(clusterCount);
+    for(unsigned int c = 0; c < clusterCount; ++c)
+        order[c] = c;
+    std::stable_sort(order.begin(), order.end(),
+                     [&keys](unsigned int a, unsigned int b) { return keys[a] > keys[b]; });
+
+    // write clusters in sorted order
+    std::vector<unsigned int> output;
+    output.reserve(triangleCount * 3);
+    for(unsigned int i = 0; i < clusterCount; ++i)
+    {
+        unsigned int c = order[i];
+        output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+    }
+    memcpy(indices, output.data(), output.size() * sizeof(unsigned int));
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// renumber vertices by first reference and move the vertex data accordingly
+///////////////////////////////////////////////////////////////////////////////
+unsigned int MeshOptimizer::optimizeVertexFetch(void* vertices, unsigned int vertexCount, unsigned int vertexSize,
+                                                unsigned int* indices, unsigned int indexCount)
+{
+    const unsigned int UNUSED = ~0u;
+    std::vector<unsigned int> remap(vertexCount, UNUSED);
+
+    unsigned int next = 0;
+    for(unsigned int i = 0; i < indexCount; ++i)
+    {
+        unsigned int v = indices[i];
+        if(remap[v] == UNUSED)
+            remap[v] = next++;
+        indices[i] = remap[v];
+    }
+    unsigned int referenced = next;
+
+    // keep unreferenced vertices after the referenced ones
+    for(unsigned int v = 0; v < vertexCount; ++v)
+    {
+        if(remap[v] == UNUSED)
+            remap[v] = next++;
+    }
+
+    if(vertices)
+    {
+        unsigned char* data = (unsigned char*)vertices;
+        std::vector<unsigned char> copy(data, data + (size_t)vertexCount * vertexSize);
+        for(unsigned int v = 0; v < vertexCount; ++v)
+            memcpy(data + (size_t)remap[v] * vertexSize, &copy[(size_t)v * vertexSize], vertexSize);
+    }
+
+    return referenced;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// vertex clustering simplification
+///////////////////////////////////////////////////////////////////////////////
+unsigned int MeshOptimizer::simplifyClustered(unsigned int* out, const unsigned int* indices, unsigned int indexCount,
+                                              const float* positions, unsigned int vertexCount,
+                                              unsigned int positionStride, unsigned int gridSize)
+{
+    if(vertexCount == 0 || indexCount < 3 || gridSize == 0)
+        return 0;
+
+    const unsigned char* data = (const unsigned char*)positions;
+    auto position = [&](unsigned int v) { return (const float*)(data + (size_t)v * positionStride); };
+
+    // bounding box and cell size from the longest axis
+    float minBound[3], maxBound[3];
+    for(int j = 0; j < 3; ++j)
+        minBound[j] = maxBound[j] = position(0)[j];
+    for(unsigned int v = 1; v < vertexCount; ++v)
+    {
+        const float* p = position(v);
+        for(int j = 0; j < 3; ++j)
+        {
+            minBound[j] = std::min(minBound[j], p[j]);
+            maxBound[j] = std::max(maxBound[j], p[j]);
+        }
+    }
+    float extent = std::max(maxBound[0] - minBound[0], std::max(maxBound[1] - minBound[1], maxBound[2] - minBound[2]));
+    float scale = extent > 0 ? gridSize / extent : 0;
+
+    // representative vertex of each occupied cell, the first vertex found in it
+    std::vector<unsigned int> remap(vertexCount);
+    std::unordered_map<unsigned long long, unsigned int> cells;
+    cells.reserve(vertexCount);
+    for(unsigned int v = 0; v < vertexCount; ++v)
+    {
+        const float* p = position(v);
+        unsigned long long key = 0;
+        for(int j = 0; j < 3; ++j)
+        {
+            unsigned int cell = std::min((unsigned int)((p[j] - minBound[j]) * scale), gridSize - 1);
+            key = (key << 21) | cell;
+        }
+        remap[v] = cells.insert(std::make_pair(key, v)).first->second;
+    }
+
+    // collapse triangles, drop the degenerate ones and the duplicates
+    std::unordered_set<Triangle, TriangleHash> seen;
+    unsigned int count = 0;
+    for(unsigned int i = 0; i + 2 < indexCount; i += 3)
+    {
+        unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+        if(a == b || b == c || c == a)
+            continue;
+
+        // rotate so the smallest index is first, winding is kept
+        if(b < a && b < c)      { unsigned int t = a; a = b; b = c; c = t; }
+        else if(c < a && c < b) { unsigned int t = c; c = b; b = a; a = t; }
+        Triangle triangle = { a, b, c };
+        if(!seen.insert(triangle).second)
+            continue;
+
+        out[count++] = a;
+        out[count++] = b;
+        out[count++] = c;
+    }
+    return count;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// print cache statistics before and after optimization
+///////////////////////////////////////////////////////////////////////////////
+void MeshOptimizer::printStats(const char* name, const VertexCacheStats& before, const VertexCacheStats& after)
+{
+    std::cout << "===== MeshOptimizer: " << (name ? name : "mesh") << " =====\n"
+              << std::fixed << std::setprecision(3)
+              << "Triangle Count: " << after.triangleCount << "\n"
+              << "  Vertex Count: " << after.vertexCount << "\n"
+              << "          ACMR: " << before.acmr << " -> " << after.acmr << "\n"
+              << "          ATVR: " << before.atvr << " -> " << after.atvr << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshOptimizer.h
+// ===============
+// Index/vertex buffer optimization before uploading a mesh to the GPU.
+// The passes are meant to run in this order:
+// 1. optimizeVertexCache(): reorder triangles for post-transform vertex cache
+//    locality (Tom Forsyth's linear-speed vertex cache optimization)
+// 2. optimizeOverdraw()   : reorder clusters of triangles so that outward
+//    facing clusters are drawn first, without hurting the vertex cache much
+// 3. optimizeVertexFetch(): reorder vertices in the order they are first
+//    referenced by the index buffer, so vertex fetch walks memory linearly
+//
+// simplifyClustered() builds a lower level of detail index buffer by vertex
+// clustering on a uniform grid (Rossignac-Borrel); the result references the
+// original vertices, so every LOD shares one vertex buffer.
+//
+// analyzeVertexCache() simulates a FIFO cache and returns ACMR (average cache
+// miss ratio, transformed vertices per triangle) and ATVR (average transformed
+// vertex ratio, transformed vertices per unique vertex; 1.0 is optimal).
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+namespace MeshOptimizer
+{
+    // result of a vertex cache simulation
+    struct VertexCacheStats
+    {
+        unsigned int vertexCount;       // # of unique vertices referenced
+        unsigned int triangleCount;
+        unsigned int transformCount;    // # of cache misses
+        float acmr;                     // transformCount / triangleCount
+        float atvr;                     // transformCount / vertexCount
+    };
+
+    // simulate a FIFO post-transform cache of cacheSize entries
+    VertexCacheStats analyzeVertexCache(const unsigned int* indices, unsigned int indexCount,
+                                        unsigned int vertexCount, unsigned int cacheSize = 16);
+
+    // reorder triangles in place for vertex cache locality
+    void optimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount);
+
+    // reorder triangle clusters in place to reduce overdraw
+    // positions: the first 3 floats of each vertex, positionStride is in bytes
+    // threshold: allowed ACMR degradation (1.05 = up to 5% worse)
+    void optimizeOverdraw(unsigned int* indices, unsigned int indexCount,
+                          const float* positions, unsigned int vertexCount,
+                          unsigned int positionStride, float threshold = 1.05f);
+
+    // reorder interleaved vertices in place by first use and remap indices
+    // vertexSize is in bytes; unreferenced vertices are moved to the end
+    // return the number of referenced vertices
+    unsigned int optimizeVertexFetch(void* vertices, unsigned int vertexCount, unsigned int vertexSize,
+                                     unsigned int* indices, unsigned int indexCount);
+
+    // write a simplified index buffer to out: vertices in the same cell of a grid with
+    // gridSize cells along the longest axis of the bounding box collapse to the first
+    // of them, degenerate and duplicated triangles are removed
+    // return the # of indices written (at most indexCount)
+    unsigned int simplifyClustered(unsigned int* out, const unsigned int* indices, unsigned int indexCount,
+                                   const float* positions, unsigned int vertexCount,
+                                   unsigned int positionStride, unsigned int gridSize);
+
+    // print ACMR/ATVR before and after optimization
+    void printStats(const char* name, const VertexCacheStats& before, const VertexCacheStats& after);
+}
+
+#endif
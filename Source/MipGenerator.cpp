@@ -0,0 +1,333 @@
+///////////////////////////////////////////////////////////////////////////////
+// MipGenerator.cpp
+// ================
+// Gamma-correct box filtered mipmap chains.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "MipGenerator.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_SSE2
+#endif
+
+
+
+namespace
+{
+    // linear values are quantized to 12 bits to look up their sRGB byte,
+    // fine enough that every dark sRGB step keeps its own entry
+    const int LINEAR_STEPS = 4096;
+
+    struct Tables
+    {
+        float srgbToLinear[256];
+        float byteToFloat[256];
+        unsigned char linearToSrgb[LINEAR_STEPS];
+
+        Tables()
+        {
+            for(int i = 0; i < 256; ++i)
+            {
+                float c = i / 255.0f;
+                srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                byteToFloat[i] = c;
+            }
+            for(int i = 0; i < LINEAR_STEPS; ++i)
+            {
+                float c = i / (float)(LINEAR_STEPS - 1);
+                float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+                linearToSrgb[i] = (unsigned char)(s * 255.0f + 0.5f);
+            }
+        }
+    };
+
+    // built once, on first use (thread safe since C++11)
+    const Tables& getTables()
+    {
+        static const Tables tables;
+        return tables;
+    }
+
+    // channel 1 of grey + alpha and channel 3 of RGBA are alpha
+    bool isAlpha(int channels, int channel)
+    {
+        return (channels == 2 && channel == 1) || (channels == 4 && channel == 3);
+    }
+
+    // first level: 2x2 average of the bytes of the base level, converted to linear floats
+    void downsampleBytes(const unsigned char* src, int width, int height, int channels, float* dst, bool srgb)
+    {
+        const Tables& t = getTables();
+        const float* table[4];
+        for(int c = 0; c < 4; ++c)
+            table[c] = (srgb && !isAlpha(channels, c)) ? t.srgbToLinear : t.byteToFloat;
+
+        const int dstWidth = MipGenerator::getLevelDimension(width, 1);
+        const int dstHeight = MipGenerator::getLevelDimension(height, 1);
+        const size_t rowSize = (size_t)width * channels;
+        for(int y = 0; y < dstHeight; ++y)
+        {
+            const unsigned char* row0 = src + (size_t)(2 * y) * rowSize;
+            const unsigned char* row1 = src + (size_t)std::min(2 * y + 1, height - 1) * rowSize;
+            float* out = dst + (size_t)y * dstWidth * channels;
+            for(int x = 0; x < dstWidth; ++x)
+            {
+                const int x0 = 2 * x * channels;
+                const int x1 = std::min(2 * x + 1, width - 1) * channels;
+                for(int c = 0; c < channels; ++c)
+                {
+                    const float* lut = table[c];
+                    out[c] = (lut[row0[x0 + c]] + lut[row0[x1 + c]] + lut[row1[x0 + c]] + lut[row1[x1 + c]]) * 0.25f;
+                }
+                out += channels;
+            }
+        }
+    }
+
+    // next levels: 2x2 average of a float level
+    void downsampleFloats(const float* src, int width, int height, int channels, float* dst)
+    {
+        const int dstWidth = MipGenerator::getLevelDimension(width, 1);
+        const int dstHeight = MipGenerator::getLevelDimension(height, 1);
+        const size_t rowSize = (size_t)width * channels;
+        for(int y = 0; y < dstHeight; ++y)
+        {
+            const float* row0 = src + (size_t)(2 * y) * rowSize;
+            const float* row1 = src + (size_t)std::min(2 * y + 1, height - 1) * rowSize;
+            float* out = dst + (size_t)y * dstWidth * channels;
+            int x = 0;
+#if defined(MIP_SSE2)
+            // one RGBA pixel per register, the pairs of source pixels are always inside the row
+            if(channels == 4)
+            {
+                const __m128 quarter = _mm_set1_ps(0.25f);
+                for(; x < width / 2; ++x)
+                {
+                    __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + 8 * x), _mm_loadu_ps(row0 + 8 * x + 4)),
+                                            _mm_add_ps(_mm_loadu_ps(row1 + 8 * x), _mm_loadu_ps(row1 + 8 * x + 4)));
+                    _mm_storeu_ps(out + 4 * x, _mm_mul_ps(sum, quarter));
+                }
+            }
+#endif
+            for(; x < dstWidth; ++x)
+            {
+                const int x0 = 2 * x * channels;
+                const int x1 = std::min(2 * x + 1, width - 1) * channels;
+                for(int c = 0; c < channels; ++c)
+                    out[x * channels + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+            }
+        }
+    }
+
+    // source pixels and weights of each destination pixel along one axis, taps per pixel
+    // a box over the footprint when shrinking, a tent (bilinear) when growing
+    struct Filter
+    {
+        int taps;
+        std::vector<int> indices;
+        std::vector<float> weights;
+    };
+
+    void makeFilter(int srcSize, int dstSize, Filter& filter)
+    {
+        const float scale = (float)srcSize / dstSize;
+        const float radius = scale > 1.0f ? scale * 0.5f : 1.0f;
+        filter.taps = (int)std::ceil(radius * 2.0f) + 1;
+        filter.indices.assign((size_t)dstSize * filter.taps, 0);
+        filter.weights.assign((size_t)dstSize * filter.taps, 0.0f);
+
+        for(int i = 0; i < dstSize; ++i)
+        {
+            const float center = (i + 0.5f) * scale;        // pixel j covers [j, j + 1)
+            const int first = (int)std::floor(center - radius);
+            int* index = &filter.indices[(size_t)i * filter.taps];
+            float* weight = &filter.weights[(size_t)i * filter.taps];
+            float sum = 0.0f;
+            for(int k = 0; k < filter.taps; ++k)
+            {
+                const int j = first + k;
+                float w;
+                if(scale > 1.0f)
+                    w = std::max(0.0f, std::min((float)j + 1.0f, center + radius) - std::max((float)j, center - radius));
+                else
+                    w = std::max(0.0f, 1.0f - std::fabs(j + 0.5f - center));
+                index[k] = std::min(std::max(j, 0), srcSize - 1);
+                weight[k] = w;
+                sum += w;
+            }
+            for(int k = 0; k < filter.taps; ++k)
+                weight[k] /= sum;
+        }
+    }
+
+    // float level to bytes, back to sRGB for the color channels
+    void encode(const float* src, int width, int height, int channels, unsigned char* dst, bool flip, bool srgb)
+    {
+        const Tables& t = getTables();
+        bool toSrgb[4];
+        for(int c = 0; c < 4; ++c)
+            toSrgb[c] = srgb && !isAlpha(channels, c);
+
+        const int count = width * channels;
+        for(int y = 0; y < height; ++y)
+        {
+            const float* in = src + (size_t)y * count;
+            unsigned char* out = dst + (size_t)(flip ? height - 1 - y : y) * count;
+            int i = 0;
+#if defined(MIP_SSE2)
+            // scale and round 4 values at once, the table lookups stay scalar
+            if(channels == 4)
+            {
+                const __m128 zero = _mm_setzero_ps();
+                const __m128 one = _mm_set1_ps(1.0f);
+                const __m128 scale = _mm_set_ps(255.0f, (float)(LINEAR_STEPS - 1), (float)(LINEAR_STEPS - 1), (float)(LINEAR_STEPS - 1));
+                const __m128 s = srgb ? scale : _mm_set1_ps(255.0f);
+                int index[4];
+                for(; i < count; i += 4)
+                {
+                    __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), zero), one);
+                    _mm_storeu_si128((__m128i*)index, _mm_cvtps_epi32(_mm_mul_ps(v, s)));
+                    out[i]     = srgb ? t.linearToSrgb[index[0]] : (unsigned char)index[0];
+                    out[i + 1] = srgb ? t.linearToSrgb[index[1]] : (unsigned char)index[1];
+                    out[i + 2] = srgb ? t.linearToSrgb[index[2]] : (unsigned char)index[2];
+                    out[i + 3] = (unsigned char)index[3];
+                }
+            }
+#endif
+            for(; i < count; i += channels)
+            {
+                for(int c = 0; c < channels; ++c)
+                {
+                    float v = std::min(std::max(in[i + c], 0.0f), 1.0f);
+                    out[i + c] = toSrgb[c] ? t.linearToSrgb[(int)(v * (LINEAR_STEPS - 1) + 0.5f)] : (unsigned char)(v * 255.0f + 0.5f);
+                }
+            }
+        }
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// chain layout
+///////////////////////////////////////////////////////////////////////////////
+unsigned int MipGenerator::getLevelCount(int width, int height)
+{
+    unsigned int levels = 1;
+    int size = std::max(width, height);
+    while(size > 1)
+    {
+        size >>= 1;
+        ++levels;
+    }
+    return levels;
+}
+
+size_t MipGenerator::getLevelSize(int width, int height, int channels, unsigned int level)
+{
+    return (size_t)getLevelDimension(width, level) * getLevelDimension(height, level) * channels;
+}
+
+size_t MipGenerator::getLevelOffset(int width, int height, int channels, unsigned int level)
+{
+    size_t offset = 0;
+    for(unsigned int i = 0; i < level; ++i)
+        offset += getLevelSize(width, height, channels, i);
+    return offset;
+}
+
+size_t MipGenerator::getChainSize(int width, int height, int channels)
+{
+    return getLevelOffset(width, height, channels, getLevelCount(width, height));
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// build levels 1 and down from the base level
+///////////////////////////////////////////////////////////////////////////////
+void MipGenerator::generate(const unsigned char* image, int width, int height, int channels, unsigned char* dst,
+                            bool flip, bool srgb)
+{
+    const unsigned int levels = getLevelCount(width, height);
+    if(levels < 2)
+        return;
+
+    // two float levels, each downsampled into the other
+    std::vector<float> current(getLevelSize(width, height, channels, 1));
+    std::vector<float> next(getLevelSize(width, height, channels, 2));
+
+    downsampleBytes(image, width, height, channels, current.data(), srgb);
+    for(unsigned int level = 1; level < levels; ++level)
+    {
+        const int w = getLevelDimension(width, level);
+        const int h = getLevelDimension(height, level);
+        encode(current.data(), w, h, channels, dst, flip, srgb);
+        dst += (size_t)w * h * channels;
+
+        if(level + 1 < levels)
+        {
+            downsampleFloats(current.data(), w, h, channels, next.data());
+            current.swap(next);
+        }
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// resample to another size, in linear light, rows then columns
+///////////////////////////////////////////////////////////////////////////////
+void MipGenerator::resize(const unsigned char* image, int width, int height, int channels,
+                          unsigned char* dst, int dstWidth, int dstHeight, bool srgb)
+{
+    const Tables& t = getTables();
+    const float* table[4];
+    for(int c = 0; c < 4; ++c)
+        table[c] = (srgb && !isAlpha(channels, c)) ? t.srgbToLinear : t.byteToFloat;
+
+    Filter horizontal, vertical;
+    makeFilter(width, dstWidth, horizontal);
+    makeFilter(height, dstHeight, vertical);
+
+    // each source row resized to dstWidth, as linear floats
+    std::vector<float> rows((size_t)dstWidth * height * channels);
+    for(int y = 0; y < height; ++y)
+    {
+        const unsigned char* in = image + (size_t)y * width * channels;
+        float* out = &rows[(size_t)y * dstWidth * channels];
+        for(int x = 0; x < dstWidth; ++x)
+        {
+            const int* index = &horizontal.indices[(size_t)x * horizontal.taps];
+            const float* weight = &horizontal.weights[(size_t)x * horizontal.taps];
+            for(int c = 0; c < channels; ++c)
+            {
+                float sum = 0.0f;
+                for(int k = 0; k < horizontal.taps; ++k)
+                    sum += weight[k] * table[c][in[index[k] * channels + c]];
+                out[x * channels + c] = sum;
+            }
+        }
+    }
+
+    std::vector<float> columns((size_t)dstWidth * dstHeight * channels);
+    const size_t rowSize = (size_t)dstWidth * channels;
+    for(int y = 0; y < dstHeight; ++y)
+    {
+        const int* index = &vertical.indices[(size_t)y * vertical.taps];
+        const float* weight = &vertical.weights[(size_t)y * vertical.taps];
+        float* out = &columns[y * rowSize];
+        for(int k = 0; k < vertical.taps; ++k)
+        {
+            const float* in = &rows[index[k] * rowSize];
+            for(size_t i = 0; i < rowSize; ++i)
+                out[i] += weight[k] * in[i];
+        }
+    }
+
+    encode(columns.data(), dstWidth, dstHeight, channels, dst, false, srgb);
+}
@@ -0,0 +1,53 @@
+///////////////////////////////////////////////////////////////////////////////
+// MipGenerator.h
+// ==============
+// Full mipmap chain of an 8-bit image, built on the CPU so it can run on the
+// texture loading threads instead of glGenerateMipmap() on the GL thread.
+//
+// Each level is a 2x2 box filter of the one above it. Color channels are
+// averaged in linear light: sRGB values are converted to linear floats with a
+// table, averaged (4 channels at a time with SSE2) and converted back only
+// when a level is written, so the small levels keep the brightness of the
+// image instead of darkening like a plain average of sRGB bytes. Alpha is
+// always averaged linearly. The levels are kept in float between steps, so
+// rounding errors do not add up down the chain.
+//
+// The levels are packed one after the other with no row padding, largest
+// first, as GL_UNPACK_ALIGNMENT 1 expects.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <cstddef>
+
+namespace MipGenerator
+{
+    // # of levels down to 1x1, including the base level
+    unsigned int getLevelCount(int width, int height);
+
+    // width or height of a level
+    inline int getLevelDimension(int size, unsigned int level) { return (size >> level) > 0 ? (size >> level) : 1; }
+
+    // # of bytes of a level, and of the levels before it (its offset in a packed chain)
+    size_t getLevelSize(int width, int height, int channels, unsigned int level);
+    size_t getLevelOffset(int width, int height, int channels, unsigned int level);
+
+    // # of bytes of the whole chain, base level included
+    size_t getChainSize(int width, int height, int channels);
+
+    // write levels 1 to getLevelCount() - 1 of image to dst, packed
+    // image is the base level, width * height pixels of channels bytes, top row first
+    // flip writes the rows of every level bottom first (the base level is left to the caller)
+    // srgb = false averages the color channels as linear values (e.g. for normal maps)
+    void generate(const unsigned char* image, int width, int height, int channels, unsigned char* dst,
+                  bool flip = false, bool srgb = true);
+
+    // resample image to dstWidth x dstHeight pixels, written to dst, top row first
+    // each destination pixel averages its footprint when shrinking and is bilinear when growing,
+    // in linear light like the mipmaps
+    void resize(const unsigned char* image, int width, int height, int channels,
+                unsigned char* dst, int dstWidth, int dstHeight, bool srgb = true);
+}
+
+#endif
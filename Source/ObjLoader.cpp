@@ -0,0 +1,809 @@
+///////////////////////////////////////////////////////////////////////////////
+// ObjLoader.cpp
+// =============
+// Wavefront OBJ/MTL loader.
+// 1. map the file and split it into line aligned chunks
+// 2. parse the chunks in parallel into per chunk v/vt/vn arrays, triangle
+//    corners and object/material markers
+// 3. concatenate the attribute arrays and resolve relative indices
+// 4. gather the corners of each object/material group and build the groups
+//    in parallel, merging identical index triplets with a hash table
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <climits>
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+
+
+namespace
+{
+    // index of a missing vt/vn; relative indices may be negative
+    const int MISSING = INT_MIN;
+
+    // corner of a triangle, v/t/n are 0 based or MISSING
+    // a relative index is an offset from the first v/vt/vn of its chunk
+    struct Corner
+    {
+        int v, t, n;
+        unsigned char relative;             // bit 0: v, bit 1: t, bit 2: n
+    };
+
+    // o/g or usemtl line, applies to the corners from corner on
+    struct Marker
+    {
+        bool material;                      // true: usemtl, false: o/g
+        std::string name;
+        size_t corner;
+    };
+
+    struct Chunk
+    {
+        const char* begin;
+        const char* end;
+        std::vector<float> positions;
+        std::vector<float> texCoords;
+        std::vector<float> normals;
+        std::vector<Corner> corners;
+        std::vector<Marker> markers;
+        std::vector<std::string> libraries;
+        unsigned int lineCount;
+        unsigned int errorLine;             // 1 based line in the chunk, 0 = no error
+    };
+
+    // corners of a group in one chunk
+    struct Range
+    {
+        unsigned int chunk;
+        size_t begin;
+        size_t end;
+    };
+
+    struct GroupInfo
+    {
+        std::string name;
+        std::string material;
+        std::vector<Range> ranges;
+        size_t cornerCount;
+    };
+
+    typedef std::chrono::high_resolution_clock Clock;
+
+    float elapsed(Clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    }
+
+    bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    const char* skipSpaces(const char* p, const char* end)
+    {
+        while(p < end && isSpace(*p))
+            ++p;
+        return p;
+    }
+
+    // compare a keyword followed by a space
+    bool isKeyword(const char* p, const char* end, const char* keyword)
+    {
+        size_t length = strlen(keyword);
+        return (size_t)(end - p) > length && memcmp(p, keyword, length) == 0 && isSpace(p[length]);
+    }
+
+    // rest of the line without leading/trailing spaces
+    std::string trimmed(const char* p, const char* end)
+    {
+        p = skipSpaces(p, end);
+        while(end > p && isSpace(end[-1]))
+            --end;
+        return std::string(p, end);
+    }
+
+    // file name of a texture map statement, the last token after the options (-bm 1.0, -clamp on, ...)
+    std::string mapName(const char* p, const char* end)
+    {
+        std::string line = trimmed(p, end);
+        size_t space = line.find_last_of(" \t");
+        return space == std::string::npos ? line : line.substr(space + 1);
+    }
+
+    // 10^e, exact for |e| <= 22
+    double powerOf10(int e)
+    {
+        static const double table[] =
+        {
+            1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+        if(e >= 0 && e <= 22)
+            return table[e];
+        return pow(10.0, (double)e);
+    }
+
+    // parse [+-]digits[.digits][(e|E)[+-]digits]
+    // return the position after the number, or p if there is no number
+    const char* parseFloat(const char* p, const char* end, float& value)
+    {
+        const char* start = p;
+        bool negative = false;
+        if(p < end && (*p == '-' || *p == '+'))
+        {
+            negative = (*p == '-');
+            ++p;
+        }
+
+        // up to 18 significant digits are kept, which is more than a float needs
+        unsigned long long mantissa = 0;
+        int exponent = 0;
+        bool digits = false;
+        for(; p < end && (unsigned)(*p - '0') < 10; ++p, digits = true)
+        {
+            if(mantissa < 100000000000000000ull)
+                mantissa = mantissa * 10 + (*p - '0');
+            else
+                ++exponent;
+        }
+        if(p < end && *p == '.')
+        {
+            for(++p; p < end && (unsigned)(*p - '0') < 10; ++p, digits = true)
+            {
+                if(mantissa < 100000000000000000ull)
+                {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    --exponent;
+                }
+            }
+        }
+        if(!digits)
+            return start;
+
+        if(p < end && (*p == 'e' || *p == 'E'))
+        {
+            const char* q = p + 1;
+            bool negativeExponent = false;
+            if(q < end && (*q == '-' || *q == '+'))
+            {
+                negativeExponent = (*q == '-');
+                ++q;
+            }
+            if(q < end && (unsigned)(*q - '0') < 10)
+            {
+                int e = 0;
+                for(; q < end && (unsigned)(*q - '0') < 10; ++q)
+                    if(e < 10000)
+                        e = e * 10 + (*q - '0');
+                exponent += negativeExponent ? -e : e;
+                p = q;
+            }
+        }
+
+        double result = (double)mantissa;
+        if(exponent < 0)
+            result /= powerOf10(-exponent);
+        else if(exponent > 0)
+            result *= powerOf10(exponent);
+        value = (float)(negative ? -result : result);
+        return p;
+    }
+
+    // parse [+-]digits, return p if there is no number or it does not fit an int,
+    // so the line is reported as malformed
+    const char* parseInt(const char* p, const char* end, int& value)
+    {
+        const char* start = p;
+        bool negative = false;
+        if(p < end && (*p == '-' || *p == '+'))
+        {
+            negative = (*p == '-');
+            ++p;
+        }
+        if(p == end || (unsigned)(*p - '0') >= 10)
+            return start;
+
+        int v = 0;
+        for(; p < end && (unsigned)(*p - '0') < 10; ++p)
+        {
+            const int digit = *p - '0';
+            if(v > (INT_MAX - digit) / 10)
+                return start;
+            v = v * 10 + digit;
+        }
+        value = negative ? -v : v;
+        return p;
+    }
+
+    // parse up to count floats, missing values are left as they are
+    // return the # of floats parsed
+    int parseFloats(const char* p, const char* end, float* values, int count)
+    {
+        int parsed = 0;
+        while(parsed < count)
+        {
+            p = skipSpaces(p, end);
+            const char* next = parseFloat(p, end, values[parsed]);
+            if(next == p)
+                break;
+            p = next;
+            ++parsed;
+        }
+        return parsed;
+    }
+
+    // OBJ index (1 based, or negative from the end) to 0 based
+    // negative indices are returned relative to the first element of the chunk
+    bool resolveIndex(int index, size_t localCount, int& out, bool& relative)
+    {
+        if(index > 0)
+        {
+            out = index - 1;
+            relative = false;
+            return true;
+        }
+        if(index < 0)
+        {
+            out = (int)localCount + index;
+            relative = true;
+            return true;
+        }
+        return false;                       // 0 is not a valid index
+    }
+
+    // parse "v", "v/t", "v//n" or "v/t/n"
+    const char* parseCorner(const char* p, const char* end, const Chunk& chunk, Corner& corner, bool& ok)
+    {
+        int index = 0;
+        bool relative = false;
+        corner.t = corner.n = MISSING;
+        corner.relative = 0;
+
+        const char* next = parseInt(p, end, index);
+        ok = (next != p) && resolveIndex(index, chunk.positions.size() / 3, corner.v, relative);
+        if(!ok)
+            return p;
+        corner.relative |= relative ? 1 : 0;
+        p = next;
+
+        if(p < end && *p == '/')
+        {
+            ++p;
+            next = parseInt(p, end, index);
+            if(next != p)
+            {
+                ok = resolveIndex(index, chunk.texCoords.size() / 2, corner.t, relative);
+                corner.relative |= relative ? 2 : 0;
+                p = next;
+            }
+            if(ok && p < end && *p == '/')
+            {
+                ++p;
+                next = parseInt(p, end, index);
+                ok = (next != p) && resolveIndex(index, chunk.normals.size() / 3, corner.n, relative);
+                corner.relative |= relative ? 4 : 0;
+                p = next;
+            }
+        }
+        return p;
+    }
+
+    // parse all lines of a chunk
+    void parseChunk(Chunk& chunk)
+    {
+        std::vector<Corner> polygon;
+        const char* p = chunk.begin;
+        while(p < chunk.end)
+        {
+            const char* lineEnd = (const char*)memchr(p, '\n', chunk.end - p);
+            if(!lineEnd)
+                lineEnd = chunk.end;
+            ++chunk.lineCount;
+
+            const char* s = skipSpaces(p, lineEnd);
+            if(s < lineEnd && s[0] == 'v')
+            {
+                if(isKeyword(s, lineEnd, "v"))
+                {
+                    float v[3] = { 0, 0, 0 };
+                    if(parseFloats(s + 1, lineEnd, v, 3) < 3 && !chunk.errorLine)
+                        chunk.errorLine = chunk.lineCount;
+                    chunk.positions.insert(chunk.positions.end(), v, v + 3);
+                }
+                else if(isKeyword(s, lineEnd, "vt"))
+                {
+                    float t[2] = { 0, 0 };
+                    if(parseFloats(s + 2, lineEnd, t, 2) < 1 && !chunk.errorLine)
+                        chunk.errorLine = chunk.lineCount;
+                    chunk.texCoords.insert(chunk.texCoords.end(), t, t + 2);
+                }
+                else if(isKeyword(s, lineEnd, "vn"))
+                {
+                    float n[3] = { 0, 0, 0 };
+                    if(parseFloats(s + 2, lineEnd, n, 3) < 3 && !chunk.errorLine)
+                        chunk.errorLine = chunk.lineCount;
+                    chunk.normals.insert(chunk.normals.end(), n, n + 3);
+                }
+            }
+            else if(isKeyword(s, lineEnd, "f"))
+            {
+                polygon.clear();
+                const char* q = skipSpaces(s + 1, lineEnd);
+                bool ok = true;
+                while(q < lineEnd && ok)
+                {
+                    Corner corner;
+                    q = parseCorner(q, lineEnd, chunk, corner, ok);
+                    if(ok)
+                        polygon.push_back(corner);
+                    q = skipSpaces(q, lineEnd);
+                }
+
+                if((!ok || polygon.size() < 3) && !chunk.errorLine)
+                    chunk.errorLine = chunk.lineCount;
+
+                // triangle fan
+                for(size_t i = 2; i < polygon.size(); ++i)
+                {
+                    chunk.corners.push_back(polygon[0]);
+                    chunk.corners.push_back(polygon[i - 1]);
+                    chunk.corners.push_back(polygon[i]);
+                }
+            }
+            else if(isKeyword(s, lineEnd, "o") || isKeyword(s, lineEnd, "g"))
+            {
+                Marker marker = { false, trimmed(s + 1, lineEnd), chunk.corners.size() };
+                chunk.markers.push_back(marker);
+            }
+            else if(isKeyword(s, lineEnd, "usemtl"))
+            {
+                Marker marker = { true, trimmed(s + 6, lineEnd), chunk.corners.size() };
+                chunk.markers.push_back(marker);
+            }
+            else if(isKeyword(s, lineEnd, "mtllib"))
+            {
+                chunk.libraries.push_back(trimmed(s + 6, lineEnd));
+            }
+            // comments, smoothing groups, lines, points and free-form geometry are ignored
+
+            p = lineEnd + 1;
+        }
+    }
+
+    // hash of a v/t/n triplet
+    unsigned int hashCorner(int v, int t, int n)
+    {
+        unsigned int h = (unsigned int)v * 73856093u ^ (unsigned int)t * 19349663u ^ (unsigned int)n * 83492791u;
+        h ^= h >> 15;
+        h *= 0x2c1b3c6du;
+        h ^= h >> 12;
+        return h;
+    }
+
+    // gather the corners of a group, merge identical triplets and compute missing normals
+    // return false if an index is out of range
+    bool buildGroup(const GroupInfo& info, const std::vector<Chunk>& chunks,
+                    const std::vector<size_t>& positionOffsets, const std::vector<size_t>& texCoordOffsets,
+                    const std::vector<size_t>& normalOffsets,
+                    const std::vector<float>& positions, const std::vector<float>& texCoords,
+                    const std::vector<float>& normals, ObjLoader::Group& group)
+    {
+        const size_t positionCount = positions.size() / 3;
+        const size_t texCoordCount = texCoords.size() / 2;
+        const size_t normalCount = normals.size() / 3;
+        const unsigned int F = ObjLoader::VERTEX_FLOATS;
+
+        unsigned int tableSize = 1;
+        while(tableSize < info.cornerCount * 2)
+            tableSize <<= 1;
+        const unsigned int mask = tableSize - 1;
+        std::vector<unsigned int> table(tableSize, 0);      // vertex index + 1, 0 = empty
+        std::vector<int> keys;                              // v, t, n of each vertex
+        std::vector<unsigned char> missingNormal;
+
+        keys.reserve(info.cornerCount);
+        group.indices.reserve(info.cornerCount);
+        group.vertices.reserve(info.cornerCount / 2 * F);
+        group.hasTexCoords = false;
+
+        for(size_t r = 0; r < info.ranges.size(); ++r)
+        {
+            const Range& range = info.ranges[r];
+            const Chunk& chunk = chunks[range.chunk];
+            for(size_t c = range.begin; c < range.end; ++c)
+            {
+                const Corner& corner = chunk.corners[c];
+                long long v = corner.v + ((corner.relative & 1) ? (long long)positionOffsets[range.chunk] : 0);
+                long long t = corner.t == MISSING ? -1 : corner.t + ((corner.relative & 2) ? (long long)texCoordOffsets[range.chunk] : 0);
+                long long n = corner.n == MISSING ? -1 : corner.n + ((corner.relative & 4) ? (long long)normalOffsets[range.chunk] : 0);
+                if(v < 0 || v >= (long long)positionCount || t >= (long long)texCoordCount || n >= (long long)normalCount ||
+                   (corner.t != MISSING && t < 0) || (corner.n != MISSING && n < 0))
+                    return false;
+
+                unsigned int slot = hashCorner((int)v, (int)t, (int)n) & mask;
+                unsigned int index;
+                for(;;)
+                {
+                    unsigned int entry = table[slot];
+                    if(entry == 0)
+                    {
+                        // new vertex
+                        index = (unsigned int)(keys.size() / 3);
+                        table[slot] = index + 1;
+                        keys.push_back((int)v);
+                        keys.push_back((int)t);
+                        keys.push_back((int)n);
+
+                        float vertex[8] = { positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2], 0, 0, 0, 0, 0 };
+                        if(n >= 0)
+                        {
+                            vertex[3] = normals[n * 3];
+                            vertex[4] = normals[n * 3 + 1];
+                            vertex[5] = normals[n * 3 + 2];
+                        }
+                        if(t >= 0)
+                        {
+                            vertex[6] = texCoords[t * 2];
+                            vertex[7] = texCoords[t * 2 + 1];
+                            group.hasTexCoords = true;
+                        }
+                        group.vertices.insert(group.vertices.end(), vertex, vertex + F);
+                        missingNormal.push_back(n < 0 ? 1 : 0);
+                        break;
+                    }
+                    const int* key = &keys[(entry - 1) * 3];
+                    if(key[0] == v && key[1] == t && key[2] == n)
+                    {
+                        index = entry - 1;
+                        break;
+                    }
+                    slot = (slot + 1) & mask;
+                }
+                group.indices.push_back(index);
+            }
+        }
+
+        // area weighted face normals for vertices without vn
+        bool anyMissing = false;
+        for(size_t i = 0; i < missingNormal.size() && !anyMissing; ++i)
+            anyMissing = missingNormal[i] != 0;
+        if(anyMissing)
+        {
+            float* vertices = &group.vertices[0];
+            for(size_t i = 0; i + 2 < group.indices.size(); i += 3)
+            {
+                const float* p0 = &vertices[group.indices[i] * F];
+                const float* p1 = &vertices[group.indices[i + 1] * F];
+                const float* p2 = &vertices[group.indices[i + 2] * F];
+                float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+                float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+                float face[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+                for(int k = 0; k < 3; ++k)
+                {
+                    unsigned int index = group.indices[i + k];
+                    if(!missingNormal[index])
+                        continue;
+                    float* normal = &vertices[index * F + 3];
+                    normal[0] += face[0];
+                    normal[1] += face[1];
+                    normal[2] += face[2];
+                }
+            }
+            for(size_t i = 0; i < missingNormal.size(); ++i)
+            {
+                if(!missingNormal[i])
+                    continue;
+                float* normal = &vertices[i * F + 3];
+                float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+                if(length > 0)
+                {
+                    normal[0] /= length;
+                    normal[1] /= length;
+                    normal[2] /= length;
+                }
+            }
+        }
+        return true;
+    }
+
+    // directory of a path including the trailing separator, empty if none
+    std::string getDirectory(const std::string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// load an OBJ file
+///////////////////////////////////////////////////////////////////////////////
+bool ObjLoader::load(const char* path, Scene& scene, unsigned int threadCount)
+{
+    Clock::time_point start = Clock::now();
+
+    scene.groups.clear();
+    scene.materials.clear();
+    memset(&scene.stats, 0, sizeof(Stats));
+
+    MappedFile file;
+    if(!file.open(path))
+    {
+        std::cout << "[ERROR] ObjLoader: cannot open " << path << std::endl;
+        return false;
+    }
+    if(threadCount == 0)
+        threadCount = Parallel::getDefaultThreadCount();
+
+    const char* data = file.getData();
+    const size_t size = file.getSize();
+
+    // 1. line aligned chunks of about 1 MB minimum
+    const size_t MIN_CHUNK_SIZE = 1 << 20;
+    size_t chunkCount = size / MIN_CHUNK_SIZE + 1;
+    if(chunkCount > threadCount)
+        chunkCount = threadCount;
+
+    std::vector<Chunk> chunks(chunkCount);
+    const char* p = data;
+    for(size_t i = 0; i < chunkCount; ++i)
+    {
+        const char* end = (i + 1 == chunkCount) ? data + size : data + size * (i + 1) / chunkCount;
+        if(end < p)
+            end = p;
+        const char* newline = (const char*)memchr(end, '\n', data + size - end);
+        end = (i + 1 == chunkCount || !newline) ? data + size : newline + 1;
+
+        chunks[i].begin = p;
+        chunks[i].end = end;
+        chunks[i].lineCount = 0;
+        chunks[i].errorLine = 0;
+        p = end;
+    }
+
+    // 2. parse
+    Parallel::forEach((unsigned int)chunkCount, threadCount, [&](unsigned int begin, unsigned int end, unsigned int)
+    {
+        for(unsigned int i = begin; i < end; ++i)
+            parseChunk(chunks[i]);
+    }, 1);
+
+    unsigned int lineOffset = 0;
+    for(size_t i = 0; i < chunkCount; ++i)
+    {
+        if(chunks[i].errorLine)
+        {
+            std::cout << "[ERROR] ObjLoader: " << path << ": malformed line " << lineOffset + chunks[i].errorLine << std::endl;
+            return false;
+        }
+        lineOffset += chunks[i].lineCount;
+    }
+
+    // 3. concatenate v/vt/vn; the offsets of each chunk resolve its relative indices
+    std::vector<size_t> positionOffsets(chunkCount + 1, 0);
+    std::vector<size_t> texCoordOffsets(chunkCount + 1, 0);
+    std::vector<size_t> normalOffsets(chunkCount + 1, 0);
+    for(size_t i = 0; i < chunkCount; ++i)
+    {
+        positionOffsets[i + 1] = positionOffsets[i] + chunks[i].positions.size() / 3;
+        texCoordOffsets[i + 1] = texCoordOffsets[i] + chunks[i].texCoords.size() / 2;
+        normalOffsets[i + 1] = normalOffsets[i] + chunks[i].normals.size() / 3;
+    }
+
+    std::vector<float> positions(positionOffsets[chunkCount] * 3);
+    std::vector<float> texCoords(texCoordOffsets[chunkCount] * 2);
+    std::vector<float> normals(normalOffsets[chunkCount] * 3);
+    Parallel::forEach((unsigned int)chunkCount, threadCount, [&](unsigned int begin, unsigned int end, unsigned int)
+    {
+        for(unsigned int i = begin; i < end; ++i)
+        {
+            Chunk& chunk = chunks[i];
+            if(!chunk.positions.empty())
+                memcpy(&positions[positionOffsets[i] * 3], &chunk.positions[0], chunk.positions.size() * sizeof(float));
+            if(!chunk.texCoords.empty())
+                memcpy(&texCoords[texCoordOffsets[i] * 2], &chunk.texCoords[0], chunk.texCoords.size() * sizeof(float));
+            if(!chunk.normals.empty())
+                memcpy(&normals[normalOffsets[i] * 3], &chunk.normals[0], chunk.normals.size() * sizeof(float));
+            std::vector<float>().swap(chunk.positions);
+            std::vector<float>().swap(chunk.texCoords);
+            std::vector<float>().swap(chunk.normals);
+        }
+    }, 1);
+    scene.stats.parseTime = elapsed(start);
+
+    // 4. split the corners into groups by object/group name and material, in file order
+    Clock::time_point buildStart = Clock::now();
+    std::vector<GroupInfo> infos;
+    std::map<std::string, size_t> groupIndices;
+    std::string name, material;
+    for(unsigned int i = 0; i < chunkCount; ++i)
+    {
+        const Chunk& chunk = chunks[i];
+        size_t begin = 0;
+        for(size_t m = 0; m <= chunk.markers.size(); ++m)
+        {
+            size_t end = (m < chunk.markers.size()) ? chunk.markers[m].corner : chunk.corners.size();
+            if(end > begin)
+            {
+                std::string key = name + '\n' + material;
+                std::map<std::string, size_t>::iterator it = groupIndices.find(key);
+                if(it == groupIndices.end())
+                {
+                    it = groupIndices.insert(std::make_pair(key, infos.size())).first;
+                    GroupInfo info;
+                    info.name = name;
+                    info.material = material;
+                    info.cornerCount = 0;
+                    infos.push_back(info);
+                }
+                Range range = { i, begin, end };
+                infos[it->second].ranges.push_back(range);
+                infos[it->second].cornerCount += end - begin;
+            }
+            begin = end;
+
+            if(m < chunk.markers.size())
+            {
+                if(chunk.markers[m].material)
+                    material = chunk.markers[m].name;
+                else
+                    name = chunk.markers[m].name;
+            }
+        }
+    }
+
+    // materials, names are resolved in the order the libraries were declared
+    std::string directory = getDirectory(path);
+    for(size_t i = 0; i < chunkCount; ++i)
+        for(size_t j = 0; j < chunks[i].libraries.size(); ++j)
+            loadMaterials((directory + chunks[i].libraries[j]).c_str(), scene.materials);
+
+    // build the groups, one group per task
+    scene.groups.resize(infos.size());
+    std::vector<unsigned char> valid(infos.size(), 1);
+    Parallel::forEach((unsigned int)infos.size(), threadCount, [&](unsigned int begin, unsigned int end, unsigned int)
+    {
+        for(unsigned int i = begin; i < end; ++i)
+        {
+            Group& group = scene.groups[i];
+            group.name = infos[i].name;
+            group.material = -1;
+            for(size_t m = 0; m < scene.materials.size(); ++m)
+            {
+                if(scene.materials[m].name == infos[i].material)
+                {
+                    group.material = (int)m;
+                    break;
+                }
+            }
+            valid[i] = buildGroup(infos[i], chunks, positionOffsets, texCoordOffsets, normalOffsets,
+                                  positions, texCoords, normals, group) ? 1 : 0;
+        }
+    }, 1);
+
+    for(size_t i = 0; i < valid.size(); ++i)
+    {
+        if(!valid[i])
+        {
+            std::cout << "[ERROR] ObjLoader: " << path << ": index out of range in group \"" << infos[i].name << "\"" << std::endl;
+            scene.groups.clear();
+            return false;
+        }
+    }
+
+    Stats& stats = scene.stats;
+    stats.fileSize = size;
+    stats.positionCount = (unsigned int)(positions.size() / 3);
+    stats.texCoordCount = (unsigned int)(texCoords.size() / 2);
+    stats.normalCount = (unsigned int)(normals.size() / 3);
+    for(size_t i = 0; i < scene.groups.size(); ++i)
+    {
+        stats.triangleCount += (unsigned int)(scene.groups[i].indices.size() / 3);
+        stats.vertexCount += (unsigned int)(scene.groups[i].vertices.size() / VERTEX_FLOATS);
+    }
+    stats.threadCount = (unsigned int)chunkCount;
+    stats.buildTime = elapsed(buildStart);
+    stats.totalTime = elapsed(start);
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// append the materials of an MTL file
+///////////////////////////////////////////////////////////////////////////////
+bool ObjLoader::loadMaterials(const char* path, std::vector<Material>& materials)
+{
+    MappedFile file;
+    if(!file.open(path))
+    {
+        std::cout << "[WARNING] ObjLoader: cannot open material library " << path << std::endl;
+        return false;
+    }
+
+    Material* material = 0;
+    const char* p = file.getData();
+    const char* end = p + file.getSize();
+    while(p < end)
+    {
+        const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+        if(!lineEnd)
+            lineEnd = end;
+        const char* s = skipSpaces(p, lineEnd);
+        p = lineEnd + 1;
+
+        if(isKeyword(s, lineEnd, "newmtl"))
+        {
+            Material m;
+            m.name = trimmed(s + 6, lineEnd);
+            for(int i = 0; i < 3; ++i)
+            {
+                m.ambient[i] = 0.0f;
+                m.diffuse[i] = 1.0f;
+                m.specular[i] = 0.0f;
+            }
+            m.shininess = 1.0f;
+            materials.push_back(m);
+            material = &materials.back();
+            continue;
+        }
+        if(!material)
+            continue;
+
+        if(isKeyword(s, lineEnd, "Ka"))
+            parseFloats(s + 2, lineEnd, material->ambient, 3);
+        else if(isKeyword(s, lineEnd, "Kd"))
+            parseFloats(s + 2, lineEnd, material->diffuse, 3);
+        else if(isKeyword(s, lineEnd, "Ks"))
+            parseFloats(s + 2, lineEnd, material->specular, 3);
+        else if(isKeyword(s, lineEnd, "Ns"))
+            parseFloats(s + 2, lineEnd, &material->shininess, 1);
+        else if(isKeyword(s, lineEnd, "map_Kd"))
+            material->diffuseMap = mapName(s + 6, lineEnd);
+        else if(isKeyword(s, lineEnd, "map_Ks"))
+            material->specularMap = mapName(s + 6, lineEnd);
+        else if(isKeyword(s, lineEnd, "map_Bump") || isKeyword(s, lineEnd, "map_bump"))
+            material->normalMap = mapName(s + 8, lineEnd);
+        else if(isKeyword(s, lineEnd, "bump") || isKeyword(s, lineEnd, "norm") || isKeyword(s, lineEnd, "disp"))
+        {
+            std::string map = mapName(s + 4, lineEnd);
+            if(s[0] == 'd')
+                material->heightMap = map;
+            else
+                material->normalMap = map;
+        }
+    }
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// print counts, timings and throughput
+///////////////////////////////////////////////////////////////////////////////
+void ObjLoader::printStats(const char* path, const Stats& stats)
+{
+    float megabytes = stats.fileSize / (1024.0f * 1024.0f);
+    std::cout << "===== ObjLoader: " << (path ? path : "") << " =====\n"
+              << std::fixed << std::setprecision(2)
+              << "     File Size: " << megabytes << " MB\n"
+              << "     Positions: " << stats.positionCount << "\n"
+              << "    Tex Coords: " << stats.texCoordCount << "\n"
+              << "       Normals: " << stats.normalCount << "\n"
+              << "Triangle Count: " << stats.triangleCount << "\n"
+              << "  Vertex Count: " << stats.vertexCount << " (deduplicated)\n"
+              << "    Parse Time: " << stats.parseTime << " ms (" << stats.threadCount << " threads)\n"
+              << "    Build Time: " << stats.buildTime << " ms\n"
+              << "    Total Time: " << stats.totalTime << " ms ("
+              << (stats.totalTime > 0 ? megabytes * 1000.0f / stats.totalTime : 0.0f) << " MB/s)" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+// ObjLoader.h
+// ===========
+// Wavefront OBJ/MTL loader.
+// The file is memory mapped and split into line aligned chunks, one per
+// thread, which are parsed in parallel with a locale independent float
+// parser (no iostreams). Relative (negative) indices are resolved after all
+// chunks are parsed, using the # of v/vt/vn of the preceding chunks.
+//
+// Faces are triangulated as fans and grouped by object/group name and
+// material; each group gets its own vertex buffer in which identical
+// position/texcoord/normal index triplets are merged. Groups are built in
+// parallel. Missing normals are computed (area weighted), missing texture
+// coordinates are set to 0.
+//
+// See model.h for building Mesh objects from the result.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <string>
+#include <vector>
+
+namespace ObjLoader
+{
+    // floats per vertex of Group::vertices: position(3), normal(3), texCoord(2)
+    const unsigned int VERTEX_FLOATS = 8;
+
+    struct Material
+    {
+        std::string name;
+        float ambient[3];               // Ka
+        float diffuse[3];               // Kd
+        float specular[3];              // Ks
+        float shininess;                // Ns
+        std::string diffuseMap;         // map_Kd
+        std::string specularMap;        // map_Ks
+        std::string normalMap;          // map_Bump, bump, norm
+        std::string heightMap;          // disp
+    };
+
+    struct Group
+    {
+        std::string name;               // o/g name, empty if none
+        int material;                   // index in Scene::materials, -1 if none
+        bool hasTexCoords;
+        std::vector<float> vertices;    // VERTEX_FLOATS per vertex
+        std::vector<unsigned int> indices;
+    };
+
+    struct Stats
+    {
+        size_t fileSize;                // bytes
+        unsigned int positionCount;     // # of v
+        unsigned int texCoordCount;     // # of vt
+        unsigned int normalCount;       // # of vn
+        unsigned int triangleCount;
+        unsigned int vertexCount;       // # of unique vertices of all groups
+        unsigned int threadCount;
+        float parseTime;                // ms, chunked parsing and index resolution
+        float buildTime;                // ms, grouping, deduplication and normals
+        float totalTime;                // ms, including mapping and materials
+    };
+
+    struct Scene
+    {
+        std::vector<Group> groups;
+        std::vector<Material> materials;
+        Stats stats;
+    };
+
+    // load an OBJ file and the MTL files it references
+    // threadCount: 0 = # of hardware threads
+    // return false if the file cannot be opened or is malformed
+    bool load(const char* path, Scene& scene, unsigned int threadCount = 0);
+
+    // append the materials of an MTL file
+    bool loadMaterials(const char* path, std::vector<Material>& materials);
+
+    // print counts, timings and throughput
+    void printStats(const char* path, const Stats& stats);
+}
+
+#endif
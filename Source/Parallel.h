@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////////////////////////
+// Parallel.h
+// ==========
+// Minimal fork/join helper for data parallel loops over [0, count).
+// The range is split into one contiguous block per thread; the calling
+// thread runs the first block and waits for the others.
+//
+// usage:
+//     Parallel::forEach(vertexCount, 0, [&](unsigned int begin, unsigned int end, unsigned int thread) {
+//         for(unsigned int i = begin; i < end; ++i) ...
+//     });
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+
+namespace Parallel
+{
+    // # of threads to use when the caller passes 0
+    inline unsigned int getDefaultThreadCount()
+    {
+        unsigned int count = std::thread::hardware_concurrency();
+        return count ? count : 1;
+    }
+
+    // # of blocks forEach() splits count items into
+    // small ranges run on the calling thread only, threads are not free
+    inline unsigned int getBlockCount(unsigned int count, unsigned int threadCount, unsigned int minBlockSize = 4096)
+    {
+        if(threadCount == 0)
+            threadCount = getDefaultThreadCount();
+        unsigned int blocks = (count + minBlockSize - 1) / minBlockSize;
+        if(blocks > threadCount)
+            blocks = threadCount;
+        return blocks ? blocks : 1;
+    }
+
+    // call func(begin, end, block) for each block of [0, count)
+    template <typename Func>
+    void forEach(unsigned int count, unsigned int threadCount, Func func, unsigned int minBlockSize = 4096)
+    {
+        unsigned int blocks = getBlockCount(count, threadCount, minBlockSize);
+        unsigned int blockSize = (count + blocks - 1) / blocks;
+
+        std::vector<std::thread> threads;
+        threads.reserve(blocks - 1);
+        for(unsigned int b = 1; b < blocks; ++b)
+        {
+            unsigned int begin = b * blockSize < count ? b * blockSize : count;
+            unsigned int end = begin + blockSize < count ? begin + blockSize : count;
+            threads.push_back(std::thread(func, begin, end, b));
+        }
+
+        func(0u, blockSize < count ? blockSize : count, 0u);
+
+        for(size_t i = 0; i < threads.size(); ++i)
+            threads[i].join();
+    }
+}
+
+#endif
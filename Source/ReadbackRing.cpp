@@ -0,0 +1,253 @@
+///////////////////////////////////////////////////////////////////////////////
+// ReadbackRing.cpp
+// ================
+// Asynchronous framebuffer readback through a ring of pixel pack buffers.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include "ReadbackRing.h"
+
+
+
+namespace
+{
+    const GLuint64 FENCE_TIMEOUT = 1000000000;      // 1s in ns
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor/dtor
+///////////////////////////////////////////////////////////////////////////////
+ReadbackRing::ReadbackRing() : next(0), persistent(false), lostCount(0), closed(false)
+{
+}
+
+ReadbackRing::~ReadbackRing()
+{
+    destroy();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// the GPU writes a slot while the consumers read the older ones, mapped for
+// good with buffer storage
+///////////////////////////////////////////////////////////////////////////////
+void ReadbackRing::create(size_t bufferSize, unsigned int slotCount)
+{
+    destroy();
+
+    slots.resize(std::max(slotCount, 2u));
+    for(size_t i = 0; i < slots.size(); ++i)
+    {
+        Slot& slot = slots[i];
+        slot.fence = 0;
+        slot.mapped = 0;
+        slot.size = 0;
+        slot.tag = 0;
+        slot.state = FREE;
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        if(GLEW_ARB_buffer_storage)
+        {
+            const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_PACK_BUFFER, bufferSize, 0, flags);
+            slot.mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bufferSize, flags);
+        }
+        else
+        {
+            glBufferData(GL_PIXEL_PACK_BUFFER, bufferSize, 0, GL_STREAM_READ);
+        }
+        if(!slot.mapped)
+            slot.copy.resize(bufferSize);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    persistent = slots[0].mapped != 0;
+
+    next = 0;
+    lostCount = 0;
+    closed = false;
+}
+
+void ReadbackRing::destroy()
+{
+    for(size_t i = 0; i < slots.size(); ++i)
+    {
+        if(slots[i].fence)
+            glDeleteSync(slots[i].fence);
+        if(slots[i].mapped)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].buffer);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glDeleteBuffers(1, &slots[i].buffer);
+    }
+    if(!slots.empty())
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slots.clear();
+    reading.clear();
+    queue.clear();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// slots are used in turn, so the slot whose turn it is holds the oldest
+// readback; the lost ones are skipped
+///////////////////////////////////////////////////////////////////////////////
+int ReadbackRing::getFreeSlot(bool wait)
+{
+    for(unsigned int lost = 0; lost < slots.size(); )
+    {
+        handOver(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        Slot& slot = slots[next];
+        if(slot.state == LOST)
+        {
+            next = (next + 1) % (unsigned int)slots.size();
+            ++lost;
+            continue;
+        }
+        if(slot.state == FREE)
+            return (int)next;
+        if(!wait)
+            return -1;
+        if(slot.state == QUEUED)
+        {
+            freeCondition.wait(lock, [&slot] { return slot.state == FREE; });
+            return (int)next;
+        }
+        lock.unlock();
+        handOver(1);                        // its readback is still in flight
+    }
+    return -1;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// issue the readback and its fence, the pixels are handed over by poll()
+///////////////////////////////////////////////////////////////////////////////
+void ReadbackRing::read(unsigned int index, unsigned int tag, int width, int height, GLenum format)
+{
+    Slot& slot = slots[index];
+    slot.size = (size_t)width * height * (format == GL_RGB ? 3 : 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, format, GL_UNSIGNED_BYTE, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.tag = tag;
+    slot.state = READING;
+    reading.push_back(index);
+    next = (index + 1) % (unsigned int)slots.size();
+}
+
+void ReadbackRing::poll(bool wait)
+{
+    handOver(wait ? reading.size() : 0);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// hand over the readbacks whose fence is signaled, in order, blocking for
+// the oldest waitCount of them
+///////////////////////////////////////////////////////////////////////////////
+void ReadbackRing::handOver(size_t waitCount)
+{
+    bool queued = false;
+    while(!reading.empty())
+    {
+        Slot& slot = slots[reading.front()];
+        const bool wait = waitCount > 0;
+        GLenum result = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? FENCE_TIMEOUT : 0);
+        if(result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+        {
+            if(!wait)
+                break;
+            // the slot leaves the ring, the GPU could still write it under a later readback
+            std::cout << "[ERROR] ReadbackRing: readback " << slot.tag << " timed out" << std::endl;
+            glDeleteSync(slot.fence);
+            slot.fence = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                slot.state = LOST;
+            }
+            ++lostCount;
+            reading.pop_front();
+            --waitCount;
+            continue;
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+
+        // without a persistent mapping, the pixels are copied out for the consumers
+        if(!slot.mapped)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.size, GL_MAP_READ_BIT);
+            if(pixels)
+                memcpy(slot.copy.data(), pixels, slot.size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot.state = QUEUED;
+            queue.push_back(reading.front());
+        }
+        reading.pop_front();
+        queued = true;
+        if(waitCount)
+            --waitCount;
+    }
+    if(queued)
+        queueCondition.notify_all();
+}
+
+void ReadbackRing::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    queueCondition.notify_all();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// consumer side, a slot taken is the consumer's until it is released, the
+// GL thread does not touch it
+///////////////////////////////////////////////////////////////////////////////
+bool ReadbackRing::take(unsigned int& index)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    queueCondition.wait(lock, [this] { return closed || !queue.empty(); });
+    if(queue.empty())
+        return false;
+    index = queue.front();
+    queue.pop_front();
+    return true;
+}
+
+void ReadbackRing::release(unsigned int index)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        slots[index].state = FREE;
+    }
+    freeCondition.notify_one();
+}
+
+const unsigned char* ReadbackRing::getPixels(unsigned int index) const
+{
+    const Slot& slot = slots[index];
+    return slot.mapped ? slot.mapped : slot.copy.data();
+}
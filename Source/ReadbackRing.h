@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////////////////////////
+// ReadbackRing.h
+// ==============
+// Ring of pixel pack buffers (PBO) that reads the framebuffer back without
+// stalling the GL thread, shared by FrameCapture and BatchRenderer.
+//
+// The GL thread takes the next free slot, issues glReadPixels() into it and
+// a fence, and keeps drawing; poll() hands the slots whose fence is signaled
+// to the consumer threads, oldest first. A consumer take()s a slot, uses its
+// pixels and release()s it, then the slot is free for the GL thread again.
+//
+// With buffer storage the buffers are persistently mapped and the consumers
+// read the pixels in place; without it, poll() maps each buffer on the GL
+// thread and copies it out for them.
+//
+// A readback whose fence is still not signaled after a second of waiting is
+// lost: its slot is never handed over nor reused (the GPU could still write
+// it), and getLostCount() counts it.
+//
+// usage:
+//     ring.create(width * height * 4, 3);
+//     // GL thread, each frame
+//     int slot = ring.getFreeSlot(false);     // -1: every slot is in use
+//     if(slot >= 0)
+//         ring.read(slot, frame, width, height, GL_RGBA);
+//     ring.poll(false);
+//     // consumer thread
+//     unsigned int slot;
+//     while(ring.take(slot)) { use(ring.getPixels(slot)); ring.release(slot); }
+//     // GL thread, at the end
+//     ring.poll(true);
+//     ring.close();                           // take() returns false once the slots handed over are taken
+//     consumer.join();
+//     ring.destroy();
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef READBACK_RING_H
+#define READBACK_RING_H
+
+#include <GL/glew.h>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+class ReadbackRing
+{
+public:
+    ReadbackRing();
+    ~ReadbackRing();
+
+    // slotCount buffers (at least 2) of bufferSize bytes, on the GL thread
+    void create(size_t bufferSize, unsigned int slotCount);
+    // release the buffers, on the GL thread once the consumers are joined
+    void destroy();
+
+    // GL thread only
+    // the slot whose turn it is, -1 if it is still read or used, or every slot is lost
+    // wait = true blocks until the GPU and its consumer are done with it instead
+    int getFreeSlot(bool wait);
+    // read width x height pixels of the read framebuffer into a slot of getFreeSlot(), rows
+    // packed without padding, format is GL_RGB or GL_RGBA; tag is for the consumer (frame, view)
+    void read(unsigned int slot, unsigned int tag, int width, int height, GLenum format);
+    // hand the readbacks whose fence is signaled to the consumers, in the order they were read
+    // wait = true blocks until every readback in flight is done (or lost)
+    void poll(bool wait);
+    // no more readbacks, the consumers stop once they took every slot handed over
+    void close();
+
+    // consumer threads
+    // the oldest slot handed over, blocks until there is one, false once closed and drained
+    bool take(unsigned int& slot);
+    // give the slot back to the GL thread once its pixels are used
+    void release(unsigned int slot);
+    const unsigned char* getPixels(unsigned int slot) const;
+    unsigned int getTag(unsigned int slot) const    { return slots[slot].tag; }
+
+    bool isPersistent() const               { return persistent; }
+    unsigned int getSlotCount() const       { return (unsigned int)slots.size(); }
+    // readbacks that timed out since create(), GL thread only
+    unsigned int getLostCount() const       { return lostCount; }
+
+private:
+    enum SlotState
+    {
+        FREE,                               // the GL thread can read into it
+        READING,                            // readback issued, waiting for its fence
+        QUEUED,                             // handed over, owned by the consumers until released
+        LOST                                // its readback timed out, never reused
+    };
+
+    struct Slot
+    {
+        GLuint buffer;
+        GLsync fence;
+        unsigned char* mapped;              // persistent mapping, 0 without buffer storage
+        std::vector<unsigned char> copy;    // the pixels copied out of the buffer without it
+        size_t size;                        // bytes of the last readback
+        unsigned int tag;
+        SlotState state;                    // guarded by mutex
+    };
+
+    // not copyable, owns GL objects
+    ReadbackRing(const ReadbackRing&);
+    ReadbackRing& operator=(const ReadbackRing&);
+
+    void handOver(size_t waitCount);
+
+    // GL thread only, except the slot states and the pixels of the slots handed over
+    std::vector<Slot> slots;
+    std::deque<unsigned int> reading;       // slots with a readback in flight, oldest first
+    unsigned int next;                      // slot whose turn it is
+    bool persistent;                        // the slots are mapped for good
+    unsigned int lostCount;
+
+    // GL thread to consumers
+    std::mutex mutex;
+    std::condition_variable queueCondition; // a slot was handed over, or closed
+    std::condition_variable freeCondition;  // a slot was released
+    std::deque<unsigned int> queue;         // slots handed over and not taken yet
+    bool closed;
+};
+
+#endif
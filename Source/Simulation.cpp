@@ -0,0 +1,400 @@
+///////////////////////////////////////////////////////////////////////////////
+// Simulation.cpp
+// ==============
+// Camera and scene animation stepped at a fixed rate on their own thread.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <cmath>
+#include <GLFW/glfw3.h>
+#include "Simulation.h"
+
+
+
+namespace
+{
+    const float LAMP_SPEED = 0.5f;                  // radians per second
+    const float TWO_PI = 6.28318530718f;
+    // a stall longer than this many steps (debugger, window dragged) skips them instead of running them all
+    const unsigned int MAX_CATCH_UP = 25;
+    // a wake up this close to the step runs it, waiting again for less than a timer tick would spin
+    const std::chrono::microseconds WAKE_SLACK(250);
+
+    // bits of Simulation::keys
+    const unsigned char KEY_HELD = 1;
+    const unsigned char KEY_PRESSED = 2;            // since the last step, so a tap moves at least one step
+
+    // movement key to Camera_Movement, -1 if the key does not move the camera
+    int getMovement(int key)
+    {
+        switch(key)
+        {
+        case GLFW_KEY_W:    return FORWARD;
+        case GLFW_KEY_S:    return BACKWARD;
+        case GLFW_KEY_A:    return LEFT;
+        case GLFW_KEY_D:    return RIGHT;
+        case GLFW_KEY_Q:    return UP;
+        case GLFW_KEY_E:    return DOWN;
+        default:            return -1;
+        }
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor/dtor
+///////////////////////////////////////////////////////////////////////////////
+Simulation::Simulation() : stopping(false), stepTime(1.0f / 120.0f), events(1024), postedCount(0), droppedCount(0),
+                           latching(false), latchFirst(0), latchFirstCursor(true), latchX(0), latchY(0),
+                           lampOrbiting(false), lampAngle(0), firstCursor(true), lastX(0), lastY(0), eventCount(0),
+                           stepCount(0), lateCount(0), resyncCount(0)
+{
+    for(int i = 0; i < 6; ++i)
+        keys[i] = 0;
+    previous = getCurrentState();
+}
+
+Simulation::~Simulation()
+{
+    stop();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// the thread starts from the render thread's camera, both buffers of the
+// snapshot hold it until the first step is published
+///////////////////////////////////////////////////////////////////////////////
+void Simulation::start(const Camera& camera, bool lampOrbiting, float stepRate)
+{
+    if(isRunning())
+        return;
+
+    this->camera = camera;
+    this->lampOrbiting = lampOrbiting;
+    lampAngle = 0;
+    for(int i = 0; i < 6; ++i)
+        keys[i] = 0;
+    firstCursor = true;
+    inputTime = Clock::time_point();
+    eventCount = 0;
+    stepTime = 1.0f / (stepRate > 0 ? stepRate : 120.0f);
+    stepCount = 0;
+    lateCount = 0;
+    resyncCount = 0;
+    postedCount = 0;
+    droppedCount = 0;
+    latchEvents.clear();
+    latchFirst = 0;
+    latchFirstCursor = true;
+
+    previous = getCurrentState();
+    Snapshot snapshot = { previous, previous, 0 };
+    snapshots.reset(snapshot);
+
+    stopping = false;
+    startTime = Clock::now();
+    thread = std::thread(&Simulation::threadLoop, this);
+}
+
+void Simulation::stop()
+{
+    if(!isRunning())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wakeCondition.notify_one();
+    thread.join();
+
+    // the thread is gone, the GL thread may empty the queue
+    Event event;
+    while(events.pop(event))
+        ;
+    latchEvents.clear();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// GLFW events, queued for the next step
+///////////////////////////////////////////////////////////////////////////////
+void Simulation::postKey(int key, int action)
+{
+    const Event event = { KEY, key, action, 0, 0, Clock::now() };
+    post(event);
+}
+
+void Simulation::postCursor(double x, double y)
+{
+    const Event event = { CURSOR, 0, 0, x, y, Clock::now() };
+    post(event);
+}
+
+void Simulation::postScroll(double offset)
+{
+    const Event event = { SCROLL, 0, 0, 0, offset, Clock::now() };
+    post(event);
+}
+
+void Simulation::post(const Event& event)
+{
+    ++postedCount;
+    if(!events.push(event))
+        ++droppedCount;
+    else if(latching)
+        latchEvents.push_back(event);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// newest snapshot, the clock gives how far into the next step we are:
+// step N is published about N steps after the start, so the time since then
+// over the step time goes from 0 to 1 until step N + 1 replaces it
+///////////////////////////////////////////////////////////////////////////////
+Simulation::State Simulation::getState()
+{
+    snapshots.update();
+    const Snapshot& snapshot = snapshots.getReadBuffer();
+
+    const double now = std::chrono::duration<double>(Clock::now() - startTime).count();
+    float alpha = static_cast<float>((now - snapshot.step * (double)stepTime) / stepTime);
+    if(alpha < 0)
+        alpha = 0;
+    if(alpha > 1)
+        alpha = 1;                              // the simulation is late, hold the newest state
+
+    State state;
+    state.position = snapshot.previous.position + (snapshot.current.position - snapshot.previous.position) * alpha;
+    state.yaw = snapshot.previous.yaw + (snapshot.current.yaw - snapshot.previous.yaw) * alpha;
+    state.pitch = snapshot.previous.pitch + (snapshot.current.pitch - snapshot.previous.pitch) * alpha;
+    state.speed = snapshot.current.speed;
+    state.lampAngle = snapshot.previous.lampAngle + (snapshot.current.lampAngle - snapshot.previous.lampAngle) * alpha;
+    state.inputTime = alpha > 0 ? snapshot.current.inputTime : snapshot.previous.inputTime;
+    state.eventCount = alpha > 0 ? snapshot.current.eventCount : snapshot.previous.eventCount;
+    return state;
+}
+
+Simulation::State Simulation::getLatestState()
+{
+    snapshots.update();
+    return snapshots.getReadBuffer().current;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// the events are handled in the order they were posted, so the first
+// eventCount posted are in the state; the others are replayed on a copy of
+// its camera the way advance() will: events first, then a step for each
+// movement key pressed, held keys only move at the step itself
+///////////////////////////////////////////////////////////////////////////////
+Simulation::State Simulation::getLatchedState()
+{
+    State state = getLatestState();
+    size_t handled = 0;
+    while(handled < latchEvents.size() && latchFirst < state.eventCount)
+    {
+        // the next cursor delta starts where the handled events left the cursor
+        const Event& event = latchEvents[handled];
+        if(event.type == CURSOR)
+        {
+            latchX = event.x;
+            latchY = event.y;
+            latchFirstCursor = false;
+        }
+        ++handled;
+        ++latchFirst;
+    }
+    // the vector keeps its capacity, no allocation per event
+    latchEvents.erase(latchEvents.begin(), latchEvents.begin() + handled);
+    if(latchEvents.empty())
+        return state;
+
+    Camera latched(state.position, glm::vec3(0.0f, 1.0f, 0.0f), state.yaw, state.pitch);
+    latched.MovementSpeed = state.speed;
+    bool cursorFirst = latchFirstCursor;
+    double x = latchX;
+    double y = latchY;
+    bool pressed[6] = { false, false, false, false, false, false };
+    for(size_t i = 0; i < latchEvents.size(); ++i)
+    {
+        const Event& event = latchEvents[i];
+        state.inputTime = event.time;
+        if(event.type == CURSOR)
+            turn(latched, event, cursorFirst, x, y);
+        else if(event.type == SCROLL)
+            latched.ProcessMouseScroll(static_cast<float>(event.y));
+        else if(event.action == GLFW_PRESS && getMovement(event.key) >= 0)
+            pressed[getMovement(event.key)] = true;
+    }
+    for(int i = 0; i < 6; ++i)
+        if(pressed[i])
+            latched.ProcessKeyboard(static_cast<Camera_Movement>(i), stepTime);
+
+    state.position = latched.Position;
+    state.yaw = latched.Yaw;
+    state.pitch = latched.Pitch;
+    state.speed = latched.MovementSpeed;
+    state.eventCount += latchEvents.size();
+    return state;
+}
+
+void Simulation::setLatching(bool enabled)
+{
+    // only the events posted from now on are kept, the earlier ones are counted as handled
+    latching = enabled;
+    latchEvents.clear();
+    latchFirst = postedCount - droppedCount;
+    latchFirstCursor = true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// wake once per step, a timed wait that stop() cuts short; after a late wake
+// up the missed steps run back to back so the simulated time keeps up with
+// the clock
+///////////////////////////////////////////////////////////////////////////////
+void Simulation::threadLoop()
+{
+    const Clock::duration step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(stepTime));
+    Clock::time_point next = startTime + step;      // end of the first step
+    while(!stopping.load())
+    {
+        Clock::time_point now = Clock::now();
+        if(now + WAKE_SLACK < next)
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wakeCondition.wait_until(lock, next, [this] { return stopping.load(); });
+            continue;
+        }
+
+        // too far behind: drop the missed steps, the state stays where it was
+        const unsigned long long behind = now > next ? (unsigned long long)((now - next) / step) : 0;
+        if(behind > MAX_CATCH_UP)
+        {
+            stepCount += behind;
+            next += step * behind;
+            ++resyncCount;
+        }
+
+        advance();
+        ++stepCount;
+        Snapshot& snapshot = snapshots.getWriteBuffer();
+        snapshot.previous = previous;
+        snapshot.current = getCurrentState();
+        snapshot.step = stepCount;
+        snapshots.publish();
+
+        next += step;
+        if(Clock::now() >= next)
+            ++lateCount;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// one step: the events since the last step, then the held keys and the
+// animations move by the step time
+///////////////////////////////////////////////////////////////////////////////
+void Simulation::advance()
+{
+    previous = getCurrentState();
+
+    Event event;
+    while(events.pop(event))
+    {
+        handle(event);
+        ++eventCount;
+    }
+
+    for(int i = 0; i < 6; ++i)
+    {
+        if(keys[i])
+            camera.ProcessKeyboard(static_cast<Camera_Movement>(i), stepTime);
+        keys[i] &= KEY_HELD;
+    }
+
+    if(lampOrbiting)
+    {
+        lampAngle += LAMP_SPEED * stepTime;
+        // wrap both states, so the interpolation between them does not turn backwards
+        if(lampAngle > TWO_PI)
+        {
+            lampAngle -= TWO_PI;
+            previous.lampAngle -= TWO_PI;
+        }
+    }
+}
+
+void Simulation::handle(const Event& event)
+{
+    inputTime = event.time;
+    if(event.type == KEY)
+    {
+        const int movement = getMovement(event.key);
+        if(movement >= 0)
+        {
+            if(event.action == GLFW_PRESS)
+                keys[movement] = KEY_HELD | KEY_PRESSED;
+            else if(event.action == GLFW_RELEASE)
+                keys[movement] &= ~KEY_HELD;
+        }
+        // L starts and stops the lamps
+        if(event.key == GLFW_KEY_L && event.action == GLFW_PRESS)
+            lampOrbiting = !lampOrbiting;
+    }
+    else if(event.type == CURSOR)
+    {
+        turn(camera, event, firstCursor, lastX, lastY);
+    }
+    else if(event.type == SCROLL)
+    {
+        camera.ProcessMouseScroll(static_cast<float>(event.y));
+    }
+}
+
+// the cursor moved from its last position, the first position only sets it
+void Simulation::turn(Camera& camera, const Event& event, bool& firstCursor, double& lastX, double& lastY)
+{
+    if(firstCursor)
+    {
+        lastX = event.x;
+        lastY = event.y;
+        firstCursor = false;
+    }
+    // y reversed since y-coordinates go from bottom to top
+    camera.ProcessMouseMovement(static_cast<float>(event.x - lastX), static_cast<float>(lastY - event.y));
+    lastX = event.x;
+    lastY = event.y;
+}
+
+Simulation::State Simulation::getCurrentState() const
+{
+    State state;
+    state.position = camera.Position;
+    state.yaw = camera.Yaw;
+    state.pitch = camera.Pitch;
+    state.speed = camera.MovementSpeed;
+    state.lampAngle = lampAngle;
+    state.inputTime = inputTime;
+    state.eventCount = eventCount;
+    return state;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// call once stopped
+///////////////////////////////////////////////////////////////////////////////
+void Simulation::printStats() const
+{
+    std::cout << "===== Simulation: " << static_cast<int>(1.0f / stepTime + 0.5f) << " steps per second =====\n"
+              << "  " << stepCount << " steps, " << lateCount << " late, " << resyncCount << " resyncs\n"
+              << "  " << postedCount << " input events, " << droppedCount << " dropped" << std::endl;
+}
@@ -0,0 +1,177 @@
+///////////////////////////////////////////////////////////////////////////////
+// Simulation.h
+// ============
+// Camera and scene animation stepped at a fixed rate on their own thread, so
+// a slow frame neither delays input nor changes how far a key press moves
+// the camera.
+//
+// The GLFW callbacks run on the GL thread (glfwPollEvents() must be called
+// there); postKey(), postCursor() and postScroll() copy the events into a
+// lock-free single-producer single-consumer queue. The simulation thread
+// wakes every step, drains the queue, keeps the movement keys held down,
+// moves its own Camera by exactly one step and advances the lamp orbit,
+// then publishes the previous and the new state through a triple buffer.
+//
+// getState() on the render thread takes the newest snapshot without waiting
+// and interpolates between its two states by how far the clock is into the
+// step, so the camera moves smoothly at any frame rate, one step (8 ms at
+// 120 Hz) behind the input.
+//
+// getLatchedState() is for events polled right before the draws: the
+// simulation only takes them at its next step, so the GL thread keeps the
+// events it posted until a state has handled them and replays the others on
+// the newest state as the next step will (cursor turns, scroll speed, a step
+// for each movement key pressed). Held keys still move the camera in steps.
+// The events are only kept once setLatching(true) is called.
+//
+// usage:
+//     simulation.start(camera, lampOrbiting);
+//     simulation.setLatching(lowLatency);                    // getLatchedState() is used
+//     // key, cursor and scroll callbacks
+//     simulation.postKey(key, action);
+//     // each frame
+//     Simulation::State state = simulation.getState();       // or glfwPollEvents(); getLatchedState();
+//     camera = Camera(state.position, glm::vec3(0, 1, 0), state.yaw, state.pitch);
+//     ...
+//     simulation.stop();
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <GL/glew.h>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include "camera.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
+
+class Simulation
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // what the render thread draws
+    struct State
+    {
+        glm::vec3 position;             // camera
+        float yaw;
+        float pitch;
+        float speed;                    // camera movement speed, scrolling changes it
+        float lampAngle;                // radians the ceiling lights turned around the middle one
+        Clock::time_point inputTime;    // when the newest event the state includes was posted
+        unsigned long long eventCount;  // # of events handled, in the order they were posted
+    };
+
+    Simulation();
+    ~Simulation();
+
+    // copy the camera and start stepping it, call on the GL thread
+    // stepRate is the # of steps per second
+    void start(const Camera& camera, bool lampOrbiting, float stepRate = 120.0f);
+    // stop the thread, queued events are dropped
+    void stop();
+    bool isRunning() const              { return thread.joinable(); }
+
+    // GLFW events, called on the GL thread only (the queue has a single producer)
+    // action is GLFW_PRESS, GLFW_REPEAT or GLFW_RELEASE
+    void postKey(int key, int action);
+    void postCursor(double x, double y);
+    void postScroll(double offset);
+
+    // state interpolated for now between the last two steps, render thread only
+    State getState();
+    // newest step as is, one step less behind the input than getState() but moving in steps
+    State getLatestState();
+    // newest step with the events posted since replayed on it, GL thread only
+    State getLatchedState();
+    // keep the events posted for getLatchedState(), off by default, GL thread only
+    void setLatching(bool enabled);
+
+    float getStepTime() const           { return stepTime; }
+
+    // print steps, late steps and events
+    void printStats() const;
+
+private:
+    enum EventType
+    {
+        KEY,
+        CURSOR,
+        SCROLL
+    };
+
+    // a GLFW event, x and y are the cursor position or the scroll offset
+    struct Event
+    {
+        EventType type;
+        int key;
+        int action;
+        double x;
+        double y;
+        Clock::time_point time;         // posted
+    };
+
+    // the two last steps, published together so the reader can interpolate
+    struct Snapshot
+    {
+        State previous;
+        State current;
+        unsigned long long step;        // # of current, it ends at step * stepTime after the start
+    };
+
+    // not copyable, owns a thread
+    Simulation(const Simulation&);
+    Simulation& operator=(const Simulation&);
+
+    void post(const Event& event);
+    void threadLoop();
+    void handle(const Event& event);
+    static void turn(Camera& camera, const Event& event, bool& firstCursor, double& lastX, double& lastY);
+    void advance();
+    State getCurrentState() const;
+
+    std::thread thread;
+    std::atomic<bool> stopping;
+    std::mutex wakeMutex;               // the thread waits for its next step on wakeCondition, stop() wakes it
+    std::condition_variable wakeCondition;
+    Clock::time_point startTime;
+    float stepTime;                     // seconds
+
+    // GL thread to simulation thread
+    SpscQueue<Event> events;
+    unsigned int postedCount;           // written by the GL thread only
+    unsigned int droppedCount;          // queue full
+
+    // GL thread only, the queued events kept for getLatchedState()
+    bool latching;
+    std::vector<Event> latchEvents;     // not handled by the newest state the GL thread has seen
+    unsigned long long latchFirst;      // # of the first of latchEvents
+    bool latchFirstCursor;              // the cursor where the handled events left it
+    double latchX;
+    double latchY;
+
+    // simulation thread only
+    Camera camera;
+    bool lampOrbiting;
+    float lampAngle;
+    unsigned char keys[6];              // held and pressed bits, by Camera_Movement
+    bool firstCursor;
+    double lastX;
+    double lastY;
+    Clock::time_point inputTime;        // of the newest event handled
+    unsigned long long eventCount;      // events handled
+    State previous;
+    unsigned long long stepCount;
+    unsigned int lateCount;             // steps run back to back because the thread woke up late
+    unsigned int resyncCount;           // times the clock was too far ahead and steps were skipped
+
+    // simulation thread to render thread
+    TripleBuffer<Snapshot> snapshots;
+};
+
+#endif
@@ -31,11 +31,48 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "Cylinder.h"
+#include "TransformSystem.h"
+#include "MeshOptimizer.h"
+#include "IndexBuffer.h"
+#include "VertexWelder.h"
+#include "TangentGenerator.h"
+#include "MeshCache.h"
+#include "MeshCacheConverter.h"
+#include "Bmp.h"
+#include "ImageKernels.h"
+#include "TextureStreamer.h"
+#include "TextureManager.h"
+#include "TextureConverter.h"
+#include "TextureArrayPacker.h"
+#include "MaterialTable.h"
+#include "Ktx2.h"
+#include "GpuTimer.h"
+#include "FrameCapture.h"
+#include "BatchRenderer.h"
+#include "CommandList.h"
+#include "JobSystem.h"
+#include "Simulation.h"
+#include "CameraUniforms.h"
+#include "FramePacer.h"
+#include "Parallel.h"
+#include "TaskGraph.h"
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cctype>
 using namespace std; // Standard namespace
 
 /*Shader program Macro*/
 #ifndef GLSL
 #define GLSL(Version, Source) "#version " #Version " core \n" #Source
+// Same, for a shader that requires an extension
+#define GLSL_EXTENSION(Version, Extension, Source) "#version " #Version " core \n#extension " #Extension " : require \n" #Source
 #endif
 
 // Unnamed namespace
@@ -46,14 +83,21 @@ namespace
     // Variables for window width and height
     const int WINDOW_WIDTH = 800;
     const int WINDOW_HEIGHT = 600;
-    Cylinder cylinder1(0.1, 0.1, 3, 6, 8, false);
-    Cylinder cylinder2(1.0, 1.0, 1.0, 100, 1, false);
-    Cylinder cylinder3(0.7, 0.7, 2.6, 82, 22, false);
+    // Aspect ratio of the projections, the window's or the batch view's being rendered
+    float gAspectRatio = (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT;
+    // Cylinder parameters, a Cylinder is only built when its mesh is missing from the mesh cache
+    struct CylinderDesc
+    {
+        float baseRadius, topRadius, height;
+        int sectorCount, stackCount;
+        bool smooth;
+    };
+    const CylinderDesc cylinder1 = { 0.1f, 0.1f, 3.0f, 6, 8, false };
+    const CylinderDesc cylinder2 = { 1.0f, 1.0f, 1.0f, 100, 1, false };
+    const CylinderDesc cylinder3 = { 0.7f, 0.7f, 2.6f, 82, 22, false };
     // Declares a camera wit specific x,y,z position
+    // The render thread's copy, set from the simulation each frame
     Camera camera(glm::vec3(0.0f, 5.0f, 8.0f));
-    float lastX = WINDOW_WIDTH / 2.0f;
-    float lastY = WINDOW_HEIGHT / 2.0f;
-    bool firstMouse = true;
 
     // timing
     float deltaTime = 0.0f;	// time between current frame and last frame
@@ -65,13 +109,13 @@ namespace
         GLuint vao;         // Handle for the vertex array object
         GLuint vbos[2];     // Handles for the vertex buffer objects
         GLuint nIndices;    // Number of indices of the mesh
+        GLenum indexType;   // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, chosen from the vertex count
     };
 
     // Main GLFW window
     GLFWwindow* gWindow = nullptr;
     // Triangle mesh data
     GLMesh gMesh, tblMesh, lidMesh, cylMesh, screenMesh, pencilMesh, lightMesh, podMesh, canMesh;
-    unsigned int texture, texture2, baseTexture, lidTexture, screenTexture, desktopTexture, pencilTexture;
 
     glm::vec2 gUVScale(5.0f, 5.0f);
     // camerad
@@ -100,8 +144,139 @@ namespace
     glm::vec3 gLightPosition2(-1.5f, 0.5f, -3.0f);
     glm::vec3 gLightScale(0.3f);
 
-    // Lamp animation
-    bool gIsLampOrbiting = true;
+    // Lamp animation, off so the lights start where the scene places them; L toggles it on the simulation thread
+    bool gIsLampOrbiting = false;
+    // Ceiling lights share the same size, height and depth, only the x position differs;
+    // when orbiting, they turn around the first one
+    const float LIGHT_X[3] = { -2.0f, -8.0f, 4.0f };
+    const float LIGHT_Y = 7.0f;
+    const float LIGHT_Z = -4.0f;
+    // Camera and lamps stepped at a fixed rate on their own thread, fed by the GLFW callbacks
+    Simulation gSimulation;
+    float gAppliedLampAngle = 0.0f;     // of the light transforms
+    // View and projection of every program, written once per view
+    CameraUniforms gCameraUniforms;
+    // Frame limit, frames in flight and input latency; --low-latency polls the input and latches the camera
+    // right before the draws, and keeps a single frame in flight
+    FramePacer gFramePacer;
+
+    // Model and normal matrices of every object in the scene
+    TransformSystem gTransforms;
+    unsigned int gBaseTransform, gLidTransform, gTableTransform, gScreenTransform;
+    unsigned int gPencilTransform, gPodTransform, gCanTransform;
+    unsigned int gLightTransforms[3];
+
+    // Welded and optimized cylinder meshes, read back with mmap on the next run
+    const char* const MESH_CACHE_PATH = "assets/scene.meshcache";
+    // Bump when the mesh build steps (weld, optimize) change, so cached meshes are rebuilt
+    const unsigned int MESH_BUILD_VERSION = 1;
+    MeshCache::Reader gMeshCache;
+    MeshCache::Writer gMeshCacheWriter;     // rebuilt meshes, written back at the end of startup
+    std::mutex gMeshCacheMutex;             // the cylinders are built in parallel and share the writer
+    std::mutex gLogMutex;                   // keeps the stats printed by the build tasks from interleaving
+
+    // Where the GL phase finds a cylinder mesh built by the CPU phase: the mapped cache file or the writer
+    struct MeshSource
+    {
+        const MeshCache::MeshEntry* cached; // in gMeshCache, or null
+        int rebuilt;                        // index in gMeshCacheWriter, or -1
+    };
+
+    // Decodes and uploads the textures in the background, so the first frame is not delayed by them
+    TextureStreamer gTextureStreamer;
+    // Shares the textures by file and sampler, unused ones are deleted when over the budget
+    const size_t TEXTURE_BUDGET = 128 * 1024 * 1024;
+    TextureManager gTextures(gTextureStreamer, TEXTURE_BUDGET);
+    // declared after gTextures, so they are released before it is destroyed
+    TextureManager::Handle texture, texture2, baseTexture, lidTexture, screenTexture, desktopTexture, pencilTexture;
+    // Every texture of the scene and whether it is flipped, compressed to .ktx2 by --convert-textures
+    struct SceneTexture
+    {
+        const char* path;
+        bool flip;
+    };
+    const SceneTexture SCENE_TEXTURES[] =
+    {
+        { "assets/textures/base.png", true },
+        { "assets/textures/lid.png", true },
+        { "assets/textures/marble.jpg", false },
+        { "assets/textures/desktop.png", false },
+        { "assets/textures/screen.png", false },
+        { "assets/textures/light.png", false },
+        { "assets/textures/yellow.png", false },
+    };
+    // How the objects get their textures, T switches between the modes to compare
+    enum TextureMode
+    {
+        TEXTURE_BINDLESS,                           // resident handles in the material table, no texture binding at all
+        TEXTURE_ARRAYS,                             // one array for every object, a layer per draw
+        TEXTURE_BINDING                             // a 2D texture bound per object
+    };
+    const char* TEXTURE_MODE_NAMES[] = { "bindless", "texture arrays", "2D textures" };
+    TextureMode gTextureMode = TEXTURE_ARRAYS;      // bindless when supported, chosen at startup
+    TextureMode gDrawTextureMode = TEXTURE_ARRAYS;  // of the current frame: 2D textures until the bindless handles are made
+    // The 2D textures and their materials are only loaded once a mode draws with them (and the arrays only
+    // built once the arrays mode is drawn), so each file is decoded and resident once unless T goes to both
+    struct TextureLoad
+    {
+        TextureManager::Handle* texture;
+        unsigned int* material;
+        const char* path;
+        TextureManager::Sampler sampler;
+    };
+    std::vector<TextureLoad> gTextureLoads;
+    bool gTexturesLoaded = false;
+    // The same textures packed in array layers: every object samples one array with its own layer
+    TextureArrayPacker gTextureArrays(gTextureStreamer);
+    unsigned int textureLayer, texture2Layer, baseLayer, lidLayer, screenLayer, desktopLayer, pencilLayer;
+    GLuint gTrilinearSampler = 0;
+    GLuint gBoundArrays[2] = { 0, 0 };              // on units 2 and 3, for ourTexture and uExtraTexture
+    GLint gDrawLayers[2] = { 0, 0 };                // per draw layer of each, sticky like a texture binding
+    GLfloat gDrawLayerScales[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    // And as bindless handles, a material of one texture per object and a row per sampler; the
+    // program of this mode replaces gProgramId while it is used
+    MaterialTable gMaterials;
+    unsigned int textureMaterial, texture2Material, baseMaterial, lidMaterial, screenMaterial, desktopMaterial, pencilMaterial;
+    unsigned int gTrilinearMaterials, gBaseLevelMaterials;
+    GLuint gClassicProgramId = 0;
+    GLuint gBindlessProgramId = 0;
+    GLuint gDrawMaterials[2] = { 0, 0 };            // per draw row of ourTexture and uExtraTexture
+    // Trilinear + anisotropic sampling of the mipmapped textures, M switches to the base level only to compare
+    bool gTrilinear = true;
+    GLuint gBaseLevelSampler = 0;
+    // GPU time of each frame, averaged and printed with the CPU frame time
+    GpuTimer gFrameTimer;
+    // Screenshots (F12) and video capture (C or --capture), read back a few frames late
+    FrameCapture gFrameCapture;
+    const unsigned int CAPTURE_FPS = 60;
+
+    // Uniform locations of the program, looked up on the GL thread for the draws recorded by other threads
+    struct DrawLocations
+    {
+        GLint model, normalMatrix;
+        GLint materials, layers, layerScales;
+    };
+    // The sticky per draw texture uniforms (gDrawMaterials, gDrawLayers, gDrawLayerScales) of a command list
+    struct DrawTextureState
+    {
+        GLuint materials[2];
+        GLint layers[2];
+        GLfloat layerScales[4];
+    };
+    // An object of the command list benchmark: a mesh and texture of the scene, spinning on a grid
+    struct BenchmarkObject
+    {
+        const GLMesh* mesh;
+        const TextureManager::Handle* texture;
+        unsigned int layer;
+        unsigned int material;
+        float position[3] = { 0.0f, 0.0f, 0.0f };
+        float angle = 0.0f;                         // radians around y at time 0
+        float scale = 1.0f;
+    };
+    const unsigned int BENCHMARK_OBJECT_COUNT = 50000;
+    // Runs the per-frame CPU stages (transform updates, command recording) on every core
+    JobSystem gJobs;
 }
 
 
@@ -114,9 +289,15 @@ namespace
 bool UInitialize(int, char* [], GLFWwindow** window);
 void UResizeWindow(GLFWwindow* window, int width, int height);
 void UProcessInput(GLFWwindow* window);
+void UApplySimulation();
+void ULatchCamera();
+void USetCameraUniforms();
 void UCreateMesh(GLMesh& mesh);
 void UDestroyMesh(GLMesh& mesh);
 void URender();
+void URenderScene();
+void UBeginScene();
+bool UBatchRender(const char* path, unsigned int threadCount, bool benchmark);
 void CreateLaptopBase(GLMesh& gMesh);
 void RenderLaptopBase();
 void CreateLaptopLid(GLMesh& lidMesh);
@@ -126,15 +307,42 @@ void RenderLaptopScreen();
 void CreateTable(GLMesh& tblMesh);
 void RenderTable();
 void CreateLight(GLMesh& lightMesh);
-void RenderLight(float pos);
-void CreatePencil(GLMesh& cylMesh);
+void RenderLight(unsigned int transformId);
+void BuildPencil(MeshSource& source);
+void CreatePencil(GLMesh& cylMesh, const MeshSource& source);
 void RenderPencil();
-void CreatePods(GLMesh& podMesh);
+void BuildPods(MeshSource& source);
+void CreatePods(GLMesh& podMesh, const MeshSource& source);
 void RenderPods();
-void CreateCan(GLMesh& canMesh);
+void BuildCan(MeshSource& source);
+void CreateCan(GLMesh& canMesh, const MeshSource& source);
 void RenderCan();
+void UCreateTransforms();
+void UOptimizeMesh(const char* name, GLuint* indices, unsigned int indexCount, GLfloat* verts, unsigned int floatsPerVertex, unsigned int vertexCount);
+void UUploadIndices(GLMesh& mesh, const GLuint* indices, unsigned int indexCount, unsigned int vertexCount);
+void UWeldMesh(const char* name, std::vector<GLfloat>& verts, std::vector<GLuint>& indices, unsigned int floatsPerVertex);
+Cylinder UBuildCylinder(const CylinderDesc& desc);
+uint64_t UCylinderKey(const CylinderDesc& desc, unsigned int floatsPerVertex);
+MeshCache::VertexFormat UVertexFormat(unsigned int floatsPerVertex, unsigned int floatsPerTexture);
+bool UFindCachedMesh(MeshSource& source, const char* name, uint64_t key);
+void UAddMeshToCache(MeshSource& source, const char* name, uint64_t key, const MeshCache::VertexFormat& format,
+                     const std::vector<GLfloat>& verts, const std::vector<GLuint>& indices);
+void UCreateMeshFromSource(GLMesh& mesh, const MeshSource& source);
+void UUploadCachedMesh(GLMesh& mesh, const MeshCache::MeshEntry& entry, const void* vertices, const void* indices);
+void USaveMeshCache();
 bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
 void UDestroyShaderProgram(GLuint programId);
+unsigned int UAddMaterial(const TextureManager::Handle& texture);
+void UAddTexture(TextureManager::Handle& texture, unsigned int& material, const char* path, const TextureManager::Sampler& sampler);
+void ULoadTextures(TextureMode mode);
+void UBindTexture(GLuint unit, const TextureManager::Handle& texture, unsigned int layer, unsigned int material);
+void UStartCapture(const char* path, unsigned int frameLimit);
+void URecordTexture(CommandList& list, GLuint unit, const TextureManager::Handle& texture, unsigned int layer, unsigned int material,
+                    const DrawLocations& locations, DrawTextureState& state);
+void UBenchmarkMatrices(const BenchmarkObject& object, float time, glm::mat4& model, glm::mat3& normalMatrix);
+void URenderBenchmarkObject(const BenchmarkObject& object, float time);
+void URecordBenchmarkObject(CommandList& list, const BenchmarkObject& object, float time, const DrawLocations& locations, DrawTextureState& state);
+void UBenchmarkCommandLists(unsigned int objectCount);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn);
 //**Callback functions added to handle keyboard events
@@ -156,14 +364,18 @@ out vec4 vertexColors;
 out vec4 vertexColor;
 //Global variables for the  transform matrices
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140, binding = 0) uniform CameraBlock // written once per view, see CameraUniforms.h
+{
+    mat4 view;
+    mat4 projection;
+};
+uniform mat3 normalMatrix; // transpose(inverse(mat3(model))), precomputed on the CPU
 void main()
 {
     gl_Position = projection * view * model * vec4(position, 1.0f); // transforms vertices to clip coordinates
     vertexFragmentPos = vec3(model * vec4(position, 1.0f)); // Gets fragment / pixel position in world space only (exclude view and projection)
     vertexColors = color;
-    vertexNormal = mat3(transpose(inverse(model))) * normal; // get normal vectors in world space only and exclude normal translation properties
+    vertexNormal = normalMatrix * normal; // get normal vectors in world space only and exclude normal translation properties
     TexCoord = aTexCoord;
 }
 );
@@ -186,6 +398,18 @@ uniform sampler2D ourTexture;
 uniform sampler2D uExtraTexture;
 uniform bool multipleTextures;
 uniform vec2 uvScale;
+// the same two textures as layers of array textures (units 2 and 3)
+uniform bool uUseTextureArrays;
+uniform sampler2DArray uTextureArray;
+uniform sampler2DArray uExtraTextureArray;
+uniform ivec2 uLayers;
+uniform vec4 uLayerScales; // part of each layer the image covers, xy and zw
+
+// fract() keeps repeated coords in the image of a padded layer, the gradients of uv keep the mip level smooth
+vec4 sampleLayer(sampler2DArray textureArray, int layer, vec2 scale, vec2 uv)
+{
+    return textureGrad(textureArray, vec3(fract(uv) * scale, layer), dFdx(uv) * scale, dFdy(uv) * scale);
+}
 
 void main()
 {
@@ -216,7 +440,38 @@ void main()
 
     // Calculate phong result
     vec3 phong = (ambient + diffuse + specular) * textureColor.xyz;
-    fragmentColor = mix(texture(ourTexture, TexCoord), texture(uExtraTexture, TexCoord), 1.0);
+    vec4 baseColor = uUseTextureArrays ? sampleLayer(uTextureArray, uLayers.x, uLayerScales.xy, TexCoord) : texture(ourTexture, TexCoord);
+    vec4 extraColor = uUseTextureArrays ? sampleLayer(uExtraTextureArray, uLayers.y, uLayerScales.zw, TexCoord) : texture(uExtraTexture, TexCoord);
+    fragmentColor = mix(baseColor, extraColor, 1.0);
+    fragmentColors = vertexColors;
+}
+);
+
+
+/* Fragment Shader Source Code of the bindless mode, the textures are handles in the material table*/
+const GLchar* bindlessFragmentShaderSource = GLSL_EXTENSION(440, GL_ARB_bindless_texture,
+    out vec4 fragmentColor;
+out vec4 fragmentColors;
+in vec4 vertexColors;
+in vec2 TexCoord;
+
+// one handle per row (MaterialTable with one texture per material), 0 for none
+layout(std430, binding = 0) readonly buffer Materials
+{
+    uvec2 textureHandles[];
+};
+uniform uvec2 uMaterials; // rows of ourTexture and uExtraTexture
+
+// the row is the same for the whole draw, as the extension requires
+vec4 sampleMaterial(uint row, vec2 uv)
+{
+    uvec2 handle = textureHandles[row];
+    return handle == uvec2(0u) ? vec4(0.5) : texture(sampler2D(handle), uv);
+}
+
+void main()
+{
+    fragmentColor = mix(sampleMaterial(uMaterials.x, TexCoord), sampleMaterial(uMaterials.y, TexCoord), 1.0);
     fragmentColors = vertexColors;
 }
 );
@@ -253,40 +508,200 @@ void main()
 // Images are loaded with Y axis going down, but OpenGL's Y axis goes up, so let's flip it
 void flipImageVertically(unsigned char* image, int width, int height, int channels)
 {
-    for (int j = 0; j < height / 2; ++j)
-    {
-        int index1 = j * width * channels;
-        int index2 = (height - 1 - j) * width * channels;
+    ImageKernels::flipVertical(image, width, height, channels);
+}
+
 
-        for (int i = width * channels; i > 0; --i)
+int main(int argc, char* argv[])
+{
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    // Times tangent generation at 1M triangles and exits
+    if (argc > 1 && std::string(argv[1]) == "--benchmark-tangents")
+    {
+        TangentGenerator::benchmark(1000000);
+        return EXIT_SUCCESS;
+    }
+    // Times the SIMD transform update of 100k dirty entries against scalar code and glm and exits
+    if (argc > 1 && std::string(argv[1]) == "--benchmark-transforms")
+    {
+        TransformSystem::benchmark(100000);
+        return EXIT_SUCCESS;
+    }
+    // Converts an OBJ/glTF file to a mesh cache and exits
+    if (argc > 3 && std::string(argv[1]) == "--convert-mesh")
+        return MeshCacheConverter::convert(argv[2], argv[3]) ? EXIT_SUCCESS : EXIT_FAILURE;
+    // Compresses an image to a BCn .ktx2 texture and exits
+    if (argc > 3 && std::string(argv[1]) == "--convert-texture")
+    {
+        bool flip = false, bc7 = false;
+        for (int i = 4; i < argc; ++i)
         {
-            unsigned char tmp = image[index1];
-            image[index1] = image[index2];
-            image[index2] = tmp;
-            ++index1;
-            ++index2;
+            flip = flip || std::string(argv[i]) == "--flip";
+            bc7 = bc7 || std::string(argv[i]) == "--bc7";
         }
+        return TextureConverter::convert(argv[2], argv[3], flip, bc7) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Compresses every scene texture next to its image, where the texture streamer looks for it, and exits
+    if (argc > 1 && std::string(argv[1]) == "--convert-textures")
+    {
+        bool bc7 = argc > 2 && std::string(argv[2]) == "--bc7";
+        bool converted = true;
+        for (size_t i = 0; i < sizeof(SCENE_TEXTURES) / sizeof(SCENE_TEXTURES[0]); ++i)
+        {
+            const SceneTexture& t = SCENE_TEXTURES[i];
+            converted = TextureConverter::convert(t.path, Ktx2::getCompressedPath(t.path).c_str(), t.flip, bc7) && converted;
+        }
+        return converted ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Checks the SIMD image kernels against the scalar ones, times them and exits
+    if (argc > 1 && std::string(argv[1]) == "--benchmark-image-kernels")
+    {
+        ImageKernels::benchmark();
+        return EXIT_SUCCESS;
+    }
+    // Times the stream and mapped BMP reads of 8K images and exits
+    if (argc > 1 && std::string(argv[1]) == "--benchmark-bmp")
+    {
+        Image::Bmp::benchmark();
+        return EXIT_SUCCESS;
+    }
+    // Times job spawning against threads and the scaling of a parallel loop up to 64 threads
+    if (argc > 1 && std::string(argv[1]) == "--benchmark-jobs")
+    {
+        JobSystem::benchmark();
+        return EXIT_SUCCESS;
+    }
+    // Times cold and warm loads of a mesh cache and exits
+    if (argc > 2 && std::string(argv[1]) == "--benchmark-mesh-cache")
+    {
+        MeshCache::benchmark(argv[2]);
+        return EXIT_SUCCESS;
     }
-}
 
+    // Records every frame from the first one to a .y4m/.rgba video or numbered .bmp files
+    const char* capturePath = nullptr;
+    // Renders the views of a file offscreen to Bmp files (or times it with 1, 2, 4... encoder threads) and exits
+    const char* batchPath = nullptr;
+    bool benchmarkBatch = false;
+    unsigned int batchThreads = 0;
+    // Times the draws of a 50k object scene prepared inline on the GL thread against recorded by worker threads and exits
+    unsigned int benchmarkObjects = 0;
+    if (argc > 1 && std::string(argv[1]) == "--benchmark-command-lists")
+        benchmarkObjects = argc > 2 ? static_cast<unsigned int>(std::atoi(argv[2])) : BENCHMARK_OBJECT_COUNT;
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--capture")
+            capturePath = argv[i + 1];
+        if (arg == "--batch-render" || arg == "--benchmark-batch")
+        {
+            batchPath = argv[i + 1];
+            benchmarkBatch = arg == "--benchmark-batch";
+        }
+        if (arg == "--threads")
+            batchThreads = static_cast<unsigned int>(std::atoi(argv[i + 1]));
+    }
+    // Polls the input and latches the camera right before the draws, one frame in flight, frames limited to
+    // the given rate or the monitor's refresh rate
+    bool lowLatency = false;
+    float frameLimit = 0.0f;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--low-latency")
+        {
+            lowLatency = true;
+            if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+                frameLimit = static_cast<float>(std::atof(argv[i + 1]));
+        }
+    }
 
-int main(int argc, char* argv[])
-{
     if (!UInitialize(argc, argv, &gWindow))
         return EXIT_FAILURE;
-  
-    //Functions to create meshes for objects
-    CreateLaptopBase(gMesh);
-    CreateLaptopLid(lidMesh);
-    CreateTable(tblMesh);
-    CreateLaptopScreen(screenMesh);
-    CreateLight(lightMesh);
-    CreatePencil(cylMesh);
-    CreatePods(podMesh);
-    CreateCan(canMesh);
-    // Create the shader program
-    if (!UCreateShaderProgram(vertexShaderSource, fragmentShaderSource, gProgramId))
+    gTextureStreamer.start();
+    gJobs.start();
+
+    // Startup runs as a task graph: the CPU work (mesh cache lookup, cylinder builds, transforms, cache write)
+    // runs on worker threads while the main thread, which owns the GL context, creates the GL objects.
+    // The texture files are decoded by the texture streamer's own workers from the moment they are queued.
+    TaskGraph startup;
+    MeshSource pencilSource, podSource, canSource;
+    bool shaderCreated = false;
+    const TaskGraph::Affinity GL = TaskGraph::MAIN_THREAD;
+
+    // The cylinder meshes come from the mesh cache when it is up to date
+    unsigned int openCache = startup.add("Open mesh cache", [] { gMeshCache.open(MESH_CACHE_PATH); });
+    unsigned int buildPencil = startup.add("Build pencil", [&] { BuildPencil(pencilSource); }, { openCache });
+    unsigned int buildPods = startup.add("Build headphone case", [&] { BuildPods(podSource); }, { openCache });
+    unsigned int buildCan = startup.add("Build soda can", [&] { BuildCan(canSource); }, { openCache });
+    // Place each object in the scene
+    startup.add("Create transforms", UCreateTransforms);
+
+    // GL objects, queued in order so the box meshes are created while the cylinders build
+    startup.add("Create shader", [&] { shaderCreated = UCreateShaderProgram(vertexShaderSource, fragmentShaderSource, gProgramId); }, {}, GL);
+    startup.add("Create laptop base", [] { CreateLaptopBase(gMesh); }, {}, GL);
+    startup.add("Create laptop lid", [] { CreateLaptopLid(lidMesh); }, {}, GL);
+    startup.add("Create table", [] { CreateTable(tblMesh); }, {}, GL);
+    startup.add("Create laptop screen", [] { CreateLaptopScreen(screenMesh); }, {}, GL);
+    startup.add("Create light", [] { CreateLight(lightMesh); }, {}, GL);
+    unsigned int createPencil = startup.add("Create pencil", [&] { CreatePencil(cylMesh, pencilSource); }, { buildPencil }, GL);
+    unsigned int createPods = startup.add("Create headphone case", [&] { CreatePods(podMesh, podSource); }, { buildPods }, GL);
+    unsigned int createCan = startup.add("Create soda can", [&] { CreateCan(canMesh, canSource); }, { buildCan }, GL);
+
+    // the mapped cache file is closed once every cylinder is uploaded from it
+    startup.add("Save mesh cache", [] {
+        std::cout << "Cylinder meshes: " << (gMeshCacheWriter.getMeshCount() ? "rebuilt" : "loaded from " + std::string(MESH_CACHE_PATH)) << std::endl;
+        USaveMeshCache();
+    }, { createPencil, createPods, createCan });
+
+    startup.run();
+    if (!shaderCreated)
         return EXIT_FAILURE;
+    // GL_LINEAR minification only reads level 0 of the mipmapped textures
+    gBaseLevelSampler = gTextures.getSamplerObject(TextureManager::Sampler());
+    // The arrays are sampled from units 2 and 3
+    gTrilinearSampler = gTextures.getSamplerObject(TextureManager::Sampler::trilinear());
+    glUseProgram(gProgramId);
+    glUniform1i(glGetUniformLocation(gProgramId, "uTextureArray"), 2);
+    glUniform1i(glGetUniformLocation(gProgramId, "uExtraTextureArray"), 3);
+    // Bindless textures when the GPU has them, the handles are made once every texture is uploaded
+    gClassicProgramId = gProgramId;
+    gTrilinearMaterials = gMaterials.addSampler(gTrilinearSampler);
+    gBaseLevelMaterials = gMaterials.addSampler(gBaseLevelSampler);
+    if (MaterialTable::isSupported() && UCreateShaderProgram(vertexShaderSource, bindlessFragmentShaderSource, gBindlessProgramId))
+        gTextureMode = TEXTURE_BINDLESS;
+    std::cout << "Textures: " << TEXTURE_MODE_NAMES[gTextureMode]
+              << (gTextureMode == TEXTURE_BINDLESS ? "" : " (no ARB_bindless_texture)") << std::endl;
+    ULoadTextures(gTextureMode);
+    gFrameTimer.create();
+    gCameraUniforms.create();
+    gFramePacer.create();
+    if (lowLatency)
+    {
+        const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+        gFramePacer.setLowLatency(true);
+        gFramePacer.setFrameLimit(frameLimit > 0.0f ? frameLimit : (mode && mode->refreshRate > 0 ? static_cast<float>(mode->refreshRate) : 60.0f));
+    }
+    if (capturePath)
+        UStartCapture(capturePath, 0);
+    // the batch replaces the render loop, then everything is released as usual
+    int exitCode = EXIT_SUCCESS;
+    if (batchPath)
+    {
+        exitCode = UBatchRender(batchPath, batchThreads, benchmarkBatch) ? EXIT_SUCCESS : EXIT_FAILURE;
+        glfwSetWindowShouldClose(gWindow, true);
+    }
+    if (benchmarkObjects)
+    {
+        UBenchmarkCommandLists(benchmarkObjects);
+        glfwSetWindowShouldClose(gWindow, true);
+    }
+    // the batch and the benchmark place the camera themselves
+    if (!glfwWindowShouldClose(gWindow))
+    {
+        gSimulation.setLatching(lowLatency);
+        gSimulation.start(camera, gIsLampOrbiting);
+    }
    /* if (!UCreateShaderProgram(lampVertexShaderSource, lampFragmentShaderSource, gKeyProgramId))
         return EXIT_FAILURE;
 
@@ -294,23 +709,86 @@ int main(int argc, char* argv[])
         return EXIT_FAILURE;*/
     // Sets the background color of the window to black (it will be implicitely used by glClear)
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    cylinder3.printSelf();
     
     // render loop
     // -----------
+    bool firstFrame = true;
+    bool texturesReported = false;
+    float frameTimeSum = 0.0f;
+    unsigned int frameCount = 0;
+    float reportTime = static_cast<float>(glfwGetTime());
     while (!glfwWindowShouldClose(gWindow))
     {
+        // the frame limit, and in low latency mode the wait for the GPU to finish the previous frame
+        gFramePacer.beginFrame();
+        // make the textures decoded since the last frame resident
+        gTextureStreamer.update();
+        gTextures.evict();
+        // the frame memory of the jobs of the last frame is free again
+        gJobs.beginFrame();
+
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
-        // input
+        // input, the movement itself is stepped by the simulation thread
         // -----
         UProcessInput(gWindow);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        if (gSimulation.isRunning())
+            UApplySimulation();
+        glBindTexture(GL_TEXTURE_2D, texture.getId());
         // Render this frame
+        gFrameTimer.begin();
         URender();
+        gFrameTimer.end();
+
+        // average frame times of the current sampling mode, every 2 seconds
+        frameTimeSum += deltaTime;
+        ++frameCount;
+        if (currentFrame - reportTime >= 2.0f)
+        {
+            std::cout << "===== Frame (" << (gTrilinear ? "trilinear, 16x anisotropic" : "base level, bilinear")
+                      << ", " << TEXTURE_MODE_NAMES[gDrawTextureMode] << "): CPU "
+                      << frameTimeSum * 1000.0f / frameCount << " ms, GPU " << gFrameTimer.getAverageTime() << " ms"
+                      << (gFrameCapture.isActive() ? ", capturing" : "") << " =====" << std::endl;
+            if (gFramePacer.getLatencyCount())
+                std::cout << "  input to GPU done " << gFramePacer.getAverageLatency() << " ms (max " << gFramePacer.getMaxLatency()
+                          << " ms), " << gFramePacer.getAverageWaitTime() << " ms paced per frame"
+                          << (gFramePacer.isLowLatency() ? ", low latency" : "") << std::endl;
+            frameTimeSum = 0.0f;
+            frameCount = 0;
+            reportTime = currentFrame;
+            gFrameTimer.reset();
+            gFramePacer.reset();
+        }
+        if (firstFrame)
+        {
+            std::cout << "First frame after " << std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count()
+                      << " ms (" << gTextureStreamer.getPendingCount() << " textures still loading)" << std::endl;
+            startup.addMarker("First frame", std::chrono::steady_clock::now());
+            firstFrame = false;
+        }
+        // once every texture is resident, add their decodes and uploads to the startup timeline
+        if (!texturesReported && gTextureStreamer.isIdle())
+        {
+            gTextureStreamer.printStats();
+            gTextures.printStats();
+            gTextureArrays.printStats();
+            gMaterials.printStats();
+            std::vector<TextureStreamer::Timing> timings = gTextureStreamer.getTimings();
+            for (size_t i = 0; i < timings.size(); ++i)
+            {
+                std::string file = timings[i].path.substr(timings[i].path.find_last_of('/') + 1);
+                startup.addSpan("Decode " + file, "texture " + std::to_string(timings[i].worker + 1), timings[i].decodeStart, timings[i].decodeEnd);
+                if (timings[i].uploadEnd > timings[i].uploadStart)
+                    startup.addSpan("Upload " + file, "main", timings[i].uploadStart, timings[i].uploadEnd);
+            }
+            startup.printTimeline("Startup");
+            texturesReported = true;
+        }
         glm::mat4 view = camera.GetViewMatrix();
-        glfwPollEvents();
+        // in low latency mode the events are polled right before the next frame's draws instead
+        if (!gFramePacer.isLowLatency())
+            glfwPollEvents();
     }
 
     // Release mesh data
@@ -319,9 +797,27 @@ int main(int argc, char* argv[])
     UDestroyMesh(tblMesh);
     UDestroyMesh(screenMesh);
     // Release shader program
-    UDestroyShaderProgram(gProgramId);
-
-    exit(EXIT_SUCCESS); // Terminates the program successfully
+    UDestroyShaderProgram(gClassicProgramId);
+    if (gBindlessProgramId)
+        UDestroyShaderProgram(gBindlessProgramId);
+    // Write the frames in flight and join the texture workers while the GL context still exists
+    gFrameCapture.stop();
+    if (gSimulation.isRunning())
+    {
+        gSimulation.stop();
+        gSimulation.printStats();
+        gFramePacer.printStats();
+    }
+    gTextureStreamer.stop();
+    gJobs.stop();
+    gMaterials.clear();
+    gTextures.clear();
+    gTextureArrays.clear();
+    gFrameTimer.destroy();
+    gFramePacer.destroy();
+    gCameraUniforms.destroy();
+
+    exit(exitCode); // Terminates the program
 }
 
 
@@ -338,6 +834,11 @@ bool UInitialize(int argc, char* argv[], GLFWwindow** window)
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+    // The batch renders offscreen, its window is only there for the context
+    for (int i = 1; i < argc; ++i)
+        if (std::string(argv[i]) == "--batch-render" || std::string(argv[i]) == "--benchmark-batch" ||
+            std::string(argv[i]) == "--benchmark-command-lists")
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     // GLFW: window creation
     // ---------------------
@@ -378,61 +879,96 @@ bool UInitialize(int argc, char* argv[], GLFWwindow** window)
 
 // Called when a key is pressed. Necessary to create a toggle for perspective. 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    // movement keys and L go to the simulation, releases included
+    if (gSimulation.isRunning())
+        gSimulation.postKey(key, action);
     if (action == GLFW_RELEASE) return; //only handle press events
     if (key == GLFW_KEY_P) isOrtho = !isOrtho;
+    if (key == GLFW_KEY_M) gTrilinear = !gTrilinear;
+    if (key == GLFW_KEY_T)
+    {
+        // bindless, arrays, binding, skipping bindless without the extension
+        gTextureMode = static_cast<TextureMode>((gTextureMode + 1) % 3);
+        if (gTextureMode == TEXTURE_BINDLESS && !gBindlessProgramId)
+            gTextureMode = TEXTURE_ARRAYS;
+    }
+    // C starts and stops a video, F12 saves the next frame
+    if (key == GLFW_KEY_C)
+    {
+        if (gFrameCapture.isActive())
+            gFrameCapture.stop();
+        else
+            UStartCapture("capture.y4m", 0);
+    }
+    if (key == GLFW_KEY_F12 && !gFrameCapture.isActive())
+        UStartCapture("screenshot.bmp", 1);
+}
+
+// Captures the back buffer at the framebuffer's current size
+void UStartCapture(const char* path, unsigned int frameLimit)
+{
+    int width, height;
+    glfwGetFramebufferSize(gWindow, &width, &height);
+    gFrameCapture.start(path, width, height, CAPTURE_FPS, frameLimit);
 }
 
 // glfw: whenever the mouse moves, this callback is called
+// the simulation thread turns the positions into camera offsets
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 {
-    float xpos = static_cast<float>(xposIn);
-    float ypos = static_cast<float>(yposIn);
-
-    if (firstMouse)
-    {
-        lastX = xpos;
-        lastY = ypos;
-        firstMouse = false;
-    }
-
-    float xoffset = xpos - lastX;
-    float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
-
-    lastX = xpos;
-    lastY = ypos;
-
-    camera.ProcessMouseMovement(xoffset, yoffset);
+    if (gSimulation.isRunning())
+        gSimulation.postCursor(xposIn, yposIn);
 }
 
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
-    camera.ProcessMouseScroll(static_cast<float>(yoffset));
-
+    if (gSimulation.isRunning())
+        gSimulation.postScroll(yoffset);
 }
 
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// W/S/A/D and Q/E (up and down) reach the simulation thread through key_callback, so the camera moves
+// by the same amount per step whatever the frame time
 void UProcessInput(GLFWwindow* window)
 {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
+}
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboard(RIGHT, deltaTime);
+// Places the camera and the ceiling lights where the simulation is at this instant,
+// between its last two steps
+void UApplySimulation()
+{
+    const Simulation::State state = gSimulation.getState();
+    camera = Camera(state.position, glm::vec3(0.0f, 1.0f, 0.0f), state.yaw, state.pitch);
+    gFramePacer.setInputTime(state.inputTime);
 
-    //***Maps Q AND E Keys to up and down respectively***
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-        camera.ProcessKeyboard(UP, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-        camera.ProcessKeyboard(DOWN, deltaTime);
+    // moving the lights marks their matrices dirty, only when they turned
+    if (state.lampAngle != gAppliedLampAngle)
+    {
+        const float c = std::cos(state.lampAngle);
+        const float s = std::sin(state.lampAngle);
+        for (int i = 0; i < 3; ++i)
+        {
+            const float radius = LIGHT_X[i] - LIGHT_X[0];
+            gTransforms.setPosition(gLightTransforms[i], LIGHT_X[0] + radius * c, LIGHT_Y, LIGHT_Z + radius * s);
+        }
+        gAppliedLampAngle = state.lampAngle;
+    }
+}
 
+// Polls the events queued since the last frame and places the camera at the newest simulation step, without
+// the interpolation delay, with the events its thread has not stepped yet replayed on it
+void ULatchCamera()
+{
+    glfwPollEvents();
+    if (!gSimulation.isRunning())
+        return;
+    const Simulation::State state = gSimulation.getLatchedState();
+    camera = Camera(state.position, glm::vec3(0.0f, 1.0f, 0.0f), state.yaw, state.pitch);
+    gFramePacer.setInputTime(state.inputTime);
 }
 
 
@@ -446,30 +982,281 @@ void UResizeWindow(GLFWwindow* window, int width, int height)
 // Functioned called to render a frame
 void URender()
 {
-    // Enable z-depth
-    glEnable(GL_DEPTH_TEST);
+    // Low latency: the input is polled and the camera taken right before the draws are issued
+    if (gFramePacer.isLowLatency())
+        ULatchCamera();
+    URenderScene();
 
-    // Clear the frame and z buffers
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Read the back buffer into the capture ring, the pixels are written a few frames later
+    gFrameCapture.capture();
+
+    // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+    glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
+    // a timestamp after the frame's commands, and in low latency mode the fence the next frame waits for
+    gFramePacer.endFrame();
+}
 
+// Draws the scene with the current camera into the bound framebuffer
+void URenderScene()
+{
+    // Recompute model/normal matrices of the objects that moved since the last frame, spread over the jobs
+    gTransforms.update(gJobs);
+    UBeginScene();
 
     //Calls to render each individual object
     RenderTable();
     RenderLaptopBase();
     RenderLaptopLid();
     RenderLaptopScreen();
-    RenderLight(-2.0f);
-    RenderLight(-8.0f);
-    RenderLight(4.0f);
+    RenderLight(gLightTransforms[0]);
+    RenderLight(gLightTransforms[1]);
+    RenderLight(gLightTransforms[2]);
     RenderPencil();
     RenderPods();
     RenderCan();
     // Deactivate the Vertex Array Object
     glBindVertexArray(0);
+}
 
-    // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-    glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
+// Picks the texture mode and program of the frame and clears the bound framebuffer
+void UBeginScene()
+{
+    // The first frame of a mode loads its textures
+    ULoadTextures(gTextureMode);
+    // A handle freezes its texture, so they are made once the streamer has uploaded every texture;
+    // the same textures are bound until then
+    if (gTextureMode == TEXTURE_BINDLESS && !gMaterials.isBuilt() && gTextureStreamer.isIdle())
+        gMaterials.build();
+    gDrawTextureMode = (gTextureMode == TEXTURE_BINDLESS && !gMaterials.isBuilt()) ? TEXTURE_BINDING : gTextureMode;
+
+    // Every object is drawn with the program of the mode
+    gProgramId = gDrawTextureMode == TEXTURE_BINDLESS ? gBindlessProgramId : gClassicProgramId;
+    glUseProgram(gProgramId);
+    if (gDrawTextureMode == TEXTURE_BINDLESS)
+        gMaterials.bind(0);
+    else
+        glUniform1i(glGetUniformLocation(gProgramId, "uUseTextureArrays"), gDrawTextureMode == TEXTURE_ARRAYS);
+    // the arrays use the same samplers as the 2D textures
+    if (gDrawTextureMode == TEXTURE_ARRAYS)
+    {
+        glBindSampler(2, gTrilinear ? gTrilinearSampler : gBaseLevelSampler);
+        glBindSampler(3, gTrilinear ? gTrilinearSampler : gBaseLevelSampler);
+    }
+
+    // View and projection of every draw of the scene
+    USetCameraUniforms();
+
+    // Enable z-depth
+    glEnable(GL_DEPTH_TEST);
+
+    // Clear the frame and z buffers
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// Writes the camera's view and the projection of the current mode to the next slot of the camera uniform block
+void USetCameraUniforms()
+{
+    const glm::mat4 view = camera.GetViewMatrix();
+    // Perspective projection, orthogonal if the flag is set
+    const glm::mat4 projection = isOrtho ? glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 0.1f, 100.0f)
+                                         : glm::perspective(45.0f, gAspectRatio, 0.1f, 100.0f);
+    gCameraUniforms.set(glm::value_ptr(view), glm::value_ptr(projection));
+}
+
+// Renders every view of a views file offscreen once the textures are resident, see BatchRenderer.h
+bool UBatchRender(const char* path, unsigned int threadCount, bool benchmark)
+{
+    std::vector<BatchRenderer::View> views;
+    if (!BatchRenderer::readViews(path, views))
+        return false;
+    while (!gTextureStreamer.isIdle())
+    {
+        gTextureStreamer.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // each view moves the camera and sets the projection's aspect ratio
+    BatchRenderer::RenderFunction render = [](const BatchRenderer::View& view)
+    {
+        camera = Camera(glm::vec3(view.position[0], view.position[1], view.position[2]), glm::vec3(0.0f, 1.0f, 0.0f), view.yaw, view.pitch);
+        gAspectRatio = (float)view.width / (float)view.height;
+        URenderScene();
+    };
+    if (benchmark)
+    {
+        BatchRenderer::benchmark(views, render);
+        return true;
+    }
+    BatchRenderer batch;
+    BatchRenderer::Stats stats = batch.run(views, render, threadCount);
+    BatchRenderer::printStats(stats);
+    return stats.failedCount == 0;
+}
+
+// Model and normal matrix of a benchmark object, it spins around y
+void UBenchmarkMatrices(const BenchmarkObject& object, float time, glm::mat4& model, glm::mat3& normalMatrix)
+{
+    model = glm::translate(glm::vec3(object.position[0], object.position[1], object.position[2])) *
+            glm::rotate(object.angle + time, glm::vec3(0.0f, 1.0f, 0.0f)) *
+            glm::scale(glm::vec3(object.scale));
+    normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+}
+
+// Draws a benchmark object the way the Render* functions draw the scene, everything on the GL thread
+void URenderBenchmarkObject(const BenchmarkObject& object, float time)
+{
+    glm::mat4 model;
+    glm::mat3 normalMatrix;
+    UBenchmarkMatrices(object, time, model, normalMatrix);
+    glUseProgram(gProgramId);
+
+    GLint modelLoc = glGetUniformLocation(gProgramId, "model");
+    GLint normalLoc = glGetUniformLocation(gProgramId, "normalMatrix");
+
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+    glUniformMatrix3fv(normalLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+    UBindTexture(0, *object.texture, object.layer, object.material);
+    glBindVertexArray(object.mesh->vao);
+    glDrawElements(GL_TRIANGLES, object.mesh->nIndices, object.mesh->indexType, NULL);
+    glBindVertexArray(0);
+}
+
+// Records the same draw on any thread; view and projection are recorded once per list
+void URecordBenchmarkObject(CommandList& list, const BenchmarkObject& object, float time, const DrawLocations& locations, DrawTextureState& state)
+{
+    glm::mat4 model;
+    glm::mat3 normalMatrix;
+    UBenchmarkMatrices(object, time, model, normalMatrix);
+    list.uniformMatrix4(locations.model, glm::value_ptr(model));
+    list.uniformMatrix3(locations.normalMatrix, glm::value_ptr(normalMatrix));
+    URecordTexture(list, 0, *object.texture, object.layer, object.material, locations, state);
+    list.bindVertexArray(object.mesh->vao);
+    list.drawElements(GL_TRIANGLES, object.mesh->nIndices, object.mesh->indexType);
+}
+
+// Draws a grid of objectCount scene objects for a few frames, first prepared inline on the GL thread like the
+// Render* functions, then recorded into command lists by 1, 2, 4... threads and replayed, and prints the time
+// the GL thread spends per frame in each case
+void UBenchmarkCommandLists(unsigned int objectCount)
+{
+    while (!gTextureStreamer.isIdle())
+    {
+        gTextureStreamer.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // the meshes and textures of the scene objects, on a square grid in front of the camera
+    const BenchmarkObject kinds[] =
+    {
+        { &tblMesh, &texture, textureLayer, textureMaterial },
+        { &gMesh, &baseTexture, baseLayer, baseMaterial },
+        { &lidMesh, &lidTexture, lidLayer, lidMaterial },
+        { &screenMesh, &screenTexture, screenLayer, screenMaterial },
+        { &lightMesh, &texture2, texture2Layer, texture2Material },
+        { &cylMesh, &pencilTexture, pencilLayer, pencilMaterial },
+        { &podMesh, &pencilTexture, pencilLayer, pencilMaterial },
+        { &canMesh, &pencilTexture, pencilLayer, pencilMaterial },
+    };
+    const unsigned int kindCount = sizeof(kinds) / sizeof(kinds[0]);
+    const unsigned int side = static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<float>(objectCount))));
+    const float spacing = 0.4f;
+    std::vector<BenchmarkObject> objects(objectCount);
+    for (unsigned int i = 0; i < objectCount; ++i)
+    {
+        objects[i] = kinds[(i * 7 + i / side) % kindCount];
+        objects[i].position[0] = ((float)(i % side) - side * 0.5f) * spacing;
+        objects[i].position[1] = 0.0f;
+        objects[i].position[2] = -((float)(i / side)) * spacing;
+        objects[i].angle = i * 0.618f;
+        objects[i].scale = 0.05f;
+    }
+    camera = Camera(glm::vec3(0.0f, 12.0f, 10.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, -35.0f);
+    int width, height;
+    glfwGetFramebufferSize(gWindow, &width, &height);
+    glViewport(0, 0, width, height);
+    gAspectRatio = (float)width / (float)height;
+
+    // the same frames both ways, the GL thread time ends when the last command is issued
+    const unsigned int warmupFrames = 2, frameCount = 10;
+    std::vector<unsigned char> inlinePixels, pixels;
+    auto timeFrames = [&](const std::function<void(float time, bool measured)>& drawFrame) -> float
+    {
+        float total = 0.0f;
+        for (unsigned int frame = 0; frame < warmupFrames + frameCount; ++frame)
+        {
+            const float time = frame / 60.0f;
+            UBeginScene();
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            drawFrame(time, frame >= warmupFrames);
+            const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            glFinish();
+            if (frame >= warmupFrames)
+                total += ms;
+        }
+        pixels.resize((size_t)width * height * 4);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        return total / frameCount;
+    };
+
+    const float inlineTime = timeFrames([&](float time, bool)
+    {
+        for (unsigned int i = 0; i < objectCount; ++i)
+            URenderBenchmarkObject(objects[i], time);
+    });
+    inlinePixels.swap(pixels);
+
+    std::cout << "===== Command Lists Benchmark: " << objectCount << " objects, " << TEXTURE_MODE_NAMES[gDrawTextureMode]
+              << " =====\n  Inline:          GL thread " << inlineTime << " ms per frame" << std::endl;
+
+    const unsigned int maxThreads = std::max(Parallel::getDefaultThreadCount(), 2u);
+    for (unsigned int threads = 1; ; threads = std::min(threads * 2, maxThreads))
+    {
+        JobSystem jobs;
+        jobs.start(threads);
+        CommandRecorder recorder(jobs);
+        float recordTime = 0.0f;
+        float replayTime = 0.0f;
+        const float totalTime = timeFrames([&](float time, bool measured)
+        {
+            // looked up once per frame on the GL thread, the workers only read them
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            DrawLocations locations;
+            locations.model = glGetUniformLocation(gProgramId, "model");
+            locations.normalMatrix = glGetUniformLocation(gProgramId, "normalMatrix");
+            locations.materials = glGetUniformLocation(gProgramId, "uMaterials");
+            locations.layers = glGetUniformLocation(gProgramId, "uLayers");
+            locations.layerScales = glGetUniformLocation(gProgramId, "uLayerScales");
+
+            recorder.record(objectCount, [&](unsigned int begin, unsigned int end, CommandList& list)
+            {
+                DrawTextureState state;
+                std::memcpy(state.materials, gDrawMaterials, sizeof(state.materials));
+                std::memcpy(state.layers, gDrawLayers, sizeof(state.layers));
+                std::memcpy(state.layerScales, gDrawLayerScales, sizeof(state.layerScales));
+                list.useProgram(gProgramId);
+                for (unsigned int i = begin; i < end; ++i)
+                    URecordBenchmarkObject(list, objects[i], time, locations, state);
+                list.bindVertexArray(0);
+            });
+            std::chrono::steady_clock::time_point recorded = std::chrono::steady_clock::now();
+            recorder.replay();
+            if (measured)
+            {
+                recordTime += std::chrono::duration<float, std::milli>(recorded - start).count();
+                replayTime += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - recorded).count();
+            }
+        });
+        // the arrays bound by the lists are not in gBoundArrays
+        gBoundArrays[0] = gBoundArrays[1] = 0;
+
+        std::cout << "  " << threads << (threads > 1 ? " threads" : " thread ") << " recording: GL thread " << totalTime << " ms per frame ("
+                  << recordTime / frameCount << " ms record, " << replayTime / frameCount << " ms replay), " << (inlineTime > 0.0f ? 100.0f * (inlineTime - totalTime) / inlineTime : 0.0f) << "% saved, "
+                  << recorder.getCommandCount() << " commands, " << recorder.getSize() / 1024 << " KB, "
+                  << (pixels == inlinePixels ? "same image" : "image differs") << std::endl;
+        if (threads == maxThreads)
+            break;
+    }
 }
 
 //DEPRECATED
@@ -567,6 +1354,212 @@ void URender()
 //}
 
 
+// Registers the scale, rotation and position of every object with the transform system.
+// Matrices are only recomputed when one of these values changes.
+void UCreateTransforms()
+{
+    //                                 position                rotation (radians, axis)        scale
+    gTableTransform  = gTransforms.add(-2.0f, -0.15f, 2.0f,    0.0f, 1.0f, 1.0f, 1.0f,         8.0f, 2.0f, 10.0f);
+    gBaseTransform   = gTransforms.add(0.0f, 0.0f, -2.0f,      0.0f, 1.0f, 1.0f, 1.0f,         3.9f, 2.0f, 2.3f);
+    gLidTransform    = gTransforms.add(0.0f, 2.0f, -4.5f,      4.6f, 1.0f, 0.0f, 0.0f,         3.9f, 2.0f, 2.0f);
+    gScreenTransform = gTransforms.add(0.0f, 2.0f, -4.49f,     4.6f, 1.0f, 0.0f, 0.0f,         3.89f, 1.99f, 2.0f);
+    gPencilTransform = gTransforms.add(3.0f, 0.05f, -0.49f,    4.6f, 2.0f, 99.9f, 0.0f,        1.0f, 1.0f, 1.0f);
+    gPodTransform    = gTransforms.add(-3.5f, 0.1f, -1.49f,    4.6f, 2.0f, 99.9f, 0.0f,        0.5f, 0.25f, 0.5f);
+    gCanTransform    = gTransforms.add(-3.0f, 0.5f, -4.00f,    4.7f, 0.01f, 0.0f, 0.0f,        0.5f, 0.5f, 0.5f);
+
+    for (int i = 0; i < 3; ++i)
+        gLightTransforms[i] = gTransforms.add(LIGHT_X[i], LIGHT_Y, LIGHT_Z, 0.0f, 1.0f, 1.0f, 1.0f, 0.5f, 0.5f, 0.5f);
+
+    gTransforms.update();
+}
+
+
+// Runs the mesh optimizer on a mesh before it is uploaded:
+// triangles are reordered for the post-transform vertex cache and then clustered to reduce overdraw,
+// and vertices are reordered by first use so vertex fetch reads memory linearly.
+void UOptimizeMesh(const char* name, GLuint* indices, unsigned int indexCount, GLfloat* verts, unsigned int floatsPerVertex, unsigned int vertexCount)
+{
+    MeshOptimizer::VertexCacheStats before = MeshOptimizer::analyzeVertexCache(indices, indexCount, vertexCount);
+
+    MeshOptimizer::optimizeVertexCache(indices, indexCount, vertexCount);
+    MeshOptimizer::optimizeOverdraw(indices, indexCount, verts, vertexCount, floatsPerVertex * sizeof(GLfloat));
+    MeshOptimizer::optimizeVertexFetch(verts, vertexCount, floatsPerVertex * sizeof(GLfloat), indices, indexCount);
+
+    MeshOptimizer::VertexCacheStats after = MeshOptimizer::analyzeVertexCache(indices, indexCount, vertexCount);
+    std::lock_guard<std::mutex> lock(gLogMutex);
+    MeshOptimizer::printStats(name, before, after);
+}
+
+
+// Merges duplicated vertices (e.g. the per-face copies of a flat shaded cylinder) and remaps the indices.
+// Attributes closer than 1e-5 are quantized to the same value.
+void UWeldMesh(const char* name, std::vector<GLfloat>& verts, std::vector<GLuint>& indices, unsigned int floatsPerVertex)
+{
+    std::vector<GLfloat> uniqueVerts;
+    std::vector<unsigned int> remap;
+    VertexWelder::WeldStats stats = VertexWelder::weld(verts.data(), verts.size() / floatsPerVertex, floatsPerVertex, uniqueVerts, remap, 1e-5f);
+    VertexWelder::remapIndices(indices.data(), indices.size(), remap.data());
+    verts.swap(uniqueVerts);
+    std::lock_guard<std::mutex> lock(gLogMutex);
+    VertexWelder::printStats(name, stats);
+}
+
+
+// Uploads indices to the bound element array buffer with the narrowest type the vertex count allows:
+// 16-bit indices halve the index buffer size and index fetch bandwidth, 32-bit are kept for meshes over 65536 vertices.
+void UUploadIndices(GLMesh& mesh, const GLuint* indices, unsigned int indexCount, unsigned int vertexCount)
+{
+    mesh.nIndices = indexCount;
+    if (IndexBuffer::getIndexSize(vertexCount) == sizeof(GLushort))
+    {
+        std::vector<GLushort> shortIndices(indexCount);
+        IndexBuffer::narrow(indices, indexCount, shortIndices.data());
+        mesh.indexType = GL_UNSIGNED_SHORT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(GLushort), shortIndices.data(), GL_STATIC_DRAW);
+    }
+    else
+    {
+        mesh.indexType = GL_UNSIGNED_INT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(GLuint), indices, GL_STATIC_DRAW);
+    }
+}
+
+
+// Builds the Cylinder described by desc
+Cylinder UBuildCylinder(const CylinderDesc& desc)
+{
+    return Cylinder(desc.baseRadius, desc.topRadius, desc.height, desc.sectorCount, desc.stackCount, desc.smooth);
+}
+
+
+// Identifies a cached cylinder mesh: changing a parameter, the vertex layout or the build steps gives a new key
+uint64_t UCylinderKey(const CylinderDesc& desc, unsigned int floatsPerVertex)
+{
+    const float params[] = { desc.baseRadius, desc.topRadius, desc.height, (float)desc.sectorCount, (float)desc.stackCount,
+                             desc.smooth ? 1.0f : 0.0f, (float)floatsPerVertex, (float)MESH_BUILD_VERSION };
+    return MeshCache::hash(params, sizeof(params));
+}
+
+
+// Interleaved float layout: position at location 0, then texture coords at location 2 if floatsPerTexture is not 0
+MeshCache::VertexFormat UVertexFormat(unsigned int floatsPerVertex, unsigned int floatsPerTexture)
+{
+    MeshCache::VertexFormat format = {};
+    format.stride = (floatsPerVertex + floatsPerTexture) * sizeof(GLfloat);
+    format.attributes[0].location = 0;
+    format.attributes[0].components = floatsPerVertex;
+    format.attributes[0].type = GL_FLOAT;
+    format.attributeCount = 1;
+    if (floatsPerTexture)
+    {
+        format.attributes[1].location = 2;
+        format.attributes[1].components = floatsPerTexture;
+        format.attributes[1].type = GL_FLOAT;
+        format.attributes[1].offset = floatsPerVertex * sizeof(GLfloat);
+        format.attributeCount = 2;
+    }
+    return format;
+}
+
+
+// Looks the mesh up in the mapped cache file, returns false if it is missing or its key is stale.
+// The file is only read here, so the build tasks can call this in parallel.
+bool UFindCachedMesh(MeshSource& source, const char* name, uint64_t key)
+{
+    const MeshCache::MeshEntry* entry = gMeshCache.isOpen() ? gMeshCache.findMesh(name) : nullptr;
+    source.cached = entry && entry->sourceKey == key ? entry : nullptr;
+    source.rebuilt = -1;
+    return source.cached != nullptr;
+}
+
+
+// Adds a rebuilt mesh to the cache writer, which narrows the indices and adds LODs, and remembers where it is
+void UAddMeshToCache(MeshSource& source, const char* name, uint64_t key, const MeshCache::VertexFormat& format,
+                     const std::vector<GLfloat>& verts, const std::vector<GLuint>& indices)
+{
+    std::lock_guard<std::mutex> lock(gMeshCacheMutex);
+    gMeshCacheWriter.addMesh(name, key, format, verts.data(), verts.size() * sizeof(GLfloat) / format.stride, indices.data(), indices.size());
+    source.cached = nullptr;
+    source.rebuilt = gMeshCacheWriter.getMeshCount() - 1;
+}
+
+
+// GL phase of a cylinder: uploads the mesh found or built by the CPU phase
+void UCreateMeshFromSource(GLMesh& mesh, const MeshSource& source)
+{
+    if (source.cached)
+    {
+        UUploadCachedMesh(mesh, *source.cached, gMeshCache.getVertices(*source.cached), gMeshCache.getIndices(*source.cached));
+    }
+    else if (source.rebuilt >= 0)
+    {
+        // another build task may be adding its mesh to the writer
+        std::lock_guard<std::mutex> lock(gMeshCacheMutex);
+        UUploadCachedMesh(mesh, gMeshCacheWriter.getMesh(source.rebuilt), gMeshCacheWriter.getVertices(source.rebuilt),
+                          gMeshCacheWriter.getIndices(source.rebuilt));
+    }
+}
+
+
+// Uploads a GPU-ready mesh, the pointers may point straight into the mapped cache file.
+// Immutable storage (GL 4.4) lets the driver place the buffers without keeping a copy for later updates.
+void UUploadCachedMesh(GLMesh& mesh, const MeshCache::MeshEntry& entry, const void* vertices, const void* indices)
+{
+    const bool immutable = GLEW_ARB_buffer_storage != 0;
+
+    glGenVertexArrays(1, &mesh.vao);
+    glBindVertexArray(mesh.vao);
+    glGenBuffers(2, mesh.vbos);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]);
+    if (immutable)
+        glBufferStorage(GL_ARRAY_BUFFER, entry.vertexBytes, vertices, 0);
+    else
+        glBufferData(GL_ARRAY_BUFFER, entry.vertexBytes, vertices, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]);
+    if (immutable)
+        glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, entry.indexBytes, indices, 0);
+    else
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, entry.indexBytes, indices, GL_STATIC_DRAW);
+
+    // LOD 0 starts at index 0, the coarser LODs follow it in the same buffer
+    mesh.nIndices = entry.lods[0].indexCount;
+    mesh.indexType = entry.indexSize == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+    for (unsigned int i = 0; i < entry.format.attributeCount; ++i)
+    {
+        const MeshCache::VertexAttribute& a = entry.format.attributes[i];
+        glVertexAttribPointer(a.location, a.components, a.type, a.normalized ? GL_TRUE : GL_FALSE,
+                              entry.format.stride, (void*)(size_t)a.offset);
+        glEnableVertexAttribArray(a.location);
+    }
+}
+
+
+// Writes the cache if a mesh was rebuilt, keeping the cached meshes that are still valid, then unmaps it
+void USaveMeshCache()
+{
+    if (gMeshCacheWriter.getMeshCount() > 0)
+    {
+        for (unsigned int i = 0; i < gMeshCache.getMeshCount(); ++i)
+        {
+            const MeshCache::MeshEntry& entry = gMeshCache.getMesh(i);
+            bool rebuilt = false;
+            for (unsigned int j = 0; j < gMeshCacheWriter.getMeshCount() && !rebuilt; ++j)
+                rebuilt = strncmp(gMeshCacheWriter.getMesh(j).name, entry.name, MeshCache::NAME_SIZE) == 0;
+            if (!rebuilt)
+                gMeshCacheWriter.addMesh(entry, gMeshCache.getVertices(entry), gMeshCache.getIndices(entry));
+        }
+        // the file must be unmapped before it is replaced
+        gMeshCache.close();
+        gMeshCacheWriter.write(MESH_CACHE_PATH);
+        gMeshCacheWriter = MeshCache::Writer();
+    }
+    gMeshCache.close();
+}
+
+
 void UDestroyMesh(GLMesh& mesh)
 {
     glDeleteVertexArrays(1, &mesh.vao);
@@ -641,6 +1634,100 @@ void UDestroyShaderProgram(GLuint programId)
     glDeleteProgram(programId);
 }
 
+
+// Adds a material of one texture to the bindless material table
+unsigned int UAddMaterial(const TextureManager::Handle& texture)
+{
+    GLuint id = texture.getId();
+    return gMaterials.add(&id, 1);
+}
+
+// Queues a 2D texture and its material, loaded by ULoadTextures() with the others
+void UAddTexture(TextureManager::Handle& texture, unsigned int& material, const char* path, const TextureManager::Sampler& sampler)
+{
+    const TextureLoad load = { &texture, &material, path, sampler };
+    gTextureLoads.push_back(load);
+}
+
+// Loads the textures a mode draws with, the first time only: the array layers, or the 2D textures and their materials
+void ULoadTextures(TextureMode mode)
+{
+    if (mode == TEXTURE_ARRAYS)
+    {
+        gTextureArrays.build();
+        return;
+    }
+    if (gTexturesLoaded)
+        return;
+    for (size_t i = 0; i < gTextureLoads.size(); ++i)
+    {
+        const TextureLoad& load = gTextureLoads[i];
+        *load.texture = gTextures.load(load.path, load.sampler);
+        *load.material = UAddMaterial(*load.texture);
+    }
+    gTexturesLoaded = true;
+}
+
+
+// Binds a texture with its sampler object, or with the base level sampler when trilinear filtering is switched off (M key)
+// In the other modes only the per draw data changes: the material row of the sampler or the layer
+void UBindTexture(GLuint unit, const TextureManager::Handle& texture, unsigned int layer, unsigned int material)
+{
+    if (gDrawTextureMode == TEXTURE_BINDLESS)
+    {
+        gDrawMaterials[unit] = gMaterials.getRow(material, gTrilinear ? gTrilinearMaterials : gBaseLevelMaterials);
+        glUniform2uiv(glGetUniformLocation(gProgramId, "uMaterials"), 1, gDrawMaterials);
+        return;
+    }
+    if (gDrawTextureMode == TEXTURE_ARRAYS)
+    {
+        // the array only changes if the layers are in several arrays, the layer is per draw data
+        const TextureArrayPacker::Layer& l = gTextureArrays.getLayer(layer);
+        if (gBoundArrays[unit] != l.array)
+        {
+            glActiveTexture(GL_TEXTURE2 + unit);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, l.array);
+            glActiveTexture(GL_TEXTURE0);
+            gBoundArrays[unit] = l.array;
+        }
+        gDrawLayers[unit] = l.index;
+        gDrawLayerScales[unit * 2] = l.scale[0];
+        gDrawLayerScales[unit * 2 + 1] = l.scale[1];
+        glUniform2iv(glGetUniformLocation(gProgramId, "uLayers"), 1, gDrawLayers);
+        glUniform4fv(glGetUniformLocation(gProgramId, "uLayerScales"), 1, gDrawLayerScales);
+        return;
+    }
+    texture.bind(unit);
+    if (!gTrilinear)
+        glBindSampler(unit, gBaseLevelSampler);
+}
+
+// Records what UBindTexture() issues, on any thread: the binds and uniforms go to the list instead of GL
+void URecordTexture(CommandList& list, GLuint unit, const TextureManager::Handle& texture, unsigned int layer, unsigned int material,
+                    const DrawLocations& locations, DrawTextureState& state)
+{
+    if (gDrawTextureMode == TEXTURE_BINDLESS)
+    {
+        state.materials[unit] = gMaterials.getRow(material, gTrilinear ? gTrilinearMaterials : gBaseLevelMaterials);
+        list.uniform2ui(locations.materials, state.materials[0], state.materials[1]);
+        return;
+    }
+    if (gDrawTextureMode == TEXTURE_ARRAYS)
+    {
+        // the list drops the bind when the array is already bound
+        const TextureArrayPacker::Layer& l = gTextureArrays.getLayer(layer);
+        list.bindTexture(2 + unit, GL_TEXTURE_2D_ARRAY, l.array);
+        state.layers[unit] = l.index;
+        state.layerScales[unit * 2] = l.scale[0];
+        state.layerScales[unit * 2 + 1] = l.scale[1];
+        list.uniform2i(locations.layers, state.layers[0], state.layers[1]);
+        list.uniform4f(locations.layerScales, state.layerScales);
+        return;
+    }
+    list.bindTexture(unit, GL_TEXTURE_2D, texture.getId());
+    list.bindSampler(unit, gTrilinear ? texture.getSampler() : gBaseLevelSampler);
+}
+
 // loads vertex, index, and color data into for laptop base into mesh
 void CreateLaptopBase(GLMesh& mesh) {
     GLfloat verts[] = {
@@ -657,7 +1744,7 @@ void CreateLaptopBase(GLMesh& mesh) {
     };
 
     // Index data to share position data
-    GLushort indices[] = {
+    GLuint indices[] = {
         0, 1, 3, // Triangle 1
         1, 2, 3, // Triangle 2
         0, 1, 4, // Triangle 3
@@ -672,6 +1759,9 @@ void CreateLaptopBase(GLMesh& mesh) {
         1, 2, 7  // Triangle 12
     };
 
+    // Reorder triangles and vertices for the GPU caches before upload
+    UOptimizeMesh("Laptop base", indices, sizeof(indices) / sizeof(indices[0]), verts, 5, sizeof(verts) / sizeof(verts[0]) / 5);
+
     const GLuint floatsPerVertex = 3;
 
     const GLuint floatsPerTexture = 2;
@@ -686,9 +1776,8 @@ void CreateLaptopBase(GLMesh& mesh) {
     glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]); // Activates the buffer
     glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
 
-    mesh.nIndices = sizeof(indices) / sizeof(indices[0]);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    UUploadIndices(mesh, indices, sizeof(indices) / sizeof(indices[0]), sizeof(verts) / sizeof(verts[0]) / 5);
 
     // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
     GLint stride = sizeof(float) * (floatsPerVertex + floatsPerTexture);// The number of floats before each
@@ -702,75 +1791,32 @@ void CreateLaptopBase(GLMesh& mesh) {
     glVertexAttribPointer(2, floatsPerTexture, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * floatsPerTexture));
     glEnableVertexAttribArray(2);
 
-    glGenTextures(1, &baseTexture);
-    glBindTexture(GL_TEXTURE_2D, baseTexture);
-    // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // load and generate the texture
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load("assets/textures/base.png", &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        flipImageVertically(data, width, height, nrChannels);
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        if (nrChannels == 3)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        else if (nrChannels == 4)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
+    // mipmapped and sampled trilinear with anisotropy, flipped for OpenGL; shared with any other user of the file
+    UAddTexture(baseTexture, baseMaterial, "assets/textures/base.png", TextureManager::Sampler::trilinear(true));
+    baseLayer = gTextureArrays.add("assets/textures/base.png", true);
 }
 
 // Renders laptop base
 void RenderLaptopBase() {
-    // 1. Scales the object by 2
-    glm::mat4 scale = glm::scale(glm::vec3(3.9f, 2.0f, 2.3f));
-    // 2. Rotates shape by 15 degrees in the x axis
-    glm::mat4 rotation = glm::rotate(0.0f, glm::vec3(1.0f, 1.0f, 1.0f));
-    // 3. Place object at the origin
-    glm::mat4 translation = glm::translate(glm::vec3(0.0f, 0.0f, -2.0f));
-    // Model matrix: transformations are applied right-to-left order
-    glm::mat4 model = translation * rotation * scale;
-
-    // Transforms the camera: move the camera back (z axis)
-    //glm::mat4 view = glm::translate(glm::vec3(0.0f, -1.0f, -6.0f));
-
-    //takes in the current camera position
-    glm::mat4 view = camera.GetViewMatrix();
-    // Creates a perspective projection
-    glm::mat4 projection = glm::perspective(45.0f, (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
-
-    //**Updates projection to orthogonal if flag is set
-    if (isOrtho == true) {
-        projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 0.1f, 100.0f);
-    }
+    // Model and normal matrices are precomputed by the transform system
+    const float* model = gTransforms.getWorldMatrix(gBaseTransform);
+    const float* normalMatrix = gTransforms.getNormalMatrix(gBaseTransform);
+
     // Set the shader to be used
     glUseProgram(gProgramId);
 
     // Retrieves and passes transform matrices to the Shader program
     GLint modelLoc = glGetUniformLocation(gProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gProgramId, "projection");
+    GLint normalLoc = glGetUniformLocation(gProgramId, "normalMatrix");
 
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, baseTexture);
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, model);
+    glUniformMatrix3fv(normalLoc, 1, GL_FALSE, normalMatrix);
+    UBindTexture(0, baseTexture, baseLayer, baseMaterial);
     // Activate the VBOs contained within the mesh's VAO
     glBindVertexArray(gMesh.vao);
 
     // Draws pyramid
-    glDrawElements(GL_TRIANGLES, gMesh.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle
+    glDrawElements(GL_TRIANGLES, gMesh.nIndices, gMesh.indexType, NULL); // Draws the triangle
     glBindVertexArray(0);
 }
 
@@ -792,7 +1838,7 @@ void CreateLaptopLid(GLMesh& lidMesh) {
 
 
     // Index data to share position data
-    GLushort indices[] = {
+    GLuint indices[] = {
         0, 1, 3, // Triangle 1
         1, 2, 3, // Triangle 2
         0, 1, 4, // Triangle 3
@@ -809,6 +1855,9 @@ void CreateLaptopLid(GLMesh& lidMesh) {
 
 
 
+    // Reorder triangles and vertices for the GPU caches before upload
+    UOptimizeMesh("Laptop lid", indices, sizeof(indices) / sizeof(indices[0]), verts, 5, sizeof(verts) / sizeof(verts[0]) / 5);
+
     const GLuint floatsPerVertex = 3;
     const GLuint floatsPerTexture = 2;
 
@@ -820,9 +1869,8 @@ void CreateLaptopLid(GLMesh& lidMesh) {
     glBindBuffer(GL_ARRAY_BUFFER, lidMesh.vbos[0]); // Activates the buffer
     glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
 
-    lidMesh.nIndices = sizeof(indices) / sizeof(indices[0]);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lidMesh.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    UUploadIndices(lidMesh, indices, sizeof(indices) / sizeof(indices[0]), sizeof(verts) / sizeof(verts[0]) / 5);
     // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
     GLint stride = sizeof(float) * (floatsPerVertex + floatsPerTexture);// The number of floats before each
 
@@ -834,73 +1882,31 @@ void CreateLaptopLid(GLMesh& lidMesh) {
     glVertexAttribPointer(2, floatsPerTexture, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * floatsPerTexture));
     glEnableVertexAttribArray(2);
 
-    glGenTextures(1, &lidTexture);
-    glBindTexture(GL_TEXTURE_2D, lidTexture);
-    // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // load and generate the texture
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load("assets/textures/lid.png", &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        flipImageVertically(data, width, height, nrChannels);
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        if (nrChannels == 3)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        else if (nrChannels == 4)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
+    UAddTexture(lidTexture, lidMaterial, "assets/textures/lid.png", TextureManager::Sampler::trilinear(true));
+    lidLayer = gTextureArrays.add("assets/textures/lid.png", true);
 }
 
 // Renders laptop lid
 void RenderLaptopLid() {
-    // 1. Scales the object by 2
-    glm::mat4 scale = glm::scale(glm::vec3(3.9f, 2.0f, 2.0f));
-    // 2. Rotates shape by 15 degrees in the x axis
-    glm::mat4 rotation = glm::rotate(4.6f, glm::vec3(1.0f, 0.0f, 0.0f));
-    // 3. Place object at the origin
-    glm::mat4 translation = glm::translate(glm::vec3(0.0f, 2.0f, -4.5f));
-    // Model matrix: transformations are applied right-to-left order
-    glm::mat4 model = translation * rotation * scale;
-
-    // Transforms the camera: move the camera back (z axis)
-    //glm::mat4 view = glm::translate(glm::vec3(0.0f, 1.3f, -6.0f));
-    //takes in the current camera postion
-    glm::mat4 view = camera.GetViewMatrix();
-    // Creates a perspective projection
-    glm::mat4 projection = glm::perspective(45.0f, (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
-    //**Updates projection to orthogonal if flag is set
-    if (isOrtho == true) {
-        projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 0.1f, 100.0f);
-    }
+    // Model and normal matrices are precomputed by the transform system
+    const float* model = gTransforms.getWorldMatrix(gLidTransform);
+    const float* normalMatrix = gTransforms.getNormalMatrix(gLidTransform);
+
     // Set the shader to be used
     glUseProgram(gProgramId);
 
     // Retrieves and passes transform matrices to the Shader program
     GLint modelLoc = glGetUniformLocation(gProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gProgramId, "projection");
+    GLint normalLoc = glGetUniformLocation(gProgramId, "normalMatrix");
 
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, lidTexture);
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, model);
+    glUniformMatrix3fv(normalLoc, 1, GL_FALSE, normalMatrix);
+    UBindTexture(0, lidTexture, lidLayer, lidMaterial);
     // Activate the VBOs contained within the mesh's VAO
     glBindVertexArray(lidMesh.vao);
 
     // Draws pyramid
-    glDrawElements(GL_TRIANGLES, lidMesh.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle
+    glDrawElements(GL_TRIANGLES, lidMesh.nIndices, lidMesh.indexType, NULL); // Draws the triangle
     glBindVertexArray(0);
 }
 
@@ -921,7 +1927,7 @@ void CreateTable(GLMesh& tblMesh) {
     };
 
     // Index data to share position data
-    GLushort indices[] = {
+    GLuint indices[] = {
         0, 1, 3, // Triangle 1
         1, 2, 3, // Triangle 2
         0, 1, 4, // Triangle 3
@@ -936,6 +1942,9 @@ void CreateTable(GLMesh& tblMesh) {
         1, 2, 7  // Triangle 12
     };
 
+    // Reorder triangles and vertices for the GPU caches before upload
+    UOptimizeMesh("Table", indices, sizeof(indices) / sizeof(indices[0]), verts, 5, sizeof(verts) / sizeof(verts[0]) / 5);
+
     const GLuint floatsPerVertex = 3;
 
     const GLuint floatsPerTexture = 2;
@@ -950,9 +1959,8 @@ void CreateTable(GLMesh& tblMesh) {
     glBindBuffer(GL_ARRAY_BUFFER, tblMesh.vbos[0]); // Activates the buffer
     glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
 
-    tblMesh.nIndices = sizeof(indices) / sizeof(indices[0]);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tblMesh.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    UUploadIndices(tblMesh, indices, sizeof(indices) / sizeof(indices[0]), sizeof(verts) / sizeof(verts[0]) / 5);
 
     // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
     GLint stride = sizeof(float) * (floatsPerVertex + floatsPerTexture);// The number of floats before each
@@ -966,70 +1974,31 @@ void CreateTable(GLMesh& tblMesh) {
     glVertexAttribPointer(2, floatsPerTexture, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * floatsPerTexture));
     glEnableVertexAttribArray(2);
 
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // load and generate the texture
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load("assets/textures/marble.jpg", &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
+    UAddTexture(texture, textureMaterial, "assets/textures/marble.jpg", TextureManager::Sampler::trilinear());
+    textureLayer = gTextureArrays.add("assets/textures/marble.jpg");
 }
 
 // Renders laptop lid
 void RenderTable() {
-    // 1. Scales the object by 2
-    glm::mat4 scale = glm::scale(glm::vec3(8.0f, 2.0f, 10.0f));
-    // 2. Rotates shape by 15 degrees in the x axis
-    glm::mat4 rotation = glm::rotate(0.0f, glm::vec3(1.0f, 1.0f, 1.0f));
-    // 3. Place object at the origin
-    glm::mat4 translation = glm::translate(glm::vec3(-2.0f, -0.15f, 2.0f));
-    // Model matrix: transformations are applied right-to-left order
-    glm::mat4 model = translation * rotation * scale;
-
-    // Transforms the camera: move the camera back (z axis)
-    //glm::mat4 view = glm::translate(glm::vec3(0.0f, 1.3f, -6.0f));
-    //takes in the current camera postion
-    glm::mat4 view = camera.GetViewMatrix();
-    // Creates a perspective projection
-    glm::mat4 projection = glm::perspective(45.0f, (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
-
-    //**Updates projection to orthogonal if flag is set
-    if (isOrtho == true) {
-        projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 0.1f, 100.0f);
-    }
+    // Model and normal matrices are precomputed by the transform system
+    const float* model = gTransforms.getWorldMatrix(gTableTransform);
+    const float* normalMatrix = gTransforms.getNormalMatrix(gTableTransform);
+
     // Set the shader to be used
     glUseProgram(gProgramId);
 
     // Retrieves and passes transform matrices to the Shader program
     GLint modelLoc = glGetUniformLocation(gProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gProgramId, "projection");
+    GLint normalLoc = glGetUniformLocation(gProgramId, "normalMatrix");
 
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, model);
+    glUniformMatrix3fv(normalLoc, 1, GL_FALSE, normalMatrix);
+    UBindTexture(0, texture, textureLayer, textureMaterial);
     // Activate the VBOs contained within the mesh's VAO
     glBindVertexArray(tblMesh.vao);
 
     // Draws pyramid
-    glDrawElements(GL_TRIANGLES, tblMesh.nIndices, GL_UNSIGNED_SHORT, 0); // Draws the triangle
+    glDrawElements(GL_TRIANGLES, tblMesh.nIndices, tblMesh.indexType, 0); // Draws the triangle
     glBindVertexArray(0);
 }
 
@@ -1063,7 +2032,7 @@ void CreateLaptopScreen(GLMesh& screenMesh) {
     };
 
     // Index data to share position data
-    GLushort indices[] = {
+    GLuint indices[] = {
         0, 1, 3, // Triangle 1
         3,2,1, // Triangle 2
         0, 1, 4, // Triangle 3
@@ -1078,6 +2047,9 @@ void CreateLaptopScreen(GLMesh& screenMesh) {
         1, 2, 7  // Triangle 12
     };
 
+    // Reorder triangles and vertices for the GPU caches before upload
+    UOptimizeMesh("Laptop screen", indices, sizeof(indices) / sizeof(indices[0]), verts, 5, sizeof(verts) / sizeof(verts[0]) / 5);
+
     const GLuint floatsPerVertex = 3;
     const GLuint floatsPerTexture = 2;
 
@@ -1089,9 +2061,8 @@ void CreateLaptopScreen(GLMesh& screenMesh) {
     glBindBuffer(GL_ARRAY_BUFFER, screenMesh.vbos[0]); // Activates the buffer
     glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
 
-    screenMesh.nIndices = sizeof(indices) / sizeof(indices[0]);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, screenMesh.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    UUploadIndices(screenMesh, indices, sizeof(indices) / sizeof(indices[0]), sizeof(verts) / sizeof(verts[0]) / 5);
     // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
     GLint stride = sizeof(float) * (floatsPerVertex + floatsPerTexture);// The number of floats before each
 
@@ -1102,54 +2073,12 @@ void CreateLaptopScreen(GLMesh& screenMesh) {
     glVertexAttribPointer(2, floatsPerTexture, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * floatsPerTexture));
     glEnableVertexAttribArray(2);
 
-    glGenTextures(1, &screenTexture);
-    glBindTexture(GL_TEXTURE_2D, screenTexture);
-
-    // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // load and generate the texture
-    int width, height, nrChannels;
-
-    unsigned char* data = stbi_load("assets/textures/desktop.png", &width, &height, &nrChannels, 0);
-    //flipImageVertically(data, width, height, nrChannels);
-    if (data)
-    {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
+    UAddTexture(screenTexture, screenMaterial, "assets/textures/desktop.png", TextureManager::Sampler::trilinear());
+    screenLayer = gTextureArrays.add("assets/textures/desktop.png");
 
     //Loading second texture
-    glGenTextures(1, &desktopTexture);
-    glBindTexture(GL_TEXTURE_2D, desktopTexture);
-
-    // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    data = stbi_load("assets/textures/screen.png", &width, &height, &nrChannels, 0);
-    //flipImageVertically(data, width, height, nrChannels);
-
-    if (data)
-    {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
+    UAddTexture(desktopTexture, desktopMaterial, "assets/textures/screen.png", TextureManager::Sampler::trilinear());
+    desktopLayer = gTextureArrays.add("assets/textures/screen.png");
     // Set the shader to be used
     glUseProgram(gProgramId);
     // We set the texture as texture unit 0
@@ -1160,48 +2089,29 @@ void CreateLaptopScreen(GLMesh& screenMesh) {
 
 // Renders laptop lid
 void RenderLaptopScreen() {
-    // 1. Scales the object by 2
-    glm::mat4 scale = glm::scale(glm::vec3(3.89f, 1.99f, 2.0f));
-    // 2. Rotates shape by 15 degrees in the x axis
-    glm::mat4 rotation = glm::rotate(4.6f, glm::vec3(1.0f, 0.0f, 0.0f));
-    // 3. Place object at the origin
-    glm::mat4 translation = glm::translate(glm::vec3(0.0f, 2.0f, -4.49f));
-    // Model matrix: transformations are applied right-to-left order
-    glm::mat4 model = translation * rotation * scale;
-
-    // Transforms the camera: move the camera back (z axis)
-    //glm::mat4 view = glm::translate(glm::vec3(0.0f, 1.3f, -6.0f));
-    //takes in the current camera postion
-    glm::mat4 view = camera.GetViewMatrix();
-    // Creates a perspective projection
-    glm::mat4 projection = glm::perspective(45.0f, (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
-    //**Updates projection to orthogonal if flag is set
-    if (isOrtho == true) {
-        projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 0.1f, 100.0f);
-    }
+    // Model and normal matrices are precomputed by the transform system
+    const float* model = gTransforms.getWorldMatrix(gScreenTransform);
+    const float* normalMatrix = gTransforms.getNormalMatrix(gScreenTransform);
+
     // Set the shader to be used
     glUseProgram(gProgramId);
 
 
     // Retrieves and passes transform matrices to the Shader program
     GLint modelLoc = glGetUniformLocation(gProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gProgramId, "projection");
+    GLint normalLoc = glGetUniformLocation(gProgramId, "normalMatrix");
 
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, model);
+    glUniformMatrix3fv(normalLoc, 1, GL_FALSE, normalMatrix);
 
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, screenTexture);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, desktopTexture);
+    UBindTexture(0, screenTexture, screenLayer, screenMaterial);
+    UBindTexture(1, desktopTexture, desktopLayer, desktopMaterial);
     // Activate the VBOs contained within the mesh's VAO
     glBindVertexArray(screenMesh.vao);
 
     // Draws pyramid
-    glDrawElements(GL_TRIANGLES, screenMesh.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle
+    glDrawElements(GL_TRIANGLES, screenMesh.nIndices, screenMesh.indexType, NULL); // Draws the triangle
     glBindVertexArray(0);
 }
 
@@ -1221,7 +2131,7 @@ void CreateLight(GLMesh& lightMesh) {
     };
 
     // Index data to share position data
-    GLushort indices[] = {
+    GLuint indices[] = {
         0, 1, 3, // Triangle 1
         1, 2, 3, // Triangle 2
         0, 1, 4, // Triangle 3
@@ -1236,6 +2146,9 @@ void CreateLight(GLMesh& lightMesh) {
         1, 2, 7  // Triangle 12
     };
 
+    // Reorder triangles and vertices for the GPU caches before upload
+    UOptimizeMesh("Light", indices, sizeof(indices) / sizeof(indices[0]), verts, 5, sizeof(verts) / sizeof(verts[0]) / 5);
+
     const GLuint floatsPerVertex = 3;
 
     const GLuint floatsPerTexture = 2;
@@ -1250,9 +2163,8 @@ void CreateLight(GLMesh& lightMesh) {
     glBindBuffer(GL_ARRAY_BUFFER, lightMesh.vbos[0]); // Activates the buffer
     glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
 
-    lightMesh.nIndices = sizeof(indices) / sizeof(indices[0]);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lightMesh.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    UUploadIndices(lightMesh, indices, sizeof(indices) / sizeof(indices[0]), sizeof(verts) / sizeof(verts[0]) / 5);
 
     // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
     GLint stride = sizeof(float) * (floatsPerVertex + floatsPerTexture);// The number of floats before each
@@ -1268,374 +2180,206 @@ void CreateLight(GLMesh& lightMesh) {
     glVertexAttribPointer(2, floatsPerTexture, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * floatsPerTexture));
     glEnableVertexAttribArray(2);
 
-    glGenTextures(1, &texture2);
-    glBindTexture(GL_TEXTURE_2D, texture2);
-    // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // load and generate the texture
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load("assets/textures/light.png", &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
-}
-
-void RenderLight(float pos) {
-    // 1. Scales the object by 2
-    glm::mat4 scale = glm::scale(glm::vec3(0.5f, 0.5f, 0.5f));
-    // 2. Rotates shape by 15 degrees in the x axis
-    glm::mat4 rotation = glm::rotate(0.0f, glm::vec3(1.0f, 1.0f, 1.0f));
-    // 3. Place object at the origin
-    glm::mat4 translation = glm::translate(glm::vec3(pos, 7.0f, -4.0f)); //-2.0f
-    // Model matrix: transformations are applied right-to-left order
-    glm::mat4 model = translation * rotation * scale;
-
-    // Transforms the camera: move the camera back (z axis)
-    //glm::mat4 view = glm::translate(glm::vec3(0.0f, 1.3f, -6.0f));
-    //takes in the current camera postion
-    glm::mat4 view = camera.GetViewMatrix();
-    // Creates a perspective projection
-    glm::mat4 projection = glm::perspective(45.0f, (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
-
-    //**Updates projection to orthogonal if flag is set
-    if (isOrtho == true) {
-        projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 0.1f, 100.0f);
-    }
+    UAddTexture(texture2, texture2Material, "assets/textures/light.png", TextureManager::Sampler::trilinear());
+    texture2Layer = gTextureArrays.add("assets/textures/light.png");
+}
+
+void RenderLight(unsigned int transformId) {
+    // Model and normal matrices are precomputed by the transform system
+    const float* model = gTransforms.getWorldMatrix(transformId);
+    const float* normalMatrix = gTransforms.getNormalMatrix(transformId);
+
     // Set the shader to be used
     glUseProgram(gProgramId);
 
     // Retrieves and passes transform matrices to the Shader program
     GLint modelLoc = glGetUniformLocation(gProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gProgramId, "projection");
+    GLint normalLoc = glGetUniformLocation(gProgramId, "normalMatrix");
 
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture2);
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, model);
+    glUniformMatrix3fv(normalLoc, 1, GL_FALSE, normalMatrix);
+    UBindTexture(0, texture2, texture2Layer, texture2Material);
     // Activate the VBOs contained within the mesh's VAO
     glBindVertexArray(lightMesh.vao);
 
     // Draws pyramid
-    glDrawElements(GL_TRIANGLES, lightMesh.nIndices, GL_UNSIGNED_SHORT, 0); // Draws the triangle
+    glDrawElements(GL_TRIANGLES, lightMesh.nIndices, lightMesh.indexType, 0); // Draws the triangle
     glBindVertexArray(0);
 }
 
 // loads vertex, index, and color data into for laptop lid into mesh
-void CreatePencil(GLMesh& cylMesh) {
-     //Position and Color data
-    const int size1 = cylinder1.getTexCoordCount() ;
-    int count=0;
-    int texCount = 0;
-    GLfloat verts[618+412];
-
-    for (int i = 0; i < 618+412; i+=5){
-        verts[i] = cylinder1.getVertices()[count];
-        verts[i + 1] = cylinder1.getVertices()[count + 1];
-        verts[i + 2] = cylinder1.getVertices()[count + 2];
-        count += 3;
-        verts[i + 3] = cylinder1.getTexCoords()[texCount];
-        verts[i + 4] = cylinder1.getTexCoords()[texCount+1];
-        texCount += 2;
-    }
-
-    GLfloat intverts[618];
-    
-    
-    
-    // Index data to share position data
-    GLushort indices[324];
-
-    for (int i = 0; i < 324; i++) {
-        indices[i] = cylinder1.getIndices()[i];
-    }
-
-    const GLuint floatsPerVertex = 3;
-
-    const GLuint floatsPerTexture = 2;
-
-      
-
-    glGenVertexArrays(1, &cylMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(cylMesh.vao);
-
-    // Create 2 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(2, cylMesh.vbos);
-    glBindBuffer(GL_ARRAY_BUFFER, cylMesh.vbos[0]); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-    cylMesh.nIndices = cylinder1.getIndexCount();
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cylMesh.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerTexture);// The number of floats before each
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
+// CPU phase of the pencil, runs on a worker thread
+void BuildPencil(MeshSource& source) {
+    const uint64_t key = UCylinderKey(cylinder1, 5);
+    if (!UFindCachedMesh(source, "Pencil", key))
+    {
+        Cylinder cylinder = UBuildCylinder(cylinder1);
+
+        //Position and Color data
+        // sized from the cylinder so any sector/stack count fits
+        const unsigned int vertCount = cylinder.getVertexCount();
+        int count = 0;
+        int texCount = 0;
+        std::vector<GLfloat> verts(vertCount * 5);
+
+        for (unsigned int i = 0; i < verts.size(); i += 5) {
+            verts[i] = cylinder.getVertices()[count];
+            verts[i + 1] = cylinder.getVertices()[count + 1];
+            verts[i + 2] = cylinder.getVertices()[count + 2];
+            count += 3;
+            verts[i + 3] = cylinder.getTexCoords()[texCount];
+            verts[i + 4] = cylinder.getTexCoords()[texCount + 1];
+            texCount += 2;
+        }
 
+        // Index data to share position data
+        std::vector<GLuint> indices(cylinder.getIndices(), cylinder.getIndices() + cylinder.getIndexCount());
 
-    glVertexAttribPointer(2, floatsPerTexture, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * floatsPerTexture));
-    glEnableVertexAttribArray(2);
+        // Merge the vertices duplicated per face, then reorder for the GPU caches before upload
+        UWeldMesh("Pencil", verts, indices, 5);
+        UOptimizeMesh("Pencil", indices.data(), indices.size(), verts.data(), 5, verts.size() / 5);
 
-    glGenTextures(1, &pencilTexture);
-    glBindTexture(GL_TEXTURE_2D, pencilTexture);
-    // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // load and generate the texture
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load("assets/textures/yellow.png", &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        // 3 floats of position then 2 of texture coords
+        UAddMeshToCache(source, "Pencil", key, UVertexFormat(3, 2), verts, indices);
     }
-    else
-    {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
+}
+void CreatePencil(GLMesh& cylMesh, const MeshSource& source) {
+    UCreateMeshFromSource(cylMesh, source);
+
+    UAddTexture(pencilTexture, pencilMaterial, "assets/textures/yellow.png", TextureManager::Sampler::trilinear());
+    pencilLayer = gTextureArrays.add("assets/textures/yellow.png");
 }
 
 void RenderPencil() {
-    // 1. Scales the object by 2
-    glm::mat4 scale = glm::scale(glm::vec3(1.0f, 1.0f, 1.0f));
-    // 2. Rotates shape by 15 degrees in the x axis
-    glm::mat4 rotation = glm::rotate(4.6f, glm::vec3(2.0f, 99.9f, 0.0f));
-    // 3. Place object at the origin
-    glm::mat4 translation = glm::translate(glm::vec3(3.0f, 0.05f, -0.49f));
-    // Model matrix: transformations are applied right-to-left order
-    glm::mat4 model = translation * rotation * scale;
-
-    // Transforms the camera: move the camera back (z axis)
-    //glm::mat4 view = glm::translate(glm::vec3(0.0f, 1.3f, -6.0f));
-    //takes in the current camera postion
-    glm::mat4 view = camera.GetViewMatrix();
-    // Creates a perspective projection
-    glm::mat4 projection = glm::perspective(45.0f, (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
-    //**Updates projection to orthogonal if flag is set
-    if (isOrtho == true) {
-        projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 0.1f, 100.0f);
-    }
+    // Model and normal matrices are precomputed by the transform system
+    const float* model = gTransforms.getWorldMatrix(gPencilTransform);
+    const float* normalMatrix = gTransforms.getNormalMatrix(gPencilTransform);
+
     // Set the shader to be used
     glUseProgram(gProgramId);
 
 
     // Retrieves and passes transform matrices to the Shader program
     GLint modelLoc = glGetUniformLocation(gProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gProgramId, "projection");
+    GLint normalLoc = glGetUniformLocation(gProgramId, "normalMatrix");
 
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, pencilTexture);
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, model);
+    glUniformMatrix3fv(normalLoc, 1, GL_FALSE, normalMatrix);
+    UBindTexture(0, pencilTexture, pencilLayer, pencilMaterial);
     
     // Activate the VBOs contained within the mesh's VAO
     glBindVertexArray(cylMesh.vao);
 
     // Draws pyramid
-    glDrawElements(GL_TRIANGLES, cylMesh.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle
+    glDrawElements(GL_TRIANGLES, cylMesh.nIndices, cylMesh.indexType, NULL); // Draws the triangle
     glBindVertexArray(0);
 }
 
 // loads vertex, index, and color data into for laptop lid into mesh
-void CreatePods(GLMesh& podMesh) {
-    //Position and Color data
-    const int vertCount = cylinder2.getVertexCount();
-    int indCount = cylinder2.getIndexCount();
+// CPU phase of the headphone case, runs on a worker thread
+void BuildPods(MeshSource& source) {
+    const uint64_t key = UCylinderKey(cylinder2, 3);
+    if (UFindCachedMesh(source, "Headphone case", key))
+        return;
 
-    GLfloat verts[1806];
+    Cylinder cylinder = UBuildCylinder(cylinder2);
 
-    for (int i = 0; i < 1806; i ++) {
-        verts[i] = cylinder2.getVertices()[i];
-    }
+    //Position and Color data, sized from the cylinder so any sector/stack count fits
+    const unsigned int vertCount = cylinder.getVertexCount();
 
+    std::vector<GLfloat> verts(cylinder.getVertices(), cylinder.getVertices() + vertCount * 3);
 
     // Index data to share position data
-    GLushort indices[1200];
-
-    for (int i = 0; i < 1200; i++) {
-        indices[i] = cylinder2.getIndices()[i];
-    }
-
-    const GLuint floatsPerVertex = 3;
-
-    const GLuint floatsPerTexture = 0;
-
-
-
-    glGenVertexArrays(1, &podMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(podMesh.vao);
-
-    // Create 2 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(2, podMesh.vbos);
-    glBindBuffer(GL_ARRAY_BUFFER, podMesh.vbos[0]); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-    podMesh.nIndices = cylinder2.getIndexCount();
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, podMesh.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerTexture);// The number of floats before each
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(0);
-
+    std::vector<GLuint> indices(cylinder.getIndices(), cylinder.getIndices() + cylinder.getIndexCount());
 
+    // Merge the vertices duplicated per face, then reorder for the GPU caches before upload
+    UWeldMesh("Headphone case", verts, indices, 3);
+    UOptimizeMesh("Headphone case", indices.data(), indices.size(), verts.data(), 3, verts.size() / 3);
 
+    // Positions only
+    UAddMeshToCache(source, "Headphone case", key, UVertexFormat(3, 0), verts, indices);
+}
+void CreatePods(GLMesh& podMesh, const MeshSource& source) {
+    UCreateMeshFromSource(podMesh, source);
 }
 
 void RenderPods() {
-    // 1. Scales the object by 2
-    glm::mat4 scale = glm::scale(glm::vec3(0.5f, 0.25f, 0.5f));
-    // 2. Rotates shape by 15 degrees in the x axis
-    glm::mat4 rotation = glm::rotate(4.6f, glm::vec3(2.0f, 99.9f, 0.0f));
-    // 3. Place object at the origin
-    glm::mat4 translation = glm::translate(glm::vec3(-3.5f, 0.1f, -1.49f));
-    // Model matrix: transformations are applied right-to-left order
-    glm::mat4 model = translation * rotation * scale;
-
-    // Transforms the camera: move the camera back (z axis)
-    //glm::mat4 view = glm::translate(glm::vec3(0.0f, 1.3f, -6.0f));
-    //takes in the current camera postion
-    glm::mat4 view = camera.GetViewMatrix();
-    // Creates a perspective projection
-    glm::mat4 projection = glm::perspective(45.0f, (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
-    //**Updates projection to orthogonal if flag is set
-    if (isOrtho == true) {
-        projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 0.1f, 100.0f);
-    }
+    // Model and normal matrices are precomputed by the transform system
+    const float* model = gTransforms.getWorldMatrix(gPodTransform);
+    const float* normalMatrix = gTransforms.getNormalMatrix(gPodTransform);
+
     // Set the shader to be used
     glUseProgram(gProgramId);
 
 
     // Retrieves and passes transform matrices to the Shader program
     GLint modelLoc = glGetUniformLocation(gProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gProgramId, "projection");
+    GLint normalLoc = glGetUniformLocation(gProgramId, "normalMatrix");
 
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, model);
+    glUniformMatrix3fv(normalLoc, 1, GL_FALSE, normalMatrix);
 
     // Activate the VBOs contained within the mesh's VAO
     glBindVertexArray(podMesh.vao);
 
     // Draws pyramid
-    glDrawElements(GL_TRIANGLES, podMesh.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle
+    glDrawElements(GL_TRIANGLES, podMesh.nIndices, podMesh.indexType, NULL); // Draws the triangle
     glBindVertexArray(0);
 }
 
 // loads vertex, index, and color data into for laptop lid into mesh
-void CreateCan(GLMesh& canMesh) {
-    //Position and Color data
-    const int vertCount = cylinder3.getVertexCount();
-    int indCount = cylinder3.getIndexCount();
+// CPU phase of the soda can, runs on a worker thread
+void BuildCan(MeshSource& source) {
+    const uint64_t key = UCylinderKey(cylinder3, 3);
+    if (UFindCachedMesh(source, "Soda can", key))
+        return;
 
-    GLfloat verts[22146];
-
-    for (int i = 0; i < 22146; i++) {
-        verts[i] = cylinder3.getVertices()[i];
-    }
-
-
-    // Index data to share position data
-    GLushort indices[11316];
-
-    for (int i = 0; i < 11316; i++) {
-        indices[i] = cylinder3.getIndices()[i];
+    Cylinder cylinder = UBuildCylinder(cylinder3);
+    {
+        std::lock_guard<std::mutex> lock(gLogMutex);
+        cylinder.printSelf();
     }
 
-    const GLuint floatsPerVertex = 3;
-
-    const GLuint floatsPerTexture = 0;
+    //Position and Color data, sized from the cylinder so any sector/stack count fits
+    const unsigned int vertCount = cylinder.getVertexCount();
 
+    std::vector<GLfloat> verts(cylinder.getVertices(), cylinder.getVertices() + vertCount * 3);
 
+    // Index data to share position data
+    std::vector<GLuint> indices(cylinder.getIndices(), cylinder.getIndices() + cylinder.getIndexCount());
 
-    glGenVertexArrays(1, &canMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(canMesh.vao);
-
-    // Create 2 buffers: first one for the vertex data; second one for the indices
-    glGenBuffers(2, canMesh.vbos);
-    glBindBuffer(GL_ARRAY_BUFFER, canMesh.vbos[0]); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-    canMesh.nIndices = cylinder3.getIndexCount();
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, canMesh.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerTexture);// The number of floats before each
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(0);
-
-
+    // Merge the vertices duplicated per face, then reorder for the GPU caches before upload
+    UWeldMesh("Soda can", verts, indices, 3);
+    UOptimizeMesh("Soda can", indices.data(), indices.size(), verts.data(), 3, verts.size() / 3);
 
+    // Positions only
+    UAddMeshToCache(source, "Soda can", key, UVertexFormat(3, 0), verts, indices);
+}
+void CreateCan(GLMesh& canMesh, const MeshSource& source) {
+    UCreateMeshFromSource(canMesh, source);
 }
 
 void RenderCan() {
-    // 1. Scales the object by 2
-    glm::mat4 scale = glm::scale(glm::vec3(0.5f, 0.5f, 0.5f));
-    // 2. Rotates shape by 15 degrees in the x axis
-    glm::mat4 rotation = glm::rotate(4.7f, glm::vec3(0.01f, 0.0f, 0.0f));
-    // 3. Place object at the origin
-    glm::mat4 translation = glm::translate(glm::vec3(-3.0f, 0.5f, -4.00f));
-    // Model matrix: transformations are applied right-to-left order
-    glm::mat4 model = translation * rotation * scale;
-
-    // Transforms the camera: move the camera back (z axis)
-    //glm::mat4 view = glm::translate(glm::vec3(0.0f, 1.3f, -6.0f));
-    //takes in the current camera postion
-    glm::mat4 view = camera.GetViewMatrix();
-    // Creates a perspective projection
-    glm::mat4 projection = glm::perspective(45.0f, (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
-    //**Updates projection to orthogonal if flag is set
-    if (isOrtho == true) {
-        projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 0.1f, 100.0f);
-    }
+    // Model and normal matrices are precomputed by the transform system
+    const float* model = gTransforms.getWorldMatrix(gCanTransform);
+    const float* normalMatrix = gTransforms.getNormalMatrix(gCanTransform);
+
     // Set the shader to be used
     glUseProgram(gProgramId);
 
 
     // Retrieves and passes transform matrices to the Shader program
     GLint modelLoc = glGetUniformLocation(gProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gProgramId, "projection");
+    GLint normalLoc = glGetUniformLocation(gProgramId, "normalMatrix");
 
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, model);
+    glUniformMatrix3fv(normalLoc, 1, GL_FALSE, normalMatrix);
 
     // Activate the VBOs contained within the mesh's VAO
     glBindVertexArray(canMesh.vao);
 
     // Draws pyramid
-    glDrawElements(GL_TRIANGLES, canMesh.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle
+    glDrawElements(GL_TRIANGLES, canMesh.nIndices, canMesh.indexType, NULL); // Draws the triangle
     glBindVertexArray(0);
 }
 
@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+// SpscQueue.h
+// ===========
+// Bounded single-producer single-consumer FIFO queue without locks: a ring
+// with a write index only the producer stores and a read index only the
+// consumer stores, so push() and pop() are a load, a copy and a store, no
+// compare-and-swap (see LockFreeQueue.h for any number of threads).
+// Each side caches the other side's index and reloads it only when the ring
+// looks full or empty, so the indices' cache lines rarely move.
+//
+// push() returns false when the queue is full and pop() returns false when
+// it is empty; neither ever blocks.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+template <typename T>
+class SpscQueue
+{
+public:
+    // capacity is rounded up to a power of 2
+    explicit SpscQueue(size_t capacity = 256) : cells(roundUp(capacity)), mask(roundUp(capacity) - 1),
+                                                head(0), cachedTail(0), tail(0), cachedHead(0)
+    {
+    }
+
+    // producer only
+    bool push(const T& value)
+    {
+        const size_t position = tail.load(std::memory_order_relaxed);
+        if(position - cachedHead > mask)
+        {
+            cachedHead = head.load(std::memory_order_acquire);
+            if(position - cachedHead > mask)
+                return false;           // full
+        }
+        cells[position & mask] = value;
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only
+    bool pop(T& value)
+    {
+        const size_t position = head.load(std::memory_order_relaxed);
+        if(position == cachedTail)
+        {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if(position == cachedTail)
+                return false;           // empty
+        }
+        value = cells[position & mask];
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t getCapacity() const          { return mask + 1; }
+
+private:
+    // not copyable, the cells are shared with another thread
+    SpscQueue(const SpscQueue&);
+    SpscQueue& operator=(const SpscQueue&);
+
+    static size_t roundUp(size_t n)
+    {
+        size_t size = 2;
+        while(size < n)
+            size <<= 1;
+        return size;
+    }
+
+    std::vector<T> cells;
+    const size_t mask;
+    // consumer and producer on separate cache lines, each with its copy of the other's index
+    // padded rather than aligned, new does not honour over-alignment before C++17
+    char pad0[64];
+    std::atomic<size_t> head;
+    size_t cachedTail;
+    char pad1[64];
+    std::atomic<size_t> tail;
+    size_t cachedHead;
+    char pad2[64];
+};
+
+#endif
@@ -0,0 +1,369 @@
+///////////////////////////////////////////////////////////////////////////////
+// TangentGenerator.cpp
+// ====================
+// Per-vertex tangent space generation (MikkTSpace conventions).
+// 1. accumulate angle weighted face tangents per corner  (parallel blocks)
+// 2. merge the per-block accumulators per vertex          (parallel)
+// 3. Gram-Schmidt orthogonalize and compute the sign      (parallel, SSE)
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include "TangentGenerator.h"
+#include "Parallel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TANGENT_SSE2
+#endif
+
+
+
+namespace
+{
+    // minimum # of triangles per accumulation block
+    const unsigned int MIN_TRIANGLE_BLOCK = 4096;
+
+    struct Vec3
+    {
+        float x, y, z;
+    };
+
+    const Vec3& attribute3(const float* base, unsigned int stride, unsigned int i)
+    {
+        return *(const Vec3*)((const char*)base + (size_t)i * stride);
+    }
+
+    const float* attribute2(const float* base, unsigned int stride, unsigned int i)
+    {
+        return (const float*)((const char*)base + (size_t)i * stride);
+    }
+
+    Vec3 sub(const Vec3& a, const Vec3& b)              { Vec3 r = { a.x - b.x, a.y - b.y, a.z - b.z }; return r; }
+    Vec3 scale(const Vec3& a, float s)                  { Vec3 r = { a.x * s, a.y * s, a.z * s }; return r; }
+    float dot(const Vec3& a, const Vec3& b)             { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+    // normalize, leave a zero vector as it is
+    Vec3 normalize(const Vec3& v)
+    {
+        float len = sqrtf(dot(v, v));
+        return len > 1e-20f ? scale(v, 1.0f / len) : v;
+    }
+
+    // remove the component along unit vector n and normalize
+    Vec3 project(const Vec3& v, const Vec3& n)
+    {
+        return normalize(sub(v, scale(n, dot(n, v))));
+    }
+
+    // per block accumulator: 6 floats (tangent, bitangent) per vertex of [first, last]
+    struct Accumulator
+    {
+        unsigned int first;
+        unsigned int last;
+        std::vector<float> sums;
+    };
+
+    // accumulate the triangles [begin, end) into acc
+    void accumulate(const TangentGenerator::VertexLayout& layout, const unsigned int* indices,
+                    unsigned int begin, unsigned int end, Accumulator& acc)
+    {
+        // vertex range of the block
+        acc.first = ~0u;
+        acc.last = 0;
+        for(unsigned int i = begin * 3; i < end * 3; ++i)
+        {
+            if(indices[i] < acc.first) acc.first = indices[i];
+            if(indices[i] > acc.last)  acc.last = indices[i];
+        }
+        if(begin == end)
+            return;
+        acc.sums.assign((size_t)(acc.last - acc.first + 1) * 6, 0.0f);
+
+        const unsigned int stride = layout.stride;
+        for(unsigned int t = begin; t < end; ++t)
+        {
+            const unsigned int* tri = &indices[t * 3];
+            const Vec3& p0 = attribute3(layout.positions, stride, tri[0]);
+            const Vec3& p1 = attribute3(layout.positions, stride, tri[1]);
+            const Vec3& p2 = attribute3(layout.positions, stride, tri[2]);
+            const float* uv0 = attribute2(layout.texCoords, stride, tri[0]);
+            const float* uv1 = attribute2(layout.texCoords, stride, tri[1]);
+            const float* uv2 = attribute2(layout.texCoords, stride, tri[2]);
+
+            Vec3 d1 = sub(p1, p0);
+            Vec3 d2 = sub(p2, p0);
+            float s1 = uv1[0] - uv0[0], t1 = uv1[1] - uv0[1];
+            float s2 = uv2[0] - uv0[0], t2 = uv2[1] - uv0[1];
+
+            // face tangent/bitangent directions, flipped on mirrored faces
+            float sign = (s1 * t2 - s2 * t1) < 0 ? -1.0f : 1.0f;
+            Vec3 faceT = { t2 * d1.x - t1 * d2.x, t2 * d1.y - t1 * d2.y, t2 * d1.z - t1 * d2.z };
+            Vec3 faceB = { s1 * d2.x - s2 * d1.x, s1 * d2.y - s2 * d1.y, s1 * d2.z - s2 * d1.z };
+            faceT = scale(normalize(faceT), sign);
+            faceB = scale(normalize(faceB), sign);
+
+            for(int k = 0; k < 3; ++k)
+            {
+                unsigned int v = tri[k];
+                const Vec3& p = attribute3(layout.positions, stride, v);
+                const Vec3& n = attribute3(layout.normals, stride, v);
+                const Vec3& pNext = attribute3(layout.positions, stride, tri[(k + 1) % 3]);
+                const Vec3& pPrev = attribute3(layout.positions, stride, tri[(k + 2) % 3]);
+
+                // corner angle in the tangent plane of the vertex
+                float c = dot(project(sub(pNext, p), n), project(sub(pPrev, p), n));
+                if(c > 1.0f) c = 1.0f;
+                if(c < -1.0f) c = -1.0f;
+                float weight = acosf(c);
+
+                Vec3 tangent = scale(project(faceT, n), weight);
+                Vec3 bitangent = scale(project(faceB, n), weight);
+                float* sum = &acc.sums[(size_t)(v - acc.first) * 6];
+                sum[0] += tangent.x;   sum[1] += tangent.y;   sum[2] += tangent.z;
+                sum[3] += bitangent.x; sum[4] += bitangent.y; sum[5] += bitangent.z;
+            }
+        }
+    }
+
+    // any unit vector perpendicular to n, for vertices without UV gradient
+    Vec3 perpendicular(const Vec3& n)
+    {
+        Vec3 axis = { 1.0f, 0.0f, 0.0f };
+        if(fabsf(n.x) > 0.9f)
+        {
+            axis.x = 0.0f;
+            axis.y = 1.0f;
+        }
+        return project(axis, n);
+    }
+
+    // orthogonalize one vertex: t = normalize(t - n * dot(n, t)), b = sign * cross(n, t)
+    void orthogonalize(const Vec3& n, Vec3 t, const Vec3& b, Vec3& tangent, Vec3& bitangent)
+    {
+        t = sub(t, scale(n, dot(n, t)));
+        float len2 = dot(t, t);
+        t = len2 > 1e-20f ? scale(t, 1.0f / sqrtf(len2)) : perpendicular(n);
+
+        Vec3 c = { n.y * t.z - n.z * t.y, n.z * t.x - n.x * t.z, n.x * t.y - n.y * t.x };
+        float sign = dot(c, b) < 0 ? -1.0f : 1.0f;
+        tangent = t;
+        bitangent = scale(c, sign);
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// compute per-vertex tangents and bitangents
+///////////////////////////////////////////////////////////////////////////////
+void TangentGenerator::generate(const VertexLayout& layout, unsigned int vertexCount,
+                                const unsigned int* indices, unsigned int indexCount, unsigned int threadCount)
+{
+    if(vertexCount == 0)
+        return;
+    if(threadCount == 0)
+        threadCount = Parallel::getDefaultThreadCount();
+
+    const unsigned int stride = layout.stride;
+    const unsigned int triangleCount = indexCount / 3;
+
+    // 1. accumulate per block, blocks only write to their own accumulator
+    std::vector<Accumulator> accumulators(Parallel::getBlockCount(triangleCount, threadCount, MIN_TRIANGLE_BLOCK));
+    Parallel::forEach(triangleCount, threadCount, [&](unsigned int begin, unsigned int end, unsigned int block)
+    {
+        accumulate(layout, indices, begin, end, accumulators[block]);
+    }, MIN_TRIANGLE_BLOCK);
+
+    // 2. merge into SoA arrays, each vertex is owned by one thread
+    std::vector<float> soa((size_t)vertexCount * 9);
+    float* nx = &soa[0];
+    float* ny = nx + vertexCount;
+    float* nz = ny + vertexCount;
+    float* tx = nz + vertexCount;
+    float* ty = tx + vertexCount;
+    float* tz = ty + vertexCount;
+    float* bx = tz + vertexCount;
+    float* by = bx + vertexCount;
+    float* bz = by + vertexCount;
+    Parallel::forEach(vertexCount, threadCount, [&](unsigned int begin, unsigned int end, unsigned int)
+    {
+        for(unsigned int v = begin; v < end; ++v)
+        {
+            const Vec3& n = attribute3(layout.normals, stride, v);
+            nx[v] = n.x; ny[v] = n.y; nz[v] = n.z;
+            tx[v] = ty[v] = tz[v] = bx[v] = by[v] = bz[v] = 0;
+        }
+        for(size_t a = 0; a < accumulators.size(); ++a)
+        {
+            const Accumulator& acc = accumulators[a];
+            if(acc.sums.empty())
+                continue;
+            unsigned int first = acc.first > begin ? acc.first : begin;
+            unsigned int last = acc.last + 1 < end ? acc.last + 1 : end;
+            for(unsigned int v = first; v < last; ++v)
+            {
+                const float* sum = &acc.sums[(size_t)(v - acc.first) * 6];
+                tx[v] += sum[0]; ty[v] += sum[1]; tz[v] += sum[2];
+                bx[v] += sum[3]; by[v] += sum[4]; bz[v] += sum[5];
+            }
+        }
+    });
+    accumulators.clear();
+
+    // 3. Gram-Schmidt, 4 vertices at a time
+    Parallel::forEach(vertexCount, threadCount, [&](unsigned int begin, unsigned int end, unsigned int)
+    {
+        unsigned int v = begin;
+#if defined(TANGENT_SSE2)
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 epsilon = _mm_set1_ps(1e-20f);
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+        for(; v + 4 <= end; v += 4)
+        {
+            __m128 Nx = _mm_loadu_ps(nx + v), Ny = _mm_loadu_ps(ny + v), Nz = _mm_loadu_ps(nz + v);
+            __m128 Tx = _mm_loadu_ps(tx + v), Ty = _mm_loadu_ps(ty + v), Tz = _mm_loadu_ps(tz + v);
+            __m128 Bx = _mm_loadu_ps(bx + v), By = _mm_loadu_ps(by + v), Bz = _mm_loadu_ps(bz + v);
+
+            // t -= n * dot(n, t)
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Nx, Tx), _mm_mul_ps(Ny, Ty)), _mm_mul_ps(Nz, Tz));
+            Tx = _mm_sub_ps(Tx, _mm_mul_ps(Nx, d));
+            Ty = _mm_sub_ps(Ty, _mm_mul_ps(Ny, d));
+            Tz = _mm_sub_ps(Tz, _mm_mul_ps(Nz, d));
+
+            __m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Tx, Tx), _mm_mul_ps(Ty, Ty)), _mm_mul_ps(Tz, Tz));
+            int degenerate = _mm_movemask_ps(_mm_cmple_ps(len2, epsilon));
+            __m128 invLen = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_max_ps(len2, epsilon)));
+            Tx = _mm_mul_ps(Tx, invLen);
+            Ty = _mm_mul_ps(Ty, invLen);
+            Tz = _mm_mul_ps(Tz, invLen);
+
+            // c = cross(n, t), flipped where it disagrees with the accumulated bitangent
+            __m128 Cx = _mm_sub_ps(_mm_mul_ps(Ny, Tz), _mm_mul_ps(Nz, Ty));
+            __m128 Cy = _mm_sub_ps(_mm_mul_ps(Nz, Tx), _mm_mul_ps(Nx, Tz));
+            __m128 Cz = _mm_sub_ps(_mm_mul_ps(Nx, Ty), _mm_mul_ps(Ny, Tx));
+            __m128 s = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Cx, Bx), _mm_mul_ps(Cy, By)), _mm_mul_ps(Cz, Bz));
+            __m128 flip = _mm_and_ps(_mm_cmplt_ps(s, zero), signBit);
+            Cx = _mm_xor_ps(Cx, flip);
+            Cy = _mm_xor_ps(Cy, flip);
+            Cz = _mm_xor_ps(Cz, flip);
+
+            float out[6][4];
+            _mm_storeu_ps(out[0], Tx); _mm_storeu_ps(out[1], Ty); _mm_storeu_ps(out[2], Tz);
+            _mm_storeu_ps(out[3], Cx); _mm_storeu_ps(out[4], Cy); _mm_storeu_ps(out[5], Cz);
+            for(int i = 0; i < 4; ++i)
+            {
+                Vec3* tangent = (Vec3*)((char*)layout.tangents + (size_t)(v + i) * stride);
+                Vec3* bitangent = (Vec3*)((char*)layout.bitangents + (size_t)(v + i) * stride);
+                if(degenerate & (1 << i))
+                {
+                    // no UV gradient, fall back to the scalar path
+                    Vec3 n = { nx[v + i], ny[v + i], nz[v + i] };
+                    Vec3 t = { tx[v + i], ty[v + i], tz[v + i] };
+                    Vec3 b = { bx[v + i], by[v + i], bz[v + i] };
+                    orthogonalize(n, t, b, *tangent, *bitangent);
+                    continue;
+                }
+                tangent->x = out[0][i];   tangent->y = out[1][i];   tangent->z = out[2][i];
+                bitangent->x = out[3][i]; bitangent->y = out[4][i]; bitangent->z = out[5][i];
+            }
+        }
+#endif
+        for(; v < end; ++v)
+        {
+            Vec3 n = { nx[v], ny[v], nz[v] };
+            Vec3 t = { tx[v], ty[v], tz[v] };
+            Vec3 b = { bx[v], by[v], bz[v] };
+            Vec3* tangent = (Vec3*)((char*)layout.tangents + (size_t)v * stride);
+            Vec3* bitangent = (Vec3*)((char*)layout.bitangents + (size_t)v * stride);
+            orthogonalize(n, t, b, *tangent, *bitangent);
+        }
+    });
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// time generate() on a wavy grid with 1, 4 and 16 threads
+///////////////////////////////////////////////////////////////////////////////
+void TangentGenerator::benchmark(unsigned int triangleCount)
+{
+    // grid of n x n quads, 2 triangles each
+    unsigned int n = (unsigned int)sqrtf(triangleCount / 2.0f);
+    if(n < 1)
+        n = 1;
+    unsigned int vertexCount = (n + 1) * (n + 1);
+
+    // position, normal, texcoord, tangent, bitangent
+    const unsigned int FLOATS = 14;
+    std::vector<float> vertices((size_t)vertexCount * FLOATS);
+    for(unsigned int y = 0; y <= n; ++y)
+    {
+        for(unsigned int x = 0; x <= n; ++x)
+        {
+            float* v = &vertices[(size_t)(y * (n + 1) + x) * FLOATS];
+            float u = (float)x / n, w = (float)y / n;
+            float h = 0.05f * sinf(u * 20.0f) * cosf(w * 20.0f);
+            float dx = 0.05f * 20.0f * cosf(u * 20.0f) * cosf(w * 20.0f);
+            float dy = -0.05f * 20.0f * sinf(u * 20.0f) * sinf(w * 20.0f);
+            float len = sqrtf(dx * dx + dy * dy + 1.0f);
+            v[0] = u;  v[1] = w;  v[2] = h;
+            v[3] = -dx / len;  v[4] = -dy / len;  v[5] = 1.0f / len;
+            v[6] = u;  v[7] = w;
+        }
+    }
+
+    std::vector<unsigned int> indices;
+    indices.reserve((size_t)n * n * 6);
+    for(unsigned int y = 0; y < n; ++y)
+    {
+        for(unsigned int x = 0; x < n; ++x)
+        {
+            unsigned int i0 = y * (n + 1) + x;
+            unsigned int i1 = i0 + 1;
+            unsigned int i2 = i0 + n + 1;
+            unsigned int i3 = i2 + 1;
+            indices.push_back(i0); indices.push_back(i1); indices.push_back(i3);
+            indices.push_back(i0); indices.push_back(i3); indices.push_back(i2);
+        }
+    }
+
+    VertexLayout layout;
+    layout.positions = &vertices[0];
+    layout.normals = &vertices[3];
+    layout.texCoords = &vertices[6];
+    layout.tangents = &vertices[8];
+    layout.bitangents = &vertices[11];
+    layout.stride = FLOATS * sizeof(float);
+
+    std::cout << "===== TangentGenerator benchmark =====\n"
+              << "Triangle Count: " << indices.size() / 3 << "\n"
+              << "  Vertex Count: " << vertexCount << "\n";
+
+    const unsigned int threadCounts[] = { 1, 4, 16 };
+    float singleTime = 0;
+    for(int i = 0; i < 3; ++i)
+    {
+        // best of 3 runs
+        float best = 0;
+        for(int run = 0; run < 3; ++run)
+        {
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            generate(layout, vertexCount, &indices[0], (unsigned int)indices.size(), threadCounts[i]);
+            float time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            if(run == 0 || time < best)
+                best = time;
+        }
+        if(i == 0)
+            singleTime = best;
+
+        std::cout << std::fixed << std::setprecision(3)
+                  << std::setw(4) << threadCounts[i] << " threads: " << best << " ms ("
+                  << std::setprecision(2) << (best > 0 ? singleTime / best : 0.0f) << "x)\n";
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6) << std::endl;
+}
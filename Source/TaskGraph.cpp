@@ -0,0 +1,239 @@
+///////////////////////////////////////////////////////////////////////////////
+// TaskGraph.cpp
+// =============
+// One-shot graph of tasks with dependencies, run on a pool of worker threads.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "TaskGraph.h"
+#include "Parallel.h"
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor
+///////////////////////////////////////////////////////////////////////////////
+TaskGraph::TaskGraph() : startTime(Clock::now()), endTime(startTime)
+{
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// add a task after its dependencies
+///////////////////////////////////////////////////////////////////////////////
+unsigned int TaskGraph::add(const char* name, Function function, std::initializer_list<unsigned int> dependencies,
+                            Affinity affinity)
+{
+    unsigned int id = (unsigned int)tasks.size();
+    Task task;
+    task.name = name;
+    task.function = function;
+    task.affinity = affinity;
+    task.dependencyCount = 0;
+    tasks.push_back(task);
+
+    // dependencies are always added first, so the graph has no cycle
+    for(unsigned int dependency : dependencies)
+    {
+        if(dependency < id)
+        {
+            tasks[dependency].successors.push_back(id);
+            ++tasks[id].dependencyCount;
+        }
+    }
+    return id;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// run all tasks, the calling thread runs the MAIN_THREAD ones
+///////////////////////////////////////////////////////////////////////////////
+void TaskGraph::run(unsigned int threadCount)
+{
+    if(threadCount == 0)
+        threadCount = std::max(Parallel::getDefaultThreadCount(), 2u) - 1;
+
+    std::mutex mutex;
+    std::condition_variable workerCondition;
+    std::condition_variable mainCondition;
+    std::deque<unsigned int> workerReady;
+    std::deque<unsigned int> mainReady;
+    std::vector<unsigned int> remaining(tasks.size());
+    size_t finished = 0;
+
+    // called with the lock held
+    auto schedule = [&](unsigned int id) {
+        if(tasks[id].affinity == MAIN_THREAD)
+        {
+            mainReady.push_back(id);
+            mainCondition.notify_one();
+        }
+        else
+        {
+            workerReady.push_back(id);
+            workerCondition.notify_one();
+        }
+    };
+
+    auto execute = [&](unsigned int id, const std::string& thread) {
+        Span span;
+        span.name = tasks[id].name;
+        span.thread = thread;
+        span.start = Clock::now();
+        if(tasks[id].function)
+            tasks[id].function();
+        span.end = Clock::now();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        spans.push_back(span);
+        ++finished;
+        for(unsigned int successor : tasks[id].successors)
+            if(--remaining[successor] == 0)
+                schedule(successor);
+        if(finished == tasks.size())
+        {
+            endTime = span.end;
+            workerCondition.notify_all();
+            mainCondition.notify_all();
+        }
+    };
+
+    startTime = Clock::now();
+    endTime = startTime;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(size_t i = 0; i < tasks.size(); ++i)
+        {
+            remaining[i] = tasks[i].dependencyCount;
+            if(remaining[i] == 0)
+                schedule((unsigned int)i);
+        }
+    }
+
+    std::vector<std::thread> workers;
+    for(unsigned int t = 0; t < threadCount; ++t)
+    {
+        std::string thread = "worker " + std::to_string(t + 1);
+        workers.push_back(std::thread([&, thread] {
+            for(;;)
+            {
+                unsigned int id;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    workerCondition.wait(lock, [&] { return !workerReady.empty() || finished == tasks.size(); });
+                    if(workerReady.empty())
+                        return;
+                    id = workerReady.front();
+                    workerReady.pop_front();
+                }
+                execute(id, thread);
+            }
+        }));
+    }
+
+    // main thread tasks
+    for(;;)
+    {
+        unsigned int id;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            mainCondition.wait(lock, [&] { return !mainReady.empty() || finished == tasks.size(); });
+            if(mainReady.empty())
+                break;
+            id = mainReady.front();
+            mainReady.pop_front();
+        }
+        execute(id, "main");
+    }
+
+    for(size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// external work and events
+///////////////////////////////////////////////////////////////////////////////
+void TaskGraph::addSpan(const std::string& name, const std::string& thread, Clock::time_point start, Clock::time_point end)
+{
+    Span span;
+    span.name = name;
+    span.thread = thread;
+    span.start = start;
+    span.end = end;
+    spans.push_back(span);
+}
+
+void TaskGraph::addMarker(const std::string& name, Clock::time_point time)
+{
+    addSpan(name, "", time, time);
+}
+
+float TaskGraph::getWallTime() const
+{
+    return std::chrono::duration<float, std::milli>(endTime - startTime).count();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// text chart: one row per span, time runs left to right
+///////////////////////////////////////////////////////////////////////////////
+void TaskGraph::printTimeline(const char* title, unsigned int width) const
+{
+    std::vector<Span> sorted(spans);
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Span& a, const Span& b) { return a.start < b.start; });
+
+    Clock::time_point first = startTime;
+    Clock::time_point last = endTime;
+    size_t nameWidth = 4;
+    for(size_t i = 0; i < sorted.size(); ++i)
+    {
+        first = std::min(first, sorted[i].start);
+        last = std::max(last, sorted[i].end);
+        nameWidth = std::max(nameWidth, sorted[i].name.size());
+    }
+    const float total = std::max(std::chrono::duration<float, std::milli>(last - first).count(), 0.001f);
+
+    // busy time summed over threads, per thread
+    float busy = 0;
+    std::vector<std::string> threads;
+    for(size_t i = 0; i < sorted.size(); ++i)
+    {
+        if(sorted[i].thread.empty())
+            continue;
+        busy += std::chrono::duration<float, std::milli>(sorted[i].end - sorted[i].start).count();
+        if(std::find(threads.begin(), threads.end(), sorted[i].thread) == threads.end())
+            threads.push_back(sorted[i].thread);
+    }
+
+    std::cout << "===== TaskGraph: " << (title ? title : "") << " =====\n"
+              << std::fixed << std::setprecision(1);
+    for(size_t i = 0; i < sorted.size(); ++i)
+    {
+        const Span& s = sorted[i];
+        float start = std::chrono::duration<float, std::milli>(s.start - first).count();
+        float end = std::chrono::duration<float, std::milli>(s.end - first).count();
+        unsigned int begin = std::min((unsigned int)(start / total * width), width - 1);
+        unsigned int stop = std::max(begin + 1, std::min((unsigned int)(end / total * width + 0.5f), width));
+
+        std::string bar(width, ' ');
+        for(unsigned int c = begin; c < stop; ++c)
+            bar[c] = s.thread.empty() ? '|' : '#';
+        std::cout << std::left << std::setw((int)nameWidth) << s.name << " " << std::setw(9) << s.thread << std::right
+                  << " [" << bar << "] " << std::setw(7) << start << " - " << std::setw(7) << end << " ms\n";
+    }
+    std::cout << "Total: " << total << " ms, busy " << busy << " ms on " << threads.size() << " threads, "
+              << std::setprecision(2) << busy / total << "x overlap" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
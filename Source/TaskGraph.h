@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+// TaskGraph.h
+// ===========
+// One-shot graph of tasks with dependencies, run on a pool of worker threads.
+// Tasks added with MAIN_THREAD affinity (e.g. OpenGL calls, which need the
+// thread owning the context) run on the thread calling run(); the others run
+// on the workers. A task starts once every task it depends on has finished.
+//
+// Each task records when and on which thread it ran, and printTimeline()
+// draws the result as a text chart, so the overlap between the CPU work and
+// the GL work is visible. Work done outside the graph (e.g. texture decodes
+// on the streamer threads) can be added to the chart with addSpan().
+//
+// usage:
+//     TaskGraph graph;
+//     unsigned int build = graph.add("Build mesh", buildMesh);
+//     graph.add("Upload mesh", uploadMesh, { build }, TaskGraph::MAIN_THREAD);
+//     graph.run();
+//     graph.printTimeline("Startup");
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include <chrono>
+
+class TaskGraph
+{
+public:
+    typedef std::function<void()> Function;
+    typedef std::chrono::steady_clock Clock;
+
+    enum Affinity
+    {
+        ANY_THREAD,                     // run on a worker
+        MAIN_THREAD                     // run on the thread calling run()
+    };
+
+    TaskGraph();
+
+    // add a task that runs after the tasks in dependencies, return its id
+    unsigned int add(const char* name, Function function, std::initializer_list<unsigned int> dependencies = {},
+                     Affinity affinity = ANY_THREAD);
+
+    // run every task and return when all are done
+    // threadCount = 0 uses one worker per core minus the calling thread (at least 1)
+    void run(unsigned int threadCount = 0);
+
+    // add work done outside of the graph to the timeline
+    void addSpan(const std::string& name, const std::string& thread, Clock::time_point start, Clock::time_point end);
+    // add an instant event (e.g. "first frame") to the timeline
+    void addMarker(const std::string& name, Clock::time_point time);
+
+    // time from the start of run() to the end of its last task, in ms
+    float getWallTime() const;
+
+    // print every task as a bar on its thread, ordered by start time
+    void printTimeline(const char* title, unsigned int width = 60) const;
+
+private:
+    struct Task
+    {
+        std::string name;
+        Function function;
+        Affinity affinity;
+        std::vector<unsigned int> successors;
+        unsigned int dependencyCount;
+    };
+
+    struct Span
+    {
+        std::string name;
+        std::string thread;
+        Clock::time_point start;
+        Clock::time_point end;
+    };
+
+    std::vector<Task> tasks;
+    std::vector<Span> spans;            // finished tasks and external spans
+    Clock::time_point startTime;
+    Clock::time_point endTime;
+};
+
+#endif
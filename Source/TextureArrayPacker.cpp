@@ -0,0 +1,266 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureArrayPacker.cpp
+// ======================
+// Images packed into the layers of array textures.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "TextureArrayPacker.h"
+#include "TextureStreamer.h"
+#include "MipGenerator.h"
+#include "Ktx2.h"
+#include "stb_image.h"
+
+
+
+namespace
+{
+    // mid grey like the streamer's placeholder, until a layer is uploaded
+    const unsigned char PLACEHOLDER[4] = { 128, 128, 128, 255 };
+
+    GLenum getFormat(int channels)
+    {
+        switch(channels)
+        {
+        case 1:  return GL_RED;
+        case 2:  return GL_RG;
+        case 3:  return GL_RGB;
+        default: return GL_RGBA;
+        }
+    }
+
+    GLenum getInternalFormat(int channels)
+    {
+        switch(channels)
+        {
+        case 1:  return GL_R8;
+        case 2:  return GL_RG8;
+        case 3:  return GL_RGB8;
+        default: return GL_RGBA8;
+        }
+    }
+
+    const char* getFormatName(int channels)
+    {
+        switch(channels)
+        {
+        case 1:  return "R8";
+        case 2:  return "RG8";
+        case 3:  return "RGB8";
+        default: return "RGBA8";
+        }
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor
+///////////////////////////////////////////////////////////////////////////////
+TextureArrayPacker::TextureArrayPacker(TextureStreamer& streamer, const Options& options)
+    : streamer(streamer), options(options)
+{
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// add an image, once per file and flip
+///////////////////////////////////////////////////////////////////////////////
+unsigned int TextureArrayPacker::add(const char* path, bool flip)
+{
+    for(unsigned int i = 0; i < images.size(); ++i)
+        if(images[i].path == path && images[i].flip == flip)
+            return i;
+
+    Image image;
+    image.path = path;
+    image.flip = flip;
+    image.layer.array = 0;
+    image.layer.index = 0;
+    image.layer.scale[0] = image.layer.scale[1] = 1.0f;
+    images.push_back(image);
+    return (unsigned int)images.size() - 1;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// group the images by channels (or by compressed format and size), size the
+// layers, create the arrays and queue the layers
+///////////////////////////////////////////////////////////////////////////////
+void TextureArrayPacker::build()
+{
+    if(!arrays.empty() || images.empty())
+        return;
+
+    // image sizes from the file headers, a missing file keeps a grey layer in the first array
+    std::vector<int> widths(images.size()), heights(images.size()), groups(images.size());
+    int arrayOfChannels[5] = { -1, -1, -1, -1, -1 };
+    for(size_t i = 0; i < images.size(); ++i)
+    {
+        // the .ktx2 as is: the streamer's checks, its whole mipmap chain and no resize
+        Ktx2::Reader compressed;
+        if(options.compressed && compressed.open(Ktx2::getCompressedPath(images[i].path).c_str()) &&
+           streamer.isSupported(compressed.getFormat()) && compressed.isFlipped() == images[i].flip &&
+           compressed.getLevelCount() >= MipGenerator::getLevelCount(compressed.getWidth(), compressed.getHeight()) &&
+           compressed.getWidth() <= options.maxSize && compressed.getHeight() <= options.maxSize)
+        {
+            widths[i] = compressed.getWidth();
+            heights[i] = compressed.getHeight();
+            size_t a = 0;
+            while(a < arrays.size() && !(arrays[a].compressed && arrays[a].format == compressed.getFormat() &&
+                                         arrays[a].width == widths[i] && arrays[a].height == heights[i]))
+                ++a;
+            if(a == arrays.size())
+            {
+                Array array = { 0, widths[i], heights[i], 0, 0, true, compressed.getFormat() };
+                arrays.push_back(array);
+            }
+            groups[i] = (int)a;
+            images[i].layer.index = (int)arrays[a].layerCount++;
+            continue;
+        }
+
+        int channels = 4;
+        if(!stbi_info(images[i].path.c_str(), &widths[i], &heights[i], &channels))
+            widths[i] = heights[i] = 0;
+        if(options.rgba || channels < 1 || channels > 4)
+            channels = 4;
+
+        if(arrayOfChannels[channels] < 0)
+        {
+            Array array = { 0, 1, 1, channels, 0, false, BlockCompression::BC1 };
+            arrayOfChannels[channels] = (int)arrays.size();
+            arrays.push_back(array);
+        }
+        Array& array = arrays[arrayOfChannels[channels]];
+        groups[i] = arrayOfChannels[channels];
+        images[i].layer.index = (int)array.layerCount++;
+        array.width = std::max(array.width, std::min(widths[i], options.maxSize));
+        array.height = std::max(array.height, std::min(heights[i], options.maxSize));
+    }
+
+    // every level of every layer, grey until uploaded (black when compressed, those cannot be cleared)
+    for(size_t a = 0; a < arrays.size(); ++a)
+    {
+        Array& array = arrays[a];
+        const GLsizei levels = (GLsizei)MipGenerator::getLevelCount(array.width, array.height);
+        glGenTextures(1, &array.id);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.id);
+        const GLenum format = array.compressed ? TextureStreamer::getCompressedFormat(array.format) : getInternalFormat(array.channels);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, format, array.width, array.height, array.layerCount);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        for(GLsizei level = 0; level < levels; ++level)
+        {
+            if(!array.compressed)
+            {
+                glClearTexImage(array.id, level, GL_RGBA, GL_UNSIGNED_BYTE, PLACEHOLDER);
+                continue;
+            }
+            const GLsizei width = MipGenerator::getLevelDimension(array.width, level);
+            const GLsizei height = MipGenerator::getLevelDimension(array.height, level);
+            const std::vector<unsigned char> zeros(BlockCompression::getImageSize(array.format, width, height) * array.layerCount);
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, width, height, array.layerCount,
+                                      TextureStreamer::getCompressedFormat(array.format), (GLsizei)zeros.size(), zeros.data());
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    for(size_t i = 0; i < images.size(); ++i)
+    {
+        const Array& array = arrays[groups[i]];
+        TextureStreamer::Layer layer;
+        layer.texture = array.id;
+        layer.index = images[i].layer.index;
+        layer.width = array.width;
+        layer.height = array.height;
+        layer.channels = array.channels;
+        layer.imageWidth = array.width;
+        layer.imageHeight = array.height;
+        layer.compressed = array.compressed;
+        layer.format = array.format;
+
+        // padded: as large as it fits in the layer without changing its aspect ratio
+        if(options.fit == PAD && !array.compressed && widths[i] > 0 && heights[i] > 0)
+        {
+            float scale = std::min(1.0f, std::min((float)array.width / widths[i], (float)array.height / heights[i]));
+            layer.imageWidth = std::min(array.width, std::max(1, (int)(widths[i] * scale + 0.5f)));
+            layer.imageHeight = std::min(array.height, std::max(1, (int)(heights[i] * scale + 0.5f)));
+        }
+
+        images[i].layer.array = array.id;
+        images[i].layer.scale[0] = (float)layer.imageWidth / array.width;
+        images[i].layer.scale[1] = (float)layer.imageHeight / array.height;
+        streamer.load(layer, images[i].path.c_str(), images[i].flip);
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// delete the arrays
+///////////////////////////////////////////////////////////////////////////////
+void TextureArrayPacker::clear()
+{
+    for(size_t i = 0; i < arrays.size(); ++i)
+        glDeleteTextures(1, &arrays[i].id);
+    arrays.clear();
+    for(size_t i = 0; i < images.size(); ++i)
+        images[i].layer.array = 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// memory of the arrays with their mipmaps
+///////////////////////////////////////////////////////////////////////////////
+size_t TextureArrayPacker::getBytes() const
+{
+    size_t bytes = 0;
+    for(size_t i = 0; i < arrays.size(); ++i)
+        bytes += getLayerSize(arrays[i]) * arrays[i].layerCount;
+    return bytes;
+}
+
+// one layer with its mipmaps
+size_t TextureArrayPacker::getLayerSize(const Array& array)
+{
+    if(!array.compressed)
+        return MipGenerator::getChainSize(array.width, array.height, array.channels);
+    size_t size = 0;
+    const unsigned int levels = MipGenerator::getLevelCount(array.width, array.height);
+    for(unsigned int level = 0; level < levels; ++level)
+        size += BlockCompression::getImageSize(array.format, MipGenerator::getLevelDimension(array.width, level),
+                                               MipGenerator::getLevelDimension(array.height, level));
+    return size;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// print each array
+///////////////////////////////////////////////////////////////////////////////
+void TextureArrayPacker::printStats() const
+{
+    const float MB = 1024.0f * 1024.0f;
+    std::cout << "===== TextureArrayPacker =====\n"
+              << std::fixed << std::setprecision(2)
+              << "    Images: " << images.size() << " in " << arrays.size() << " arrays ("
+              << (options.fit == PAD ? "padded" : "resized") << " to the layer size)\n";
+    for(size_t i = 0; i < arrays.size(); ++i)
+    {
+        const Array& a = arrays[i];
+        std::cout << "  Array " << i << ": " << a.width << " x " << a.height << " "
+                  << (a.compressed ? BlockCompression::getName(a.format) : getFormatName(a.channels)) << ", "
+                  << a.layerCount << " layers, " << getLayerSize(a) * a.layerCount / MB << " MB\n";
+    }
+    std::cout << "     Total: " << getBytes() / MB << " MB" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
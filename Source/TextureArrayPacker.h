@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureArrayPacker.h
+// ====================
+// Packs images into the layers of GL_TEXTURE_2D_ARRAY textures, so objects
+// with different textures are drawn with the same texture binding and only
+// a layer index changes between draws (and they can later be merged into
+// one multi-draw).
+//
+// build() reads the header of each image (stbi_info(), no decode) and puts
+// the images with the same # of channels in one array, or every image in one
+// RGBA array with Options::rgba. The layers of an array have the size of its
+// largest image, up to Options::maxSize. Images of another size are either
+// stretched to the layer size (RESIZE, they still tile with GL_REPEAT) or
+// shrunk to fit if needed and padded with their edge pixels (PAD, the shader
+// scales the texture coords by Layer::scale). The arrays are allocated with
+// every mipmap level and cleared to grey, then the TextureStreamer decodes,
+// fits and uploads each layer in the background.
+//
+// An image with a block compressed .ktx2 next to it (see TextureConverter.h)
+// that the GPU can sample goes to an array of its format and size instead,
+// with Options::compressed: its layer is copied from the file's levels, not
+// decoded, and takes 4 to 8 times less memory. Compressed blocks cannot be
+// resized, so each compressed size is its own array.
+//
+// usage:
+//     TextureArrayPacker arrays(streamer);
+//     unsigned int base = arrays.add("assets/textures/base.png", true);
+//     arrays.build();                     // on the GL thread, once every image is added
+//     const TextureArrayPacker::Layer& layer = arrays.getLayer(base);
+//     glBindTexture(GL_TEXTURE_2D_ARRAY, layer.array);    // + layer.index in the draw data
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TEXTURE_ARRAY_PACKER_H
+#define TEXTURE_ARRAY_PACKER_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+#include "BlockCompression.h"
+
+class TextureStreamer;
+
+class TextureArrayPacker
+{
+public:
+    // how an image of another size than the layers is fitted
+    enum Fit
+    {
+        RESIZE,                         // stretched to the layer size
+        PAD                             // keeps its aspect ratio, padded with its edge pixels
+    };
+
+    struct Options
+    {
+        int maxSize;                    // largest layer width and height
+        Fit fit;
+        bool rgba;                      // convert every image to RGBA, so they all share one array
+        bool compressed;                // layers from .ktx2 files where they exist
+
+        explicit Options(int maxSize = 1024, Fit fit = RESIZE, bool rgba = true, bool compressed = true)
+            : maxSize(maxSize), fit(fit), rgba(rgba), compressed(compressed) {}
+    };
+
+    // where an image is, per draw data
+    struct Layer
+    {
+        GLuint array;                   // 0 until build()
+        int index;                      // layer in the array
+        float scale[2];                 // part of the layer the image covers, (1, 1) unless padded
+    };
+
+    explicit TextureArrayPacker(TextureStreamer& streamer, const Options& options = Options());
+
+    // add an image file, return its index, the same file and flip added twice share the layer
+    unsigned int add(const char* path, bool flip = false);
+
+    // group the images, create the arrays and queue the layers, once on the GL thread
+    void build();
+    // delete the arrays, on the GL thread after the streamer is stopped
+    void clear();
+    bool isBuilt() const                { return !arrays.empty(); }
+
+    const Layer& getLayer(unsigned int index) const { return images[index].layer; }
+    unsigned int getImageCount() const  { return (unsigned int)images.size(); }
+    unsigned int getArrayCount() const  { return (unsigned int)arrays.size(); }
+    GLuint getArray(unsigned int index) const       { return arrays[index].id; }
+    size_t getBytes() const;
+
+    // print each array with its size, format, layers and memory
+    void printStats() const;
+
+private:
+    struct Image
+    {
+        std::string path;
+        bool flip;
+        Layer layer;
+    };
+
+    struct Array
+    {
+        GLuint id;
+        int width;
+        int height;
+        int channels;
+        unsigned int layerCount;
+        bool compressed;                // in format, channels unused
+        BlockCompression::Format format;
+    };
+
+    // not copyable, owns GL objects
+    TextureArrayPacker(const TextureArrayPacker&);
+    TextureArrayPacker& operator=(const TextureArrayPacker&);
+
+    static size_t getLayerSize(const Array& array);
+
+    TextureStreamer& streamer;
+    Options options;
+    std::vector<Image> images;
+    std::vector<Array> arrays;
+};
+
+#endif
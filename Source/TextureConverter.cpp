@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureConverter.cpp
+// ====================
+// Offline conversion of images to block compressed KTX2 textures.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include "TextureConverter.h"
+#include "BlockCompression.h"
+#include "MipGenerator.h"
+#include "Ktx2.h"
+#include "stb_image.h"
+
+
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// decode, build the mipmaps, compress each level and write
+///////////////////////////////////////////////////////////////////////////////
+bool TextureConverter::convert(const char* inputPath, const char* outputPath, bool flip, bool highQuality)
+{
+    Clock::time_point start = Clock::now();
+
+    int width, height, channels;
+    unsigned char* pixels = stbi_load(inputPath, &width, &height, &channels, 0);
+    if(!pixels)
+    {
+        std::cout << "[ERROR] TextureConverter: failed to load " << inputPath << std::endl;
+        return false;
+    }
+
+    // the uncompressed chain exactly as the streamer would upload it: flipped base level, then the mipmaps
+    const unsigned int levelCount = MipGenerator::getLevelCount(width, height);
+    const size_t rowSize = (size_t)width * channels;
+    std::vector<unsigned char> chain(MipGenerator::getChainSize(width, height, channels));
+    for(int y = 0; y < height; ++y)
+        memcpy(&chain[(size_t)y * rowSize], pixels + (size_t)(flip ? height - 1 - y : y) * rowSize, rowSize);
+    MipGenerator::generate(pixels, width, height, channels, chain.data() + rowSize * height, flip);
+    stbi_image_free(pixels);
+
+    const BlockCompression::Format format = BlockCompression::getFormat(channels, highQuality);
+    Ktx2::Writer writer(format, width, height, flip);
+    std::vector<unsigned char> compressed;
+    size_t compressedSize = 0;
+    for(unsigned int level = 0; level < levelCount; ++level)
+    {
+        const int w = MipGenerator::getLevelDimension(width, level);
+        const int h = MipGenerator::getLevelDimension(height, level);
+        compressed.resize(BlockCompression::getImageSize(format, w, h));
+        BlockCompression::compress(&chain[MipGenerator::getLevelOffset(width, height, channels, level)],
+                                   w, h, channels, format, compressed.data());
+        writer.addLevel(compressed.data(), compressed.size());
+        compressedSize += compressed.size();
+    }
+    if(!writer.write(outputPath))
+        return false;
+
+    const float KB = 1024.0f;
+    float time = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    std::cout << "===== TextureConverter: " << inputPath << " -> " << outputPath << " =====\n"
+              << std::fixed << std::setprecision(2)
+              << "     Image: " << width << " x " << height << ", " << channels << " channels, " << levelCount << " levels"
+              << (flip ? ", flipped" : "") << "\n"
+              << "    Format: " << BlockCompression::getName(format) << "\n"
+              << "      Size: " << chain.size() / KB << " KB -> " << compressedSize / KB << " KB ("
+              << (float)chain.size() / compressedSize << ":1)\n"
+              << "      Time: " << time << " ms" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+    return true;
+}
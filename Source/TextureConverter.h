@@ -0,0 +1,28 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureConverter.h
+// ==================
+// Offline conversion of images to block compressed KTX2 textures (see
+// Ktx2.h). The full mipmap chain is built from the source image with
+// MipGenerator, as the streamer would at load time, then every level is
+// compressed: BC4 for 1 channel, BC5 for 2, BC1 for RGB and BC3 for RGBA, or
+// BC7 for RGB and RGBA with highQuality. The texture is written flipped if
+// the scene flips it, so it is uploaded as it is.
+//
+// TextureStreamer uses the .ktx2 next to an image in its place (see
+// Ktx2::getCompressedPath()); convert again whenever the image changes.
+//
+// Run from the command line:
+//   OpenGLSample --convert-texture <input.png|input.jpg> <output.ktx2> [--flip] [--bc7]
+//   OpenGLSample --convert-textures [--bc7]      (every texture of the scene)
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TEXTURE_CONVERTER_H
+#define TEXTURE_CONVERTER_H
+
+namespace TextureConverter
+{
+    // convert an image file, return false if it cannot be read or written
+    bool convert(const char* inputPath, const char* outputPath, bool flip = false, bool highQuality = false);
+}
+
+#endif
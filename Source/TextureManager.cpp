@@ -0,0 +1,411 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureManager.cpp
+// ==================
+// Shared, reference counted textures with a memory budget.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+#include <cctype>
+#include "TextureManager.h"
+#include "TextureStreamer.h"
+
+
+
+namespace
+{
+    // the streamer's 1x1 RGBA placeholder, counted until the image is uploaded
+    const size_t PLACEHOLDER_BYTES = 4;
+
+    bool usesMipmaps(GLint minFilter)
+    {
+        return minFilter == GL_NEAREST_MIPMAP_NEAREST || minFilter == GL_LINEAR_MIPMAP_NEAREST ||
+               minFilter == GL_NEAREST_MIPMAP_LINEAR || minFilter == GL_LINEAR_MIPMAP_LINEAR;
+    }
+
+    // remove "." and "name/.." from a path with '/' separators
+    std::string normalize(const std::string& path)
+    {
+        std::vector<std::string> parts;
+        size_t begin = 0;
+        while(begin <= path.size())
+        {
+            size_t end = path.find('/', begin);
+            if(end == std::string::npos)
+                end = path.size();
+            std::string part = path.substr(begin, end - begin);
+            if(part == "..")
+            {
+                if(!parts.empty() && parts.back() != "..")
+                    parts.pop_back();
+                else
+                    parts.push_back(part);
+            }
+            else if(!part.empty() && part != ".")
+            {
+                parts.push_back(part);
+            }
+            begin = end + 1;
+        }
+
+        std::string result = !path.empty() && path[0] == '/' ? "/" : "";
+        for(size_t i = 0; i < parts.size(); ++i)
+        {
+            if(i > 0)
+                result += '/';
+            result += parts[i];
+        }
+        return result;
+    }
+
+    // absolute path with '/' separators, so "a/../b.png" and "./b.png" give the same key
+    // falls back to the path relative to the working directory if it cannot be resolved
+    std::string getCanonicalPath(const char* path)
+    {
+        std::string result = path;
+#ifdef _WIN32
+        char buffer[_MAX_PATH];
+        if(_fullpath(buffer, path, _MAX_PATH))
+            result = buffer;
+        // the file system is not case sensitive
+        std::transform(result.begin(), result.end(), result.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+#else
+        char* resolved = realpath(path, 0);
+        if(resolved)
+        {
+            result = resolved;
+            free(resolved);
+        }
+#endif
+        std::replace(result.begin(), result.end(), '\\', '/');
+        return normalize(result);
+    }
+
+    std::string getSamplerKey(const TextureManager::Sampler& sampler)
+    {
+        return std::to_string(sampler.wrapS) + "," + std::to_string(sampler.wrapT) + "," + std::to_string(sampler.minFilter) + "," +
+               std::to_string(sampler.magFilter) + "," + std::to_string(sampler.anisotropy);
+    }
+
+    std::string getKey(const std::string& path, const TextureManager::Sampler& sampler)
+    {
+        return path + "|" + getSamplerKey(sampler) + (sampler.flip ? ",flip" : "");
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Handle
+///////////////////////////////////////////////////////////////////////////////
+TextureManager::Handle::Handle(TextureManager* manager, unsigned int index) : manager(manager), index(index)
+{
+    manager->acquire(index);
+}
+
+TextureManager::Handle::Handle(const Handle& rhs) : manager(rhs.manager), index(rhs.index)
+{
+    if(manager)
+        manager->acquire(index);
+}
+
+TextureManager::Handle& TextureManager::Handle::operator=(const Handle& rhs)
+{
+    // acquire first, rhs may share the texture of this handle
+    if(rhs.manager)
+        rhs.manager->acquire(rhs.index);
+    reset();
+    manager = rhs.manager;
+    index = rhs.index;
+    return *this;
+}
+
+void TextureManager::Handle::reset()
+{
+    if(manager)
+        manager->release(index);
+    manager = 0;
+    index = 0;
+}
+
+GLuint TextureManager::Handle::getId() const
+{
+    return manager ? manager->entries[index].id : 0;
+}
+
+GLuint TextureManager::Handle::getSampler() const
+{
+    return manager ? manager->entries[index].sampler : 0;
+}
+
+void TextureManager::Handle::bind(GLuint unit) const
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, getId());
+    glBindSampler(unit, getSampler());
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor/dtor
+///////////////////////////////////////////////////////////////////////////////
+TextureManager::TextureManager(TextureStreamer& streamer, size_t budget) : streamer(streamer), budget(budget),
+                                                                           residentBytes(0), useCounter(0), evictedCount(0),
+                                                                           maxAnisotropy(0)
+{
+    streamer.setUploadCallback([this](GLuint texture, size_t bytes) { onUpload(texture, bytes); });
+}
+
+TextureManager::~TextureManager()
+{
+    // the GL context may be gone, textures are only deleted by clear()
+    streamer.setUploadCallback(TextureStreamer::UploadCallback());
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// return the shared texture for the file and sampler
+///////////////////////////////////////////////////////////////////////////////
+TextureManager::Handle TextureManager::load(const char* path, const Sampler& sampler)
+{
+    const std::string key = getKey(getCanonicalPath(path), sampler);
+    std::unordered_map<std::string, unsigned int>::const_iterator it = keys.find(key);
+    if(it != keys.end())
+        return Handle(this, it->second);
+
+    // make room before adding more
+    evict();
+
+    const bool mipmaps = usesMipmaps(sampler.minFilter);
+    GLuint id;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler.wrapS);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler.wrapT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+
+    unsigned int index;
+    if(!freeEntries.empty())
+    {
+        index = freeEntries.back();
+        freeEntries.pop_back();
+    }
+    else
+    {
+        index = (unsigned int)entries.size();
+        entries.push_back(Entry());
+    }
+    Entry& entry = entries[index];
+    entry.key = key;
+    entry.path = path;
+    entry.id = id;
+    entry.sampler = getSamplerObject(sampler);
+    entry.references = 0;
+    entry.bytes = PLACEHOLDER_BYTES;
+    entry.loading = true;
+    entry.failed = false;
+    entry.lastUsed = useCounter;
+    keys[key] = index;
+    ids[id] = index;
+    residentBytes += entry.bytes;
+
+    // the streamer calls onUpload() once the image replaces the placeholder
+    streamer.load(id, path, sampler.flip, mipmaps);
+    return Handle(this, index);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// reference counting
+///////////////////////////////////////////////////////////////////////////////
+void TextureManager::acquire(unsigned int index)
+{
+    ++entries[index].references;
+    entries[index].lastUsed = ++useCounter;
+}
+
+void TextureManager::release(unsigned int index)
+{
+    Entry& entry = entries[index];
+    entry.lastUsed = ++useCounter;
+    // the entry of a texture deleted by clear() is reused once its last handle is gone
+    if(--entry.references == 0 && entry.key.empty())
+        freeEntries.push_back(index);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// the streamer uploaded a texture, count its real size
+///////////////////////////////////////////////////////////////////////////////
+void TextureManager::onUpload(GLuint texture, size_t bytes)
+{
+    std::unordered_map<GLuint, unsigned int>::const_iterator it = ids.find(texture);
+    if(it == ids.end())
+        return;             // not loaded by this manager
+
+    Entry& entry = entries[it->second];
+    entry.loading = false;
+    if(bytes == 0)
+    {
+        entry.failed = true;                // keeps the placeholder
+        return;
+    }
+    residentBytes = residentBytes - entry.bytes + bytes;
+    entry.bytes = bytes;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// delete unused textures, least recently used first, until under budget
+///////////////////////////////////////////////////////////////////////////////
+unsigned int TextureManager::evict()
+{
+    if(residentBytes <= budget)
+        return 0;
+
+    std::vector<unsigned int> unused;
+    for(unsigned int i = 0; i < entries.size(); ++i)
+    {
+        // textures still loading are kept, the streamer would upload to a deleted name
+        const Entry& entry = entries[i];
+        if(!entry.key.empty() && entry.references == 0 && !entry.loading)
+            unused.push_back(i);
+    }
+    std::sort(unused.begin(), unused.end(), [this](unsigned int a, unsigned int b) {
+        return entries[a].lastUsed < entries[b].lastUsed;
+    });
+
+    unsigned int count = 0;
+    for(size_t i = 0; i < unused.size() && residentBytes > budget; ++i)
+    {
+        remove(unused[i]);
+        freeEntries.push_back(unused[i]);
+        ++count;
+    }
+    evictedCount += count;
+    return count;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// delete every texture, call after the streamer is stopped
+///////////////////////////////////////////////////////////////////////////////
+void TextureManager::clear()
+{
+    for(unsigned int i = 0; i < entries.size(); ++i)
+    {
+        if(entries[i].key.empty())
+            continue;
+        remove(i);
+        if(entries[i].references == 0)
+            freeEntries.push_back(i);
+    }
+
+    for(std::unordered_map<std::string, GLuint>::const_iterator it = samplers.begin(); it != samplers.end(); ++it)
+        glDeleteSamplers(1, &it->second);
+    samplers.clear();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// create a sampler object for the settings, or return the existing one
+///////////////////////////////////////////////////////////////////////////////
+GLuint TextureManager::getSamplerObject(const Sampler& sampler)
+{
+    const std::string key = getSamplerKey(sampler);
+    std::unordered_map<std::string, GLuint>::const_iterator it = samplers.find(key);
+    if(it != samplers.end())
+        return it->second;
+
+    GLuint id;
+    glGenSamplers(1, &id);
+    glSamplerParameteri(id, GL_TEXTURE_WRAP_S, sampler.wrapS);
+    glSamplerParameteri(id, GL_TEXTURE_WRAP_T, sampler.wrapT);
+    glSamplerParameteri(id, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
+    glSamplerParameteri(id, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+
+    // core in GL 4.6, an extension before
+    if(sampler.anisotropy > 1.0f && GLEW_EXT_texture_filter_anisotropic)
+    {
+        if(maxAnisotropy == 0)
+            glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+        glSamplerParameterf(id, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::min(sampler.anisotropy, maxAnisotropy));
+    }
+
+    samplers[key] = id;
+    return id;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// delete the texture of an entry and forget its key
+///////////////////////////////////////////////////////////////////////////////
+void TextureManager::remove(unsigned int index)
+{
+    Entry& entry = entries[index];
+    glDeleteTextures(1, &entry.id);
+    residentBytes -= entry.bytes;
+    keys.erase(entry.key);
+    ids.erase(entry.id);
+    entry.key.clear();
+    entry.id = 0;
+    entry.sampler = 0;
+    entry.bytes = 0;
+    entry.loading = false;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// sizes
+///////////////////////////////////////////////////////////////////////////////
+size_t TextureManager::getResidentBytes(const Handle& handle) const
+{
+    return handle.manager == this ? entries[handle.index].bytes : 0;
+}
+
+unsigned int TextureManager::getTextureCount() const
+{
+    return (unsigned int)keys.size();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// print each texture with its references and size
+///////////////////////////////////////////////////////////////////////////////
+void TextureManager::printStats() const
+{
+    const float KB = 1024.0f;
+    const float MB = 1024.0f * 1024.0f;
+    std::cout << "===== TextureManager =====\n" << std::fixed << std::setprecision(1);
+    for(size_t i = 0; i < entries.size(); ++i)
+    {
+        const Entry& entry = entries[i];
+        if(entry.key.empty())
+            continue;
+        std::cout << "  " << std::setw(9) << entry.bytes / KB << " KB  refs " << entry.references << "  " << entry.path;
+        if(entry.loading)
+            std::cout << " (loading)";
+        else if(entry.failed)
+            std::cout << " (failed)";
+        else if(entry.references == 0)
+            std::cout << " (unused)";
+        std::cout << "\n";
+    }
+    std::cout << "  Resident: " << std::setprecision(2) << residentBytes / MB << " MB of " << budget / MB << " MB budget, "
+              << getTextureCount() << " textures, " << evictedCount << " evicted" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
@@ -0,0 +1,148 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureManager.h
+// ================
+// Shared, reference counted textures.
+// load() returns a Handle to the texture for the canonical path of the file
+// and its sampler settings, so the same file asked for twice is decoded and
+// uploaded once. Copies of a Handle share the texture; when the last one is
+// released the texture stays resident (it may be asked for again) until
+// evict() needs its memory to get back under the budget, least recently
+// used first. Files are loaded by a TextureStreamer, which tells the manager
+// the size of each texture once it is uploaded.
+//
+// Each texture also gets a sampler object for its Sampler settings (shared by
+// the textures with the same settings), bound with the texture by bind().
+// Trilinear filtering with anisotropy keeps textures seen from far away or at
+// grazing angles from aliasing; the mipmaps come with the image from the
+// streamer.
+//
+// The GL objects are only created and deleted by load(), evict() and clear(),
+// which must be called on the GL thread; releasing a Handle never calls GL.
+//
+// usage:
+//     TextureManager textures(streamer, 128 * 1024 * 1024);
+//     TextureManager::Handle base = textures.load("assets/textures/base.png", TextureManager::Sampler::trilinear(true));
+//     base.bind(0);                       // texture unit 0
+//     textures.evict();                   // once per frame
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+class TextureStreamer;
+
+class TextureManager
+{
+public:
+    // texture parameters, part of the key: the same file with other settings is another texture
+    struct Sampler
+    {
+        GLint wrapS;
+        GLint wrapT;
+        GLint minFilter;                // mipmaps are only generated for the *_MIPMAP_* filters
+        GLint magFilter;
+        float anisotropy;               // max anisotropy, 1 = off, clamped to what the GPU supports
+        bool flip;                      // flip the image vertically (OpenGL's Y axis goes up)
+
+        explicit Sampler(bool flip = false, GLint minFilter = GL_LINEAR, GLint magFilter = GL_LINEAR,
+                         GLint wrapS = GL_REPEAT, GLint wrapT = GL_REPEAT, float anisotropy = 1.0f)
+            : wrapS(wrapS), wrapT(wrapT), minFilter(minFilter), magFilter(magFilter), anisotropy(anisotropy), flip(flip) {}
+
+        // mipmapped, linear between levels, repeated
+        static Sampler trilinear(bool flip = false, float anisotropy = 16.0f)
+        {
+            return Sampler(flip, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR, GL_REPEAT, GL_REPEAT, anisotropy);
+        }
+    };
+
+    // shared reference to a texture, the texture is unused once every copy is gone
+    class Handle
+    {
+    public:
+        Handle() : manager(0), index(0) {}
+        Handle(const Handle& rhs);
+        Handle& operator=(const Handle& rhs);
+        ~Handle()                       { reset(); }
+
+        void reset();                   // release the texture
+        bool isValid() const            { return manager != 0; }
+        GLuint getId() const;           // 0 if not valid or cleared
+        GLuint getSampler() const;      // sampler object of the texture, 0 if not valid or cleared
+        void bind(GLuint unit) const;   // bind the texture and its sampler to a texture unit
+
+    private:
+        friend class TextureManager;
+        Handle(TextureManager* manager, unsigned int index);
+
+        TextureManager* manager;
+        unsigned int index;             // in manager->entries
+    };
+
+    // budget is the # of bytes the resident textures may use before unused ones are evicted
+    explicit TextureManager(TextureStreamer& streamer, size_t budget = 256 * 1024 * 1024);
+    ~TextureManager();
+
+    // return the texture for the file and sampler, queue the file if it is not loaded yet
+    Handle load(const char* path, const Sampler& sampler = Sampler());
+
+    // delete unused textures, least recently used first, until under budget
+    // return the # of textures deleted
+    unsigned int evict();
+    // delete every texture and sampler, the handles still alive get id 0
+    void clear();
+
+    // shared sampler object for the settings, e.g. to sample a texture with other settings
+    GLuint getSamplerObject(const Sampler& sampler);
+
+    void setBudget(size_t bytes)        { budget = bytes; }
+    size_t getBudget() const            { return budget; }
+    size_t getResidentBytes() const     { return residentBytes; }
+    size_t getResidentBytes(const Handle& handle) const;
+    unsigned int getTextureCount() const;
+
+    // print each texture with its references and resident bytes
+    void printStats() const;
+
+private:
+    struct Entry
+    {
+        std::string key;                // canonical path + sampler, empty if the entry is free
+        std::string path;
+        GLuint id;
+        GLuint sampler;
+        unsigned int references;
+        size_t bytes;                   // resident size, the placeholder until uploaded
+        bool loading;                   // queued in the streamer, not deleted until uploaded
+        bool failed;
+        uint64_t lastUsed;              // value of useCounter when last acquired or released
+    };
+
+    // not copyable, the handles point to it
+    TextureManager(const TextureManager&);
+    TextureManager& operator=(const TextureManager&);
+
+    void acquire(unsigned int index);
+    void release(unsigned int index);
+    void onUpload(GLuint texture, size_t bytes);
+    void remove(unsigned int index);
+
+    TextureStreamer& streamer;
+    std::vector<Entry> entries;
+    std::vector<unsigned int> freeEntries;
+    std::unordered_map<std::string, unsigned int> keys;     // key to entry
+    std::unordered_map<GLuint, unsigned int> ids;           // texture id to entry
+    std::unordered_map<std::string, GLuint> samplers;       // sampler settings to sampler object
+    size_t budget;
+    size_t residentBytes;
+    uint64_t useCounter;
+    unsigned int evictedCount;
+    float maxAnisotropy;                                    // 0 until queried
+};
+
+#endif
@@ -0,0 +1,686 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureStreamer.cpp
+// ===================
+// Background texture loading through a persistently mapped PBO ring.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include "TextureStreamer.h"
+#include "Parallel.h"
+#include "MipGenerator.h"
+#include "ImageKernels.h"
+#include "Ktx2.h"
+#include "stb_image.h"
+
+
+
+namespace
+{
+    // mid grey, drawn until the real image is resident
+    const unsigned char PLACEHOLDER[4] = { 128, 128, 128, 255 };
+
+    GLenum getFormat(int channels)
+    {
+        switch(channels)
+        {
+        case 1:  return GL_RED;
+        case 2:  return GL_RG;
+        case 3:  return GL_RGB;
+        default: return GL_RGBA;
+        }
+    }
+
+    GLenum getInternalFormat(int channels)
+    {
+        switch(channels)
+        {
+        case 1:  return GL_R8;
+        case 2:  return GL_RG8;
+        case 3:  return GL_RGB8;
+        default: return GL_RGBA8;
+        }
+    }
+
+    // # of bytes of a level
+    size_t getLevelSize(bool compressed, BlockCompression::Format format, int width, int height, int channels, unsigned int level)
+    {
+        if(!compressed)
+            return MipGenerator::getLevelSize(width, height, channels, level);
+        return BlockCompression::getImageSize(format, MipGenerator::getLevelDimension(width, level), MipGenerator::getLevelDimension(height, level));
+    }
+
+    // image resized to the layer's image size and padded with its edge pixels to the layer size
+    // the image is put where the staged rows start (its top, or its bottom if the rows are flipped)
+    // so it is at (u, v) = (0, 0) either way
+    void fitToLayer(const unsigned char* image, int width, int height, const TextureStreamer::Layer& layer, bool flip,
+                    std::vector<unsigned char>& dst)
+    {
+        const int channels = layer.channels;
+        std::vector<unsigned char> resized;
+        if(width != layer.imageWidth || height != layer.imageHeight)
+        {
+            resized.resize((size_t)layer.imageWidth * layer.imageHeight * channels);
+            MipGenerator::resize(image, width, height, channels, resized.data(), layer.imageWidth, layer.imageHeight);
+            image = resized.data();
+        }
+
+        const size_t imageRowSize = (size_t)layer.imageWidth * channels;
+        const size_t rowSize = (size_t)layer.width * channels;
+        const int top = flip ? layer.height - layer.imageHeight : 0;
+        dst.resize(rowSize * layer.height);
+        for(int y = 0; y < layer.height; ++y)
+        {
+            const int sy = std::min(std::max(y - top, 0), layer.imageHeight - 1);
+            const unsigned char* in = image + sy * imageRowSize;
+            unsigned char* out = &dst[y * rowSize];
+            memcpy(out, in, imageRowSize);
+            for(size_t x = imageRowSize; x < rowSize; x += channels)
+                memcpy(out + x, in + imageRowSize - channels, channels);
+        }
+    }
+
+    // copy rows, bottom row first if flip is set (OpenGL's Y axis goes up)
+    void copyRows(unsigned char* dst, const unsigned char* src, size_t rowSize, int height, bool flip)
+    {
+        for(int y = 0; y < height; ++y)
+            memcpy(dst + (size_t)y * rowSize, src + (size_t)(flip ? height - 1 - y : y) * rowSize, rowSize);
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor/dtor
+///////////////////////////////////////////////////////////////////////////////
+TextureStreamer::TextureStreamer() : stopping(false), uploads(256), pendingCount(0),
+                                     stagingBuffer(0), stagingData(0), stagingSize(0), stagingHead(0), nextAllocation(0),
+                                     compressedFormats(0), textureCount(0), failedCount(0), stagedCount(0), compressedCount(0), uploadedBytes(0)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    stop();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// GL format of a block format
+///////////////////////////////////////////////////////////////////////////////
+GLenum TextureStreamer::getCompressedFormat(BlockCompression::Format format)
+{
+    switch(format)
+    {
+    case BlockCompression::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BlockCompression::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BlockCompression::BC4: return GL_COMPRESSED_RED_RGTC1;
+    case BlockCompression::BC5: return GL_COMPRESSED_RG_RGTC2;
+    default:                    return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// create the staging ring and start the workers
+///////////////////////////////////////////////////////////////////////////////
+void TextureStreamer::start(unsigned int threadCount, size_t size)
+{
+    if(!workers.empty())
+        return;
+
+    // the ring is written by the workers while the GPU reads older ranges of it
+    if(GLEW_ARB_buffer_storage && size > 0)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &stagingBuffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, 0, flags);
+        stagingData = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if(stagingData)
+        {
+            stagingSize = size;
+        }
+        else
+        {
+            glDeleteBuffers(1, &stagingBuffer);
+            stagingBuffer = 0;
+        }
+    }
+
+    // compressed formats the workers may stage instead of decoding, core since GL 4.2 except S3TC
+    compressedFormats = 0;
+    if(GLEW_EXT_texture_compression_s3tc)
+        compressedFormats |= (1u << BlockCompression::BC1) | (1u << BlockCompression::BC3);
+    if(GLEW_VERSION_3_0 || GLEW_ARB_texture_compression_rgtc)
+        compressedFormats |= (1u << BlockCompression::BC4) | (1u << BlockCompression::BC5);
+    if(GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc)
+        compressedFormats |= 1u << BlockCompression::BC7;
+
+    if(threadCount == 0)
+        threadCount = std::max(Parallel::getDefaultThreadCount(), 2u) - 1;
+    stopping = false;
+    for(unsigned int i = 0; i < threadCount; ++i)
+        workers.push_back(std::thread(&TextureStreamer::workerLoop, this, i));
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// stop the workers and release everything still in flight
+///////////////////////////////////////////////////////////////////////////////
+void TextureStreamer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        stopping = true;
+        pendingCount -= (unsigned int)requests.size();
+        requests.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(stagingMutex);     // wake workers waiting for ring space
+    }
+    requestCondition.notify_all();
+    stagingCondition.notify_all();
+    for(size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+    workers.clear();
+
+    Upload upload;
+    while(uploads.pop(upload))
+    {
+        free(upload.pixels);
+        --pendingCount;
+    }
+
+    for(size_t i = 0; i < allocations.size(); ++i)
+        if(allocations[i].fence)
+            glDeleteSync(allocations[i].fence);
+    allocations.clear();
+    stagingHead = 0;
+
+    if(stagingBuffer)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &stagingBuffer);
+        stagingBuffer = 0;
+        stagingData = 0;
+        stagingSize = 0;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// queue a file
+///////////////////////////////////////////////////////////////////////////////
+GLuint TextureStreamer::load(const char* path, bool flipVertically, bool generateMipmaps)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, generateMipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    load(texture, path, flipVertically, generateMipmaps);
+    return texture;
+}
+
+void TextureStreamer::load(GLuint texture, const char* path, bool flipVertically, bool generateMipmaps)
+{
+    // placeholder, so the texture is complete and can be sampled right away
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, PLACEHOLDER);
+    if(generateMipmaps)
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+    Request request;
+    request.texture = texture;
+    request.path = path;
+    request.flip = flipVertically;
+    request.mipmaps = generateMipmaps;
+    request.array = false;
+    queue(request);
+}
+
+void TextureStreamer::load(const Layer& layer, const char* path, bool flipVertically)
+{
+    Request request;
+    request.texture = layer.texture;
+    request.path = path;
+    request.flip = flipVertically;
+    request.mipmaps = true;
+    request.array = true;
+    request.layer = layer;
+    queue(request);
+}
+
+void TextureStreamer::queue(const Request& request)
+{
+    if(pendingCount.load() == 0 && textureCount == 0)
+        firstRequest = Clock::now();
+
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        requests.push_back(request);
+        ++pendingCount;
+    }
+    requestCondition.notify_one();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// decode files and stage them for upload
+///////////////////////////////////////////////////////////////////////////////
+void TextureStreamer::workerLoop(unsigned int index)
+{
+    for(;;)
+    {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(requestMutex);
+            requestCondition.wait(lock, [this] { return stopping || !requests.empty(); });
+            if(stopping)
+                return;
+            request = requests.front();
+            requests.pop_front();
+        }
+
+        Upload upload;
+        upload.texture = request.texture;
+        upload.layer = request.array ? request.layer.index : -1;
+        upload.levels = 1;
+        upload.size = 0;
+        upload.compressed = false;
+        upload.format = BlockCompression::BC1;
+        upload.pixels = 0;
+        upload.offset = 0;
+        upload.allocation = 0;
+
+        Timing timing;
+        timing.path = request.path;
+        timing.worker = index;
+        timing.decodeStart = Clock::now();
+        timing.mipmapTime = 0;
+
+        // the compressed texture is read in place from the mapped file, else the image is decoded
+        // layers of uncompressed arrays are always decoded, they are fitted to the layer size
+        Ktx2::Reader compressed;
+        unsigned char* pixels = 0;
+        const unsigned char* image = 0;
+        std::vector<unsigned char> fitted;
+        std::vector<unsigned char> expanded;
+        if(request.array && request.layer.compressed)
+        {
+            // the packer checked the file, it is only missing if it changed since
+            upload.width = request.layer.width;
+            upload.height = request.layer.height;
+            upload.channels = 0;
+            upload.levels = MipGenerator::getLevelCount(upload.width, upload.height);
+            if(compressed.open(Ktx2::getCompressedPath(request.path).c_str()) && canUpload(compressed, request) &&
+               compressed.getFormat() == request.layer.format &&
+               compressed.getWidth() == upload.width && compressed.getHeight() == upload.height)
+            {
+                upload.compressed = true;
+                upload.format = compressed.getFormat();
+            }
+            else
+            {
+                std::cout << "[ERROR] TextureStreamer: " << Ktx2::getCompressedPath(request.path) << " does not fit its layer" << std::endl;
+            }
+        }
+        else if(request.array)
+        {
+            int width, height, channels;
+            pixels = stbi_load(request.path.c_str(), &width, &height, &channels, request.layer.channels);
+            if(pixels)
+            {
+                upload.width = request.layer.width;
+                upload.height = request.layer.height;
+                upload.channels = request.layer.channels;
+                upload.levels = MipGenerator::getLevelCount(upload.width, upload.height);
+                image = pixels;
+                if(width != upload.width || height != upload.height)
+                {
+                    fitToLayer(pixels, width, height, request.layer, request.flip, fitted);
+                    image = fitted.data();
+                }
+            }
+            else
+            {
+                std::cout << "[ERROR] TextureStreamer: failed to load " << request.path << std::endl;
+            }
+        }
+        else if(compressedFormats && compressed.open(Ktx2::getCompressedPath(request.path).c_str()) && canUpload(compressed, request))
+        {
+            upload.compressed = true;
+            upload.format = compressed.getFormat();
+            upload.width = compressed.getWidth();
+            upload.height = compressed.getHeight();
+            upload.channels = 0;
+            upload.levels = request.mipmaps ? MipGenerator::getLevelCount(upload.width, upload.height) : 1;
+        }
+        else
+        {
+            image = pixels = stbi_load(request.path.c_str(), &upload.width, &upload.height, &upload.channels, 0);
+            if(pixels)
+            {
+                upload.levels = request.mipmaps ? MipGenerator::getLevelCount(upload.width, upload.height) : 1;
+                // GPUs store RGB8 as RGBA8 anyway, expanded here it is not converted by the driver on upload
+                if(upload.channels == 3)
+                {
+                    expanded.resize((size_t)upload.width * upload.height * 4);
+                    ImageKernels::expandRgbToRgba(pixels, expanded.data(), (size_t)upload.width * upload.height);
+                    image = expanded.data();
+                    upload.channels = 4;
+                }
+            }
+            else
+                std::cout << "[ERROR] TextureStreamer: failed to load " << request.path << std::endl;
+        }
+        upload.failed = !upload.compressed && !image;
+
+        if(!upload.failed)
+        {
+            // the whole mipmap chain is staged here, so update() only copies it
+            for(unsigned int level = 0; level < upload.levels; ++level)
+                upload.size += getLevelSize(upload.compressed, upload.format, upload.width, upload.height, upload.channels, level);
+
+            unsigned char* dst = 0;
+            if(stagingData && upload.size <= stagingSize && allocate(upload.size, upload.offset, upload.allocation))
+            {
+                dst = stagingData + upload.offset;
+            }
+            else
+            {
+                if(stopping)
+                {
+                    stbi_image_free(pixels);
+                    --pendingCount;
+                    return;
+                }
+                dst = upload.pixels = (unsigned char*)malloc(upload.size);
+            }
+
+            if(!dst)
+            {
+                std::cout << "[ERROR] TextureStreamer: out of memory for " << request.path << std::endl;
+                upload.failed = true;
+            }
+            else if(upload.compressed)
+            {
+                // levels are stored smallest first in the file, staged largest first
+                for(unsigned int level = 0; level < upload.levels; ++level)
+                {
+                    memcpy(dst, compressed.getLevelData(level), compressed.getLevelSize(level));
+                    dst += compressed.getLevelSize(level);
+                }
+            }
+            else
+            {
+                // flip and stage in one pass, then the smaller levels from the unflipped image
+                const size_t rowSize = (size_t)upload.width * upload.channels;
+                copyRows(dst, image, rowSize, upload.height, request.flip);
+                if(upload.levels > 1)
+                {
+                    Clock::time_point mipmapStart = Clock::now();
+                    MipGenerator::generate(image, upload.width, upload.height, upload.channels, dst + rowSize * upload.height, request.flip);
+                    timing.mipmapTime = std::chrono::duration<float, std::milli>(Clock::now() - mipmapStart).count();
+                }
+            }
+            stbi_image_free(pixels);
+        }
+
+        timing.decodeEnd = timing.uploadStart = timing.uploadEnd = Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(timingMutex);
+            upload.timing = timings.size();
+            timings.push_back(timing);
+        }
+
+        // the queue only fills up if the GL thread stops calling update()
+        while(!uploads.push(upload))
+        {
+            if(stopping)
+            {
+                free(upload.pixels);
+                --pendingCount;
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// a compressed texture replaces the file only if it gives the same texture
+///////////////////////////////////////////////////////////////////////////////
+bool TextureStreamer::canUpload(const Ktx2::Reader& texture, const Request& request) const
+{
+    const unsigned int levels = request.mipmaps ? MipGenerator::getLevelCount(texture.getWidth(), texture.getHeight()) : 1;
+    return (compressedFormats & (1u << texture.getFormat())) &&
+           texture.isFlipped() == request.flip &&
+           texture.getLevelCount() >= levels;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// reserve size bytes of the ring, wait while the GPU still reads them
+// return false when stopping
+///////////////////////////////////////////////////////////////////////////////
+bool TextureStreamer::allocate(size_t size, size_t& offset, unsigned int& id)
+{
+    std::unique_lock<std::mutex> lock(stagingMutex);
+    for(;;)
+    {
+        if(stopping)
+            return false;
+
+        if(allocations.empty())
+        {
+            stagingHead = 0;
+            offset = 0;
+            break;
+        }
+
+        size_t tail = allocations.front().offset;
+        if(stagingHead > tail)
+        {
+            // free space at the end, or wrap to the start
+            if(stagingSize - stagingHead >= size)
+            {
+                offset = stagingHead;
+                break;
+            }
+            if(tail >= size)
+            {
+                offset = 0;
+                break;
+            }
+        }
+        else if(tail - stagingHead >= size)
+        {
+            offset = stagingHead;
+            break;
+        }
+        stagingCondition.wait(lock);
+    }
+
+    Allocation allocation;
+    allocation.id = id = ++nextAllocation;
+    allocation.offset = offset;
+    allocation.size = size;
+    allocation.fence = 0;
+    allocations.push_back(allocation);
+    stagingHead = offset + size;
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// release the ring ranges the GPU is done with, in ring order
+///////////////////////////////////////////////////////////////////////////////
+void TextureStreamer::retireAllocations()
+{
+    bool released = false;
+    {
+        std::lock_guard<std::mutex> lock(stagingMutex);
+        while(!allocations.empty() && allocations.front().fence)
+        {
+            GLenum result = glClientWaitSync(allocations.front().fence, 0, 0);
+            if(result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(allocations.front().fence);
+            allocations.pop_front();
+            released = true;
+        }
+    }
+    if(released)
+        stagingCondition.notify_all();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// upload decoded images
+///////////////////////////////////////////////////////////////////////////////
+unsigned int TextureStreamer::update(size_t byteBudget)
+{
+    retireAllocations();
+
+    unsigned int count = 0;
+    size_t bytes = 0;
+    Upload upload;
+    while(bytes < byteBudget && uploads.pop(upload))
+    {
+        --pendingCount;
+        if(upload.failed)
+        {
+            ++failedCount;
+            if(uploadCallback)
+                uploadCallback(upload.texture, 0);
+            continue;           // keeps the placeholder
+        }
+
+        Clock::time_point uploadStart = Clock::now();
+        const GLenum target = upload.layer >= 0 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+        glBindTexture(target, upload.texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if(!upload.pixels)
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+
+        // every level of the chain, from client memory or as offsets in the bound PBO
+        size_t offset = 0;
+        for(unsigned int level = 0; level < upload.levels; ++level)
+        {
+            const GLsizei width = MipGenerator::getLevelDimension(upload.width, level);
+            const GLsizei height = MipGenerator::getLevelDimension(upload.height, level);
+            const size_t levelSize = getLevelSize(upload.compressed, upload.format, upload.width, upload.height, upload.channels, level);
+            const void* data = upload.pixels ? (const void*)(upload.pixels + offset) : (const void*)(upload.offset + offset);
+            if(upload.layer >= 0 && upload.compressed)
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, upload.layer, width, height, 1,
+                                          getCompressedFormat(upload.format), (GLsizei)levelSize, data);
+            else if(upload.layer >= 0)
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, upload.layer, width, height, 1,
+                                getFormat(upload.channels), GL_UNSIGNED_BYTE, data);
+            else if(upload.compressed)
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, getCompressedFormat(upload.format), width, height, 0, (GLsizei)levelSize, data);
+            else
+                glTexImage2D(GL_TEXTURE_2D, level, getInternalFormat(upload.channels), width, height, 0,
+                             getFormat(upload.channels), GL_UNSIGNED_BYTE, data);
+            offset += levelSize;
+        }
+        if(upload.compressed)
+            ++compressedCount;
+
+        if(upload.pixels)
+        {
+            free(upload.pixels);
+        }
+        else
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+            // the range is reused once the GPU has copied it
+            GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            std::lock_guard<std::mutex> lock(stagingMutex);
+            for(size_t i = 0; i < allocations.size(); ++i)
+            {
+                if(allocations[i].id == upload.allocation)
+                {
+                    allocations[i].fence = fence;
+                    break;
+                }
+            }
+            ++stagedCount;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        bytes += upload.size;
+        uploadedBytes += upload.size;
+        ++textureCount;
+        ++count;
+        lastUpload = Clock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(timingMutex);
+            timings[upload.timing].uploadStart = uploadStart;
+            timings[upload.timing].uploadEnd = lastUpload;
+        }
+        if(uploadCallback)
+            uploadCallback(upload.texture, upload.size);
+    }
+    return count;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// print texture count, bytes and load time
+///////////////////////////////////////////////////////////////////////////////
+void TextureStreamer::printStats() const
+{
+    const float MB = 1024.0f * 1024.0f;
+    float time = textureCount ? std::chrono::duration<float, std::milli>(lastUpload - firstRequest).count() : 0.0f;
+    float mipmapTime = 0;
+    {
+        std::lock_guard<std::mutex> lock(timingMutex);
+        for(size_t i = 0; i < timings.size(); ++i)
+            mipmapTime += timings[i].mipmapTime;
+    }
+    std::cout << "===== TextureStreamer =====\n"
+              << std::fixed << std::setprecision(2)
+              << "  Textures: " << textureCount << " (" << failedCount << " failed, " << getPendingCount() << " pending)\n"
+              << "  Uploaded: " << uploadedBytes / MB << " MB (" << stagedCount << " through the PBO ring)\n"
+              << "Compressed: " << compressedCount << " textures uploaded from .ktx2 files\n"
+              << "   Mipmaps: " << mipmapTime << " ms on the workers\n"
+              << "   Staging: " << stagingSize / MB << " MB persistent PBO, " << workers.size() << " worker threads\n"
+              << " Load Time: " << time << " ms (first request to last upload)" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// copy of the per file timings
+///////////////////////////////////////////////////////////////////////////////
+std::vector<TextureStreamer::Timing> TextureStreamer::getTimings() const
+{
+    std::lock_guard<std::mutex> lock(timingMutex);
+    return timings;
+}
@@ -0,0 +1,222 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureStreamer.h
+// =================
+// Background texture loading.
+// load() gives the texture a 1x1 placeholder and queues the file, so the
+// texture can be drawn right away. Worker threads decode the files with
+// stbi_load(), expand RGB images to RGBA (ImageKernels, so the driver does
+// not convert them on upload), build the mipmap chain (MipGenerator) and copy
+// the levels (flipped if asked) into a persistently mapped pixel unpack
+// buffer (PBO) ring. Finished images reach the GL thread
+// through a lock-free queue; update(), called once per frame, issues
+// glTexImage2D() from the PBO, so the driver copies the pixels with DMA and
+// the GL thread never waits for a decode or a memcpy.
+//
+// A fence per upload tells when the GPU is done reading a ring range so the
+// workers can reuse it. Images larger than the ring (or when buffer storage
+// is not available) are uploaded from client memory instead.
+//
+// If a block compressed texture (.ktx2, see TextureConverter.h) is next to
+// the file, with the same orientation, every level the request needs and a
+// format the GPU supports, the worker copies its levels from the mapped
+// file instead of decoding, and update() uploads them with
+// glCompressedTexImage2D(): no decode or mipmap work, and 4 to 8 times less
+// to copy and keep resident.
+//
+// A file can also be loaded into a layer of a GL_TEXTURE_2D_ARRAY (see
+// TextureArrayPacker.h): the worker converts it to the array's channels,
+// resizes it, pads it with its edge pixels to the layer size and builds its
+// mipmaps, and update() uploads them with glTexSubImage3D(). A layer of a
+// block compressed array is copied from the file's .ktx2 instead, which
+// must have the layer's size and format, and uploaded with
+// glCompressedTexSubImage3D().
+//
+// usage:
+//     streamer.start();
+//     GLuint id = streamer.load("assets/textures/base.png", true);
+//     while(running) { streamer.update(); render(); }
+//     streamer.stop();
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include "LockFreeQueue.h"
+#include "BlockCompression.h"
+
+namespace Ktx2 { class Reader; }
+
+class TextureStreamer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // when and where one file was decoded and uploaded
+    struct Timing
+    {
+        std::string path;
+        unsigned int worker;            // index of the decoding thread
+        Clock::time_point decodeStart;
+        Clock::time_point decodeEnd;    // decoded and staged
+        Clock::time_point uploadStart;  // same as uploadEnd until update() uploads it
+        Clock::time_point uploadEnd;
+        float mipmapTime;               // ms spent on the mipmap chain, part of the decode
+    };
+
+    // a layer of an array texture created by the caller with the full mipmap chain
+    struct Layer
+    {
+        GLuint texture;                 // GL_TEXTURE_2D_ARRAY
+        GLint index;                    // layer in the array
+        int width;                      // size of the layers
+        int height;
+        int channels;                   // of the array's format, the image is converted to it
+        int imageWidth;                 // size the image is resized to, at (u, v) = (0, 0) in the layer
+        int imageHeight;                // the rest of the layer repeats the image's edge pixels
+        bool compressed;                // the array has format, the levels come from the .ktx2, channels unused
+        BlockCompression::Format format;
+    };
+
+    // called on the GL thread by update() once a file is uploaded
+    // bytes is the size of the texture with its mipmaps, 0 if the file failed to load
+    typedef std::function<void(GLuint texture, size_t bytes)> UploadCallback;
+
+    TextureStreamer();
+    ~TextureStreamer();
+
+    // create the staging ring and the workers, call on the GL thread
+    // threadCount = 0 uses one thread per core minus the GL thread
+    void start(unsigned int threadCount = 0, size_t stagingSize = 64 * 1024 * 1024);
+    // stop the workers and release the ring, queued files are dropped
+    void stop();
+
+    // create a texture with a placeholder and queue the file, return the texture id
+    GLuint load(const char* path, bool flipVertically = false, bool generateMipmaps = true);
+    // same for a texture created by the caller (e.g. with its sampling parameters already set)
+    void load(GLuint texture, const char* path, bool flipVertically = false, bool generateMipmaps = true);
+    // queue a file for a layer of an array texture, the layer keeps its content until the image is uploaded
+    void load(const Layer& layer, const char* path, bool flipVertically = false);
+
+    // upload finished images, call once per frame on the GL thread
+    // at least one image is uploaded, then more while under byteBudget bytes
+    // return the # of textures made resident
+    unsigned int update(size_t byteBudget = 32 * 1024 * 1024);
+
+    // true when every queued file is uploaded (or failed)
+    bool isIdle() const                 { return pendingCount.load() == 0; }
+    unsigned int getPendingCount() const { return pendingCount.load(); }
+
+    // print texture count, bytes and the time from the first load() to the last upload
+    void printStats() const;
+
+    // decode and upload times of every file loaded so far
+    std::vector<Timing> getTimings() const;
+
+    void setUploadCallback(UploadCallback callback) { uploadCallback = callback; }
+
+    // the GPU can sample the format, known once started
+    bool isSupported(BlockCompression::Format format) const { return (compressedFormats & (1u << format)) != 0; }
+    // GL internal format of a block format
+    static GLenum getCompressedFormat(BlockCompression::Format format);
+
+private:
+
+    struct Request
+    {
+        GLuint texture;
+        std::string path;
+        bool flip;
+        bool mipmaps;
+        bool array;                     // to layer, not texture
+        Layer layer;
+    };
+
+    // a decoded image waiting for the GL thread
+    struct Upload
+    {
+        GLuint texture;
+        GLint layer;                    // in the array texture, -1 for a 2D texture
+        int width;
+        int height;
+        int channels;
+        unsigned int levels;            // 1, or the full mipmap chain packed after the base level
+        size_t size;                    // # of bytes of the levels
+        bool compressed;                // levels in format from a .ktx2, channels unused
+        BlockCompression::Format format;
+        bool failed;
+        unsigned char* pixels;          // client memory from malloc, 0 if staged
+        size_t offset;                  // in the staging ring if staged
+        unsigned int allocation;        // id of the ring range
+        size_t timing;                  // index in timings
+    };
+
+    // a range of the staging ring, released once its fence is signaled
+    struct Allocation
+    {
+        unsigned int id;
+        size_t offset;
+        size_t size;
+        GLsync fence;                   // 0 until the upload is issued
+    };
+
+    // not copyable, owns threads and GL objects
+    TextureStreamer(const TextureStreamer&);
+    TextureStreamer& operator=(const TextureStreamer&);
+
+    void queue(const Request& request);
+    void workerLoop(unsigned int index);
+    bool canUpload(const Ktx2::Reader& texture, const Request& request) const;
+    bool allocate(size_t size, size_t& offset, unsigned int& id);
+    void retireAllocations();
+
+    // workers and their requests
+    std::vector<std::thread> workers;
+    std::mutex requestMutex;
+    std::condition_variable requestCondition;
+    std::deque<Request> requests;
+    bool stopping;
+
+    // decoded images, workers to GL thread
+    LockFreeQueue<Upload> uploads;
+    std::atomic<unsigned int> pendingCount;
+
+    // persistently mapped PBO ring
+    GLuint stagingBuffer;
+    unsigned char* stagingData;
+    size_t stagingSize;
+    std::mutex stagingMutex;
+    std::condition_variable stagingCondition;
+    std::deque<Allocation> allocations;     // in ring order
+    size_t stagingHead;
+    unsigned int nextAllocation;
+
+    // per file timings, written by the workers and the GL thread
+    mutable std::mutex timingMutex;
+    std::vector<Timing> timings;
+
+    UploadCallback uploadCallback;
+
+    // bit per BlockCompression::Format the GPU can sample, set by start()
+    unsigned int compressedFormats;
+
+    // stats, GL thread only
+    unsigned int textureCount;
+    unsigned int failedCount;
+    unsigned int stagedCount;
+    unsigned int compressedCount;
+    size_t uploadedBytes;
+    Clock::time_point firstRequest;
+    Clock::time_point lastUpload;
+};
+
+#endif
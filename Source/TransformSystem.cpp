@@ -0,0 +1,602 @@
+///////////////////////////////////////////////////////////////////////////////
+// TransformSystem.cpp
+// ===================
+// Batched transform storage for scene objects.
+// Translation, rotation (unit quaternion) and scale are stored in SoA form
+// (one array per component) so that the world (model) matrix and the normal
+// matrix of many objects can be computed together with SSE (4 wide) or AVX2
+// (8 wide) instructions. Only batches that contain a modified entry are
+// recomputed by update().
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtx/transform.hpp>
+#include "TransformSystem.h"
+#include "JobSystem.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TRANSFORM_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define TRANSFORM_TARGET(isa)
+#define TRANSFORM_INLINE __forceinline
+#else
+// compiled for the instruction set whatever the build flags, only called once the CPU is known to have it
+#define TRANSFORM_TARGET(isa) __attribute__((target(isa)))
+#define TRANSFORM_INLINE __attribute__((always_inline)) inline
+// the kernel template passes vectors between the lane helpers, but it is always inlined
+// into the entry point of its own instruction set, so no vector crosses an ABI boundary
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+#else
+#define TRANSFORM_INLINE inline
+#endif
+
+
+
+// lane helpers ///////////////////////////////////////////////////////////////
+// Each helper wraps one SIMD width, so the same kernel is used for all paths.
+namespace
+{
+    // # of output components per entry: 16 for world + 9 for normal matrix
+    const int COMPONENT_COUNT = 25;
+
+    // copy the results of lanes [begin, end) of a SIMD step (out[component][lane], width lanes per
+    // component) to the matrices of their entries, world and normal are those of the step's first entry
+    inline void scatterScalar(const float* out, unsigned int width, unsigned int begin, unsigned int end,
+                              float* world, float* normal)
+    {
+        for(unsigned int i = begin; i < end; ++i)
+        {
+            for(int j = 0; j < 16; ++j)
+                world[i * 16 + j] = out[j * width + i];
+            for(int j = 0; j < 9; ++j)
+                normal[i * 9 + j] = out[(16 + j) * width + i];
+        }
+    }
+
+#if defined(TRANSFORM_X86)
+    // the same for the 4 lanes from begin, 4 components at a time with a 4x4 transpose;
+    // the rows of the normal matrices overlap the next entry's first components, written after
+    TRANSFORM_TARGET("sse2")
+    inline void scatter4(const float* out, unsigned int width, unsigned int begin, float* world, float* normal)
+    {
+        for(int j = 0; j < 24; j += 4)
+        {
+            __m128 c0 = _mm_loadu_ps(out + (j + 0) * width + begin);
+            __m128 c1 = _mm_loadu_ps(out + (j + 1) * width + begin);
+            __m128 c2 = _mm_loadu_ps(out + (j + 2) * width + begin);
+            __m128 c3 = _mm_loadu_ps(out + (j + 3) * width + begin);
+            _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+            float* p = j < 16 ? world + begin * 16 + j : normal + begin * 9 + j - 16;
+            const unsigned int stride = j < 16 ? 16 : 9;
+            _mm_storeu_ps(p, c0);
+            _mm_storeu_ps(p + stride, c1);
+            _mm_storeu_ps(p + stride * 2, c2);
+            _mm_storeu_ps(p + stride * 3, c3);
+        }
+        for(unsigned int i = begin; i < begin + 4; ++i)
+            normal[i * 9 + 8] = out[24 * width + i];
+    }
+#endif
+
+    struct Lanes1
+    {
+        typedef float Type;
+        static const unsigned int WIDTH = 1;
+        static Type load(const float* p)            { return *p; }
+        static void store(float* p, Type v)         { *p = v; }
+        static Type set(float s)                    { return s; }
+        static Type add(Type a, Type b)             { return a + b; }
+        static Type sub(Type a, Type b)             { return a - b; }
+        static Type mul(Type a, Type b)             { return a * b; }
+        static Type div(Type a, Type b)             { return a / b; }
+        static void scatter(const float* out, unsigned int lanes, float* world, float* normal)
+        {
+            scatterScalar(out, WIDTH, 0, lanes, world, normal);
+        }
+    };
+
+#if defined(TRANSFORM_X86)
+    struct Lanes4
+    {
+        typedef __m128 Type;
+        static const unsigned int WIDTH = 4;
+        TRANSFORM_TARGET("sse2") static Type load(const float* p)       { return _mm_loadu_ps(p); }
+        TRANSFORM_TARGET("sse2") static void store(float* p, Type v)    { _mm_store_ps(p, v); }
+        TRANSFORM_TARGET("sse2") static Type set(float s)               { return _mm_set1_ps(s); }
+        TRANSFORM_TARGET("sse2") static Type add(Type a, Type b)        { return _mm_add_ps(a, b); }
+        TRANSFORM_TARGET("sse2") static Type sub(Type a, Type b)        { return _mm_sub_ps(a, b); }
+        TRANSFORM_TARGET("sse2") static Type mul(Type a, Type b)        { return _mm_mul_ps(a, b); }
+        TRANSFORM_TARGET("sse2") static Type div(Type a, Type b)        { return _mm_div_ps(a, b); }
+        TRANSFORM_TARGET("sse2") static void scatter(const float* out, unsigned int lanes, float* world, float* normal)
+        {
+            if(lanes == 4)
+                scatter4(out, WIDTH, 0, world, normal);
+            else
+                scatterScalar(out, WIDTH, 0, lanes, world, normal);
+        }
+    };
+
+    struct Lanes8
+    {
+        typedef __m256 Type;
+        static const unsigned int WIDTH = 8;
+        TRANSFORM_TARGET("avx2") static Type load(const float* p)       { return _mm256_loadu_ps(p); }
+        TRANSFORM_TARGET("avx2") static void store(float* p, Type v)    { _mm256_store_ps(p, v); }
+        TRANSFORM_TARGET("avx2") static Type set(float s)               { return _mm256_set1_ps(s); }
+        TRANSFORM_TARGET("avx2") static Type add(Type a, Type b)        { return _mm256_add_ps(a, b); }
+        TRANSFORM_TARGET("avx2") static Type sub(Type a, Type b)        { return _mm256_sub_ps(a, b); }
+        TRANSFORM_TARGET("avx2") static Type mul(Type a, Type b)        { return _mm256_mul_ps(a, b); }
+        TRANSFORM_TARGET("avx2") static Type div(Type a, Type b)        { return _mm256_div_ps(a, b); }
+        TRANSFORM_TARGET("avx2") static void scatter(const float* out, unsigned int lanes, float* world, float* normal)
+        {
+            unsigned int i = 0;
+            for(; i + 4 <= lanes; i += 4)
+                scatter4(out, WIDTH, i, world, normal);
+            scatterScalar(out, WIDTH, i, lanes, world, normal);
+        }
+    };
+#endif
+}
+
+
+
+// batch kernel ///////////////////////////////////////////////////////////////
+// One template for all widths, compiled once per instruction set.
+namespace
+{
+    // the SoA arrays of a TransformSystem
+    struct Arrays
+    {
+        const float *posX, *posY, *posZ;
+        const float *rotX, *rotY, *rotZ, *rotW;
+        const float *sclX, *sclY, *sclZ;
+        float* world;
+        float* normal;
+        unsigned int count;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // compute the matrices of BATCH_SIZE entries starting at first
+    // The rotation matrix is built from the quaternion (x, y, z, w):
+    //     | 1-2(yy+zz)   2(xy-wz)    2(xz+wy) |
+    // R = |  2(xy+wz)   1-2(xx+zz)   2(yz-wx) |
+    //     |  2(xz-wy)    2(yz+wx)   1-2(xx+yy)|
+    // world  = [R0*sx, R1*sy, R2*sz, T]  (Ri is the i-th column of R)
+    // normal = [R0/sx, R1/sy, R2/sz]     (inverse transpose of R*S)
+    ///////////////////////////////////////////////////////////////////////////
+    template<class Lanes>
+    TRANSFORM_INLINE void computeBatch(const Arrays& a, unsigned int first)
+    {
+        typedef typename Lanes::Type V;
+        const unsigned int W = Lanes::WIDTH;
+        const unsigned int count = a.count;
+
+        // results of one SIMD step, component-major: out[component][lane]
+        alignas(32) float out[COMPONENT_COUNT][W];
+
+        const V one = Lanes::set(1.0f);
+        const V two = Lanes::set(2.0f);
+        const V zero = Lanes::set(0.0f);
+
+        for(unsigned int base = first; base < first + TransformSystem::BATCH_SIZE && base < count; base += W)
+        {
+            V x = Lanes::load(&a.rotX[base]);
+            V y = Lanes::load(&a.rotY[base]);
+            V z = Lanes::load(&a.rotZ[base]);
+            V w = Lanes::load(&a.rotW[base]);
+            V sx = Lanes::load(&a.sclX[base]);
+            V sy = Lanes::load(&a.sclY[base]);
+            V sz = Lanes::load(&a.sclZ[base]);
+
+            V xx = Lanes::mul(x, x), yy = Lanes::mul(y, y), zz = Lanes::mul(z, z);
+            V xy = Lanes::mul(x, y), xz = Lanes::mul(x, z), yz = Lanes::mul(y, z);
+            V wx = Lanes::mul(w, x), wy = Lanes::mul(w, y), wz = Lanes::mul(w, z);
+
+            // columns of the rotation matrix
+            V r00 = Lanes::sub(one, Lanes::mul(two, Lanes::add(yy, zz)));
+            V r01 = Lanes::mul(two, Lanes::add(xy, wz));
+            V r02 = Lanes::mul(two, Lanes::sub(xz, wy));
+            V r10 = Lanes::mul(two, Lanes::sub(xy, wz));
+            V r11 = Lanes::sub(one, Lanes::mul(two, Lanes::add(xx, zz)));
+            V r12 = Lanes::mul(two, Lanes::add(yz, wx));
+            V r20 = Lanes::mul(two, Lanes::add(xz, wy));
+            V r21 = Lanes::mul(two, Lanes::sub(yz, wx));
+            V r22 = Lanes::sub(one, Lanes::mul(two, Lanes::add(xx, yy)));
+
+            // world matrix
+            Lanes::store(out[0], Lanes::mul(r00, sx));
+            Lanes::store(out[1], Lanes::mul(r01, sx));
+            Lanes::store(out[2], Lanes::mul(r02, sx));
+            Lanes::store(out[3], zero);
+            Lanes::store(out[4], Lanes::mul(r10, sy));
+            Lanes::store(out[5], Lanes::mul(r11, sy));
+            Lanes::store(out[6], Lanes::mul(r12, sy));
+            Lanes::store(out[7], zero);
+            Lanes::store(out[8], Lanes::mul(r20, sz));
+            Lanes::store(out[9], Lanes::mul(r21, sz));
+            Lanes::store(out[10], Lanes::mul(r22, sz));
+            Lanes::store(out[11], zero);
+            Lanes::store(out[12], Lanes::load(&a.posX[base]));
+            Lanes::store(out[13], Lanes::load(&a.posY[base]));
+            Lanes::store(out[14], Lanes::load(&a.posZ[base]));
+            Lanes::store(out[15], one);
+
+            // normal matrix
+            V isx = Lanes::div(one, sx);
+            V isy = Lanes::div(one, sy);
+            V isz = Lanes::div(one, sz);
+            Lanes::store(out[16], Lanes::mul(r00, isx));
+            Lanes::store(out[17], Lanes::mul(r01, isx));
+            Lanes::store(out[18], Lanes::mul(r02, isx));
+            Lanes::store(out[19], Lanes::mul(r10, isy));
+            Lanes::store(out[20], Lanes::mul(r11, isy));
+            Lanes::store(out[21], Lanes::mul(r12, isy));
+            Lanes::store(out[22], Lanes::mul(r20, isz));
+            Lanes::store(out[23], Lanes::mul(r21, isz));
+            Lanes::store(out[24], Lanes::mul(r22, isz));
+
+            // scatter to per-entry matrices, skip the padding entries
+            const unsigned int lanes = (count - base < W) ? count - base : W;
+            Lanes::scatter(&out[0][0], lanes, &a.world[base * 16], &a.normal[base * 9]);
+        }
+    }
+
+    // one entry point per level, the kernel is inlined into each with its instruction set
+    void computeBatchScalar(const Arrays& a, unsigned int first)
+    {
+        computeBatch<Lanes1>(a, first);
+    }
+
+#if defined(TRANSFORM_X86)
+    TRANSFORM_TARGET("sse2")
+    void computeBatchSse2(const Arrays& a, unsigned int first)
+    {
+        computeBatch<Lanes4>(a, first);
+    }
+
+    TRANSFORM_TARGET("avx2")
+    void computeBatchAvx2(const Arrays& a, unsigned int first)
+    {
+        computeBatch<Lanes8>(a, first);
+    }
+#endif
+
+    typedef void (*BatchFunction)(const Arrays&, unsigned int);
+
+    // SSSE3 adds nothing to the float math, it runs the SSE2 kernel
+    BatchFunction getBatchFunction(ImageKernels::Level level)
+    {
+#if defined(TRANSFORM_X86)
+        if(level >= ImageKernels::AVX2)
+            return computeBatchAvx2;
+        if(level >= ImageKernels::SSE2)
+            return computeBatchSse2;
+#endif
+        return computeBatchScalar;
+    }
+
+    unsigned int getWidth(ImageKernels::Level level)
+    {
+        return level >= ImageKernels::AVX2 ? 8 : level >= ImageKernels::SSE2 ? 4 : 1;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// ctor
+///////////////////////////////////////////////////////////////////////////////
+TransformSystem::TransformSystem() : count(0), dirty(false), level(ImageKernels::getSupportedLevel()),
+                                     lastUpdateCount(0), lastUpdateTime(0)
+{
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// cap the SIMD level, the CPU may not support the one asked for
+///////////////////////////////////////////////////////////////////////////////
+void TransformSystem::setLevel(ImageKernels::Level level)
+{
+    const ImageKernels::Level supported = ImageKernels::getSupportedLevel();
+    this->level = level < supported ? level : supported;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// reserve memory for count transforms
+///////////////////////////////////////////////////////////////////////////////
+void TransformSystem::reserve(unsigned int n)
+{
+    unsigned int padded = (n + BATCH_SIZE - 1) / BATCH_SIZE * BATCH_SIZE;
+    posX.reserve(padded); posY.reserve(padded); posZ.reserve(padded);
+    rotX.reserve(padded); rotY.reserve(padded); rotZ.reserve(padded); rotW.reserve(padded);
+    sclX.reserve(padded); sclY.reserve(padded); sclZ.reserve(padded);
+    worldMatrices.reserve(n * 16);
+    normalMatrices.reserve(n * 9);
+    dirtyBatches.reserve(padded / BATCH_SIZE);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// remove all transforms
+///////////////////////////////////////////////////////////////////////////////
+void TransformSystem::clear()
+{
+    count = 0;
+    posX.clear(); posY.clear(); posZ.clear();
+    rotX.clear(); rotY.clear(); rotZ.clear(); rotW.clear();
+    sclX.clear(); sclY.clear(); sclZ.clear();
+    worldMatrices.clear();
+    normalMatrices.clear();
+    dirtyBatches.clear();
+    dirty = false;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// add a new transform and return its id
+// The SoA arrays always hold a multiple of BATCH_SIZE entries; the padding
+// entries are identity transforms so a full batch can be loaded safely.
+///////////////////////////////////////////////////////////////////////////////
+unsigned int TransformSystem::add(float px, float py, float pz,
+                                  float angle, float ax, float ay, float az,
+                                  float sx, float sy, float sz)
+{
+    unsigned int id = count++;
+
+    if(id % BATCH_SIZE == 0)
+    {
+        // append a new batch of identity transforms
+        for(unsigned int i = 0; i < BATCH_SIZE; ++i)
+        {
+            posX.push_back(0); posY.push_back(0); posZ.push_back(0);
+            rotX.push_back(0); rotY.push_back(0); rotZ.push_back(0); rotW.push_back(1);
+            sclX.push_back(1); sclY.push_back(1); sclZ.push_back(1);
+        }
+        dirtyBatches.push_back(0);
+    }
+    worldMatrices.resize(count * 16);
+    normalMatrices.resize(count * 9);
+
+    setPosition(id, px, py, pz);
+    setRotation(id, angle, ax, ay, az);
+    setScale(id, sx, sy, sz);
+    return id;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// setters
+///////////////////////////////////////////////////////////////////////////////
+void TransformSystem::setPosition(unsigned int id, float x, float y, float z)
+{
+    posX[id] = x;
+    posY[id] = y;
+    posZ[id] = z;
+    markDirty(id);
+}
+
+// same convention as glm::rotate(angle, axis): the axis is normalized first
+void TransformSystem::setRotation(unsigned int id, float angle, float ax, float ay, float az)
+{
+    float length = sqrtf(ax * ax + ay * ay + az * az);
+    float s = 0;
+    if(length > 0)
+        s = sinf(angle * 0.5f) / length;
+
+    rotX[id] = ax * s;
+    rotY[id] = ay * s;
+    rotZ[id] = az * s;
+    rotW[id] = cosf(angle * 0.5f);
+    markDirty(id);
+}
+
+void TransformSystem::setScale(unsigned int id, float x, float y, float z)
+{
+    sclX[id] = x;
+    sclY[id] = y;
+    sclZ[id] = z;
+    markDirty(id);
+}
+
+void TransformSystem::markDirty(unsigned int id)
+{
+    dirtyBatches[id / BATCH_SIZE] = 1;
+    dirty = true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// recompute world/normal matrices of all dirty batches, on this thread or
+// spread over the threads of jobs
+///////////////////////////////////////////////////////////////////////////////
+void TransformSystem::update()
+{
+    updateDirtyBatches(0);
+}
+
+void TransformSystem::update(JobSystem& jobs)
+{
+    updateDirtyBatches(&jobs);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// without jobs each dirty batch is computed as it is found; with jobs they
+// are listed in frame memory, then computed in parallel (batches write
+// disjoint matrices, so the jobs share nothing)
+///////////////////////////////////////////////////////////////////////////////
+void TransformSystem::updateDirtyBatches(JobSystem* jobs)
+{
+    lastUpdateCount = 0;
+    if(!dirty)
+    {
+        lastUpdateTime = 0;
+        return;
+    }
+
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+    unsigned int batchCount = (unsigned int)dirtyBatches.size();
+    unsigned int* firsts = jobs ? jobs->getFrameAllocator().allocate<unsigned int>(batchCount) : 0;
+    unsigned int dirtyCount = 0;
+    for(unsigned int i = 0; i < batchCount; ++i)
+    {
+        if(!dirtyBatches[i])
+            continue;
+
+        unsigned int first = i * BATCH_SIZE;
+        if(firsts)
+            firsts[dirtyCount++] = first;
+        else
+            updateBatch(first);
+        dirtyBatches[i] = 0;
+        lastUpdateCount += (count - first < BATCH_SIZE) ? count - first : BATCH_SIZE;
+    }
+    dirty = false;
+
+    // 32 batches (256 transforms) per job at least, a few transforms are not worth a job
+    if(firsts)
+    {
+        jobs->parallelFor(dirtyCount, [this, firsts](unsigned int begin, unsigned int end) {
+            for(unsigned int i = begin; i < end; ++i)
+                updateBatch(firsts[i]);
+        }, 32);
+    }
+
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+    lastUpdateTime = std::chrono::duration<double, std::milli>(t2 - t1).count();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// compute the matrices of BATCH_SIZE entries starting at first with the
+// kernel of the current level
+///////////////////////////////////////////////////////////////////////////////
+void TransformSystem::updateBatch(unsigned int first)
+{
+    const Arrays arrays = { posX.data(), posY.data(), posZ.data(),
+                            rotX.data(), rotY.data(), rotZ.data(), rotW.data(),
+                            sclX.data(), sclY.data(), sclZ.data(),
+                            worldMatrices.data(), normalMatrices.data(), count };
+    getBatchFunction(level)(arrays, first);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// print itself
+///////////////////////////////////////////////////////////////////////////////
+void TransformSystem::printSelf() const
+{
+    std::cout << "===== TransformSystem =====\n"
+              << "  Transform Count: " << count << "\n"
+              << "       SIMD Level: " << ImageKernels::getName(level) << " (" << getWidth(level) << " wide)\n"
+              << "Last Update Count: " << lastUpdateCount << "\n"
+              << " Last Update Time: " << lastUpdateTime << " ms" << std::endl;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// every entry is dirty in every iteration, as when all objects move; the glm
+// column is the per object translate * rotate * scale and inverse transpose
+// the renderer did before, and the reference for the largest difference
+///////////////////////////////////////////////////////////////////////////////
+void TransformSystem::benchmark(unsigned int count, unsigned int iterations)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    if(count == 0)
+        count = 1;
+    const unsigned int runs = iterations > 0 ? iterations : 1;
+
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> angle(-3.14159265f, 3.14159265f);
+    std::uniform_real_distribution<float> axis(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scale(0.1f, 10.0f);
+    std::vector<glm::vec3> positions(count), axes(count), scales(count);
+    std::vector<float> angles(count);
+    TransformSystem transforms;
+    transforms.reserve(count);
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        positions[i] = glm::vec3(position(random), position(random), position(random));
+        angles[i] = angle(random);
+        axes[i] = glm::vec3(axis(random), axis(random), axis(random) + 2.0f);      // never 0
+        scales[i] = glm::vec3(scale(random), scale(random), scale(random));
+        transforms.add(positions[i].x, positions[i].y, positions[i].z, angles[i], axes[i].x, axes[i].y, axes[i].z,
+                       scales[i].x, scales[i].y, scales[i].z);
+    }
+
+    std::vector<glm::mat4> worlds(count);
+    std::vector<glm::mat3> normals(count);
+    Clock::time_point start = Clock::now();
+    for(unsigned int r = 0; r < runs; ++r)
+    {
+        for(unsigned int i = 0; i < count; ++i)
+        {
+            worlds[i] = glm::translate(positions[i]) * glm::rotate(angles[i], axes[i]) * glm::scale(scales[i]);
+            normals[i] = glm::transpose(glm::inverse(glm::mat3(worlds[i])));
+        }
+    }
+    const double glmTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / runs;
+
+    std::cout << "===== TransformSystem Benchmark: " << count << " dirty entries, supported: "
+              << ImageKernels::getName(ImageKernels::getSupportedLevel()) << " =====\n"
+              << std::fixed << std::setprecision(2)
+              << std::setw(8) << "glm" << ": " << std::setw(8) << glmTime << " ms\n";
+
+    for(int l = ImageKernels::SCALAR; l <= ImageKernels::getSupportedLevel(); ++l)
+    {
+        const ImageKernels::Level level = (ImageKernels::Level)l;
+        if(level == ImageKernels::SSSE3)
+            continue;                           // same kernel as SSE2
+        transforms.setLevel(level);
+
+        double time = 0;
+        for(unsigned int r = 0; r < runs; ++r)
+        {
+            // the setters only flag the batches, update() alone is timed
+            for(unsigned int i = 0; i < count; ++i)
+                transforms.setScale(i, scales[i].x, scales[i].y, scales[i].z);
+            transforms.update();
+            time += transforms.getLastUpdateTime();
+        }
+        time /= runs;
+
+        float difference = 0;
+        for(unsigned int i = 0; i < count; ++i)
+        {
+            const float* world = transforms.getWorldMatrix(i);
+            const float* normal = transforms.getNormalMatrix(i);
+            for(int j = 0; j < 16; ++j)
+                difference = std::max(difference, std::fabs(world[j] - worlds[i][j / 4][j % 4]));
+            for(int j = 0; j < 9; ++j)
+                difference = std::max(difference, std::fabs(normal[j] - normals[i][j / 3][j % 3]));
+        }
+
+        std::cout << std::setw(8) << ImageKernels::getName(level) << ": " << std::setw(8) << time << " ms, "
+                  << std::setw(6) << (time > 0 ? glmTime / time : 0.0) << "x glm, largest difference "
+                  << std::scientific << difference << std::fixed << "\n";
+    }
+    std::cout << std::flush;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
@@ -0,0 +1,99 @@
+///////////////////////////////////////////////////////////////////////////////
+// TransformSystem.h
+// =================
+// Batched transform storage for scene objects.
+// Translation, rotation (unit quaternion) and scale are stored in SoA form
+// (one array per component) so that the world (model) matrix and the normal
+// matrix of many objects can be computed together with SSE (4 wide) or AVX2
+// (8 wide) instructions. Only batches that contain a modified entry are
+// recomputed by update().
+//
+// - world matrix : translate * rotate * scale, 4x4 column-major (16 floats)
+// - normal matrix: transpose(inverse(mat3(world))) = rotate * inverse(scale),
+//                  3x3 column-major (9 floats), ready for glUniformMatrix3fv()
+//
+// The SIMD path is selected at run time, like ImageKernels: AVX2 when the CPU
+// and OS support it, SSE2 otherwise, and plain C++ for other CPUs, whatever
+// instruction set the build targets. setLevel() caps it, to compare them:
+//   OpenGLSample --benchmark-transforms
+// update(jobs) spreads the dirty batches over the threads of a JobSystem.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TRANSFORM_SYSTEM_H
+#define TRANSFORM_SYSTEM_H
+
+#include <vector>
+#include "ImageKernels.h"
+
+class JobSystem;
+
+class TransformSystem
+{
+public:
+    // ctor/dtor
+    TransformSystem();
+    ~TransformSystem() {}
+
+    // add a new transform and return its id
+    // angle is in radians, the rotation axis does not need to be normalized
+    unsigned int add(float px, float py, float pz,
+                     float angle, float ax, float ay, float az,
+                     float sx, float sy, float sz);
+    void reserve(unsigned int count);
+    void clear();
+
+    // setters (mark the entry dirty)
+    void setPosition(unsigned int id, float x, float y, float z);
+    void setRotation(unsigned int id, float angle, float ax, float ay, float az);
+    void setScale(unsigned int id, float x, float y, float z);
+
+    // recompute world/normal matrices of all dirty entries
+    void update();
+    // the same with the dirty batches split into parallel jobs, on the thread that started jobs
+    void update(JobSystem& jobs);
+
+    // getters
+    unsigned int getCount() const                   { return count; }
+    const float* getWorldMatrix(unsigned int id) const  { return &worldMatrices[id * 16]; }
+    const float* getNormalMatrix(unsigned int id) const { return &normalMatrices[id * 9]; }
+    const float* getWorldMatrices() const           { return worldMatrices.data(); }
+    const float* getNormalMatrices() const          { return normalMatrices.data(); }
+    unsigned int getLastUpdateCount() const         { return lastUpdateCount; }
+    double getLastUpdateTime() const                { return lastUpdateTime; }
+
+    // SIMD level of update(), the widest the CPU supports unless capped
+    ImageKernels::Level getLevel() const            { return level; }
+    // cap the level, clamped to ImageKernels::getSupportedLevel()
+    void setLevel(ImageKernels::Level level);
+
+    // debug
+    void printSelf() const;
+
+    // time update() of count dirty entries at each supported level against the same matrices built with glm
+    static void benchmark(unsigned int count = 100000, unsigned int iterations = 20);
+
+    static const unsigned int BATCH_SIZE = 8;       // # of entries per dirty flag
+
+private:
+    // member functions
+    void markDirty(unsigned int id);
+    void updateDirtyBatches(JobSystem* jobs);       // both update(), in jobs if not null
+    void updateBatch(unsigned int first);           // compute BATCH_SIZE entries from first
+
+    // member vars
+    unsigned int count;                             // # of transforms
+    std::vector<float> posX, posY, posZ;            // translation
+    std::vector<float> rotX, rotY, rotZ, rotW;      // rotation as unit quaternion
+    std::vector<float> sclX, sclY, sclZ;            // scale
+    std::vector<unsigned char> dirtyBatches;        // 1 flag per BATCH_SIZE entries
+    bool dirty;                                     // any batch is dirty
+
+    std::vector<float> worldMatrices;               // 16 floats per entry
+    std::vector<float> normalMatrices;              // 9 floats per entry
+
+    ImageKernels::Level level;                      // of the batch kernel
+    unsigned int lastUpdateCount;                   // # of entries recomputed by the last update()
+    double lastUpdateTime;                          // duration of the last update() in ms
+};
+
+#endif
@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////
+// TripleBuffer.h
+// ==============
+// Hands the latest value from one writer thread to one reader thread without
+// locks and without either ever waiting: three copies, one owned by the
+// writer, one by the reader, and one in the middle. publish() swaps the
+// writer's copy with the middle one, update() swaps the middle one with the
+// reader's if it is newer. Values the reader did not pick up in time are
+// skipped, e.g. a simulation ticking faster than the frames are drawn.
+//
+// usage:
+//     // writer
+//     buffer.getWriteBuffer() = state;
+//     buffer.publish();
+//     // reader
+//     buffer.update();
+//     draw(buffer.getReadBuffer());
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : middle(1), back(2), front(0)
+    {
+    }
+
+    // set every copy, while neither thread uses the buffer
+    void reset(const T& value)
+    {
+        buffers[0] = buffers[1] = buffers[2] = value;
+        middle.store(1, std::memory_order_relaxed);
+        back = 2;
+        front = 0;
+    }
+
+    // writer only: fill it, then publish()
+    T& getWriteBuffer()                     { return buffers[back]; }
+    void publish()
+    {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // reader only: take the newest published value, false if there is none since the last call
+    bool update()
+    {
+        if(!(middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+    const T& getReadBuffer() const          { return buffers[front]; }
+
+private:
+    // not copyable, shared by two threads
+    TripleBuffer(const TripleBuffer&);
+    TripleBuffer& operator=(const TripleBuffer&);
+
+    static const unsigned int INDEX_MASK = 3;
+    static const unsigned int FRESH = 4;    // the middle copy was published and not read yet
+
+    T buffers[3];
+    std::atomic<unsigned int> middle;       // index of the middle copy and FRESH
+    unsigned int back;                      // writer only
+    unsigned int front;                     // reader only
+};
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+// Encoders for the compact vertex formats used by Mesh (see mesh.h).
+//
+// - positions : 16-bit unsigned normalized, relative to the mesh bounding box.
+//               The shader dequantizes with position * positionScale + positionOffset.
+// - normals   : octahedral encoding, 2 x 16-bit signed normalized.
+// - tangents  : octahedral encoding, 2 x 16-bit integer. The lowest bit of x holds
+//               the bitangent sign, so the bitangent is cross(N, T) * sign.
+// - texcoords : 2 x 16-bit half float.
+
+// GLSL helpers to decode the packed attributes in a vertex shader.
+// The packed layout binds: location 0 = vec3 (normalized), 1 = vec2 (normalized),
+// 2 = vec2 (half float), 3 = ivec2 (integer, see decodeTangent).
+static const char* const PACKED_VERTEX_GLSL =
+	"uniform vec3 positionScale;\n"
+	"uniform vec3 positionOffset;\n"
+	"vec3 decodePosition(vec3 p) { return p * positionScale + positionOffset; }\n"
+	"vec3 decodeOctahedral(vec2 e)\n"
+	"{\n"
+	"    vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));\n"
+	"    float t = max(-v.z, 0.0);\n"
+	"    v.x += (v.x >= 0.0) ? -t : t;\n"
+	"    v.y += (v.y >= 0.0) ? -t : t;\n"
+	"    return normalize(v);\n"
+	"}\n"
+	"vec4 decodeTangent(ivec2 t)\n"
+	"{\n"
+	"    float handedness = ((t.x & 1) != 0) ? -1.0 : 1.0;\n"
+	"    return vec4(decodeOctahedral(vec2(t >> 1) / 16383.0), handedness);\n"
+	"}\n";
+
+namespace VertexPacking
+{
+	// convert 32-bit float to 16-bit half float (round to nearest even)
+	inline uint16_t floatToHalf(float value)
+	{
+		uint32_t f;
+		std::memcpy(&f, &value, 4);
+
+		uint32_t sign = (f >> 16) & 0x8000;
+		int exponent = (int)((f >> 23) & 0xff) - 127 + 15;
+		uint32_t mantissa = f & 0x7fffff;
+
+		if(((f >> 23) & 0xff) == 0xff)                     // Inf or NaN
+			return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+		if(exponent >= 31)                                  // overflow, clamp to Inf
+			return (uint16_t)(sign | 0x7c00);
+		if(exponent <= 0)                                   // denormal or zero
+		{
+			if(exponent < -10)
+				return (uint16_t)sign;
+			mantissa |= 0x800000;
+			int shift = 14 - exponent;
+			uint32_t half = mantissa >> shift;
+			uint32_t rest = mantissa & ((1u << shift) - 1);
+			uint32_t halfway = 1u << (shift - 1);
+			if(rest > halfway || (rest == halfway && (half & 1)))
+				++half;
+			return (uint16_t)(sign | half);
+		}
+
+		uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+		uint32_t rest = mantissa & 0x1fff;
+		if(rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+			++half;                                         // may carry into exponent, which is still correct
+		return (uint16_t)half;
+	}
+
+	// convert 16-bit half float to 32-bit float
+	inline float halfToFloat(uint16_t h)
+	{
+		uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+		uint32_t exponent = (h >> 10) & 0x1f;
+		uint32_t mantissa = h & 0x3ff;
+		uint32_t f;
+
+		if(exponent == 0)
+		{
+			if(mantissa == 0)
+				f = sign;
+			else                                            // denormal, normalize it
+			{
+				exponent = 1;
+				while(!(mantissa & 0x400))
+				{
+					mantissa <<= 1;
+					--exponent;
+				}
+				mantissa &= 0x3ff;
+				f = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+			}
+		}
+		else if(exponent == 31)
+			f = sign | 0x7f800000 | (mantissa << 13);
+		else
+			f = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+
+		float value;
+		std::memcpy(&value, &f, 4);
+		return value;
+	}
+
+	// map a unit vector onto the [-1,1] square of the octahedral projection
+	inline glm::vec2 octahedralEncode(const glm::vec3& n)
+	{
+		float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+		if(l1 == 0)
+			return glm::vec2(0.0f, 0.0f);
+
+		glm::vec2 p(n.x / l1, n.y / l1);
+		if(n.z < 0)
+		{
+			float x = (1.0f - std::fabs(p.y)) * (p.x >= 0 ? 1.0f : -1.0f);
+			float y = (1.0f - std::fabs(p.x)) * (p.y >= 0 ? 1.0f : -1.0f);
+			p = glm::vec2(x, y);
+		}
+		return p;
+	}
+
+	inline glm::vec3 octahedralDecode(const glm::vec2& e)
+	{
+		glm::vec3 v(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+		float t = v.z < 0 ? -v.z : 0.0f;
+		v.x += (v.x >= 0) ? -t : t;
+		v.y += (v.y >= 0) ? -t : t;
+		return glm::normalize(v);
+	}
+
+	// octahedral encode to 2 integers in [-range, range]
+	// The rounded result is refined by testing the neighbouring grid points,
+	// which keeps the angular error close to the theoretical minimum.
+	inline void octahedralQuantize(const glm::vec3& n, int range, int& qx, int& qy)
+	{
+		glm::vec2 p = octahedralEncode(n);
+		int bx = (int)std::floor(p.x * range);
+		int by = (int)std::floor(p.y * range);
+
+		float best = -2.0f;
+		qx = bx;
+		qy = by;
+		for(int i = 0; i < 2; ++i)
+		{
+			for(int j = 0; j < 2; ++j)
+			{
+				int x = bx + i;
+				int y = by + j;
+				if(x > range) x = range;
+				if(y > range) y = range;
+				if(x < -range) x = -range;
+				if(y < -range) y = -range;
+
+				glm::vec3 d = octahedralDecode(glm::vec2((float)x / range, (float)y / range));
+				float c = glm::dot(d, n);
+				if(c > best)
+				{
+					best = c;
+					qx = x;
+					qy = y;
+				}
+			}
+		}
+	}
+
+	// unit normal to 2 x snorm16
+	inline void packNormal(const glm::vec3& n, int16_t out[2])
+	{
+		int x, y;
+		octahedralQuantize(n, 32767, x, y);
+		out[0] = (int16_t)x;
+		out[1] = (int16_t)y;
+	}
+
+	inline glm::vec3 unpackNormal(const int16_t in[2])
+	{
+		return octahedralDecode(glm::vec2(in[0] / 32767.0f, in[1] / 32767.0f));
+	}
+
+	// unit tangent to 2 x int16 with the bitangent sign in the lowest bit of x
+	inline void packTangent(const glm::vec3& t, bool negativeBitangent, int16_t out[2])
+	{
+		int x, y;
+		octahedralQuantize(t, 16383, x, y);
+		out[0] = (int16_t)(x * 2 + (negativeBitangent ? 1 : 0));
+		out[1] = (int16_t)(y * 2);
+	}
+
+	inline glm::vec3 unpackTangent(const int16_t in[2], float& handedness)
+	{
+		handedness = (in[0] & 1) ? -1.0f : 1.0f;
+		int x = in[0] >> 1;
+		int y = in[1] >> 1;
+		return octahedralDecode(glm::vec2(x / 16383.0f, y / 16383.0f));
+	}
+
+	// value in [0,1] to unorm16
+	inline uint16_t packUnorm16(float v)
+	{
+		if(v <= 0) return 0;
+		if(v >= 1) return 65535;
+		return (uint16_t)(v * 65535.0f + 0.5f);
+	}
+
+	// angle between two unit vectors in degrees
+	inline float angleBetween(const glm::vec3& a, const glm::vec3& b)
+	{
+		float c = glm::dot(a, b);
+		if(c > 1.0f) c = 1.0f;
+		if(c < -1.0f) c = -1.0f;
+		return std::acos(c) * 57.2957795f;
+	}
+}
+
+#endif
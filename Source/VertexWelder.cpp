@@ -0,0 +1,247 @@
+///////////////////////////////////////////////////////////////////////////////
+// VertexWelder.cpp
+// ================
+// Vertex welding (deduplication) of interleaved float vertex data.
+// 1. quantize attributes and hash them           (parallel)
+// 2. insert into an open-addressing table        (parallel, lock-free)
+//    a slot keeps the smallest vertex index of its key, so the representative
+//    of each group of equal vertices is its first occurrence
+// 3. number the representatives by prefix sum    (parallel per block)
+// 4. build the remap table and copy the vertices (parallel)
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include "VertexWelder.h"
+#include "Parallel.h"
+
+
+
+namespace
+{
+    // the grid cells are clamped to [-LIMIT, LIMIT], inf and NaN get cells past it
+    const long long LIMIT = 1LL << 62;
+
+    // quantize a float to an integer grid cell of size epsilon, 64 bits so a
+    // large coordinate over a small epsilon still gets its own cell
+    // with epsilon = 0, the bits are compared as they are (+0 and -0 are the same)
+    long long quantize(float value, float invEpsilon)
+    {
+        if(invEpsilon == 0 || !std::isfinite(value))
+        {
+            if(value == 0)
+                return 0;
+            unsigned int bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return invEpsilon == 0 ? (long long)(int)bits : LIMIT + 1 + bits;
+        }
+        const double cell = std::floor((double)value * invEpsilon + 0.5);
+        return cell <= -LIMIT ? -LIMIT : (cell >= LIMIT ? LIMIT : (long long)cell);
+    }
+
+    // 32-bit FNV-1a over the halves of the quantized attributes followed by a
+    // final mix, so that keys differing in the low bits still spread over the table
+    unsigned int hashKey(const long long* key, unsigned int count)
+    {
+        unsigned int h = 2166136261u;
+        for(unsigned int i = 0; i < count; ++i)
+        {
+            h ^= (unsigned int)key[i];
+            h *= 16777619u;
+            h ^= (unsigned int)((unsigned long long)key[i] >> 32);
+            h *= 16777619u;
+        }
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        return h;
+    }
+
+    bool equalKeys(const long long* a, const long long* b, unsigned int count)
+    {
+        return std::memcmp(a, b, count * sizeof(long long)) == 0;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// merge vertices with equal quantized attributes
+///////////////////////////////////////////////////////////////////////////////
+VertexWelder::WeldStats VertexWelder::weld(const float* vertices, unsigned int vertexCount, unsigned int floatsPerVertex,
+                                           std::vector<float>& uniqueVertices, std::vector<unsigned int>& remap,
+                                           float epsilon, unsigned int threadCount)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    if(threadCount == 0)
+        threadCount = Parallel::getDefaultThreadCount();
+
+    WeldStats stats;
+    stats.vertexCount = vertexCount;
+    stats.uniqueCount = 0;
+    stats.sizeBefore = (size_t)vertexCount * floatsPerVertex * sizeof(float);
+    stats.sizeAfter = 0;
+    stats.threadCount = Parallel::getBlockCount(vertexCount, threadCount);
+    stats.time = 0;
+
+    uniqueVertices.clear();
+    remap.assign(vertexCount, 0);
+    if(vertexCount == 0 || floatsPerVertex == 0)
+        return stats;
+
+    const float invEpsilon = epsilon > 0 ? 1.0f / epsilon : 0.0f;
+
+    // table at most half full keeps probe sequences short
+    unsigned int tableSize = 1;
+    while(tableSize < vertexCount * 2)
+        tableSize <<= 1;
+    const unsigned int mask = tableSize - 1;
+
+    std::vector<long long> keys((size_t)vertexCount * floatsPerVertex);
+    std::vector<unsigned int> hashes(vertexCount);
+    std::vector<std::atomic<unsigned int> > table(tableSize);    // vertex index + 1, 0 = empty
+    for(unsigned int i = 0; i < tableSize; ++i)
+        table[i].store(0, std::memory_order_relaxed);
+
+    // quantize and hash
+    Parallel::forEach(vertexCount, threadCount, [&](unsigned int begin, unsigned int end, unsigned int)
+    {
+        for(unsigned int i = begin; i < end; ++i)
+        {
+            const float* v = vertices + (size_t)i * floatsPerVertex;
+            long long* key = &keys[(size_t)i * floatsPerVertex];
+            for(unsigned int j = 0; j < floatsPerVertex; ++j)
+                key[j] = quantize(v[j], invEpsilon);
+            hashes[i] = hashKey(key, floatsPerVertex);
+        }
+    });
+
+    // insert with linear probing
+    // a slot is claimed by the first key that reaches it and never changes key,
+    // only its vertex index can decrease to another vertex with the same key
+    Parallel::forEach(vertexCount, threadCount, [&](unsigned int begin, unsigned int end, unsigned int)
+    {
+        for(unsigned int i = begin; i < end; ++i)
+        {
+            const long long* key = &keys[(size_t)i * floatsPerVertex];
+            unsigned int slot = hashes[i] & mask;
+            for(;;)
+            {
+                unsigned int current = table[slot].load(std::memory_order_acquire);
+                if(current == 0)
+                {
+                    if(table[slot].compare_exchange_weak(current, i + 1, std::memory_order_acq_rel))
+                        break;
+                    if(current == 0)
+                        continue;   // spurious failure, try the same slot again
+                }
+
+                if(equalKeys(&keys[(size_t)(current - 1) * floatsPerVertex], key, floatsPerVertex))
+                {
+                    // keep the smallest index of the group
+                    while(current > i + 1 &&
+                          !table[slot].compare_exchange_weak(current, i + 1, std::memory_order_acq_rel))
+                        ;
+                    break;
+                }
+                slot = (slot + 1) & mask;
+            }
+        }
+    });
+
+    // find the representative of each vertex, then count representatives per block
+    unsigned int blockCount = Parallel::getBlockCount(vertexCount, threadCount);
+    std::vector<unsigned int> blockOffsets(blockCount + 1, 0);
+    Parallel::forEach(vertexCount, threadCount, [&](unsigned int begin, unsigned int end, unsigned int block)
+    {
+        unsigned int count = 0;
+        for(unsigned int i = begin; i < end; ++i)
+        {
+            const long long* key = &keys[(size_t)i * floatsPerVertex];
+            unsigned int slot = hashes[i] & mask;
+            for(;;)
+            {
+                unsigned int current = table[slot].load(std::memory_order_relaxed);
+                if(equalKeys(&keys[(size_t)(current - 1) * floatsPerVertex], key, floatsPerVertex))
+                {
+                    remap[i] = current - 1;
+                    break;
+                }
+                slot = (slot + 1) & mask;
+            }
+            if(remap[i] == i)
+                ++count;
+        }
+        blockOffsets[block + 1] = count;
+    });
+
+    // exclusive prefix sum of the block counts
+    for(unsigned int b = 0; b < blockCount; ++b)
+        blockOffsets[b + 1] += blockOffsets[b];
+    const unsigned int uniqueCount = blockOffsets[blockCount];
+    uniqueVertices.resize((size_t)uniqueCount * floatsPerVertex);
+
+    // number the representatives in order and copy them
+    // hashes[] is reused to store the new index of each representative
+    std::vector<unsigned int>& newIndex = hashes;
+    Parallel::forEach(vertexCount, threadCount, [&](unsigned int begin, unsigned int end, unsigned int block)
+    {
+        unsigned int next = blockOffsets[block];
+        for(unsigned int i = begin; i < end; ++i)
+        {
+            if(remap[i] != i)
+                continue;
+            newIndex[i] = next;
+            std::memcpy(&uniqueVertices[(size_t)next * floatsPerVertex], vertices + (size_t)i * floatsPerVertex,
+                        floatsPerVertex * sizeof(float));
+            ++next;
+        }
+    });
+
+    // every representative was numbered by the previous pass
+    Parallel::forEach(vertexCount, threadCount, [&](unsigned int begin, unsigned int end, unsigned int)
+    {
+        for(unsigned int i = begin; i < end; ++i)
+            remap[i] = newIndex[remap[i]];
+    });
+
+    stats.uniqueCount = uniqueCount;
+    stats.sizeAfter = uniqueVertices.size() * sizeof(float);
+    stats.time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return stats;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// replace each index with remap[index]
+///////////////////////////////////////////////////////////////////////////////
+void VertexWelder::remapIndices(unsigned int* indices, unsigned int indexCount, const unsigned int* remap)
+{
+    for(unsigned int i = 0; i < indexCount; ++i)
+        indices[i] = remap[indices[i]];
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// print vertex count and memory reduction
+///////////////////////////////////////////////////////////////////////////////
+void VertexWelder::printStats(const char* name, const WeldStats& stats)
+{
+    float ratio = stats.vertexCount ? 100.0f * (1.0f - (float)stats.uniqueCount / stats.vertexCount) : 0.0f;
+
+    std::cout << "===== VertexWelder: " << (name ? name : "mesh") << " =====\n"
+              << std::fixed << std::setprecision(1)
+              << "Vertex Count: " << stats.vertexCount << " -> " << stats.uniqueCount << " (" << ratio << "% fewer)\n"
+              << " Vertex Data: " << stats.sizeBefore << " -> " << stats.sizeAfter << " bytes\n"
+              << std::setprecision(3)
+              << "        Time: " << stats.time << " ms (" << stats.threadCount << " threads)" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
@@ -0,0 +1,53 @@
+///////////////////////////////////////////////////////////////////////////////
+// VertexWelder.h
+// ==============
+// Vertex welding (deduplication) of interleaved float vertex data.
+// Each attribute is quantized to a grid of size epsilon (epsilon = 0 compares
+// the exact bits), and vertices with identical quantized attributes are merged
+// into the first of them. Vertices closer than epsilon but falling into
+// different grid cells are not merged.
+//
+// The pass runs in linear time: quantized keys are hashed into a shared
+// open-addressing table filled by all threads with atomic compare-and-swap,
+// then the unique vertices are numbered in order of first occurrence with a
+// parallel prefix sum, so the result does not depend on the thread count.
+//
+// The remap table maps each input vertex to its unique vertex. For an
+// unindexed mesh (e.g. Cylinder with flat shading) it is the index buffer;
+// for an indexed mesh, pass the index buffer through remapIndices().
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef VERTEX_WELDER_H
+#define VERTEX_WELDER_H
+
+#include <vector>
+#include <cstddef>
+
+namespace VertexWelder
+{
+    struct WeldStats
+    {
+        unsigned int vertexCount;       // # of input vertices
+        unsigned int uniqueCount;       // # of output vertices
+        size_t sizeBefore;              // vertex data in bytes
+        size_t sizeAfter;
+        unsigned int threadCount;
+        float time;                     // ms
+    };
+
+    // merge vertices with equal attributes after quantization by epsilon
+    // uniqueVertices: floatsPerVertex floats per unique vertex
+    // remap         : unique vertex index of each input vertex
+    // threadCount   : 0 = # of hardware threads
+    WeldStats weld(const float* vertices, unsigned int vertexCount, unsigned int floatsPerVertex,
+                   std::vector<float>& uniqueVertices, std::vector<unsigned int>& remap,
+                   float epsilon = 0.0f, unsigned int threadCount = 0);
+
+    // replace each index with remap[index]
+    void remapIndices(unsigned int* indices, unsigned int indexCount, const unsigned int* remap);
+
+    // print vertex count and memory reduction
+    void printStats(const char* name, const WeldStats& stats);
+}
+
+#endif
@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////////
+// WorkStealingDeque.h
+// ===================
+// Bounded Chase-Lev work stealing deque without locks ("Dynamic Circular
+// Work-Stealing Deque", Chase and Lev 2005, with the C11 atomics of Le et al.
+// 2013). The owner thread pushes and pops at the bottom, like a stack, so it
+// runs its newest (cache hot) items first; other threads steal the oldest
+// items from the top. Owner operations only contend with thieves when one
+// item is left.
+//
+// Only the owner may call push() and pop(); any thread may call steal().
+// push() returns false when the deque is full, pop() and steal() return
+// false when it is empty (steal() also when another thief won the item).
+// T must be small and trivially copyable, e.g. a pointer.
+//
+// The orderings are sequentially consistent atomics instead of standalone
+// fences; on x86 it costs the same, and thread sanitizers understand it.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+template <typename T>
+class WorkStealingDeque
+{
+public:
+    // capacity is rounded up to a power of 2
+    explicit WorkStealingDeque(size_t capacity = 4096) : cells(roundUp(capacity)), mask(roundUp(capacity) - 1), top(0), bottom(0)
+    {
+    }
+
+    // owner only
+    bool push(const T& value)
+    {
+        const ptrdiff_t b = bottom.load(std::memory_order_relaxed);
+        const ptrdiff_t t = top.load(std::memory_order_acquire);
+        if(b - t > (ptrdiff_t)mask)
+            return false;               // full
+
+        cells[b & mask].store(value, std::memory_order_relaxed);
+        // publishes the cell, and whatever value points to, to the thieves
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    // owner only, the newest item
+    bool pop(T& value)
+    {
+        // take the bottom item first, then see if a thief got there too
+        const ptrdiff_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_seq_cst);
+        ptrdiff_t t = top.load(std::memory_order_seq_cst);
+        if(t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;               // empty
+        }
+
+        value = cells[b & mask].load(std::memory_order_relaxed);
+        if(t == b)
+        {
+            // the last item, race the thieves for it
+            const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // any thread, the oldest item
+    bool steal(T& value)
+    {
+        ptrdiff_t t = top.load(std::memory_order_seq_cst);
+        const ptrdiff_t b = bottom.load(std::memory_order_seq_cst);
+        if(t >= b)
+            return false;               // empty
+
+        value = cells[t & mask].load(std::memory_order_relaxed);
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    // # of items, only a hint while other threads use the deque
+    size_t getSize() const
+    {
+        const ptrdiff_t b = bottom.load(std::memory_order_relaxed);
+        const ptrdiff_t t = top.load(std::memory_order_relaxed);
+        return b > t ? (size_t)(b - t) : 0;
+    }
+
+    size_t getCapacity() const          { return mask + 1; }
+
+private:
+    // not copyable, the cells are shared with other threads
+    WorkStealingDeque(const WorkStealingDeque&);
+    WorkStealingDeque& operator=(const WorkStealingDeque&);
+
+    static size_t roundUp(size_t n)
+    {
+        size_t size = 2;
+        while(size < n)
+            size <<= 1;
+        return size;
+    }
+
+    std::vector<std::atomic<T> > cells;
+    const size_t mask;
+    // thieves and owner on separate cache lines; padding instead of alignas, the deques are allocated with new
+    std::atomic<ptrdiff_t> top;
+    char topPadding[64 - sizeof(std::atomic<ptrdiff_t>)];
+    std::atomic<ptrdiff_t> bottom;
+};
+
+#endif
@@ -7,9 +7,14 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader.h"
+#include "VertexPacking.h"
+#include "IndexBuffer.h"
+#include "TangentGenerator.h"
 
 #include <string>
 #include <vector>
+#include <iostream>
+#include <algorithm>
 using namespace std;
 
 struct Vertex {
@@ -25,12 +30,72 @@ struct Vertex {
 	glm::vec3 Bitangent;
 };
 
+// vertex layouts a mesh can be uploaded with
+enum VertexFormat {
+	VERTEX_FORMAT_FULL,                 // 56 bytes: float position, normal, texCoords, tangent, bitangent
+	VERTEX_FORMAT_PACKED,               // 20 bytes: unorm16 position, octahedral normal/tangent, half texCoords
+	VERTEX_FORMAT_PACKED_FLOAT_POSITION // 24 bytes: float position, the rest same as VERTEX_FORMAT_PACKED
+};
+
+// compact vertices, see VertexPacking.h for the encodings
+// the bitangent is not stored, the shader derives it as cross(normal, tangent) * sign
+struct PackedVertex {
+	uint16_t Position[4];   // xyz relative to the mesh bounds, w is padding
+	int16_t  Normal[2];
+	int16_t  Tangent[2];    // bitangent sign in the lowest bit of x
+	uint16_t TexCoords[2];
+};
+
+struct PackedVertexFloatPosition {
+	float    Position[3];
+	int16_t  Normal[2];
+	int16_t  Tangent[2];
+	uint16_t TexCoords[2];
+};
+
+// memory use and precision loss of a packed mesh compared to VERTEX_FORMAT_FULL
+struct VertexPackingStats {
+	size_t fullSize;            // bytes as Vertex
+	size_t packedSize;          // bytes as uploaded
+	float maxPositionError;     // in model units
+	float maxNormalError;       // in degrees
+	float maxTangentError;      // in degrees
+	float maxTexCoordError;
+};
+
+// fill in Tangent and Bitangent from positions, normals and texCoords (MikkTSpace conventions)
+// call before constructing the Mesh, the vertices are uploaded by the constructor
+inline void generateTangents(vector<Vertex>& vertices, const vector<unsigned int>& indices, unsigned int threadCount = 0)
+{
+	if (vertices.empty())
+		return;
+	TangentGenerator::VertexLayout layout;
+	layout.positions = &vertices[0].Position.x;
+	layout.normals = &vertices[0].Normal.x;
+	layout.texCoords = &vertices[0].TexCoords.x;
+	layout.tangents = &vertices[0].Tangent.x;
+	layout.bitangents = &vertices[0].Bitangent.x;
+	layout.stride = sizeof(Vertex);
+	TangentGenerator::generate(layout, vertices.size(), indices.data(), indices.size(), threadCount);
+}
+
 struct Texture {
 	unsigned int id;
 	string type;
 	string path;
 };
 
+// a vertex attribute read straight from an already uploaded buffer (e.g. a glTF buffer view)
+struct MeshAttribute {
+	unsigned int location;  // 0 position, 1 normal, 2 texCoords, 3 tangent
+	unsigned int buffer;    // GL buffer object
+	size_t offset;          // in bytes
+	int size;               // component count
+	GLenum type;
+	GLboolean normalized;
+	int stride;             // in bytes, 0 = tightly packed
+};
+
 class Mesh {
 public:
 	// mesh Data
@@ -38,20 +103,101 @@ public:
 	vector<unsigned int> indices;
 	vector<Texture>      textures;
 	unsigned int VAO;
+	VertexFormat format;
+	// dequantization of packed positions: position * positionScale + positionOffset
+	glm::vec3 positionScale;
+	glm::vec3 positionOffset;
+	VertexPackingStats packingStats;
+	// GL_UNSIGNED_SHORT when every vertex is addressable with 16 bits (or the mesh is split), else GL_UNSIGNED_INT
+	GLenum indexType;
+	bool splitLargeMeshes;
+	// 16-bit draw ranges of a split mesh, empty if the mesh is drawn with a single call
+	vector<IndexBuffer::Chunk> indexChunks;
+	// indices drawn by a single call, starting at indexOffset bytes in the index buffer
+	unsigned int indexCount;
+	size_t indexOffset;
+	// row of the mesh's textures in a bindless MaterialTable (see MaterialTable.h), -1 binds them per draw
+	int material;
 
 	// constructor
-	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+	// splitLargeMeshes: draw meshes over 65536 vertices as 16-bit chunks instead of with 32-bit indices
+	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexFormat format = VERTEX_FORMAT_FULL, bool splitLargeMeshes = false)
 	{
 		this->vertices = vertices;
 		this->indices = indices;
 		this->textures = textures;
+		this->format = format;
+		this->splitLargeMeshes = splitLargeMeshes;
+		this->positionScale = glm::vec3(1.0f);
+		this->positionOffset = glm::vec3(0.0f);
+		this->material = -1;
 
 		// now that we have all the required data, set the vertex buffers and its attribute pointers.
 		setupMesh();
 	}
 
+	// constructor for data already in GL buffers, nothing is copied and vertices/indices stay empty
+	// the buffers are owned by the caller (e.g. Model) and must outlive the mesh
+	// a tangent at location 3 is vec4 with the bitangent sign in w, bitangent = cross(normal, tangent.xyz) * tangent.w
+	Mesh(const vector<MeshAttribute>& attributes, unsigned int indexBuffer, size_t indexOffset, GLenum indexType, unsigned int indexCount, vector<Texture> textures)
+	{
+		this->textures = textures;
+		this->format = VERTEX_FORMAT_FULL;
+		this->splitLargeMeshes = false;
+		this->positionScale = glm::vec3(1.0f);
+		this->positionOffset = glm::vec3(0.0f);
+		this->material = -1;
+		this->packingStats = VertexPackingStats();
+		this->indexType = indexType;
+		this->indexCount = indexCount;
+		this->indexOffset = indexOffset;
+		VBO = 0;
+		EBO = indexBuffer;
+
+		glGenVertexArrays(1, &VAO);
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		for (unsigned int i = 0; i < attributes.size(); i++)
+		{
+			const MeshAttribute& a = attributes[i];
+			glBindBuffer(GL_ARRAY_BUFFER, a.buffer);
+			glEnableVertexAttribArray(a.location);
+			glVertexAttribPointer(a.location, a.size, a.type, a.normalized, a.stride, (void*)a.offset);
+		}
+		glBindVertexArray(0);
+	}
+
 	// render the mesh
 	void Draw(Shader &shader)
+	{
+		// bindless: the shader reads the handles of the row from the material table, nothing to bind
+		if (material >= 0)
+			shader.setInt("material", material);
+		else
+			bindTextures(shader);
+
+		// packed positions are dequantized in the vertex shader
+		if (format != VERTEX_FORMAT_FULL)
+		{
+			shader.setVec3("positionScale", positionScale);
+			shader.setVec3("positionOffset", positionOffset);
+		}
+
+		// draw mesh
+		glBindVertexArray(VAO);
+		if (indexChunks.empty())
+			glDrawElements(GL_TRIANGLES, indexCount, indexType, (void*)indexOffset);
+		for (unsigned int i = 0; i < indexChunks.size(); i++)
+		{
+			const IndexBuffer::Chunk& chunk = indexChunks[i];
+			glDrawElementsBaseVertex(GL_TRIANGLES, chunk.indexCount, GL_UNSIGNED_SHORT,
+			                         (void*)(size_t)(chunk.firstIndex * sizeof(unsigned short)), chunk.baseVertex);
+		}
+		glBindVertexArray(0);
+	}
+
+	// bind each texture to its own unit and point its sampler uniform (diffuse_textureN, ...) at it
+	void bindTextures(Shader &shader)
 	{
 		// bind appropriate textures
 		unsigned int diffuseNr = 1;
@@ -79,15 +225,42 @@ public:
 			glBindTexture(GL_TEXTURE_2D, textures[i].id);
 		}
 
-		// draw mesh
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
-
 		// always good practice to set everything back to defaults once configured.
 		glActiveTexture(GL_TEXTURE0);
 	}
 
+	// vertex stride in bytes of the selected format
+	unsigned int getVertexStride() const
+	{
+		if (format == VERTEX_FORMAT_PACKED)
+			return sizeof(PackedVertex);
+		if (format == VERTEX_FORMAT_PACKED_FLOAT_POSITION)
+			return sizeof(PackedVertexFloatPosition);
+		return sizeof(Vertex);
+	}
+
+	// index size in bytes of the selected index type
+	unsigned int getIndexStride() const
+	{
+		return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+	}
+
+	// print memory and vertex fetch savings and the precision loss of the packed format
+	void printPackingStats() const
+	{
+		const VertexPackingStats& s = packingStats;
+		std::cout << "===== Mesh Vertex Packing =====\n"
+		          << "      Vertex Count: " << vertices.size() << "\n"
+		          << "     Vertex Stride: " << getVertexStride() << " bytes (full: " << sizeof(Vertex) << ")\n"
+		          << "       Buffer Size: " << s.packedSize << " bytes (full: " << s.fullSize << ")\n"
+		          << "      Index Stride: " << getIndexStride() << " bytes (draw calls: " << std::max<size_t>(indexChunks.size(), 1) << ")\n"
+		          << "  Memory/Bandwidth: " << (s.packedSize ? (float)s.fullSize / s.packedSize : 1.0f) << "x smaller per draw\n"
+		          << "    Position Error: " << s.maxPositionError << "\n"
+		          << "      Normal Error: " << s.maxNormalError << " deg\n"
+		          << "     Tangent Error: " << s.maxTangentError << " deg\n"
+		          << "    TexCoord Error: " << s.maxTexCoordError << std::endl;
+	}
+
 private:
 	// render data 
 	unsigned int VBO, EBO;
@@ -101,6 +274,68 @@ private:
 		glGenBuffers(1, &EBO);
 
 		glBindVertexArray(VAO);
+
+		// must run before the vertex upload, splitting duplicates the vertices shared by chunks
+		setupIndices();
+
+		packingStats = VertexPackingStats();
+		packingStats.fullSize = vertices.size() * sizeof(Vertex);
+		packingStats.packedSize = packingStats.fullSize;
+
+		if (format == VERTEX_FORMAT_PACKED)
+			setupPackedAttributes<PackedVertex>(GL_UNSIGNED_SHORT, GL_TRUE);
+		else if (format == VERTEX_FORMAT_PACKED_FLOAT_POSITION)
+			setupPackedAttributes<PackedVertexFloatPosition>(GL_FLOAT, GL_FALSE);
+		else
+			setupFullAttributes();
+
+		glBindVertexArray(0);
+	}
+
+	// upload the index buffer with the narrowest index type the vertex count allows
+	void setupIndices()
+	{
+		indexChunks.clear();
+		indexCount = indices.size();
+		indexOffset = 0;
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+		if (IndexBuffer::getIndexSize(vertices.size()) == sizeof(unsigned short))
+		{
+			indexType = GL_UNSIGNED_SHORT;
+			vector<unsigned short> shortIndices(indices.size());
+			IndexBuffer::narrow(indices.data(), indices.size(), shortIndices.data());
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+		}
+		else if (splitLargeMeshes)
+		{
+			indexType = GL_UNSIGNED_SHORT;
+			vector<unsigned short> chunkIndices;
+			vector<unsigned int> vertexRemap;
+			IndexBuffer::split(indices.data(), indices.size(), vertices.size(), chunkIndices, vertexRemap, indexChunks);
+
+			// rebuild vertices/indices in chunk order so they stay consistent with the GPU buffers
+			vector<Vertex> chunkVertices(vertexRemap.size());
+			for (unsigned int i = 0; i < vertexRemap.size(); i++)
+				chunkVertices[i] = vertices[vertexRemap[i]];
+			vertices.swap(chunkVertices);
+			for (unsigned int i = 0; i < indexChunks.size(); i++)
+			{
+				const IndexBuffer::Chunk& chunk = indexChunks[i];
+				for (unsigned int j = chunk.firstIndex; j < chunk.firstIndex + chunk.indexCount; j++)
+					indices[j] = chunk.baseVertex + chunkIndices[j];
+			}
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, chunkIndices.size() * sizeof(unsigned short), chunkIndices.data(), GL_STATIC_DRAW);
+		}
+		else
+		{
+			indexType = GL_UNSIGNED_INT;
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+		}
+	}
+
+	void setupFullAttributes()
+	{
 		// load data into vertex buffers
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
 		// A great thing about structs is that their memory layout is sequential for all its items.
@@ -108,9 +343,6 @@ private:
 		// again translates to 3/2 floats which translates to a byte array.
 		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
 		// set the vertex attribute pointers
 		// vertex Positions
 		glEnableVertexAttribArray(0);
@@ -127,8 +359,94 @@ private:
 		// vertex bitangent
 		glEnableVertexAttribArray(4);
 		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+	}
 
-		glBindVertexArray(0);
+	// encode the vertices into PackedVertex or PackedVertexFloatPosition and set the attribute pointers
+	template <typename T>
+	void setupPackedAttributes(GLenum positionType, GLboolean positionNormalized)
+	{
+		const bool quantizePosition = (positionType != GL_FLOAT);
+
+		// quantized positions are stored relative to the bounding box
+		if (quantizePosition && !vertices.empty())
+		{
+			glm::vec3 minBound = vertices[0].Position;
+			glm::vec3 maxBound = vertices[0].Position;
+			for (unsigned int i = 1; i < vertices.size(); i++)
+			{
+				minBound = glm::min(minBound, vertices[i].Position);
+				maxBound = glm::max(maxBound, vertices[i].Position);
+			}
+			positionOffset = minBound;
+			positionScale = maxBound - minBound;
+			// avoid division by 0 for flat meshes
+			for (int i = 0; i < 3; i++)
+				if (positionScale[i] == 0.0f)
+					positionScale[i] = 1.0f;
+		}
+
+		vector<T> packed(vertices.size());
+		for (unsigned int i = 0; i < vertices.size(); i++)
+		{
+			const Vertex& v = vertices[i];
+			T& p = packed[i];
+
+			// position
+			glm::vec3 decoded;
+			for (int j = 0; j < 3; j++)
+			{
+				if (quantizePosition)
+				{
+					uint16_t q = VertexPacking::packUnorm16((v.Position[j] - positionOffset[j]) / positionScale[j]);
+					p.Position[j] = q;
+					decoded[j] = q / 65535.0f * positionScale[j] + positionOffset[j];
+				}
+				else
+				{
+					p.Position[j] = v.Position[j];
+					decoded[j] = v.Position[j];
+				}
+			}
+			packingStats.maxPositionError = std::max(packingStats.maxPositionError, glm::length(decoded - v.Position));
+
+			// normal and tangent frame
+			VertexPacking::packNormal(v.Normal, p.Normal);
+			packingStats.maxNormalError = std::max(packingStats.maxNormalError,
+				VertexPacking::angleBetween(VertexPacking::unpackNormal(p.Normal), glm::normalize(v.Normal)));
+
+			bool negative = glm::dot(glm::cross(v.Normal, v.Tangent), v.Bitangent) < 0.0f;
+			VertexPacking::packTangent(v.Tangent, negative, p.Tangent);
+			float handedness;
+			glm::vec3 tangent = VertexPacking::unpackTangent(p.Tangent, handedness);
+			if (glm::dot(v.Tangent, v.Tangent) > 0.0f)
+				packingStats.maxTangentError = std::max(packingStats.maxTangentError,
+					VertexPacking::angleBetween(tangent, glm::normalize(v.Tangent)));
+
+			// texture coords
+			for (int j = 0; j < 2; j++)
+			{
+				p.TexCoords[j] = VertexPacking::floatToHalf(v.TexCoords[j]);
+				float error = std::fabs(VertexPacking::halfToFloat(p.TexCoords[j]) - v.TexCoords[j]);
+				packingStats.maxTexCoordError = std::max(packingStats.maxTexCoordError, error);
+			}
+		}
+		packingStats.packedSize = packed.size() * sizeof(T);
+
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(T), packed.data(), GL_STATIC_DRAW);
+
+		// vertex Positions
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, positionType, positionNormalized, sizeof(T), (void*)offsetof(T, Position));
+		// vertex normals (octahedral, decoded in the shader)
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(T), (void*)offsetof(T, Normal));
+		// vertex texture coords
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(T), (void*)offsetof(T, TexCoords));
+		// vertex tangent with bitangent sign, read as integers
+		glEnableVertexAttribArray(3);
+		glVertexAttribIPointer(3, 2, GL_SHORT, sizeof(T), (void*)offsetof(T, Tangent));
 	}
 };
 #endif
\ No newline at end of file
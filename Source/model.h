@@ -0,0 +1,380 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "stb_image.h"
+
+#include "mesh.h"
+#include "shader.h"
+#include "ObjLoader.h"
+#include "GltfLoader.h"
+
+#include <string>
+#include <iostream>
+#include <vector>
+#include <chrono>
+using namespace std;
+
+unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
+unsigned int TextureFromMemory(const unsigned char* buffer, size_t size, bool gamma = false);
+
+class Model
+{
+public:
+	// model data
+	vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+	vector<Mesh>    meshes;
+	string directory;
+	bool gammaCorrection;
+	VertexFormat format;
+	vector<unsigned int> buffers;	// GL buffers shared by the meshes of a glTF model, one per uploaded buffer view
+
+	// constructor, expects a filepath to a Wavefront OBJ (.obj) or binary glTF (.glb) file.
+	Model(string const& path, bool gamma = false, VertexFormat format = VERTEX_FORMAT_FULL) : gammaCorrection(gamma), format(format)
+	{
+		loadModel(path);
+	}
+
+	// draws the model, and thus all its meshes
+	void Draw(Shader& shader)
+	{
+		for (unsigned int i = 0; i < meshes.size(); i++)
+			meshes[i].Draw(shader);
+	}
+
+private:
+	// loads the OBJ file with ObjLoader and stores the resulting meshes in the meshes vector.
+	void loadModel(string const& path)
+	{
+		// retrieve the directory path of the filepath
+		size_t slash = path.find_last_of("/\\");
+		directory = (slash == string::npos) ? string(".") : path.substr(0, slash);
+
+		if (path.size() > 4 && path.compare(path.size() - 4, 4, ".glb") == 0)
+		{
+			loadGltf(path);
+			return;
+		}
+
+		ObjLoader::Scene scene;
+		if (!ObjLoader::load(path.c_str(), scene))
+		{
+			cout << "ERROR::OBJLOADER:: failed to load " << path << endl;
+			return;
+		}
+		ObjLoader::printStats(path.c_str(), scene.stats);
+
+		// one mesh per object/material group
+		meshes.reserve(scene.groups.size());
+		for (unsigned int i = 0; i < scene.groups.size(); i++)
+			meshes.push_back(processGroup(scene.groups[i], scene));
+	}
+
+	Mesh processGroup(const ObjLoader::Group& group, const ObjLoader::Scene& scene)
+	{
+		// data to fill
+		vector<Vertex> vertices(group.vertices.size() / ObjLoader::VERTEX_FLOATS);
+		vector<Texture> textures;
+
+		// walk through each of the group's vertices
+		for (unsigned int i = 0; i < vertices.size(); i++)
+		{
+			const float* v = &group.vertices[i * ObjLoader::VERTEX_FLOATS];
+			Vertex& vertex = vertices[i];
+			vertex.Position = glm::vec3(v[0], v[1], v[2]);
+			vertex.Normal = glm::vec3(v[3], v[4], v[5]);
+			vertex.TexCoords = glm::vec2(v[6], v[7]);
+			vertex.Tangent = glm::vec3(0.0f);
+			vertex.Bitangent = glm::vec3(0.0f);
+		}
+
+		// tangent space for normal mapping needs texture coordinates
+		if (group.hasTexCoords)
+			generateTangents(vertices, group.indices);
+
+		// process materials
+		// we assume a convention for sampler names in the shaders. Each diffuse texture should be named
+		// as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
+		// Same applies to other texture as the following list summarizes:
+		// diffuse: texture_diffuseN
+		// specular: texture_specularN
+		// normal: texture_normalN
+		// height: texture_heightN
+		if (group.material >= 0)
+		{
+			const ObjLoader::Material& material = scene.materials[group.material];
+			// 1. diffuse maps
+			loadMaterialTexture(material.diffuseMap, "texture_diffuse", textures);
+			// 2. specular maps
+			loadMaterialTexture(material.specularMap, "texture_specular", textures);
+			// 3. normal maps
+			loadMaterialTexture(material.normalMap, "texture_normal", textures);
+			// 4. height maps
+			loadMaterialTexture(material.heightMap, "texture_height", textures);
+		}
+
+		// return a mesh object created from the extracted mesh data
+		return Mesh(vertices, group.indices, textures, format);
+	}
+
+	// loads a .glb file. Accessors OpenGL can read in place are uploaded straight from the mapped file,
+	// one buffer per buffer view, without building vector<Vertex>; only the others are converted.
+	void loadGltf(string const& path)
+	{
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+
+		GltfLoader::Document document;
+		if (!GltfLoader::load(path.c_str(), document))
+		{
+			cout << "ERROR::GLTFLOADER:: failed to load " << path << endl;
+			return;
+		}
+
+		vector<unsigned int> viewBuffers(document.bufferViews.size(), 0);
+		for (unsigned int i = 0; i < document.meshes.size(); i++)
+		{
+			const GltfLoader::Mesh& mesh = document.meshes[i];
+			for (unsigned int j = 0; j < mesh.primitives.size(); j++)
+				meshes.push_back(processPrimitive(mesh.primitives[j], document, viewBuffers));
+		}
+
+		GltfLoader::Stats& stats = document.stats;
+		stats.totalTime = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - start).count();
+		stats.peakMemory = GltfLoader::getPeakMemoryUsage();
+		GltfLoader::printStats(path.c_str(), stats);
+	}
+
+	Mesh processPrimitive(const GltfLoader::Primitive& primitive, GltfLoader::Document& document, vector<unsigned int>& viewBuffers)
+	{
+		// attribute locations match the Vertex layout of setupFullAttributes(), a missing attribute keeps
+		// the default generic value. glTF tangents are vec4, see the Mesh constructor for the bitangent.
+		const int accessors[] = { primitive.position, primitive.normal, primitive.texCoord, primitive.tangent };
+		vector<MeshAttribute> attributes;
+		for (unsigned int location = 0; location < 4; location++)
+		{
+			if (accessors[location] < 0)
+				continue;
+			const GltfLoader::Accessor& accessor = document.accessors[accessors[location]];
+			MeshAttribute attribute;
+			attribute.location = location;
+			attribute.size = accessor.components;
+			if (GltfLoader::isDirectAttribute(document, accessor))
+			{
+				attribute.buffer = getViewBuffer(accessor.bufferView, document, viewBuffers);
+				attribute.offset = accessor.byteOffset;
+				attribute.type = accessor.componentType;
+				attribute.normalized = accessor.normalized ? GL_TRUE : GL_FALSE;
+				attribute.stride = document.bufferViews[accessor.bufferView].byteStride;
+			}
+			else
+			{
+				vector<float> data;
+				GltfLoader::readAccessor(document, accessor, data);
+				attribute.buffer = createBuffer(data.data(), data.size() * sizeof(float));
+				document.stats.convertedBytes += data.size() * sizeof(float);
+				attribute.offset = 0;
+				attribute.type = GL_FLOAT;
+				attribute.normalized = GL_FALSE;
+				attribute.stride = 0;
+			}
+			attributes.push_back(attribute);
+		}
+
+		// indices, non-indexed primitives draw their vertices in order
+		const unsigned int vertexCount = document.accessors[primitive.position].count;
+		unsigned int indexBuffer;
+		size_t indexOffset = 0;
+		GLenum indexType;
+		unsigned int indexCount;
+		if (primitive.indices >= 0 && GltfLoader::isDirectIndexBuffer(document, document.accessors[primitive.indices]))
+		{
+			const GltfLoader::Accessor& accessor = document.accessors[primitive.indices];
+			indexBuffer = getViewBuffer(accessor.bufferView, document, viewBuffers);
+			indexOffset = accessor.byteOffset;
+			indexType = accessor.componentType;
+			indexCount = accessor.count;
+		}
+		else
+		{
+			vector<unsigned int> indices;
+			if (primitive.indices >= 0)
+				GltfLoader::readIndices(document, document.accessors[primitive.indices], indices);
+			else
+				for (unsigned int i = 0; i < vertexCount; i++)
+					indices.push_back(i);
+			indexCount = indices.size();
+
+			if (IndexBuffer::getIndexSize(vertexCount) == sizeof(unsigned short))
+			{
+				vector<unsigned short> shortIndices(indices.size());
+				IndexBuffer::narrow(indices.data(), indices.size(), shortIndices.data());
+				indexBuffer = createBuffer(shortIndices.data(), shortIndices.size() * sizeof(unsigned short));
+				document.stats.convertedBytes += shortIndices.size() * sizeof(unsigned short);
+				indexType = GL_UNSIGNED_SHORT;
+			}
+			else
+			{
+				indexBuffer = createBuffer(indices.data(), indices.size() * sizeof(unsigned int));
+				document.stats.convertedBytes += indices.size() * sizeof(unsigned int);
+				indexType = GL_UNSIGNED_INT;
+			}
+		}
+
+		// process materials, same sampler names as the OBJ path:
+		// base color: texture_diffuseN
+		// metallic-roughness: texture_specularN
+		// normal: texture_normalN
+		vector<Texture> textures;
+		if (primitive.material >= 0 && primitive.material < (int)document.materials.size())
+		{
+			const GltfLoader::Material& material = document.materials[primitive.material];
+			loadGltfTexture(material.baseColorTexture, "texture_diffuse", document, textures);
+			loadGltfTexture(material.metallicRoughnessTexture, "texture_specular", document, textures);
+			loadGltfTexture(material.normalTexture, "texture_normal", document, textures);
+		}
+
+		return Mesh(attributes, indexBuffer, indexOffset, indexType, indexCount, textures);
+	}
+
+	// GL buffer holding a whole buffer view, uploaded from the mapped file on first use
+	unsigned int getViewBuffer(int view, GltfLoader::Document& document, vector<unsigned int>& viewBuffers)
+	{
+		if (viewBuffers[view] == 0)
+		{
+			const GltfLoader::BufferView& bufferView = document.bufferViews[view];
+			viewBuffers[view] = createBuffer(document.bin + bufferView.byteOffset, bufferView.byteLength);
+			document.stats.directBytes += bufferView.byteLength;
+		}
+		return viewBuffers[view];
+	}
+
+	unsigned int createBuffer(const void* data, size_t size)
+	{
+		unsigned int buffer;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		buffers.push_back(buffer);
+		return buffer;
+	}
+
+	// loads a glTF texture (embedded in the BIN chunk or an external file) if it's not loaded yet
+	void loadGltfTexture(int textureIndex, const string& typeName, const GltfLoader::Document& document, vector<Texture>& textures)
+	{
+		if (textureIndex < 0 || textureIndex >= (int)document.textures.size())
+			return;
+		int imageIndex = document.textures[textureIndex];
+		if (imageIndex < 0 || imageIndex >= (int)document.images.size())
+			return;
+
+		const GltfLoader::Image& image = document.images[imageIndex];
+		if (image.bufferView < 0)
+		{
+			loadMaterialTexture(image.uri, typeName, textures);
+			return;
+		}
+
+		// embedded images have no path, use the image index as the key
+		string key = "#image" + std::to_string(imageIndex);
+		for (unsigned int j = 0; j < textures_loaded.size(); j++)
+		{
+			if (textures_loaded[j].path == key)
+			{
+				textures.push_back(textures_loaded[j]);
+				return;
+			}
+		}
+
+		const GltfLoader::BufferView& view = document.bufferViews[image.bufferView];
+		Texture texture;
+		texture.id = TextureFromMemory(document.bin + view.byteOffset, view.byteLength);
+		texture.type = typeName;
+		texture.path = key;
+		textures.push_back(texture);
+		textures_loaded.push_back(texture);
+	}
+
+	// loads a material texture if it's not loaded yet and appends it to textures.
+	void loadMaterialTexture(const string& file, const string& typeName, vector<Texture>& textures)
+	{
+		if (file.empty())
+			return;
+
+		// check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
+		for (unsigned int j = 0; j < textures_loaded.size(); j++)
+		{
+			if (textures_loaded[j].path == file)
+			{
+				textures.push_back(textures_loaded[j]);
+				return;
+			}
+		}
+
+		// if texture hasn't been loaded already, load it
+		Texture texture;
+		texture.id = TextureFromFile(file.c_str(), this->directory);
+		texture.type = typeName;
+		texture.path = file;
+		textures.push_back(texture);
+		textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+	}
+};
+
+
+// uploads decoded pixels (1 to 4 components) with mipmaps, 0 if data is null
+inline unsigned int TextureFromData(unsigned char* data, int width, int height, int nrComponents)
+{
+	unsigned int textureID;
+	glGenTextures(1, &textureID);
+
+	if (data)
+	{
+		GLenum format = GL_RGB;
+		if (nrComponents == 1)
+			format = GL_RED;
+		else if (nrComponents == 3)
+			format = GL_RGB;
+		else if (nrComponents == 4)
+			format = GL_RGBA;
+
+		glBindTexture(GL_TEXTURE_2D, textureID);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		stbi_image_free(data);
+	}
+
+	return textureID;
+}
+
+inline unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
+{
+	string filename = string(path);
+	filename = directory + '/' + filename;
+
+	int width, height, nrComponents;
+	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+	if (!data)
+		std::cout << "Texture failed to load at path: " << path << std::endl;
+	return TextureFromData(data, width, height, nrComponents);
+}
+
+// decodes an image file held in memory, e.g. a PNG or JPEG embedded in a .glb
+inline unsigned int TextureFromMemory(const unsigned char* buffer, size_t size, bool gamma)
+{
+	int width, height, nrComponents;
+	unsigned char* data = stbi_load_from_memory(buffer, (int)size, &width, &height, &nrComponents, 0);
+	if (!data)
+		std::cout << "Texture failed to load from memory" << std::endl;
+	return TextureFromData(data, width, height, nrComponents);
+}
+#endif